@@ -68,6 +68,10 @@ usage(FILE *stream) {
   "\nSignature:\n%s"
   "\nOptions are:\n"
   "\t-s scriptnumber: Execute only this script (counting from 1)\n"
+  "\t-j nr_of_threads: Process epochs in parallel where the iterated queue allows it\n"
+  "\t-p: Print a table of the time spent in each method after each script\n"
+  "\t-P tracefile: As -p, and write each method call to tracefile (Chrome trace JSON)\n"
+  "\t-R resultfile: As -p, and append the tables to resultfile as tab-separated values\n"
 #ifndef STANDALONE
   "\t-l: List all available methods\n"
   "\t-h methodname: Describe method methodname\n"
@@ -92,7 +96,8 @@ int
 main(int argc, char **argv) {
  int errflag=0, c;
  int nr_of_script_variables, variables_requested1, variables_requested2, max_var_requested;
- Bool dumponly=FALSE;
+ Bool dumponly=FALSE, profile=FALSE;
+ char const *profile_tracefile=NULL, *profile_resultfile=NULL;
  FILE * const dumpfile=stdout;
  int only_script=0;
  char const * const validate_msg=validate(argv[0]);
@@ -131,9 +136,9 @@ main(int argc, char **argv) {
  /*}}}  */
  /*{{{  Process command line*/
 #ifndef STANDALONE
-#define GETOPT_STRING "t:lHh:Ds:"
+#define GETOPT_STRING "t:lHh:Ds:j:pP:R:"
 #else
-#define GETOPT_STRING "t:Ds:"
+#define GETOPT_STRING "t:Ds:j:pP:R:"
 #endif
  const struct option longopts[]={{"help",no_argument,NULL,'?'},{"version",no_argument,NULL,'V'},{NULL,0,NULL,0}};
  while ((c=getopt_long(argc, argv, GETOPT_STRING, longopts, NULL))!=-1) {
@@ -159,6 +164,25 @@ main(int argc, char **argv) {
    case 's':
     only_script=atoi(optarg);
     break;
+   case 'j':
+    emethod.nr_of_threads=atoi(optarg);
+#ifndef _OPENMP
+    if (emethod.nr_of_threads>1) {
+     fprintf(stderr, "%s: Compiled without OpenMP support, -j has no effect.\n", argv[0]);
+     emethod.nr_of_threads=1;
+    }
+#endif
+    break;
+   case 'R':
+    profile_resultfile=optarg;
+    profile=TRUE;
+    break;
+   case 'P':
+    profile_tracefile=optarg;
+    /* Fall through */
+   case 'p':
+    profile=TRUE;
+    break;
    case 'V':
     fprintf(stdout, "%s", get_avg_q_signature());
     exit(0);
@@ -182,6 +206,7 @@ main(int argc, char **argv) {
  /* Since the trace level might have changed... */
  clear_external_methods(&emethod);
  trafo_std_defaults(&tinfostruc);
+ if (profile && !dumponly) profile_start(&tinfostruc, profile_tracefile, profile_resultfile);
 
  {
 #ifndef STANDALONE
@@ -247,6 +272,7 @@ main(int argc, char **argv) {
    fp_exception_init();	/* This sets up the math exception signal handler */
 # endif
    do_queues(&tinfostruc, &iter_queue, &post_queue);
+   if (profile) profile_report(&tinfostruc, stderr);
    /*}}}  */
 
    if (tinfostruc.tsdata!=NULL) {
@@ -308,6 +334,7 @@ main(int argc, char **argv) {
    fp_exception_init();	/* This sets up the math exception signal handler */
 # endif
    do_queues(&tinfostruc, &iter_queue, &post_queue);
+   if (profile) profile_report(&tinfostruc, stderr);
    /*}}}  */
 
    if (tinfostruc.tsdata!=NULL) {
@@ -321,6 +348,7 @@ main(int argc, char **argv) {
  }
 #endif
  }
+ if (profile && !dumponly) profile_end(&tinfostruc);
 
  return 0;
 }
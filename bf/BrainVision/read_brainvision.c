@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2007-2016,2018,2021,2023,2024 Bernd Feige
+ * Copyright (C) 2007-2016,2018,2021,2023,2024,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -74,6 +74,7 @@ enum ARGS_ENUM {
  ARGS_EPOCHS,
  ARGS_OFFSET,
  ARGS_TRIGFILE,
+ ARGS_CHANNELNAMES,
  ARGS_IFILE,
  ARGS_BEFORETRIG,
  ARGS_AFTERTRIG,
@@ -87,6 +88,7 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_LONG, "epochs: Specify maximum number of epochs to get", "e", 1, NULL},
  {T_ARGS_TAKES_STRING_WORD, "offset: The zero point 'beforetrig' is shifted by offset", "o", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_FILENAME, "trigger_file: Read trigger points and codes from this file", "R", ARGDESC_UNUSED, (char const *const *)"*.trg"},
+ {T_ARGS_TAKES_STRING_WORD, "channelnames: Only read these channels (in file order)", "n", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_FILENAME, "Input file (.vhdr/.ahdr)", "", ARGDESC_UNUSED, (char const *const *)"*.vhdr"},
  {T_ARGS_TAKES_STRING_WORD, "beforetrig", "", ARGDESC_UNUSED, (char const *const *)"1s"},
  {T_ARGS_TAKES_STRING_WORD, "aftertrig", "", ARGDESC_UNUSED, (char const *const *)"1s"}
@@ -97,10 +99,12 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
 struct read_brainvision_storage {
  FILE *infile;	/* Input file */
  int *trigcodes;
- int current_trigger;
+ struct trigger_epochs trigger_epochs;
  growing_buf triggers;
  int nr_of_channels;
  int nr_of_binchannels; /* Storage channels are nr_of_channels+1 for V-Amps */
+ Bool *channel_selected;	/* NULL if all channels are read */
+ int nr_of_selected;
  int itemsize;
  long points_in_file;
  long bytes_per_point;
@@ -135,6 +139,7 @@ read_brainvision_get_filestrings(transform_info_ptr tinfo) {
  int channel, ntokens;
 
  tinfo->xdata=NULL;
+ tinfo->nr_of_channels=local_arg->nr_of_channels;
  if ((tinfo->channelnames=(char **)malloc(tinfo->nr_of_channels*sizeof(char *)))==NULL ||
      (tinfo->comment=(char *)malloc(MAX_COMMENTLEN))==NULL ||
      (innamebuf=(char *)malloc(local_arg->channelnames_buf.current_length))==NULL) {
@@ -165,16 +170,10 @@ read_brainvision_get_filestrings(transform_info_ptr tinfo) {
   tinfo->probepos=NULL;
   create_channelgrid(tinfo);
  }
+ if (local_arg->channel_selected!=NULL) select_channelinfo(tinfo, local_arg->channel_selected);
 }
 /*}}}  */
 
-/*{{{  Maintaining the triggers list*/
-LOCAL void 
-read_brainvision_reset_triggerbuffer(transform_info_ptr tinfo) {
- struct read_brainvision_storage *local_arg=(struct read_brainvision_storage *)tinfo->methods->local_storage;
- local_arg->current_trigger=0;
-}
-/*}}}  */
 /*{{{  read_brainvision_build_trigbuffer(transform_info_ptr tinfo) {*/
 /* This function has all the knowledge about events in the various file types */
 LOCAL void 
@@ -280,32 +279,6 @@ reevaluate:
  }
 }
 /*}}}  */
-/*{{{  read_brainvision_read_trigger(transform_info_ptr tinfo) {*/
-/* This is the highest-level access function: Read the next trigger and
- * advance the trigger counter. If this function is not called at least
- * once, event information is not even touched. */
-LOCAL int
-read_brainvision_read_trigger(transform_info_ptr tinfo, long *position, char **descriptionp) {
- struct read_brainvision_storage *local_arg=(struct read_brainvision_storage *)tinfo->methods->local_storage;
- int code=0;
- if (local_arg->triggers.buffer_start==NULL) {
-  /* Load the event information */
-  read_brainvision_build_trigbuffer(tinfo);
- }
- {
- int const nevents=local_arg->triggers.current_length/sizeof(struct trigger);
-
- if (local_arg->current_trigger<nevents) {
-  struct trigger * const intrig=((struct trigger *)local_arg->triggers.buffer_start)+local_arg->current_trigger;
-  *position=intrig->position;
-   code    =intrig->code;
-  if (descriptionp!=NULL) *descriptionp=intrig->description;
- }
- }
- local_arg->current_trigger++;
- return code;
-}
-/*}}}  */
 
 /*{{{  read_brainvision_init(transform_info_ptr tinfo) {*/
 METHODDEF void
@@ -506,6 +479,28 @@ reevaluate:
   ERREXIT(tinfo->emethods, "read_brainvision_init: No channel table!\n");
  }
 
+ /*{{{  Resolve the channel selection*/
+ local_arg->channel_selected=NULL;
+ local_arg->nr_of_selected=local_arg->nr_of_channels;
+ if (args[ARGS_CHANNELNAMES].is_set) {
+  char **channelnames;
+  int channel;
+  if (growing_buf_count_tokens(&local_arg->channelnames_buf)!=local_arg->nr_of_channels) {
+   ERREXIT(tinfo->emethods, "read_brainvision_init: Channel count mismatch\n");
+  }
+  if ((channelnames=(char **)malloc(local_arg->nr_of_channels*sizeof(char *)))==NULL) {
+   ERREXIT(tinfo->emethods, "read_brainvision_init: Error allocating channelnames\n");
+  }
+  local_arg->channelnames_buf.current_token=local_arg->channelnames_buf.buffer_start;
+  for (channel=0; channel<local_arg->nr_of_channels; channel++) {
+   channelnames[channel]=local_arg->channelnames_buf.current_token;
+   growing_buf_get_nexttoken(&local_arg->channelnames_buf,NULL);
+  }
+  local_arg->channel_selected=expand_channel_selection(tinfo, args[ARGS_CHANNELNAMES].arg.s, local_arg->nr_of_channels, channelnames, &local_arg->nr_of_selected);
+  free(channelnames);
+ }
+ /*}}}  */
+
  /*{{{  Parse arguments that can be in seconds*/
  tinfo->sfreq=local_arg->sfreq;
  local_arg->beforetrig=tinfo->beforetrig=gettimeslice(tinfo, args[ARGS_BEFORETRIG].arg.s);
@@ -546,7 +541,10 @@ reevaluate:
   }
  }
 
- read_brainvision_reset_triggerbuffer(tinfo);
+ trigger_epochs_init(&local_arg->trigger_epochs, &local_arg->triggers, &read_brainvision_build_trigbuffer);
+ local_arg->trigger_epochs.trigcodes=local_arg->trigcodes;
+ local_arg->trigger_epochs.offset=local_arg->offset;
+ local_arg->trigger_epochs.points_in_file=local_arg->points_in_file;
  local_arg->current_point=0;
 
  tinfo->methods->init_done=TRUE;
@@ -617,6 +615,16 @@ read_value(FILE *infile,
 }
 /*}}}  */
 
+/*{{{  read_brainvision_next_channel: Skip channel numbers not selected*/
+LOCAL int
+read_brainvision_next_channel(struct read_brainvision_storage *local_arg, int channel) {
+ if (local_arg->channel_selected!=NULL) {
+  while (channel<local_arg->nr_of_channels && !local_arg->channel_selected[channel]) channel++;
+ }
+ return channel;
+}
+/*}}}  */
+
 /*{{{  read_brainvision(transform_info_ptr tinfo) {*/
 /*
  * The method read_brainvision() returns a pointer to the allocated tsdata memory
@@ -632,15 +640,16 @@ read_brainvision(transform_info_ptr tinfo) {
  transform_argument *args=tinfo->methods->arguments;
  array myarray;
  FILE *infile=local_arg->infile;
- Bool not_correct_trigger=FALSE;
  long trigger_point, file_start_point, file_end_point;
+ long const valuesize=local_arg->itemsize*datatype_size[local_arg->datatype];
  char *description=NULL;
+ int channel;
 
  if (local_arg->epochs--==0) return NULL;
  tinfo->beforetrig=local_arg->beforetrig;
  tinfo->aftertrig=local_arg->aftertrig;
  tinfo->nr_of_points=local_arg->beforetrig+local_arg->aftertrig;
- tinfo->nr_of_channels=local_arg->nr_of_channels;
+ tinfo->nr_of_channels=local_arg->nr_of_selected;
  tinfo->multiplexed=local_arg->multiplexed;
  tinfo->itemsize=local_arg->itemsize;
  tinfo->nrofaverages=1;
@@ -656,55 +665,28 @@ read_brainvision(transform_info_ptr tinfo) {
    trigger_point=file_start_point+tinfo->beforetrig;
    file_end_point=trigger_point+tinfo->aftertrig-1;
    if (local_arg->points_in_file>0 && file_end_point>=local_arg->points_in_file) return NULL;
-   local_arg->current_trigger++;
+   local_arg->trigger_epochs.current_trigger++;
    local_arg->current_point+=tinfo->nr_of_points;
    tinfo->condition=0;
-  } else 
-  do {
-   tinfo->condition=read_brainvision_read_trigger(tinfo, &trigger_point, &description);
+  } else {
+   tinfo->condition=trigger_epochs_next(tinfo, &local_arg->trigger_epochs, tinfo->beforetrig, tinfo->aftertrig);
    if (tinfo->condition==0) return NULL;	/* No more triggers in file */
-   file_start_point=trigger_point-tinfo->beforetrig+local_arg->offset;
-   file_end_point=trigger_point+tinfo->aftertrig-1-local_arg->offset;
-   
-   if (local_arg->trigcodes==NULL) {
-    not_correct_trigger=FALSE;
-   } else {
-    int trigno=0;
-    not_correct_trigger=TRUE;
-    while (local_arg->trigcodes[trigno]!=0) {
-     if (local_arg->trigcodes[trigno]==tinfo->condition) {
-      not_correct_trigger=FALSE;
-      break;
-     }
-     trigno++;
-    }
-   }
-  } while (not_correct_trigger || file_start_point<0 || (local_arg->points_in_file>0 && file_end_point>=local_arg->points_in_file));
+   trigger_point=local_arg->trigger_epochs.trigger_point;
+   file_start_point=local_arg->trigger_epochs.start_point;
+   file_end_point=local_arg->trigger_epochs.end_point;
+   description=local_arg->trigger_epochs.description;
+  }
  } while (--local_arg->fromepoch>0);
  if (description==NULL) {
-  TRACEMS3(tinfo->emethods, 1, "read_brainvision: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
+  TRACEMS3(tinfo->emethods, 1, "read_brainvision: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
  } else {
-  TRACEMS4(tinfo->emethods, 1, "read_brainvision: Reading around tag %d at %d, condition=%d, description=%s\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition), MSGPARM(description));
+  TRACEMS4(tinfo->emethods, 1, "read_brainvision: Reading around tag %d at %d, condition=%d, description=%s\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition), MSGPARM(description));
  }
  /*}}}  */
 
  /*{{{  Handle triggers within the epoch (option -T)*/
  if (args[ARGS_TRIGTRANSFER].is_set) {
-  int code;
-  long trigpoint;
-  long const old_current_trigger=local_arg->current_trigger;
-  char *thisdescription;
-
-  /* First trigger entry holds file_start_point */
-  push_trigger(&tinfo->triggers, file_start_point, -1, NULL);
-  read_brainvision_reset_triggerbuffer(tinfo);
-  for (; (code=read_brainvision_read_trigger(tinfo, &trigpoint, &thisdescription))!=0;) {
-   if (trigpoint>=file_start_point && trigpoint<=file_end_point) {
-    push_trigger(&tinfo->triggers, trigpoint-file_start_point, code, thisdescription);
-   }
-  }
-  push_trigger(&tinfo->triggers, 0L, 0, NULL); /* End of list */
-  local_arg->current_trigger=old_current_trigger;
+  trigger_epochs_transfer(tinfo, &local_arg->trigger_epochs, &tinfo->triggers, file_start_point, file_end_point);
  }
  /*}}}  */
 
@@ -742,20 +724,28 @@ read_brainvision(transform_info_ptr tinfo) {
  switch ((enum ERROR_ENUM)setjmp(local_arg->error_jmp)) {
   case ERR_NONE:
    local_arg->first_in_epoch=TRUE;
+   channel=0;
    do {
     double resolution=1.0;
     if (!local_arg->multiplexed) {
      /* Nonmultiplexed: read all data of one channel at once, but need to seek for every channel */
-     int const channel=myarray.current_vector;
+     channel=read_brainvision_next_channel(local_arg, channel);
      resolution=((double *)local_arg->resolutions_buf.buffer_start)[channel];
-     fseek(infile, (local_arg->points_in_file*channel+file_start_point)*local_arg->itemsize*datatype_size[local_arg->datatype], SEEK_SET);
+     fseek(infile, (local_arg->points_in_file*channel+file_start_point)*valuesize, SEEK_SET);
+     channel++;
+    } else {
+     channel=0;
     }
     do {
      DATATYPE * const item0_addr=ARRAY_ELEMENT(&myarray);
      int itempart;
      if (local_arg->multiplexed) {
-      int const channel=myarray.current_element;
+      /* Seek over the values of channels not selected */
+      int const next_channel=read_brainvision_next_channel(local_arg, channel);
+      if (next_channel>channel) fseek(infile, (next_channel-channel)*valuesize, SEEK_CUR);
+      channel=next_channel;
       resolution=((double *)local_arg->resolutions_buf.buffer_start)[channel];
+      channel++;
      }
      /* Multiple items are always stored side by side: */
      for (itempart=0; itempart<tinfo->itemsize; itempart++) {
@@ -764,6 +754,9 @@ read_brainvision(transform_info_ptr tinfo) {
      array_advance(&myarray);
      local_arg->first_in_epoch=FALSE;
     } while (myarray.message==ARRAY_CONTINUE);
+    if (local_arg->multiplexed && channel<local_arg->nr_of_channels) {
+     fseek(infile, (local_arg->nr_of_channels-channel)*valuesize, SEEK_CUR);
+    }
     if (local_arg->V_Amp) read_value(infile, local_arg); /* Read the "signature" channel */
    } while (myarray.message!=ARRAY_ENDOFSCAN);
    break;
@@ -806,9 +799,11 @@ read_brainvision_exit(transform_info_ptr tinfo) {
  growing_buf_free(&local_arg->channelnames_buf);
  growing_buf_free(&local_arg->resolutions_buf);
  growing_buf_free(&local_arg->coordinates_buf);
+ free_pointer((void **)&local_arg->channel_selected);
  if (local_arg->infile!=NULL) fclose(local_arg->infile);
  free_pointer((void **)&local_arg->markerfilename);
  free_pointer((void **)&local_arg->trigcodes);
+ trigger_epochs_free(&local_arg->trigger_epochs);
 
  if (local_arg->triggers.buffer_start!=NULL) {
   clear_triggers(&local_arg->triggers);
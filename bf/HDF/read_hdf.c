@@ -100,8 +100,9 @@ struct read_hdf_storage {
  char descbuf[DESCBUF_LEN];
 
  int *trigcodes;
- int current_trigger;
+ int current_trigger;	/* For epoched data sets */
  growing_buf triggers;
+ struct trigger_epochs trigger_epochs;	/* For continuous data sets */
 };
 /*}}}  */
 
@@ -291,6 +292,7 @@ read_hdf_init(transform_info_ptr tinfo) {
   }
  }
  read_hdf_reset_triggerbuffer(tinfo);
+ trigger_epochs_init(&local_arg->trigger_epochs, &local_arg->triggers, &read_hdf_build_trigbuffer);
  local_arg->current_dataset=0;
  local_arg->current_point=0;
  local_arg->sdsid=local_arg->rank=FAIL;
@@ -317,8 +319,14 @@ read_hdf(transform_info_ptr tinfo) {
 
  if (local_arg->sdsid==FAIL) {
   /* A new dataset must be found; it carries its own triggers. */
-  growing_buf_clear(&local_arg->triggers);
+  trigger_epochs_free(&local_arg->trigger_epochs);
+  if (local_arg->triggers.buffer_start!=NULL) {
+   clear_triggers(&local_arg->triggers);
+   growing_buf_free(&local_arg->triggers);
+  }
   read_hdf_reset_triggerbuffer(tinfo);
+  trigger_epochs_init(&local_arg->trigger_epochs, &local_arg->triggers, &read_hdf_build_trigbuffer);
+  local_arg->trigger_epochs.trigcodes=local_arg->trigcodes;
   local_arg->current_point=0;
  
   /*{{{  Select the next suitable dataset*/
@@ -484,54 +492,40 @@ read_hdf(transform_info_ptr tinfo) {
     trigger_point=file_start_point+tinfo->beforetrig;
     file_end_point=trigger_point+tinfo->aftertrig-1;
     if (file_end_point>=local_arg->dims[local_arg->pointsdim]) return NULL;
-    local_arg->current_trigger++;
+    local_arg->trigger_epochs.current_trigger++;
     local_arg->current_point+=tinfo->nr_of_points;
     tinfo->condition=0;
    } else {
-    Bool not_correct_trigger=FALSE;
-    char *description=NULL;
-    do {
-     tinfo->condition=read_hdf_read_trigger(tinfo, &trigger_point, &description);
-     if (tinfo->condition==0) return NULL;	/* No more triggers in file */
-     file_start_point=trigger_point-tinfo->beforetrig+offset;
-     file_end_point=trigger_point+tinfo->aftertrig-1-offset;
-     
-     if (local_arg->trigcodes==NULL) {
-      not_correct_trigger=FALSE;
-     } else {
-      int trigno=0;
-      not_correct_trigger=TRUE;
-      while (local_arg->trigcodes[trigno]!=0) {
-       if (local_arg->trigcodes[trigno]==tinfo->condition) {
-	not_correct_trigger=FALSE;
-	break;
-       }
-       trigno++;
-      }
-     }
-    } while (not_correct_trigger || file_start_point<0 || file_end_point>=local_arg->dims[local_arg->pointsdim]);
+    local_arg->trigger_epochs.offset=offset;
+    local_arg->trigger_epochs.points_in_file=local_arg->dims[local_arg->pointsdim];
+    tinfo->condition=trigger_epochs_next(tinfo, &local_arg->trigger_epochs, tinfo->beforetrig, tinfo->aftertrig);
+    if (tinfo->condition==0) return NULL;	/* No more triggers in file */
+    trigger_point=local_arg->trigger_epochs.trigger_point;
+    file_start_point=local_arg->trigger_epochs.start_point;
+    file_end_point=local_arg->trigger_epochs.end_point;
    }
   }
   if (local_arg->fromepoch<=1) break;
   local_arg->fromepoch--;
  }
- TRACEMS3(tinfo->emethods, 1, "read_hdf: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
+ TRACEMS3(tinfo->emethods, 1, "read_hdf: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
  /*}}}  */
  //printf("nr_of_points=%ld, beforetrig=%ld, aftertrig=%ld, file_start_point=%ld\n", tinfo->nr_of_points, tinfo->beforetrig, tinfo->aftertrig, file_start_point);
  file_end_point=file_start_point+tinfo->nr_of_points-1;
 
  /*{{{  Handle triggers within the epoch (option -T)*/
  if (args[ARGS_TRIGTRANSFER].is_set) {
-  int code;
-  long trigpoint;
-  long const old_current_trigger=local_arg->current_trigger;
-  char *thisdescription;
-
-  read_hdf_reset_triggerbuffer(tinfo);
-  /* First trigger entry holds file_start_point */
   if (dimsize0==0) {
-   push_trigger(&tinfo->triggers, file_start_point, -1, NULL);
+   trigger_epochs_transfer(tinfo, &local_arg->trigger_epochs, &tinfo->triggers, file_start_point, file_end_point);
   } else {
+   /* Epoched data sets carry only their own triggers */
+   int code;
+   long trigpoint;
+   long const old_current_trigger=local_arg->current_trigger;
+   char *thisdescription;
+
+   read_hdf_reset_triggerbuffer(tinfo);
+   /* First trigger entry holds file_start_point */
    code=read_hdf_read_trigger(tinfo, &trigpoint, &thisdescription);
    if (code== -1) {
     /* File start already coded in epoch read - transfer it */
@@ -540,14 +534,14 @@ read_hdf(transform_info_ptr tinfo) {
     read_hdf_reset_triggerbuffer(tinfo); /* Back to the first trigger */
     push_trigger(&tinfo->triggers, file_start_point, -1, NULL);
    }
-  }
-  for (; (code=read_hdf_read_trigger(tinfo, &trigpoint, &thisdescription))!=0;) {
-   if (trigpoint>=file_start_point && trigpoint<=file_end_point) {
-    push_trigger(&tinfo->triggers, trigpoint-file_start_point, code, thisdescription);
+   for (; (code=read_hdf_read_trigger(tinfo, &trigpoint, &thisdescription))!=0;) {
+    if (trigpoint>=file_start_point && trigpoint<=file_end_point) {
+     push_trigger(&tinfo->triggers, trigpoint-file_start_point, code, thisdescription);
+    }
    }
+   push_trigger(&tinfo->triggers, 0, 0, NULL); /* End of list */
+   local_arg->current_trigger=old_current_trigger;
   }
-  push_trigger(&tinfo->triggers, 0, 0, NULL); /* End of list */
-  local_arg->current_trigger=old_current_trigger;
  }
  /*}}}  */
 
@@ -637,6 +631,7 @@ read_hdf_exit(transform_info_ptr tinfo) {
  SDend(local_arg->fileid);
  free_pointer((void **)&local_arg->trigcodes);
 
+ trigger_epochs_free(&local_arg->trigger_epochs);
  if (local_arg->triggers.buffer_start!=NULL) {
   clear_triggers(&local_arg->triggers);
   growing_buf_free(&local_arg->triggers);
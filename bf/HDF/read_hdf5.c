@@ -53,6 +53,7 @@ enum ARGS_ENUM {
  ARGS_EPOCHS,
  ARGS_OFFSET,
  ARGS_TRIGFILE,
+ ARGS_CHANNELNAMES,
  ARGS_IFILE,
  ARGS_BEFORETRIG,
  ARGS_AFTERTRIG,
@@ -66,6 +67,7 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_LONG, "epochs: Specify maximum number of epochs to get", "e", 1, NULL},
  {T_ARGS_TAKES_STRING_WORD, "offset: The zero point 'beforetrig' is shifted by offset", "o", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_FILENAME, "trigger_file: Read trigger points and codes from this file", "R", ARGDESC_UNUSED, (const char *const *)"*.trg"},
+ {T_ARGS_TAKES_STRING_WORD, "channelnames: Only read these channels (in file order)", "n", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_FILENAME, "Input file", "", ARGDESC_UNUSED, (const char *const *)"*.hdf5"},
  {T_ARGS_TAKES_STRING_WORD, "beforetrig", " ", ARGDESC_UNUSED, (const char *const *)"1s"},
  {T_ARGS_TAKES_STRING_WORD, "aftertrig", " ", ARGDESC_UNUSED, (const char *const *)"1s"}
@@ -105,11 +107,14 @@ struct read_hdf5_storage {
  int pointsdim;
  int channelsdim;
  Bool is_continuous;     /* TRUE if the points dim is unlimited                */
+ Bool *channel_selected; /* Channels of the current dataset selected by -n     */
+ int file_channels;      /* Size of the channels dim of the current dataset   */
  char descbuf[DESCBUF_LEN];
 
  int *trigcodes;
- int current_trigger;
+ int current_trigger;	/* For epoched data sets */
  growing_buf triggers;
+ struct trigger_epochs trigger_epochs;	/* For continuous data sets */
 };
 /*}}}  */
 
@@ -566,6 +571,7 @@ read_hdf5_init(transform_info_ptr tinfo) {
   }
  }
  read_hdf5_reset_triggerbuffer(tinfo);
+ trigger_epochs_init(&local_arg->trigger_epochs, &local_arg->triggers, &read_hdf5_build_trigbuffer);
  local_arg->current_dataset=0;
  local_arg->current_point=0;
  local_arg->sdsid=H5I_INVALID_HID;
@@ -574,6 +580,7 @@ read_hdf5_init(transform_info_ptr tinfo) {
  local_arg->pointsdim=-1;
  local_arg->channelsdim=-1;
  local_arg->is_continuous=FALSE;
+ local_arg->channel_selected=NULL;
 
  tinfo->methods->init_done=TRUE;
 }
@@ -597,8 +604,14 @@ read_hdf5(transform_info_ptr tinfo) {
 
  if (local_arg->sdsid==H5I_INVALID_HID) {
   /* A new dataset must be found; it carries its own triggers. */
-  growing_buf_clear(&local_arg->triggers);
+  trigger_epochs_free(&local_arg->trigger_epochs);
+  if (local_arg->triggers.buffer_start!=NULL) {
+   clear_triggers(&local_arg->triggers);
+   growing_buf_free(&local_arg->triggers);
+  }
   read_hdf5_reset_triggerbuffer(tinfo);
+  trigger_epochs_init(&local_arg->trigger_epochs, &local_arg->triggers, &read_hdf5_build_trigbuffer);
+  local_arg->trigger_epochs.trigcodes=local_arg->trigcodes;
   local_arg->current_point=0;
 
   /*{{{  Select the next suitable dataset*/
@@ -781,6 +794,17 @@ read_hdf5(transform_info_ptr tinfo) {
  }
  /*}}}  */
 
+ /*{{{  Resolve the channel selection against the channels of this dataset*/
+ local_arg->file_channels=tinfo->nr_of_channels;
+ free_pointer((void **)&local_arg->channel_selected);
+ if (args[ARGS_CHANNELNAMES].is_set) {
+  int nr_selected;
+  create_channelgrid(tinfo);
+  local_arg->channel_selected=expand_channel_selection(tinfo, args[ARGS_CHANNELNAMES].arg.s, tinfo->nr_of_channels, tinfo->channelnames, &nr_selected);
+  select_channelinfo(tinfo, local_arg->channel_selected);
+ }
+ /*}}}  */
+
  /*{{{  Allocate the comment*/
  {
   hid_t commentattr=H5Aopen(local_arg->sdsid, "Comment", H5P_DEFAULT);
@@ -850,53 +874,39 @@ read_hdf5(transform_info_ptr tinfo) {
     trigger_point=file_start_point+tinfo->beforetrig;
     file_end_point=trigger_point+tinfo->aftertrig-1;
     if (file_end_point>=local_arg->dims[local_arg->pointsdim]) return NULL;
-    local_arg->current_trigger++;
+    local_arg->trigger_epochs.current_trigger++;
     local_arg->current_point+=tinfo->nr_of_points;
     tinfo->condition=0;
    } else {
-    Bool not_correct_trigger=FALSE;
-    char *description=NULL;
-    do {
-     tinfo->condition=read_hdf5_read_trigger(tinfo, &trigger_point, &description);
-     if (tinfo->condition==0) return NULL;	/* No more triggers in file */
-     file_start_point=trigger_point-tinfo->beforetrig+offset;
-     file_end_point=trigger_point+tinfo->aftertrig-1-offset;
-
-     if (local_arg->trigcodes==NULL) {
-      not_correct_trigger=FALSE;
-     } else {
-      int trigno=0;
-      not_correct_trigger=TRUE;
-      while (local_arg->trigcodes[trigno]!=0) {
-       if (local_arg->trigcodes[trigno]==tinfo->condition) {
-        not_correct_trigger=FALSE;
-        break;
-       }
-       trigno++;
-      }
-     }
-    } while (not_correct_trigger || file_start_point<0 || file_end_point>=local_arg->dims[local_arg->pointsdim]);
+    local_arg->trigger_epochs.offset=offset;
+    local_arg->trigger_epochs.points_in_file=local_arg->dims[local_arg->pointsdim];
+    tinfo->condition=trigger_epochs_next(tinfo, &local_arg->trigger_epochs, tinfo->beforetrig, tinfo->aftertrig);
+    if (tinfo->condition==0) return NULL;	/* No more triggers in file */
+    trigger_point=local_arg->trigger_epochs.trigger_point;
+    file_start_point=local_arg->trigger_epochs.start_point;
+    file_end_point=local_arg->trigger_epochs.end_point;
    }
   }
   if (local_arg->fromepoch<=1) break;
   local_arg->fromepoch--;
  }
- TRACEMS3(tinfo->emethods, 1, "read_hdf5: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
+ TRACEMS3(tinfo->emethods, 1, "read_hdf5: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
  /*}}}  */
  file_end_point=file_start_point+tinfo->nr_of_points-1;
 
  /*{{{  Handle triggers within the epoch (option -T)*/
  if (args[ARGS_TRIGTRANSFER].is_set) {
-  int code;
-  long trigpoint;
-  long const old_current_trigger=local_arg->current_trigger;
-  char *thisdescription;
-
-  read_hdf5_reset_triggerbuffer(tinfo);
-  /* First trigger entry holds file_start_point */
   if (dimsize0==0) {
-   push_trigger(&tinfo->triggers, file_start_point, -1, NULL);
+   trigger_epochs_transfer(tinfo, &local_arg->trigger_epochs, &tinfo->triggers, file_start_point, file_end_point);
   } else {
+   /* Epoched data sets carry only their own triggers */
+   int code;
+   long trigpoint;
+   long const old_current_trigger=local_arg->current_trigger;
+   char *thisdescription;
+
+   read_hdf5_reset_triggerbuffer(tinfo);
+   /* First trigger entry holds file_start_point */
    code=read_hdf5_read_trigger(tinfo, &trigpoint, &thisdescription);
    if (code== -1) {
     /* File start already coded in epoch read - transfer it */
@@ -905,14 +915,14 @@ read_hdf5(transform_info_ptr tinfo) {
     read_hdf5_reset_triggerbuffer(tinfo); /* Back to the first trigger */
     push_trigger(&tinfo->triggers, file_start_point, -1, NULL);
    }
-  }
-  for (; (code=read_hdf5_read_trigger(tinfo, &trigpoint, &thisdescription))!=0;) {
-   if (trigpoint>=file_start_point && trigpoint<=file_end_point) {
-    push_trigger(&tinfo->triggers, trigpoint-file_start_point, code, thisdescription);
+   for (; (code=read_hdf5_read_trigger(tinfo, &trigpoint, &thisdescription))!=0;) {
+    if (trigpoint>=file_start_point && trigpoint<=file_end_point) {
+     push_trigger(&tinfo->triggers, trigpoint-file_start_point, code, thisdescription);
+    }
    }
+   push_trigger(&tinfo->triggers, 0, 0, NULL); /* End of list */
+   local_arg->current_trigger=old_current_trigger;
   }
-  push_trigger(&tinfo->triggers, 0, 0, NULL); /* End of list */
-  local_arg->current_trigger=old_current_trigger;
  }
  /*}}}  */
 
@@ -952,7 +962,29 @@ read_hdf5(transform_info_ptr tinfo) {
 
  /*{{{  Read the data*/
  filespace=H5Dget_space(local_arg->sdsid);
- H5Sselect_hyperslab(filespace, H5S_SELECT_SET, starts, NULL, ends, NULL);
+ if (local_arg->channel_selected==NULL) {
+  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, starts, NULL, ends, NULL);
+ } else {
+  /* Select one hyperslab per run of adjacent selected channels, so that only
+   * these are read. Elements are transferred in file order, matching the
+   * compacted channel order in memory. */
+  hsize_t runstarts[MAXRANK_FOR_MYDATA], runends[MAXRANK_FOR_MYDATA];
+  int channel=0;
+  memcpy(runstarts, starts, sizeof(starts));
+  memcpy(runends, ends, sizeof(ends));
+  H5Sselect_none(filespace);
+  while (channel<local_arg->file_channels) {
+   if (!local_arg->channel_selected[channel]) {
+    channel++;
+    continue;
+   }
+   runstarts[local_arg->channelsdim]=channel;
+   for (runends[local_arg->channelsdim]=0; channel<local_arg->file_channels && local_arg->channel_selected[channel]; channel++) {
+    runends[local_arg->channelsdim]++;
+   }
+   H5Sselect_hyperslab(filespace, H5S_SELECT_OR, runstarts, NULL, runends, NULL);
+  }
+ }
  memspace=H5Screate_simple(local_arg->rank, ends, NULL);
  ret=H5Dread(local_arg->sdsid, H5_MEM_DATATYPE, memspace, filespace, H5P_DEFAULT, myarray.start);
  H5Sclose(memspace);
@@ -1001,7 +1033,9 @@ read_hdf5_exit(transform_info_ptr tinfo) {
  }
  H5Fclose(local_arg->fileid);
  free_pointer((void **)&local_arg->trigcodes);
+ free_pointer((void **)&local_arg->channel_selected);
 
+ trigger_epochs_free(&local_arg->trigger_epochs);
  if (local_arg->triggers.buffer_start!=NULL) {
   clear_triggers(&local_arg->triggers);
   growing_buf_free(&local_arg->triggers);
@@ -60,8 +60,8 @@ struct read_Inomed_storage {
  MULTI_CHANNEL_CONTINUOUS EEG;
  FILE *infile;
  int *trigcodes;
- int current_trigger;
  growing_buf triggers;
+ struct trigger_epochs trigger_epochs;
  long headersize;
  long points_in_file;
  long bytes_per_point;
@@ -76,13 +76,6 @@ struct read_Inomed_storage {
 };
 /*}}}  */
 
-/*{{{  Maintaining the triggers list*/
-LOCAL void 
-read_Inomed_reset_triggerbuffer(transform_info_ptr tinfo) {
- struct read_Inomed_storage *local_arg=(struct read_Inomed_storage *)tinfo->methods->local_storage;
- local_arg->current_trigger=0;
-}
-/*}}}  */
 /*{{{  read_Inomed_build_trigbuffer(transform_info_ptr tinfo) {*/
 /* This function has all the knowledge about events in the various file types */
 LOCAL void 
@@ -115,32 +108,6 @@ read_Inomed_build_trigbuffer(transform_info_ptr tinfo) {
  }
 }
 /*}}}  */
-/*{{{  read_Inomed_read_trigger(transform_info_ptr tinfo) {*/
-/* This is the highest-level access function: Read the next trigger and
- * advance the trigger counter. If this function is not called at least
- * once, event information is not even touched. */
-LOCAL int
-read_Inomed_read_trigger(transform_info_ptr tinfo, long *position, char **descriptionp) {
- struct read_Inomed_storage *local_arg=(struct read_Inomed_storage *)tinfo->methods->local_storage;
- int code=0;
- if (local_arg->triggers.buffer_start==NULL) {
-  /* Load the event information */
-  read_Inomed_build_trigbuffer(tinfo);
- }
- {
- int const nevents=local_arg->triggers.current_length/sizeof(struct trigger);
-
- if (local_arg->current_trigger<nevents) {
-  struct trigger * const intrig=((struct trigger *)local_arg->triggers.buffer_start)+local_arg->current_trigger;
-  *position=intrig->position;
-   code    =intrig->code;
-  if (descriptionp!=NULL) *descriptionp=intrig->description;
- }
- }
- local_arg->current_trigger++;
- return code;
-}
-/*}}}  */
 
 /*{{{  read_Inomed_init(transform_info_ptr tinfo) {*/
 METHODDEF void
@@ -214,8 +181,10 @@ read_Inomed_init(transform_info_ptr tinfo) {
   }
  }
 
- read_Inomed_reset_triggerbuffer(tinfo);
- local_arg->current_trigger=0;
+ trigger_epochs_init(&local_arg->trigger_epochs, &local_arg->triggers, &read_Inomed_build_trigbuffer);
+ local_arg->trigger_epochs.trigcodes=local_arg->trigcodes;
+ local_arg->trigger_epochs.offset=local_arg->offset;
+ local_arg->trigger_epochs.points_in_file=local_arg->points_in_file;
  local_arg->current_point=0;
 
  tinfo->methods->init_done=TRUE;
@@ -252,7 +221,6 @@ read_Inomed(transform_info_ptr tinfo) {
  transform_argument *args=tinfo->methods->arguments;
  array myarray;
  FILE *infile=local_arg->infile;
- Bool not_correct_trigger=FALSE;
  long trigger_point, file_start_point, file_end_point;
  char *description=NULL;
 
@@ -276,55 +244,28 @@ read_Inomed(transform_info_ptr tinfo) {
    trigger_point=file_start_point+tinfo->beforetrig;
    file_end_point=trigger_point+tinfo->aftertrig-1;
    if (local_arg->points_in_file>0 && file_end_point>=local_arg->points_in_file) return NULL;
-   local_arg->current_trigger++;
+   local_arg->trigger_epochs.current_trigger++;
    local_arg->current_point+=tinfo->nr_of_points;
    tinfo->condition=0;
-  } else 
-  do {
-   tinfo->condition=read_Inomed_read_trigger(tinfo, &trigger_point, &description);
+  } else {
+   tinfo->condition=trigger_epochs_next(tinfo, &local_arg->trigger_epochs, tinfo->beforetrig, tinfo->aftertrig);
    if (tinfo->condition==0) return NULL;	/* No more triggers in file */
-   file_start_point=trigger_point-tinfo->beforetrig+local_arg->offset;
-   file_end_point=trigger_point+tinfo->aftertrig-1-local_arg->offset;
-   
-   if (local_arg->trigcodes==NULL) {
-    not_correct_trigger=FALSE;
-   } else {
-    int trigno=0;
-    not_correct_trigger=TRUE;
-    while (local_arg->trigcodes[trigno]!=0) {
-     if (local_arg->trigcodes[trigno]==tinfo->condition) {
-      not_correct_trigger=FALSE;
-      break;
-     }
-     trigno++;
-    }
-   }
-  } while (not_correct_trigger || file_start_point<0 || (local_arg->points_in_file>0 && file_end_point>=local_arg->points_in_file));
+   trigger_point=local_arg->trigger_epochs.trigger_point;
+   file_start_point=local_arg->trigger_epochs.start_point;
+   file_end_point=local_arg->trigger_epochs.end_point;
+   description=local_arg->trigger_epochs.description;
+  }
  } while (--local_arg->fromepoch>0);
  if (description==NULL) {
-  TRACEMS3(tinfo->emethods, 1, "read_Inomed: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
+  TRACEMS3(tinfo->emethods, 1, "read_Inomed: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
  } else {
-  TRACEMS4(tinfo->emethods, 1, "read_Inomed: Reading around tag %d at %d, condition=%d, description=%s\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition), MSGPARM(description));
+  TRACEMS4(tinfo->emethods, 1, "read_Inomed: Reading around tag %d at %d, condition=%d, description=%s\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition), MSGPARM(description));
  }
  /*}}}  */
 
  /*{{{  Handle triggers within the epoch (option -T)*/
  if (args[ARGS_TRIGTRANSFER].is_set) {
-  int code;
-  long trigpoint;
-  long const old_current_trigger=local_arg->current_trigger;
-  char *thisdescription;
-
-  /* First trigger entry holds file_start_point */
-  push_trigger(&tinfo->triggers, file_start_point, -1, NULL);
-  read_Inomed_reset_triggerbuffer(tinfo);
-  for (; (code=read_Inomed_read_trigger(tinfo, &trigpoint, &thisdescription))!=0;) {
-   if (trigpoint>=file_start_point && trigpoint<=file_end_point) {
-    push_trigger(&tinfo->triggers, trigpoint-file_start_point, code, thisdescription);
-   }
-  }
-  push_trigger(&tinfo->triggers, 0, 0, NULL); /* End of list */
-  local_arg->current_trigger=old_current_trigger;
+  trigger_epochs_transfer(tinfo, &local_arg->trigger_epochs, &tinfo->triggers, file_start_point, file_end_point);
  }
  /*}}}  */
 
@@ -397,6 +338,7 @@ read_Inomed_exit(transform_info_ptr tinfo) {
  local_arg->infile=NULL;
  free_pointer((void **)&local_arg->trigcodes);
 
+ trigger_epochs_free(&local_arg->trigger_epochs);
  if (local_arg->triggers.buffer_start!=NULL) {
   clear_triggers(&local_arg->triggers);
   growing_buf_free(&local_arg->triggers);
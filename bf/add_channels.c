@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-1999,2001,2003-2008,2010,2011,2013 Bernd Feige
+ * Copyright (C) 1996-1999,2001,2003-2008,2010,2011,2013,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -278,28 +278,7 @@ add_channels_or_points(transform_info_ptr const to_tinfo, transform_info_ptr con
    }
    /*}}}  */
    /*{{{  Join triggers*/
-   if (from_tinfo->triggers.buffer_start!=NULL) {
-    struct trigger *intrig;
-
-    if (to_tinfo->triggers.buffer_start==NULL) {
-     growing_buf_allocate(&to_tinfo->triggers, 0);
-     /* Record the file position... */
-     growing_buf_append(&to_tinfo->triggers, from_tinfo->triggers.buffer_start, sizeof(struct trigger));
-    } else {
-     /* Delete the end marker */
-     to_tinfo->triggers.current_length-=sizeof(struct trigger);
-    }
-    for (intrig=(struct trigger *)from_tinfo->triggers.buffer_start+1; intrig->code!=0; intrig++) {
-     char *description=intrig->description;
-     if (description!=NULL) {
-      description=(char *)malloc(strlen(intrig->description)+1);
-      strcpy(description,intrig->description);
-     }
-     push_trigger(&to_tinfo->triggers, intrig->position+to_tinfo->nr_of_points, intrig->code, description);
-    }
-    /* Write end marker */
-    push_trigger(&to_tinfo->triggers, 0, 0, NULL);
-   }
+   join_triggers(&to_tinfo->triggers, &from_tinfo->triggers, to_tinfo->nr_of_points);
    /*}}}  */
    break;
   case ADD_ITEMS:
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1997-1999,2002-2004,2010 Bernd Feige
+ * Copyright (C) 1997-1999,2002-2004,2010,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -35,14 +35,145 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_SELECTION, "Add channels, points, items or link epochs", " ", 1, type_choice},
 };
 /*{{{  Global defines*/
+/* Growth factor of the point capacity when appending points */
+#define APPEND_GROWTH(capacity) ((capacity)+(capacity)/2)
+
 struct append_local_struct {
  struct transform_info_struct tinfo;
  transform_info_ptr tinfop;
  int nroffiles;
  enum add_channels_types type;
+ /* For appending points: Number of points allocated in the tsdata of each
+  * linked epoch. Data is stored as for nr_of_points==capacity, and
+  * compacted in append_exit. */
+ long *capacity;
+ int nr_of_capacities;
 };
 /*}}}  */
 
+/*{{{  Appending points in place*/
+/* Rows are the parts of tsdata that grow independently when points are
+ * added: One per shift if multiplexed, else one per shift and channel.
+ * point_size is the number of values per point within a row. */
+LOCAL void
+append_rowlayout(transform_info_ptr tinfo, long *nr_of_rowsp, long *point_size) {
+ int const nrofshifts=(tinfo->data_type==TIME_DATA ? 1 : tinfo->nrofshifts);
+ *nr_of_rowsp=nrofshifts*(tinfo->multiplexed ? 1 : tinfo->nr_of_channels);
+ *point_size=tinfo->itemsize*(tinfo->multiplexed ? tinfo->nr_of_channels : 1);
+}
+
+/* Append the points of from_tinfo to to_tinfo, whose tsdata has room for
+ * *capacityp points per row and is grown geometrically if necessary. */
+LOCAL void
+append_points(transform_info_ptr to_tinfo, transform_info_ptr from_tinfo, long *capacityp) {
+ int const from_nrofshifts=(from_tinfo->data_type==TIME_DATA ? 1 : from_tinfo->nrofshifts);
+ int const to_nrofshifts=(to_tinfo->data_type==TIME_DATA ? 1 : to_tinfo->nrofshifts);
+ int const nr_of_channels=to_tinfo->nr_of_channels, itemsize=to_tinfo->itemsize;
+ long const to_points=(to_tinfo->data_type==FREQ_DATA ? to_tinfo->nroffreq : to_tinfo->nr_of_points);
+ long const from_points=(from_tinfo->data_type==FREQ_DATA ? from_tinfo->nroffreq : from_tinfo->nr_of_points);
+ long const new_points=to_points+from_points;
+ long nr_of_rows, point_size, row;
+ int shift, channel;
+
+ if (from_tinfo->nr_of_channels!=nr_of_channels ||
+     from_tinfo->itemsize!=itemsize ||
+     from_tinfo->data_type!=to_tinfo->data_type ||
+     from_nrofshifts!=to_nrofshifts) {
+  ERREXIT(to_tinfo->emethods, "append: Epoch dimensions do not match.\n");
+ }
+ append_rowlayout(to_tinfo, &nr_of_rows, &point_size);
+
+ if (new_points>*capacityp) {
+  /*{{{  Grow tsdata and xdata*/
+  long const new_capacity=(APPEND_GROWTH(*capacityp)>new_points ? APPEND_GROWTH(*capacityp) : new_points);
+  DATATYPE * const new_tsdata=(DATATYPE *)realloc(to_tinfo->tsdata, nr_of_rows*new_capacity*point_size*sizeof(DATATYPE));
+  if (new_tsdata==NULL) {
+   ERREXIT(to_tinfo->emethods, "append: Error allocating data.\n");
+  }
+  /* Move the rows to their new places, last first */
+  for (row=nr_of_rows-1; row>0; row--) {
+   memmove(new_tsdata+row*new_capacity*point_size, new_tsdata+row*(*capacityp)*point_size, to_points*point_size*sizeof(DATATYPE));
+  }
+  to_tinfo->tsdata=new_tsdata;
+  if (to_tinfo->xdata!=NULL && from_tinfo->xdata!=NULL) {
+   DATATYPE * const new_xdata=(DATATYPE *)realloc(to_tinfo->xdata, new_capacity*sizeof(DATATYPE));
+   if (new_xdata==NULL) {
+    ERREXIT(to_tinfo->emethods, "append: Error allocating xdata memory.\n");
+   }
+   to_tinfo->xdata=new_xdata;
+  }
+  *capacityp=new_capacity;
+  /*}}}  */
+ }
+
+ /*{{{  Copy the new points*/
+ for (shift=0; shift<to_nrofshifts; shift++) {
+  DATATYPE const * const from_shift=from_tinfo->tsdata+shift*from_points*nr_of_channels*itemsize;
+  if (to_tinfo->multiplexed) {
+   DATATYPE * const to_row=to_tinfo->tsdata+(shift*(*capacityp)+to_points)*point_size;
+   if (from_tinfo->multiplexed) {
+    memcpy(to_row, from_shift, from_points*point_size*sizeof(DATATYPE));
+   } else {
+    long point;
+    for (channel=0; channel<nr_of_channels; channel++) {
+     for (point=0; point<from_points; point++) {
+      memcpy(to_row+point*point_size+channel*itemsize, from_shift+(channel*from_points+point)*itemsize, itemsize*sizeof(DATATYPE));
+     }
+    }
+   }
+  } else {
+   for (channel=0; channel<nr_of_channels; channel++) {
+    DATATYPE * const to_row=to_tinfo->tsdata+((shift*nr_of_channels+channel)*(*capacityp)+to_points)*point_size;
+    if (from_tinfo->multiplexed) {
+     long point;
+     for (point=0; point<from_points; point++) {
+      memcpy(to_row+point*itemsize, from_shift+(point*nr_of_channels+channel)*itemsize, itemsize*sizeof(DATATYPE));
+     }
+    } else {
+     memcpy(to_row, from_shift+channel*from_points*itemsize, from_points*itemsize*sizeof(DATATYPE));
+    }
+   }
+  }
+ }
+ /*}}}  */
+
+ /*{{{  Join xdata if available*/
+ /* The output data set will have explicit xdata if both xdata's are present */
+ if (to_tinfo->xdata!=NULL && from_tinfo->xdata!=NULL) {
+  memcpy(to_tinfo->xdata+to_points, from_tinfo->xdata, from_points*sizeof(DATATYPE));
+ } else {
+  free_pointer((void **)&to_tinfo->xdata);
+ }
+ /*}}}  */
+ join_triggers(&to_tinfo->triggers, &from_tinfo->triggers, to_points);
+
+ to_tinfo->nr_of_points=new_points;
+ if (to_tinfo->data_type==FREQ_DATA) to_tinfo->nroffreq=new_points;
+ to_tinfo->length_of_output_region=nr_of_rows*new_points*point_size;
+}
+
+/* Remove the unused capacity between the rows and at the end */
+LOCAL void
+append_compact(transform_info_ptr tinfo, long capacity) {
+ long const points=(tinfo->data_type==FREQ_DATA ? tinfo->nroffreq : tinfo->nr_of_points);
+ long nr_of_rows, point_size, row;
+ DATATYPE *new_tsdata;
+ if (capacity==points) return;
+ append_rowlayout(tinfo, &nr_of_rows, &point_size);
+ for (row=1; row<nr_of_rows; row++) {
+  memmove(tinfo->tsdata+row*points*point_size, tinfo->tsdata+row*capacity*point_size, points*point_size*sizeof(DATATYPE));
+ }
+ /* Shrinking can't fail in practice, but if it does, the old block is fine */
+ if ((new_tsdata=(DATATYPE *)realloc(tinfo->tsdata, nr_of_rows*points*point_size*sizeof(DATATYPE)))!=NULL) {
+  tinfo->tsdata=new_tsdata;
+ }
+ if (tinfo->xdata!=NULL) {
+  DATATYPE * const new_xdata=(DATATYPE *)realloc(tinfo->xdata, points*sizeof(DATATYPE));
+  if (new_xdata!=NULL) tinfo->xdata=new_xdata;
+ }
+}
+/*}}}  */
+
 /*{{{  append_init(transform_info_ptr tinfo)*/
 METHODDEF void
 append_init(transform_info_ptr tinfo) {
@@ -52,6 +183,8 @@ append_init(transform_info_ptr tinfo) {
  localp->tinfo.tsdata=NULL;
  localp->tinfop=NULL;
  localp->nroffiles=0;
+ localp->capacity=NULL;
+ localp->nr_of_capacities=0;
  if (args[ARGS_TYPE].is_set) {
   localp->type=(enum add_channels_types)args[ARGS_TYPE].arg.i;
  } else {
@@ -95,11 +228,25 @@ append(transform_info_ptr tinfo) {
   return tinfo->tsdata;
  } else {	/* !ARGS_LINKEPOCHS */
   transform_info_ptr tinfoptr, tinfop;
+  int linked_epoch;
   /* Go to the start: */
   for (tinfoptr=tinfo; tinfoptr->previous!=NULL; tinfoptr=tinfoptr->previous);
-  for (tinfop= &localp->tinfo; tinfoptr!=NULL; tinfoptr=tinfoptr->next, tinfop=tinfop->next) {
+  for (tinfop= &localp->tinfo, linked_epoch=0; tinfoptr!=NULL; tinfoptr=tinfoptr->next, tinfop=tinfop->next, linked_epoch++) {
    if (tinfop==NULL) {
     ERREXIT(tinfo->emethods, "append: Varying number of linked epochs in input!\n");
+   } else if (localp->type==ADD_POINTS) {
+    /* Points are appended in place to a geometrically growing buffer,
+     * avoiding to copy all data collected so far for each epoch */
+    if (linked_epoch>=localp->nr_of_capacities) {
+     long * const new_capacity=(long *)realloc(localp->capacity, (linked_epoch+1)*sizeof(long));
+     if (new_capacity==NULL) {
+      ERREXIT(tinfo->emethods, "append: Error allocating capacity array\n");
+     }
+     localp->capacity=new_capacity;
+     localp->capacity[linked_epoch]=(tinfop->data_type==FREQ_DATA ? tinfop->nroffreq : tinfop->nr_of_points);
+     localp->nr_of_capacities=linked_epoch+1;
+    }
+    append_points(tinfop, tinfoptr, &localp->capacity[linked_epoch]);
    } else {
    DATATYPE * const newtsdata=add_channels_or_points(tinfop, tinfoptr, /* channel_list= */NULL, localp->type, /* zero_newdata= */FALSE);
    free_pointer((void **)&tinfop->tsdata);
@@ -121,10 +268,17 @@ append_exit(transform_info_ptr tinfo) {
  struct append_local_struct *localp=(struct append_local_struct *)tinfo->methods->local_storage;
 
  if (localp->tinfop!=NULL) {
+  transform_info_ptr tinfop;
+  int linked_epoch;
+  for (tinfop= &localp->tinfo, linked_epoch=0; tinfop!=NULL && linked_epoch<localp->nr_of_capacities; tinfop=tinfop->next, linked_epoch++) {
+   append_compact(tinfop, localp->capacity[linked_epoch]);
+  }
   memcpy(tinfo, &localp->tinfo, sizeof(struct transform_info_struct));
   /* Correct the backwards pointer of the next tinfo to point to us: */
   if (tinfo->next!=NULL) tinfo->next->previous=tinfo;
  }
+ free_pointer((void **)&localp->capacity);
+ localp->nr_of_capacities=0;
 
  tinfo->methods->init_done=FALSE;
 }
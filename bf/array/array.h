@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1994-1996,1999,2004 Bernd Feige
+ * Copyright (C) 1994-1996,1999,2004,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 #ifndef ARRAY_H
@@ -55,12 +55,27 @@ typedef struct array_struct {
 #define READ_ELEMENT(arr)  ((*(arr)->read_element)(arr))
 #define WRITE_ELEMENT(arr, value) ((*(arr)->write_element)(arr, value))
 
+/* A plain strided view of the memory behind an array, for inner loops that
+ * would otherwise call read_element/write_element per element.
+ * Element e of vector v is start[v*vector_skip+e*element_skip].
+ * Obtained by array_get_view(), which fails if the array is currently
+ * used as a ring buffer or has non-standard access functions installed. */
+typedef struct {
+ DATATYPE *start;
+ long element_skip;
+ long vector_skip;
+ int nr_of_elements;
+ int nr_of_vectors;
+} array_view;
+#define ARRAY_VIEW_VECTOR(view, vector) ((view)->start+(long)(vector)*(view)->vector_skip)
+
 enum mult_levels {MULT_CONTRACT, MULT_SAMESIZE, MULT_VECTOR, MULT_BLOWUP};
 
 /*{{{}}}*/
 /*{{{  Functions to access the stored data*/
 void array_setreadwrite(array *thisarray);
 void array_setreadwrite_double(array *thisarray);
+Bool array_get_view(array *thisarray, array_view *view);
 /*}}}  */
 /*{{{  General functions to manipulate arrays*/
 void array_reset(array *thisarray);
@@ -103,11 +118,14 @@ DATATYPE array_abs(array *thisarray);
 DATATYPE array_parameter_linedist(array *x1, array *x2, array *x3);
 DATATYPE array_linedist(array *x1, array *x2, array *x3);
 void array_make_orthogonal(array *array1);
+void array_view_transpose(array_view *view);
+void array_view_multiply(array_view const *a, array_view const *b, array_view *c, DATATYPE alpha, DATATYPE beta);
 
 void array_tred2(array *a, array *d, array *e);
 void array_tqli(array *d, array *e, array *z);
 void array_eigsrt(array *d, array *v);
 void array_svdcmp(array *a, array *w, array *v);
+void array_svd_leading(array *a, array *w, array *v, int ncomps, Bool randomized);
 void array_svd_solution(array *a, array *b, array *x);
 void array_pseudoinverse(array *a);
 int array_ludcmp(array *a, array *indx);
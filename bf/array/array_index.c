@@ -4,6 +4,8 @@
  *  read by the program and not modified in any way.
  * Based on array_hpsort.c derived from the Numerical Recipes (2.0).
  *					-- Bernd Feige 18.10.1993
+ * array_quantile uses selection instead of sorting an index.
+ *					-- Bernd Feige 17.10.2026
  */
 
 #include <stdlib.h>
@@ -56,11 +58,62 @@ array_index(array *a, unsigned long *indx) {
  }
 }
 
+/* Rearrange arr[0..n-1] so that arr[k] is the value that would be there
+ * if arr were sorted, with all smaller or equal values before and all
+ * larger or equal values after it. Based on select() of the Numerical
+ * Recipes (2.0). */
+LOCAL void
+select_element(unsigned long k, unsigned long n, DATATYPE *arr) {
+ unsigned long i,ir,j,l,mid;
+ DATATYPE a,temp;
+
+#define SWAP(a,b) temp=(a);(a)=(b);(b)=temp;
+ l=0;
+ ir=n-1;
+ for (;;) {
+  if (ir <= l+1) {
+   if (ir == l+1 && arr[ir] < arr[l]) {
+    SWAP(arr[l],arr[ir])
+   }
+   return;
+  } else {
+   mid=(l+ir) >> 1;
+   SWAP(arr[mid],arr[l+1])
+   if (arr[l] > arr[ir]) {
+    SWAP(arr[l],arr[ir])
+   }
+   if (arr[l+1] > arr[ir]) {
+    SWAP(arr[l+1],arr[ir])
+   }
+   if (arr[l] > arr[l+1]) {
+    SWAP(arr[l],arr[l+1])
+   }
+   i=l+1;
+   j=ir;
+   a=arr[l+1];
+   for (;;) {
+    do i++; while (arr[i] < a);
+    do j--; while (arr[j] > a);
+    if (j < i) break;
+    SWAP(arr[i],arr[j])
+   }
+   arr[l+1]=arr[j];
+   arr[j]=a;
+   if (j >= k) ir=j-1;
+   if (j <= k) l=i;
+  }
+ }
+#undef SWAP
+}
+
+/* Number of elements for which array_quantile works on the stack */
+#define QUANTILE_STACKSIZE 256
+
 GLOBAL DATATYPE
 array_quantile(array *a, DATATYPE q) {
  int const n=a->nr_of_elements;
- unsigned long i1=(n-1)*q, i2=n*q;
- unsigned long *indx;
+ unsigned long i1=(n-1)*q, i2=n*q, i;
+ DATATYPE stackbuf[QUANTILE_STACKSIZE], *buf=stackbuf;
  DATATYPE d;
 
  if (n==0 || i2>=n) {
@@ -68,15 +121,23 @@ array_quantile(array *a, DATATYPE q) {
   if (i2>=n && i1<n) i2=i1;
   if (n==0 || i2>=n) return 0.0;
  }
- if ((indx=(unsigned long *)malloc(n*sizeof(unsigned long)))==NULL) return 0.0;
- array_index(a, indx);
- a->current_element=indx[i1];
- d=READ_ELEMENT(a);
+ /* The input array is not modified, selection works on a copy */
+ if (n>QUANTILE_STACKSIZE && (buf=(DATATYPE *)malloc(n*sizeof(DATATYPE)))==NULL) return 0.0;
+ for (i=0; i<n; i++) {
+  a->current_element=i;
+  buf[i]=READ_ELEMENT(a);
+ }
+ select_element(i1, n, buf);
+ d=buf[i1];
  if (i2!=i1) {
-  a->current_element=indx[i2];
-  d=(d+READ_ELEMENT(a))/2;
+  /* i2==i1+1: The smallest element above the selected one */
+  DATATYPE d2=buf[i2];
+  for (i=i2+1; i<n; i++) {
+   if (buf[i]<d2) d2=buf[i];
+  }
+  d=(d+d2)/2;
  }
- free(indx);
+ if (buf!=stackbuf) free(buf);
  /* This is cleaner for programs working through data vector for vector: */
  a->current_element=0;
  return d;
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1993-1995,1997 Bernd Feige
+ * Copyright (C) 1993-1995,1997,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*
@@ -102,6 +102,28 @@ array_setreadwrite(array *thisarray) {
 }
 /*}}}  */
 
+/*{{{  array_get_view(array *thisarray, array_view *view) {*/
+/* Describe the memory of thisarray as a plain strided view. This is only
+ * possible if the standard access functions above are installed and the
+ * start of the ring buffer was not moved other than by array_use_item, since
+ * otherwise element addresses may wrap around. The current item is included
+ * in view->start. Returns FALSE if no view can be given. */
+GLOBAL Bool
+array_get_view(array *thisarray, array_view *view) {
+ if (thisarray->read_element!= &array_readelement ||
+     thisarray->write_element!= &array_writeelement ||
+     thisarray->ringstart!=thisarray->start+thisarray->current_item) {
+  return FALSE;
+ }
+ view->start=thisarray->ringstart;
+ view->element_skip=thisarray->element_skip;
+ view->vector_skip=thisarray->vector_skip;
+ view->nr_of_elements=thisarray->nr_of_elements;
+ view->nr_of_vectors=thisarray->nr_of_vectors;
+ return TRUE;
+}
+/*}}}  */
+
 /*{{{  array_remove_vectorrange(array *thisarray, long vector_from, long vector_to) {*/
 /* This function is defined in this place because it depends on the actual
  * representation of the array in memory. The intention is to remove a channel
@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2026 Bernd Feige
+ * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+ */
+/*
+ * array_svd_leading computes the ncomps largest singular values and the
+ * corresponding singular vectors of a (M elements x N vectors), using the
+ * same conventions as array_svdcmp: On return, the first ncomps vectors of
+ * a are the left singular vectors (U), the first ncomps elements of w the
+ * singular values and the first ncomps vectors of v the right singular
+ * vectors (V), such that A~=U W V'. Unlike array_svdcmp, the components are
+ * sorted by decreasing singular value. The other vectors of a and v and
+ * elements of w are undefined. If ncomps exceeds min(M,N), the surplus
+ * singular values and vectors are zero.
+ * The work is done on a dense copy of the array:
+ * - With LAPACK (AVG_Q_WITH_LAPACK), dgesdd computes the exact SVD.
+ * - Otherwise, array_svdcmp is applied to the copy and the result sorted.
+ * - If randomized is TRUE and ncomps is small compared to min(M,N), a
+ *   randomized subspace iteration (Halko, Martinsson & Tropp 2011) finds
+ *   the leading components only, iterating until the singular values are
+ *   stable. This is much faster for eg 256 channels x 30000 points when only
+ *   a few components are needed, but approximate.
+ * a->message is set to ARRAY_ERROR on failure.
+ *					-- Bernd Feige 17.10.2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "array.h"
+
+/* Number of extra vectors in the randomized subspace */
+#define RSVD_OVERSAMPLING 10
+#define RSVD_MAXITERATIONS 50
+/* Relative change of the leading singular values at convergence */
+#define RSVD_TOLERANCE 1e-10
+
+#ifdef AVG_Q_WITH_LAPACK
+extern void dgesdd_(char const *jobz, int const *m, int const *n, double *a, int const *lda, double *s, double *u, int const *ldu, double *vt, int const *ldvt, double *work, int const *lwork, int *iwork, int *info, size_t jobz_len);
+#endif
+
+/*{{{  Dense copies of arrays*/
+/* Dense matrices are stored vector by vector: Element i of vector j of an
+ * m-element matrix is at [j*m+i] */
+LOCAL void
+array_to_dense(array *a, double *dense) {
+ long const m=a->nr_of_elements;
+ array_view view;
+ int i, j;
+ if (array_get_view(a, &view)) {
+  for (j=0; j<view.nr_of_vectors; j++) {
+   DATATYPE const *in=ARRAY_VIEW_VECTOR(&view, j);
+   double *out=dense+j*m;
+   for (i=0; i<m; i++, in+=view.element_skip) out[i]=*in;
+  }
+ } else {
+  for (j=0; j<a->nr_of_vectors; j++) {
+   a->current_vector=j;
+   for (i=0; i<m; i++) {
+    a->current_element=i;
+    dense[j*m+i]=READ_ELEMENT(a);
+   }
+  }
+ }
+ array_reset(a);
+}
+/* Write the first nr_of_vectors vectors of the m-element dense matrix to a */
+LOCAL void
+dense_to_array(double const *dense, int nr_of_vectors, array *a) {
+ long const m=a->nr_of_elements;
+ array_view view;
+ int i, j;
+ if (array_get_view(a, &view)) {
+  for (j=0; j<nr_of_vectors; j++) {
+   DATATYPE *out=ARRAY_VIEW_VECTOR(&view, j);
+   double const *in=dense+j*m;
+   for (i=0; i<m; i++, out+=view.element_skip) *out=in[i];
+  }
+ } else {
+  for (j=0; j<nr_of_vectors; j++) {
+   a->current_vector=j;
+   for (i=0; i<m; i++) {
+    a->current_element=i;
+    WRITE_ELEMENT(a, dense[j*m+i]);
+   }
+  }
+ }
+ array_reset(a);
+}
+/*}}}  */
+
+/*{{{  Dense matrix products*/
+/* Y(m x l)=A(m x n)*X(n x l) */
+LOCAL void
+dense_multiply(double const *A, long m, long n, double const *X, int l, double *Y) {
+ int c;
+ for (c=0; c<l; c++) {
+  double *y=Y+c*m;
+  long i, j;
+  memset(y, 0, m*sizeof(double));
+  for (j=0; j<n; j++) {
+   double const x=X[c*n+j];
+   double const *a=A+j*m;
+   if (x==0.0) continue;
+   for (i=0; i<m; i++) y[i]+=a[i]*x;
+  }
+ }
+}
+/* Z(n x l)=A'(n x m)*Q(m x l) */
+LOCAL void
+dense_multiply_transposed(double const *A, long m, long n, double const *Q, int l, double *Z) {
+ long j;
+ for (j=0; j<n; j++) {
+  double const *a=A+j*m;
+  int c;
+  for (c=0; c<l; c++) {
+   double const *q=Q+c*m;
+   double sum=0.0;
+   long i;
+   for (i=0; i<m; i++) sum+=a[i]*q[i];
+   Z[c*n+j]=sum;
+  }
+ }
+}
+/* Orthonormalize the l m-element vectors of Q by modified Gram-Schmidt,
+ * applied twice for numerical orthogonality. Vectors found to be linearly
+ * dependent are set to zero. */
+LOCAL void
+dense_orthonormalize(double *Q, long m, int l) {
+ int pass, c, d;
+ for (pass=0; pass<2; pass++) {
+  for (c=0; c<l; c++) {
+   double *q=Q+c*m;
+   double norm=0.0;
+   long i;
+   for (i=0; i<m; i++) norm+=q[i]*q[i];
+   for (d=0; d<c; d++) {
+    double const *p=Q+d*m;
+    double dot=0.0;
+    for (i=0; i<m; i++) dot+=p[i]*q[i];
+    for (i=0; i<m; i++) q[i]-=dot*p[i];
+   }
+   {
+   double newnorm=0.0;
+   for (i=0; i<m; i++) newnorm+=q[i]*q[i];
+   if (newnorm<=1e-28*norm || newnorm==0.0) {
+    memset(q, 0, m*sizeof(double));
+   } else {
+    double const scale=1.0/sqrt(newnorm);
+    for (i=0; i<m; i++) q[i]*=scale;
+   }
+   }
+  }
+ }
+}
+/*}}}  */
+
+/*{{{  Full SVD of a dense matrix*/
+/* Compute the k leading components of the m x n matrix A (destroyed):
+ * U (m x k), S (k), V (n x k), k<=min(m,n). Returns FALSE on failure. */
+LOCAL Bool
+dense_svd_full(double *A, long m, long n, int k, double *U, double *S, double *V) {
+#ifdef AVG_Q_WITH_LAPACK
+ long const r=(m<n ? m : n);
+ int const im=m, in=n, ir=r;
+ int lwork= -1, info=0, c;
+ double worksize;
+ double *u, *s, *vt, *work;
+ int *iwork;
+ /* One allocation for u (m x r), s (r) and vt (r x n) */
+ if ((u=(double *)malloc((m+1+n)*r*sizeof(double)))==NULL) return FALSE;
+ s=u+m*r;
+ vt=s+r;
+ if ((iwork=(int *)malloc(8*r*sizeof(int)))==NULL) {
+  free(u); return FALSE;
+ }
+ dgesdd_("S", &im, &in, A, &im, s, u, &im, vt, &ir, &worksize, &lwork, iwork, &info, 1);
+ lwork=(int)worksize;
+ if (info!=0 || (work=(double *)malloc(lwork*sizeof(double)))==NULL) {
+  free(iwork); free(u); return FALSE;
+ }
+ dgesdd_("S", &im, &in, A, &im, s, u, &im, vt, &ir, work, &lwork, iwork, &info, 1);
+ free(work); free(iwork);
+ if (info==0) {
+  /* s is sorted already; vt holds the right singular vectors as rows */
+  memcpy(S, s, k*sizeof(double));
+  memcpy(U, u, m*k*sizeof(double));
+  for (c=0; c<k; c++) {
+   long j;
+   for (j=0; j<n; j++) V[c*n+j]=vt[j*r+c];
+  }
+ }
+ free(u);
+ return (info==0);
+#else
+ array u, w, v;
+ int *order;
+ int c;
+ u.nr_of_elements=m;
+ u.nr_of_vectors=v.nr_of_vectors=v.nr_of_elements=w.nr_of_elements=n;
+ w.nr_of_vectors=1;
+ u.element_skip=v.element_skip=w.element_skip=1;
+ if (array_allocate(&u)==NULL || array_allocate(&v)==NULL || array_allocate(&w)==NULL) {
+  array_free(&u); array_free(&v); array_free(&w);
+  return FALSE;
+ }
+ if ((order=(int *)malloc(n*sizeof(int)))==NULL) {
+  array_free(&u); array_free(&v); array_free(&w);
+  return FALSE;
+ }
+ {long i; for (i=0; i<m*n; i++) u.start[i]=A[i];}
+ array_svdcmp(&u, &w, &v);
+ /* Sort by decreasing singular value (insertion sort, stable) */
+ for (c=0; c<n; c++) {
+  int d=c;
+  while (d>0 && w.start[order[d-1]]<w.start[c]) {
+   order[d]=order[d-1];
+   d--;
+  }
+  order[d]=c;
+ }
+ for (c=0; c<k; c++) {
+  long i;
+  S[c]=w.start[order[c]];
+  for (i=0; i<m; i++) U[c*m+i]=u.start[order[c]*m+i];
+  for (i=0; i<n; i++) V[c*n+i]=v.start[order[c]*n+i];
+ }
+ free(order);
+ array_free(&u); array_free(&v); array_free(&w);
+ return TRUE;
+#endif
+}
+/*}}}  */
+
+/*{{{  Randomized subspace iteration*/
+/* Deterministic uniform random numbers in [-1,1) for the start subspace,
+ * so that results are reproducible and the global generators untouched */
+LOCAL double
+rsvd_random(uint64_t *state) {
+ *state^= *state<<13;
+ *state^= *state>>7;
+ *state^= *state<<17;
+ return (double)(*state>>11)/(double)(UINT64_C(1)<<52)-1.0;
+}
+
+LOCAL Bool
+dense_svd_randomized(double const *A, long m, long n, int k, double *U, double *S, double *V) {
+ long const r=(m<n ? m : n);
+ int const l=(k+RSVD_OVERSAMPLING<r ? k+RSVD_OVERSAMPLING : (int)r);
+ double *Q, *Z, *Vz, *Sz, *Sold;
+ Bool ok=FALSE;
+ uint64_t state=UINT64_C(0x9E3779B97F4A7C15);
+ int iteration, c;
+ long i;
+
+ Q=(double *)malloc(m*l*sizeof(double));
+ Z=(double *)malloc(n*l*sizeof(double));
+ Vz=(double *)malloc(l*l*sizeof(double));
+ Sz=(double *)malloc(l*sizeof(double));
+ Sold=(double *)malloc(l*sizeof(double));
+ if (Q==NULL || Z==NULL || Vz==NULL || Sz==NULL || Sold==NULL) goto cleanup;
+
+ for (i=0; i<n*l; i++) Z[i]=rsvd_random(&state);
+ for (iteration=0; ; iteration++) {
+  /* Range of A applied to the current right subspace */
+  dense_multiply(A, m, n, Z, l, Q);
+  dense_orthonormalize(Q, m, l);
+  /* A'Q=Uz Sz Vz', thus A~=QQ'A=(Q Vz) Sz Uz' */
+  dense_multiply_transposed(A, m, n, Q, l, Z);
+  if (!dense_svd_full(Z, n, l, l, Z, Sz, Vz)) goto cleanup;
+  if (iteration>0) {
+   Bool converged=TRUE;
+   for (c=0; c<k; c++) {
+    if (fabs(Sz[c]-Sold[c])>RSVD_TOLERANCE*Sz[0]) converged=FALSE;
+   }
+   if (converged || iteration>=RSVD_MAXITERATIONS) break;
+  }
+  memcpy(Sold, Sz, l*sizeof(double));
+ }
+ dense_multiply(Q, m, l, Vz, k, U);
+ memcpy(S, Sz, k*sizeof(double));
+ memcpy(V, Z, n*k*sizeof(double));
+ ok=TRUE;
+
+cleanup:
+ free(Sold); free(Sz); free(Vz); free(Z); free(Q);
+ return ok;
+}
+/*}}}  */
+
+GLOBAL void
+array_svd_leading(array *a, array *w, array *v, int ncomps, Bool randomized) {
+ long const m=a->nr_of_elements, n=a->nr_of_vectors;
+ long const r=(m<n ? m : n);
+ int const k=(ncomps<r ? ncomps : (int)r);
+ double *A, *U, *S, *V;
+ Bool ok=FALSE;
+
+ if (ncomps>n) ncomps=n;
+ A=(double *)malloc(m*n*sizeof(double));
+ U=(double *)calloc(m*ncomps, sizeof(double));
+ S=(double *)calloc(ncomps, sizeof(double));
+ V=(double *)calloc(n*ncomps, sizeof(double));
+ if (A!=NULL && U!=NULL && S!=NULL && V!=NULL) {
+  array_to_dense(a, A);
+  if (randomized && 2*(k+RSVD_OVERSAMPLING)<=r) {
+   ok=dense_svd_randomized(A, m, n, k, U, S, V);
+  } else {
+   /* dense_svd_full may write U with the k vectors it computes only */
+   ok=dense_svd_full(A, m, n, k, U, S, V);
+  }
+ }
+ if (ok) {
+  int c;
+  dense_to_array(U, ncomps, a);
+  dense_to_array(V, ncomps, v);
+  for (c=0; c<ncomps; c++) {
+   w->current_element=c;
+   WRITE_ELEMENT(w, S[c]);
+  }
+  array_reset(w);
+ } else {
+  a->message=ARRAY_ERROR;
+ }
+ free(V); free(S); free(U); free(A);
+}
@@ -36,7 +36,12 @@ array_svd_solution(array *a, array *b, array *x) {
   return;
  }
  array_copy(a, &u);
- array_svdcmp(&u, &w, &v);
+ array_svd_leading(&u, &w, &v, u.nr_of_vectors, FALSE);
+ if (u.message==ARRAY_ERROR) {
+  fprintf(stderr, "array_svd_solution: SVD failed\n");
+  array_free(&prod); array_free(&w); array_free(&v); array_free(&u);
+  return;
+ }
  array_reset(&u); array_reset(&w); array_reset(&v);
  threshold=TOL*array_max(&w);
  do {
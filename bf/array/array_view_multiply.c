@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2026 Bernd Feige
+ * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+ */
+/*
+ * array_view_multiply computes the matrix product of two array views in
+ * the same sense as array_multiply with MULT_SAMESIZE, ie scalar products
+ * between the vectors of a and those of b, but all at once:
+ *  c[v][e]=alpha*sum_k a[v][k]*b[e][k] + beta*c[v][e]
+ * The vectors of c correspond to the vectors of a and its elements to the
+ * vectors of b; a and b must have the same number of elements. With
+ * beta==0, c is only written to, so it need not be initialized.
+ * a and b may be the same view, but c must not overlap either of them.
+ * Use array_view_transpose() to get the other products, eg the map
+ * reconstruction from scalars.
+ * - With LAPACK/BLAS (AVG_Q_WITH_LAPACK), dgemm is called directly on the
+ *   memory if each view is contiguous along one of its dimensions, as is the
+ *   case for single-item data.
+ * - Otherwise a cache-blocked loop accumulating 4 output elements at a
+ *   time is used, parallelized over blocks of vectors by OpenMP.
+ *					-- Bernd Feige 17.10.2026
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+#include "array.h"
+
+/* Block sizes for the fallback kernel: A KBLOCK stretch of VBLOCK vectors of
+ * a and EBLOCK vectors of b should fit in the L2 cache */
+#define VBLOCK 64
+#define EBLOCK 64
+#define KBLOCK 256
+
+#if defined(AVG_Q_WITH_LAPACK) && defined(DOUBLE_DATATYPE)
+extern void dgemm_(char const *transa, char const *transb, int const *m, int const *n, int const *k, double const *alpha, double const *a, int const *lda, double const *b, int const *ldb, double const *beta, double *c, int const *ldc, size_t transa_len, size_t transb_len);
+
+/*{{{  blas_layout(array_view const *view, Bool *transposed, int *ld) {*/
+/* BLAS matrices are column-major: Entry (r,c) is at [r+c*ld] with ld>=rows.
+ * A view (vector v, element e) is either the matrix (e,v) with ld=vector_skip
+ * (*transposed==FALSE) or the matrix (v,e) with ld=element_skip
+ * (*transposed==TRUE). Returns FALSE if neither is possible. */
+LOCAL Bool
+blas_layout(array_view const *view, Bool *transposed, int *ld) {
+ /* A stride across a single entry is arbitrary */
+ long const element_skip=(view->nr_of_elements==1 ? 1 : view->element_skip);
+ long const vector_skip=(view->nr_of_vectors==1 ? view->nr_of_elements : view->vector_skip);
+ if (element_skip==1 && vector_skip>=view->nr_of_elements && vector_skip<=INT_MAX) {
+  *transposed=FALSE;
+  *ld=(int)vector_skip;
+  return TRUE;
+ }
+ if (vector_skip==1 && element_skip>=view->nr_of_vectors && element_skip<=INT_MAX) {
+  *transposed=TRUE;
+  *ld=(int)element_skip;
+  return TRUE;
+ }
+ return FALSE;
+}
+/*}}}  */
+#endif
+
+/*{{{  array_view_transpose(array_view *view) {*/
+GLOBAL void
+array_view_transpose(array_view *view) {
+ long const skip=view->element_skip;
+ int const n=view->nr_of_elements;
+ view->element_skip=view->vector_skip;
+ view->vector_skip=skip;
+ view->nr_of_elements=view->nr_of_vectors;
+ view->nr_of_vectors=n;
+}
+/*}}}  */
+
+/*{{{  array_view_multiply(array_view const *a, array_view const *b, array_view *c, DATATYPE alpha, DATATYPE beta) {*/
+GLOBAL void
+array_view_multiply(array_view const *a, array_view const *b, array_view *c, DATATYPE alpha, DATATYPE beta) {
+ int const nv=a->nr_of_vectors, ne=b->nr_of_vectors, nk=a->nr_of_elements;
+ int vb;
+
+ if (nv==0 || ne==0) return;
+
+#if defined(AVG_Q_WITH_LAPACK) && defined(DOUBLE_DATATYPE)
+ /*{{{  Let BLAS do it if possible*/
+ {
+ Bool a_transposed, b_transposed, c_transposed;
+ int lda, ldb, ldc;
+ if (blas_layout(a, &a_transposed, &lda) && blas_layout(b, &b_transposed, &ldb) && blas_layout(c, &c_transposed, &ldc)) {
+  /* The product c=a*b' in the matrix (v,e) sense; a is (v,k), b is (e,k).
+   * If c is stored as (v,e), compute a*b', else b*a' */
+  if (c_transposed) {
+   dgemm_(a_transposed ? "N" : "T", b_transposed ? "T" : "N", &nv, &ne, &nk, &alpha, a->start, &lda, b->start, &ldb, &beta, c->start, &ldc, 1, 1);
+  } else {
+   dgemm_(b_transposed ? "N" : "T", a_transposed ? "T" : "N", &ne, &nv, &nk, &alpha, b->start, &ldb, a->start, &lda, &beta, c->start, &ldc, 1, 1);
+  }
+  return;
+ }
+ }
+ /*}}}  */
+#endif
+
+ /*{{{  Cache-blocked loop*/
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if ((double)nv*ne*nk>1e6)
+#endif
+ for (vb=0; vb<nv; vb+=VBLOCK) {
+  int const vend=(vb+VBLOCK<nv ? vb+VBLOCK : nv);
+  long const aes=a->element_skip, bes=b->element_skip;
+  int v, e, eb, kb;
+
+  for (v=vb; v<vend; v++) {
+   DATATYPE *cp=ARRAY_VIEW_VECTOR(c, v);
+   for (e=0; e<ne; e++, cp+=c->element_skip) {
+    *cp=(beta==0.0 ? 0.0 : beta* *cp);
+   }
+  }
+  for (eb=0; eb<ne; eb+=EBLOCK) {
+   int const eend=(eb+EBLOCK<ne ? eb+EBLOCK : ne);
+   for (kb=0; kb<nk; kb+=KBLOCK) {
+    int const klen=(kb+KBLOCK<nk ? KBLOCK : nk-kb);
+    for (v=vb; v<vend; v++) {
+     DATATYPE const * const ap=ARRAY_VIEW_VECTOR(a, v)+kb*aes;
+     DATATYPE * const cv=ARRAY_VIEW_VECTOR(c, v);
+     for (e=eb; e+3<eend; e+=4) {
+      /* Four scalar products sharing the loads from a */
+      DATATYPE const *b0=ARRAY_VIEW_VECTOR(b, e)+kb*bes;
+      DATATYPE const *b1=b0+b->vector_skip, *b2=b1+b->vector_skip, *b3=b2+b->vector_skip;
+      DATATYPE s0=0.0, s1=0.0, s2=0.0, s3=0.0;
+      int k;
+      for (k=0; k<klen; k++) {
+       DATATYPE const x=ap[k*aes];
+       long const kk=k*bes;
+       s0+=x*b0[kk]; s1+=x*b1[kk]; s2+=x*b2[kk]; s3+=x*b3[kk];
+      }
+      cv[e*c->element_skip]+=alpha*s0;
+      cv[(e+1)*c->element_skip]+=alpha*s1;
+      cv[(e+2)*c->element_skip]+=alpha*s2;
+      cv[(e+3)*c->element_skip]+=alpha*s3;
+     }
+     for (; e<eend; e++) {
+      DATATYPE const *b0=ARRAY_VIEW_VECTOR(b, e)+kb*bes;
+      DATATYPE s0=0.0;
+      int k;
+      for (k=0; k<klen; k++) s0+=ap[k*aes]*b0[k*bes];
+      cv[e*c->element_skip]+=alpha*s0;
+     }
+    }
+   }
+  }
+ }
+ /*}}}  */
+}
+/*}}}  */
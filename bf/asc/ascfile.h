@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008 Bernd Feige
+ * Copyright (C) 2008,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 #ifndef _ASCFILE_H
@@ -69,6 +69,17 @@
   where the length of this whole epoch data set INCLUDING this int value
   is given to enable programs to skip backwards to the start of the
   previous data set.
+
+ OPTIONALLY, AFTER THE LAST DATA SET (writeasc -i):
+ (int64)epoch_offset[nr_of_epochs]
+  File position of the start of each data set.
+ (int64)index_offset, nr_of_epochs
+ (char[8])ASC_INDEX_MAGIC
+  This fixed-size footer at the very end of the file locates the offset
+  table; index_offset is also the end of the epoch data. Like the rest
+  of the file, the int64 values are in the byte order of the writer.
+  Either way, the first int64 after the data is the position of the first
+  data set, which is how readers that cannot seek recognize the index.
  }}}
  }}}
 #endif
@@ -77,6 +88,8 @@
 #define ASC_BF_DOUBLE_MAGIC 0xbddb
 #define OLD_ASC_BF_MAGIC 0xbfbf
 #define ZAXIS_DELIMITER ";Zaxis:"
+#define ASC_INDEX_MAGIC "ascindx1"
+#define ASC_INDEX_MAGIC_LENGTH 8
 #ifdef FLOAT_DATATYPE
 #define ASC_BF_MAGIC ASC_BF_FLOAT_MAGIC
 #endif
@@ -84,4 +97,12 @@
 #define ASC_BF_MAGIC ASC_BF_DOUBLE_MAGIC
 #endif
 
+/* ascindex.c */
+Bool ascindex_skip_epoch(FILE *filep, Bool Intel_Fix, size_t elementsize);
+void ascindex_scan(FILE *filep, Bool Intel_Fix, size_t elementsize, growing_buf *offsetsp);
+long ascindex_read_embedded(transform_info_ptr tinfo, FILE *filep, Bool Intel_Fix, growing_buf *offsetsp);
+Bool ascindex_write_embedded(FILE *filep, growing_buf *offsetsp);
+Bool ascindex_load_sidecar(transform_info_ptr tinfo, char const *datafilename, growing_buf *offsetsp);
+void ascindex_save_sidecar(transform_info_ptr tinfo, char const *datafilename, growing_buf *offsetsp);
+
 #endif
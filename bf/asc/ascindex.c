@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2026 Bernd Feige
+ * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+ */
+/*
+ * ascindex.c maintains the epoch offset index of binary asc files.
+ * writeasc -i appends a table of the file offsets of all epochs and a
+ * fixed-size footer locating it (see ascfile.h); readasc uses it to seek
+ * directly to the start epoch. For files without an embedded index, readasc
+ * walks the epoch headers once and keeps the table in a sidecar file
+ * <file>.ascidx, valid as long as size and modification time of the data
+ * file match (see sidecar.c). Offset tables are growing_bufs holding `long' values.
+ *	-- Bernd Feige 17.10.2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "transform.h"
+#include "bf.h"
+#include "Intel_compat.h"
+#include "ascfile.h"
+
+#define ASC_INDEX_SIDECAR_SUFFIX ".ascidx"
+#define ASC_INDEX_SIDECAR_MAGIC "avg_q asc index 2\n"
+
+struct asc_index_footer {
+ int64_t index_offset;	/* File position of the offset table = end of epoch data */
+ int64_t nr_of_epochs;
+ char magic[ASC_INDEX_MAGIC_LENGTH];
+};
+
+/*{{{  ascindex_skip_epoch(FILE *filep, Bool Intel_Fix, size_t elementsize)*/
+/* Skips the binary data set at the current file position; elementsize is
+ * the size of the data values in the file. Returns FALSE at end of file. */
+GLOBAL Bool
+ascindex_skip_epoch(FILE *filep, Bool Intel_Fix, size_t elementsize) {
+ int nr_of_channels, nr_of_points, itemsize;
+ int length_of_string_section;
+
+ IGNORE_RESULT(fread((void *)&nr_of_channels, sizeof(int), 1, filep));
+ if (feof(filep)) return FALSE;
+ IGNORE_RESULT(fread((void *)&nr_of_points, sizeof(int), 1, filep));
+ IGNORE_RESULT(fread((void *)&itemsize, sizeof(int), 1, filep));
+ fseek(filep, (long)sizeof(int), 1);	/* Skip multiplexed value */
+ IGNORE_RESULT(fread((void *)&length_of_string_section, sizeof(int), 1, filep));
+ if (Intel_Fix) {
+  Intel_int((unsigned int *)&nr_of_channels);
+  Intel_int((unsigned int *)&nr_of_points);
+  Intel_int((unsigned int *)&itemsize);
+  Intel_int((unsigned int *)&length_of_string_section);
+ }
+
+ fseek(filep, (long)(length_of_string_section+3*nr_of_channels*sizeof(double)+ (nr_of_channels*itemsize+1)*nr_of_points*elementsize+sizeof(int)), 1);
+ return TRUE;
+}
+/*}}}  */
+
+/*{{{  ascindex_scan(FILE *filep, Bool Intel_Fix, size_t elementsize, growing_buf *offsetsp)*/
+/* Builds the offset table by walking the data sets from the current file
+ * position to the end of the file, which must not have an embedded index. */
+GLOBAL void
+ascindex_scan(FILE *filep, Bool Intel_Fix, size_t elementsize, growing_buf *offsetsp) {
+ long epoch_start;
+ growing_buf_allocate(offsetsp, 0);
+ while (epoch_start=ftell(filep), ascindex_skip_epoch(filep, Intel_Fix, elementsize)) {
+  growing_buf_append(offsetsp, (char *)&epoch_start, sizeof(long));
+ }
+ clearerr(filep);
+}
+/*}}}  */
+
+/*{{{  ascindex_read_embedded(transform_info_ptr tinfo, FILE *filep, Bool Intel_Fix, growing_buf *offsetsp)*/
+/* Looks for an index footer at the end of filep. Returns the file position
+ * at which the epoch data ends or -1 if the file has no valid index.
+ * If offsetsp!=NULL, the offset table is read into it. The file position
+ * is undefined on return. */
+GLOBAL long
+ascindex_read_embedded(transform_info_ptr tinfo, FILE *filep, Bool Intel_Fix, growing_buf *offsetsp) {
+ struct asc_index_footer footer;
+ long filesize;
+ long epoch;
+
+ if (fseek(filep, 0L, SEEK_END)!=0 || (filesize=ftell(filep))<(long)sizeof(footer)
+  || fseek(filep, filesize-(long)sizeof(footer), SEEK_SET)!=0
+  || fread(&footer, sizeof(footer), 1, filep)!=1
+  || memcmp(footer.magic, ASC_INDEX_MAGIC, ASC_INDEX_MAGIC_LENGTH)!=0) {
+  return -1;
+ }
+ if (Intel_Fix) {
+  Intel_int64((uint64_t *)&footer.index_offset);
+  Intel_int64((uint64_t *)&footer.nr_of_epochs);
+ }
+ if (footer.index_offset<=0 || footer.nr_of_epochs<0
+  || footer.index_offset+footer.nr_of_epochs*(int64_t)sizeof(int64_t)+(int64_t)sizeof(footer)!=filesize) {
+  TRACEMS(tinfo->emethods, 0, "ascindex_read_embedded: Ignoring inconsistent epoch index\n");
+  return -1;
+ }
+ if (offsetsp!=NULL) {
+  if (!growing_buf_allocate(offsetsp, footer.nr_of_epochs*sizeof(long))) {
+   ERREXIT(tinfo->emethods, "ascindex_read_embedded: Error allocating index\n");
+  }
+  fseek(filep, (long)footer.index_offset, SEEK_SET);
+  for (epoch=0; epoch<footer.nr_of_epochs; epoch++) {
+   int64_t offset;
+   long position;
+   if (fread(&offset, sizeof(offset), 1, filep)!=1) {
+    ERREXIT(tinfo->emethods, "ascindex_read_embedded: Error reading index\n");
+   }
+   if (Intel_Fix) Intel_int64((uint64_t *)&offset);
+   position=(long)offset;
+   growing_buf_append(offsetsp, (char *)&position, sizeof(long));
+  }
+ }
+ return (long)footer.index_offset;
+}
+/*}}}  */
+
+/*{{{  ascindex_write_embedded(FILE *filep, growing_buf *offsetsp)*/
+/* Appends offset table and footer at the current position of filep, which
+ * must be the end of the epoch data. */
+GLOBAL Bool
+ascindex_write_embedded(FILE *filep, growing_buf *offsetsp) {
+ struct asc_index_footer footer;
+ long const nr_of_epochs=(offsetsp->buffer_start==NULL ? 0 : offsetsp->current_length/sizeof(long));
+ long const * const offsets=(long const *)offsetsp->buffer_start;
+ long epoch;
+
+ memset(&footer, 0, sizeof(footer));
+ if ((footer.index_offset=ftell(filep))<=0) return FALSE;
+ footer.nr_of_epochs=nr_of_epochs;
+ memcpy(footer.magic, ASC_INDEX_MAGIC, ASC_INDEX_MAGIC_LENGTH);
+ for (epoch=0; epoch<nr_of_epochs; epoch++) {
+  int64_t const offset=offsets[epoch];
+  if (fwrite(&offset, sizeof(offset), 1, filep)!=1) return FALSE;
+ }
+ return fwrite(&footer, sizeof(footer), 1, filep)==1;
+}
+/*}}}  */
+
+/*{{{  Sidecar index*/
+/* The sidecar (see sidecar.c) holds the number of epochs and their offsets */
+
+/*{{{  ascindex_load_sidecar(transform_info_ptr tinfo, char const *datafilename, growing_buf *offsetsp)*/
+/* Returns TRUE and fills *offsetsp if a sidecar index matching the current
+ * state of datafilename exists. */
+GLOBAL Bool
+ascindex_load_sidecar(transform_info_ptr tinfo, char const *datafilename, growing_buf *offsetsp) {
+ struct sidecar_file sidecar;
+ int64_t nr_of_epochs;
+ Bool valid;
+
+ if (!sidecar_open(&sidecar, datafilename, ASC_INDEX_SIDECAR_SUFFIX, ASC_INDEX_SIDECAR_MAGIC, "")) return FALSE;
+ valid=(fread(&nr_of_epochs, sizeof(nr_of_epochs), 1, sidecar.file)==1 && nr_of_epochs>=0
+  && growing_buf_allocate(offsetsp, nr_of_epochs*sizeof(long)));
+ if (valid) {
+  long epoch;
+  for (epoch=0; epoch<nr_of_epochs; epoch++) {
+   int64_t offset;
+   long position;
+   if (fread(&offset, sizeof(offset), 1, sidecar.file)!=1) {
+    valid=FALSE;
+    break;
+   }
+   position=(long)offset;
+   growing_buf_append(offsetsp, (char *)&position, sizeof(long));
+  }
+ }
+ if (!valid) {
+  growing_buf_clear(offsetsp);
+  TRACEMS1(tinfo->emethods, 0, "ascindex_load_sidecar: Ignoring damaged index file %s\n", MSGPARM(sidecar.filename));
+ } else {
+  TRACEMS2(tinfo->emethods, 1, "ascindex_load_sidecar: Read %ld epoch offsets from %s\n", MSGPARM(nr_of_epochs), MSGPARM(sidecar.filename));
+ }
+ sidecar_close(&sidecar);
+ return valid;
+}
+/*}}}  */
+
+/*{{{  ascindex_save_sidecar(transform_info_ptr tinfo, char const *datafilename, growing_buf *offsetsp)*/
+/* Failure is not an error. */
+GLOBAL void
+ascindex_save_sidecar(transform_info_ptr tinfo, char const *datafilename, growing_buf *offsetsp) {
+ struct sidecar_file sidecar;
+ int64_t const nr_of_epochs=(offsetsp->buffer_start==NULL ? 0 : offsetsp->current_length/sizeof(long));
+ long const * const offsets=(long const *)offsetsp->buffer_start;
+ long epoch;
+ Bool ok;
+
+ if (!sidecar_create(&sidecar, datafilename, ASC_INDEX_SIDECAR_SUFFIX, ASC_INDEX_SIDECAR_MAGIC, "")) {
+  TRACEMS1(tinfo->emethods, 1, "ascindex_save_sidecar: Not creating an index file for %s\n", MSGPARM(datafilename));
+  return;
+ }
+ ok=(fwrite(&nr_of_epochs, sizeof(nr_of_epochs), 1, sidecar.file)==1);
+ for (epoch=0; ok && epoch<nr_of_epochs; epoch++) {
+  int64_t const offset=offsets[epoch];
+  ok=(fwrite(&offset, sizeof(offset), 1, sidecar.file)==1);
+ }
+ if (sidecar_commit(&sidecar, ok)) {
+  TRACEMS2(tinfo->emethods, 1, "ascindex_save_sidecar: Wrote %ld epoch offsets for %s\n", MSGPARM(nr_of_epochs), MSGPARM(datafilename));
+ } else {
+  TRACEMS1(tinfo->emethods, 1, "ascindex_save_sidecar: Can't write the index file for %s\n", MSGPARM(datafilename));
+ }
+}
+/*}}}  */
+/*}}}  */
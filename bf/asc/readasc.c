@@ -16,6 +16,11 @@
  * For the binary format, the byte-swap issue (little vs big endian) is
  * handled by readasc, providing read compatibility between Intel and other
  * processors. writeasc only writes the byte order of the local machine.
+ *
+ * To start at epoch -f in a binary file, readasc seeks directly using the
+ * epoch index appended by writeasc -i. Without such an index, the epoch
+ * headers are walked once and the offsets kept in a sidecar file (see
+ * ascindex.c) for subsequent reads.
  */
 /*}}}  */
 
@@ -91,8 +96,16 @@ struct readasc_storage {
  int epochs;
  int current_epoch;
  int nrofaverages;
+ growing_buf epoch_offsets;	/* File positions of the epochs, if known */
+ long data_end;	/* End of the epoch data for files with an embedded index, else -1 */
+ Bool embedded_index_checked;
+ Bool sidecar_index_checked;
+ Bool sequential;	/* The file cannot seek (pipe, stdin) */
+ long first_epoch_position;	/* Where the first binary data set starts */
 };
 #define ASCFILEPTR (local_arg->ascfile)
+/* Size of the data values in the file */
+#define READASC_ELEMENTSIZE(local_arg) ((local_arg)->otherdatatype ? sizeof(C_OTHERDATATYPE) : sizeof(DATATYPE))
 /*}}}  */
 
 /*{{{  assign_key_value(transform_info_ptr tinfo, enum keyword_numbers keynum, char *where) {*/
@@ -156,6 +169,39 @@ fskip_lines(FILE *filep, int count) {
 }
 /*}}}  */
 
+/*{{{  readasc_get_index(transform_info_ptr tinfo, Bool need_offsets) {*/
+/* Looks for an embedded epoch index and, if need_offsets is set and there
+ * is none, loads or builds the sidecar index. The file position is
+ * restored. Streams that cannot seek (pipes) are read sequentially. */
+LOCAL void
+readasc_get_index(transform_info_ptr tinfo, Bool need_offsets) {
+ struct readasc_storage *local_arg=(struct readasc_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+ FILE * const ascfileptr=ASCFILEPTR;
+ long const data_start=ftell(ascfileptr);
+
+ if (data_start<0 || fseek(ascfileptr, data_start, SEEK_SET)!=0) {
+  local_arg->embedded_index_checked=local_arg->sidecar_index_checked=TRUE;
+  local_arg->sequential=TRUE;
+  return;
+ }
+ if (!local_arg->embedded_index_checked) {
+  local_arg->data_end=ascindex_read_embedded(tinfo, ascfileptr, local_arg->Intel_Fix, &local_arg->epoch_offsets);
+  local_arg->embedded_index_checked=TRUE;
+  if (local_arg->data_end>=0) local_arg->sidecar_index_checked=TRUE;
+ }
+ if (need_offsets && !local_arg->sidecar_index_checked) {
+  if (!ascindex_load_sidecar(tinfo, args[ARGS_IFILE].arg.s, &local_arg->epoch_offsets)) {
+   fseek(ascfileptr, data_start, SEEK_SET);
+   ascindex_scan(ascfileptr, local_arg->Intel_Fix, READASC_ELEMENTSIZE(local_arg), &local_arg->epoch_offsets);
+   ascindex_save_sidecar(tinfo, args[ARGS_IFILE].arg.s, &local_arg->epoch_offsets);
+  }
+  local_arg->sidecar_index_checked=TRUE;
+ }
+ fseek(ascfileptr, data_start, SEEK_SET);
+}
+/*}}}  */
+
 /*{{{  readasc_open_file(transform_info_ptr tinfo) {*/
 LOCAL void
 readasc_open_file(transform_info_ptr tinfo) {
@@ -203,6 +249,7 @@ readasc_open_file(transform_info_ptr tinfo) {
  } else {
   fseek(ascfileptr, -2, 1);
  }
+ local_arg->Intel_Fix=Intel_Fix;
 
  /*{{{  Parse arguments that can be in seconds*/
  local_arg->offset=(args[ARGS_OFFSET].is_set ? gettimeslice(tinfo, args[ARGS_OFFSET].arg.s) : 0);
@@ -243,30 +290,27 @@ readasc_open_file(transform_info_ptr tinfo) {
  local_arg->leaveright=tinfo->leaveright;
  local_arg->nrofaverages=tinfo->nrofaverages;
  
+ if (local_arg->binary) {
+  /* magic, length of the keyword section and the keywords */
+  local_arg->first_epoch_position=4+shortbuf;
+  local_arg->sequential=(ascfileptr==stdin);
+  if (!local_arg->sequential) readasc_get_index(tinfo, skipepochs>0);
+ }
+
  /*{{{  Skip epochs if fromepoch>1*/
+ if (skipepochs>0 && (local_arg->data_end>=0 || local_arg->epoch_offsets.current_length>0)) {
+  if (skipepochs>=local_arg->epoch_offsets.current_length/(long)sizeof(long)) {
+   ERREXIT(tinfo->emethods, "readasc_init: Error seeking first epoch\n");
+  }
+  fseek(ascfileptr, ((long *)local_arg->epoch_offsets.buffer_start)[skipepochs], SEEK_SET);
+  skipepochs=0;
+ }
  while (skipepochs>0) {
   int nr_of_channels, nr_of_points, itemsize;
   if (local_arg->binary) {
-   /*{{{  Skip binary data set*/
-   int length_of_string_section;
-
-   IGNORE_RESULT(fread((void *)&nr_of_channels, sizeof(int), 1, ascfileptr));
-   if (feof(ascfileptr)) {
+   if (!ascindex_skip_epoch(ascfileptr, Intel_Fix, READASC_ELEMENTSIZE(local_arg))) {
     ERREXIT(tinfo->emethods, "readasc_init: Error seeking first epoch\n");
    }
-   IGNORE_RESULT(fread((void *)&nr_of_points, sizeof(int), 1, ascfileptr));
-   IGNORE_RESULT(fread((void *)&itemsize, sizeof(int), 1, ascfileptr));
-   fseek(ascfileptr, (long)sizeof(int), 1);	/* Skip multiplexed value */
-   IGNORE_RESULT(fread((void *)&length_of_string_section, sizeof(int), 1, ascfileptr));
-   if (Intel_Fix) {
-    Intel_int((unsigned int *)&nr_of_channels);
-    Intel_int((unsigned int *)&nr_of_points);
-    Intel_int((unsigned int *)&itemsize);
-    Intel_int((unsigned int *)&length_of_string_section);
-   }
-
-   fseek(ascfileptr, (long)(length_of_string_section+3*nr_of_channels*sizeof(double)+ (nr_of_channels*itemsize+1)*nr_of_points*(local_arg->otherdatatype ? sizeof(C_OTHERDATATYPE) : sizeof(DATATYPE))+sizeof(int)), 1);
-   /*}}}  */
   } else {
    /*{{{  Skip ascii  data set*/
    fskip_lines(ascfileptr, 1);	/* Skip comment line */
@@ -289,8 +333,6 @@ readasc_open_file(transform_info_ptr tinfo) {
   skipepochs--;
  }
  /*}}}  */
-
- local_arg->Intel_Fix=Intel_Fix;
 }
 /*}}}  */
 
@@ -300,6 +342,10 @@ readasc_close_file(transform_info_ptr tinfo) {
  struct readasc_storage *local_arg=(struct readasc_storage *)tinfo->methods->local_storage;
  if (ASCFILEPTR!=stdin) fclose(ASCFILEPTR);
  ASCFILEPTR=NULL;
+ /* The file may change until it is opened again (-c) */
+ growing_buf_clear(&local_arg->epoch_offsets);
+ local_arg->data_end= -1;
+ local_arg->embedded_index_checked=local_arg->sidecar_index_checked=FALSE;
 }
 /*}}}  */
 /*}}}  */
@@ -313,6 +359,10 @@ readasc_init(transform_info_ptr tinfo) {
  local_arg->fromepoch=(args[ARGS_FROMEPOCH].is_set ? args[ARGS_FROMEPOCH].arg.i : 1);
  local_arg->current_epoch=local_arg->fromepoch-1;
  local_arg->epochs=(args[ARGS_EPOCHS].is_set ? args[ARGS_EPOCHS].arg.i : -1);
+ growing_buf_init(&local_arg->epoch_offsets);
+ local_arg->data_end= -1;
+ local_arg->embedded_index_checked=local_arg->sidecar_index_checked=FALSE;
+ local_arg->sequential=FALSE;
  if (!args[ARGS_CLOSE].is_set) readasc_open_file(tinfo);
 
  tinfo->methods->init_done=TRUE;
@@ -454,9 +504,21 @@ readasc(transform_info_ptr tinfo) {
   /*{{{  Read binary data set*/
   int length_of_string_section;
 
+  /* The epoch index following the data in indexed files acts as EOF */
+  if (local_arg->data_end>=0 && ftell(ascfileptr)>=local_arg->data_end) return NULL;
   IGNORE_RESULT(fread((void *)&tinfo->nr_of_channels, sizeof(int), 1, ascfileptr));
   if (feof(ascfileptr)) return NULL;
   IGNORE_RESULT(fread((void *)&tinfo->nr_of_points, sizeof(int), 1, ascfileptr));
+  if (local_arg->sequential) {
+   /* Without seeking, the epoch index of an indexed file is only seen when
+    * we get there: Its first entry is the position of the first data set,
+    * which can't be a valid (nr_of_channels, nr_of_points) pair */
+   int const header_words[2]={tinfo->nr_of_channels, tinfo->nr_of_points};
+   int64_t first_entry;
+   memcpy(&first_entry, header_words, sizeof(first_entry));
+   if (Intel_Fix) Intel_int64((uint64_t *)&first_entry);
+   if (first_entry==local_arg->first_epoch_position) return NULL;
+  }
   IGNORE_RESULT(fread((void *)&tinfo->itemsize, sizeof(int), 1, ascfileptr));
   IGNORE_RESULT(fread((void *)&tinfo->multiplexed, sizeof(int), 1, ascfileptr));
   IGNORE_RESULT(fread((void *)&length_of_string_section, sizeof(int), 1, ascfileptr));
@@ -694,9 +756,11 @@ readasc(transform_info_ptr tinfo) {
 /*{{{  readasc_exit(transform_info_ptr tinfo) {*/
 METHODDEF void
 readasc_exit(transform_info_ptr tinfo) {
+ struct readasc_storage *local_arg=(struct readasc_storage *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
 
  if (!args[ARGS_CLOSE].is_set) readasc_close_file(tinfo);
+ growing_buf_free(&local_arg->epoch_offsets);
 
  tinfo->methods->init_done=FALSE;
 }
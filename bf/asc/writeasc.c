@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008,2010,2011,2014,2025 Bernd Feige
+ * Copyright (C) 2008,2010,2011,2014,2025,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -10,6 +10,13 @@
  *
  * If (args[ARGS_OFILE].arg.s eq "stdout") tinfo->outfptr=stdout;
  * If (args[ARGS_OFILE].arg.s eq "stderr") tinfo->outfptr=stderr;
+ *
+ * With -i, the file offsets of the binary epochs are collected and written
+ * as an index after the last epoch when the file is closed (see ascfile.h).
+ * Appending to an indexed file removes the index and rewrites it on close,
+ * whether or not -i is given. With -c -a, the file is reopened for each
+ * epoch; the offsets are then kept over all epochs and the index is written
+ * only once on exit, instead of being read back and rewritten per epoch.
  */
 /*}}}  */
 
@@ -17,6 +24,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #ifdef __MINGW32__
 #include <fcntl.h>
 #include <io.h>
@@ -30,6 +38,7 @@ enum ARGS_ENUM {
  ARGS_APPEND=0, 
  ARGS_BINARY, 
  ARGS_CLOSE,
+ ARGS_INDEX,
  ARGS_LINKED, 
  ARGS_OFILE,
  NR_OF_ARGUMENTS
@@ -38,6 +47,7 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_NOTHING, "Append data if file exists", "a", FALSE, NULL},
  {T_ARGS_TAKES_NOTHING, "Binary file format", "b", TRUE, NULL},
  {T_ARGS_TAKES_NOTHING, "Close the file after writing each epoch (and open it again next time)", "c", FALSE, NULL},
+ {T_ARGS_TAKES_NOTHING, "Write an epoch index for direct access (binary files only)", "i", FALSE, NULL},
  {T_ARGS_TAKES_NOTHING, "Write all linked datasets", "L", FALSE, NULL},
  {T_ARGS_TAKES_FILENAME, "Output file", "", ARGDESC_UNUSED, (const char *const *)"*.asc"}
 };
@@ -52,6 +62,9 @@ struct writeasc_storage {
  DATATYPE sfreq;
  int beforetrig;
  int leaveright;
+ Bool write_index;
+ Bool index_deferred;	/* -c -a: Offsets are complete, index is written on exit */
+ growing_buf epoch_offsets;
 };
 
 /*{{{  Local open_file and close_file routines*/
@@ -93,6 +106,41 @@ writeasc_open_file(transform_info_ptr tinfo) {
   if (ftell(outfptr)==0L) append_mode=FALSE;	/* If at start: write header */
   /*}}}  */
  }
+ /* When reopened with -c -a, the file has no index and the offsets are kept */
+ if (!local_arg->index_deferred) {
+  growing_buf_allocate(&local_arg->epoch_offsets, 0);
+  local_arg->write_index=args[ARGS_BINARY].is_set && args[ARGS_INDEX].is_set;
+  if (append_mode && args[ARGS_BINARY].is_set) {
+   /*{{{  Remove an existing index and take over its offsets*/
+   long const data_end=ascindex_read_embedded(tinfo, outfptr, FALSE, &local_arg->epoch_offsets);
+   if (data_end>=0) {
+    fflush(outfptr);
+#ifdef __MINGW32__
+    if (_chsize(_fileno(outfptr), data_end)!=0) {
+#else
+    if (ftruncate(fileno(outfptr), data_end)!=0) {
+#endif
+     ERREXIT1(tinfo->emethods, "writeasc_open_file: Can't remove the epoch index of %s\n", MSGPARM(args[ARGS_OFILE].arg.s));
+    }
+    local_arg->write_index=TRUE;
+   } else if (local_arg->write_index) {
+    /* Index the epochs already in the file */
+    unsigned short magic, length_of_header;
+    fseek(outfptr, 0L, 0);
+    if (fread((void *)&magic, 2, 1, outfptr)==1 && magic==ASC_BF_MAGIC
+     && fread((void *)&length_of_header, 2, 1, outfptr)==1) {
+     fseek(outfptr, 4L+length_of_header, 0);
+     ascindex_scan(outfptr, FALSE, sizeof(DATATYPE), &local_arg->epoch_offsets);
+    } else {
+     TRACEMS1(tinfo->emethods, 0, "writeasc_open_file: Can't index %s, not writing an epoch index\n", MSGPARM(args[ARGS_OFILE].arg.s));
+     local_arg->write_index=FALSE;
+    }
+   }
+   fseek(outfptr, 0L, 2);
+   /*}}}  */
+  }
+  local_arg->index_deferred=args[ARGS_CLOSE].is_set && args[ARGS_APPEND].is_set;
+ }
  if (outfptr==NULL) {
   /*{{{  Truncate mode open*/
   if ((outfptr=fopen(args[ARGS_OFILE].arg.s, "wb"))==NULL) {
@@ -147,6 +195,9 @@ writeasc_open_file(transform_info_ptr tinfo) {
 LOCAL void
 writeasc_close_file(transform_info_ptr tinfo) {
  struct writeasc_storage *local_arg=(struct writeasc_storage *)tinfo->methods->local_storage;
+ if (local_arg->write_index && !local_arg->index_deferred && !ascindex_write_embedded(local_arg->outfptr, &local_arg->epoch_offsets)) {
+  TRACEMS(tinfo->emethods, 0, "writeasc_close_file: Error writing the epoch index\n");
+ }
  if (local_arg->outfptr!=stdout && local_arg->outfptr!=stderr) {
   fclose(local_arg->outfptr);
  } else {
@@ -160,8 +211,12 @@ writeasc_close_file(transform_info_ptr tinfo) {
 /*{{{  writeasc_init(transform_info_ptr tinfo) {*/
 METHODDEF void
 writeasc_init(transform_info_ptr tinfo) {
+ struct writeasc_storage *local_arg=(struct writeasc_storage *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
 
+ growing_buf_init(&local_arg->epoch_offsets);
+ local_arg->index_deferred=FALSE;
+
  if (!args[ARGS_CLOSE].is_set) writeasc_open_file(tinfo);
 
  tinfo->methods->init_done=TRUE;
@@ -216,6 +271,15 @@ writeasc(transform_info_ptr calltinfo) {
   char outbuf[OUTBUFSIZE], *inoutbuf;
   int len;
 
+  if (local_arg->write_index) {
+   long const epoch_start=ftell(outfptr);
+   if (epoch_start<0) {
+    TRACEMS(tinfo->emethods, 0, "writeasc: Output is not seekable, not writing an epoch index\n");
+    local_arg->write_index=FALSE;
+   } else {
+    growing_buf_append(&local_arg->epoch_offsets, (char *)&epoch_start, sizeof(long));
+   }
+  }
   fwrite((void *)&tinfo->nr_of_channels, sizeof(int), 1, outfptr);
   fwrite((void *)&tinfo->nr_of_points, sizeof(int), 1, outfptr);
   if (tinfo->itemsize<=0) tinfo->itemsize=1;
@@ -367,9 +431,18 @@ writeasc(transform_info_ptr calltinfo) {
 /*{{{  writeasc_exit(transform_info_ptr tinfo) {*/
 METHODDEF void
 writeasc_exit(transform_info_ptr tinfo) {
+ struct writeasc_storage *local_arg=(struct writeasc_storage *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
 
- if (!args[ARGS_CLOSE].is_set) writeasc_close_file(tinfo);
+ if (!args[ARGS_CLOSE].is_set) {
+  writeasc_close_file(tinfo);
+ } else if (local_arg->index_deferred && local_arg->write_index) {
+  /* Write the index collected over all epochs appended with -c -a */
+  writeasc_open_file(tinfo);
+  local_arg->index_deferred=FALSE;
+  writeasc_close_file(tinfo);
+ }
+ growing_buf_free(&local_arg->epoch_offsets);
 
  tinfo->methods->init_done=FALSE;
 }
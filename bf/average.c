@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-1999,2001,2003,2004,2009,2013 Bernd Feige
+ * Copyright (C) 1996-1999,2001,2003,2004,2009,2013,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -68,6 +68,10 @@ struct average_local_struct {
  int original_leaveright;
  long *channelaverages;
  long *channelweights;
+ /* -M: Map of the last incoming channel set to accumulator channels */
+ int *channelmap;
+ int channelmap_channels;
+ char *channelmap_names;
 };
 /*}}}  */
 
@@ -79,6 +83,9 @@ average_init(transform_info_ptr tinfo) {
 
  localp->nr_of_averages=0;
  localp->nroffiles=0;
+ localp->channelmap=NULL;
+ localp->channelmap_channels=0;
+ localp->channelmap_names=NULL;
 
  if (args[ARGS_SIGNTEST].is_set) {
   localp->stat_test=STAT_SIGN;
@@ -97,17 +104,98 @@ average_init(transform_info_ptr tinfo) {
 }
 /*}}}  */
 
+/*{{{  average_channelmap(transform_info_ptr tinfo)*/
+/* Return the map from incoming channel to accumulator channel for -M,
+ * adding channels not seen before to the accumulator. The map is kept
+ * together with the channel names it was built for and reused as long as
+ * the incoming epochs carry the same channels in the same order. */
+LOCAL int *
+average_channelmap(transform_info_ptr tinfo) {
+ struct average_local_struct *localp=(struct average_local_struct *)tinfo->methods->local_storage;
+ int *missmap=NULL;
+ int missing_channels=0;
+ int channel;
+ long namelength=0;
+ char *inname;
+
+ if (localp->channelmap!=NULL && localp->channelmap_channels==tinfo->nr_of_channels) {
+  inname=localp->channelmap_names;
+  for (channel=0; channel<tinfo->nr_of_channels; channel++) {
+   if (strcmp(inname, tinfo->channelnames[channel])!=0) break;
+   inname+=strlen(inname)+1;
+  }
+  if (channel==tinfo->nr_of_channels) return localp->channelmap;
+ }
+
+ /*{{{  Build a new map*/
+ free_pointer((void **)&localp->channelmap);
+ free_pointer((void **)&localp->channelmap_names);
+ for (channel=0; channel<tinfo->nr_of_channels; channel++) {
+  namelength+=strlen(tinfo->channelnames[channel])+1;
+ }
+ if ((localp->channelmap=(int *)malloc(tinfo->nr_of_channels*sizeof(int)))==NULL ||
+     (localp->channelmap_names=(char *)malloc(namelength))==NULL ||
+     (missmap=(int *)malloc((tinfo->nr_of_channels+1)*sizeof(int)))==NULL) {
+  ERREXIT(tinfo->emethods, "average: Error allocating channelmap\n");
+ }
+ localp->channelmap_channels=tinfo->nr_of_channels;
+ inname=localp->channelmap_names;
+ for (channel=0; channel<tinfo->nr_of_channels; channel++) {
+  strcpy(inname, tinfo->channelnames[channel]);
+  inname+=strlen(inname)+1;
+  localp->channelmap[channel]=find_channel_number(&localp->tinfo, tinfo->channelnames[channel]);
+  if (localp->channelmap[channel]== -1) {
+   /* Enter the location this channel will have after add_channels_or_points */
+   localp->channelmap[channel]=localp->tinfo.nr_of_channels+missing_channels;
+   missmap[missing_channels]=channel+1;
+   missing_channels++;
+  }
+ }
+ missmap[missing_channels]=0;	/* End of list */
+ /*}}}  */
+
+ if (missing_channels>0) {
+  DATATYPE *new_tsdata=add_channels_or_points(&localp->tinfo, tinfo, /* channel_list= */missmap, ADD_CHANNELS, /* zero_newdata= */TRUE);
+  /* At this point, localp->tinfo.nr_of_channels is already enlarged: */
+  long *new_channelaverages=(long *)realloc(localp->channelaverages, localp->tinfo.nr_of_channels*sizeof(long));
+  long *new_channelweights=(long *)realloc(localp->channelweights, localp->tinfo.nr_of_channels*sizeof(long));
+  if (new_tsdata==NULL || new_channelaverages==NULL || new_channelweights==NULL) {
+   ERREXIT(tinfo->emethods, "average: Error adding new channels\n");
+  }
+  free_pointer((void **)&localp->tinfo.tsdata);
+  localp->tinfo.tsdata=new_tsdata;
+  localp->channelaverages=new_channelaverages;
+  localp->channelweights=new_channelweights;
+  for (channel=localp->tinfo.nr_of_channels-missing_channels; channel<localp->tinfo.nr_of_channels; channel++) {
+   localp->channelaverages[channel]=localp->channelweights[channel]=0;
+  }
+  TRACEMS1(tinfo->emethods, 1, "average: Added %d channels!\n", MSGPARM(missing_channels));
+ }
+ free(missmap);
+ return localp->channelmap;
+}
+/*}}}  */
+
+/*{{{  Comparison function for qsort*/
+LOCAL int
+average_compare_values(const void *a, const void *b) {
+ DATATYPE const va= *(DATATYPE const *)a, vb= *(DATATYPE const *)b;
+ return (va<vb ? -1 : (va>vb ? 1 : 0));
+}
+/*}}}  */
+
 /*{{{  average(transform_info_ptr tinfo)*/
 METHODDEF DATATYPE *
 average(transform_info_ptr tinfo) {
  struct average_local_struct *localp=(struct average_local_struct *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
  int *channelmap=NULL;
- int missing_channels=0;
  int const varstep=var_steps[localp->stat_test]+(args[ARGS_MATCHBYNAME].is_set ? matchbyname_addsteps[localp->stat_test] : 0);
  int channel, itempart, freq, nfreq;
  int basepoints=tinfo->beforetrig;
- array avg_tsdata, tsdata, baseline;
+ DATATYPE *sorted_baseline=NULL;
+ array tsdata, avg_tsdata;
+ array_view avgview, tsview;
 
  if (tinfo->nrofaverages<=0 || !args[ARGS_WEIGHTED].is_set) tinfo->nrofaverages=1;
  if (localp->nr_of_averages==0) {
@@ -139,40 +227,7 @@ average(transform_info_ptr tinfo) {
   }
  }
  if (args[ARGS_MATCHBYNAME].is_set) {
-  int *missmap=NULL;
- if ((channelmap=(int *)malloc(tinfo->nr_of_channels*sizeof(int)))==NULL ||
-     (missmap=(int *)malloc((tinfo->nr_of_channels+1)*sizeof(int)))==NULL) {
-  ERREXIT(tinfo->emethods, "average: Error allocating channelmap\n");
- }
- for (channel=0; channel<tinfo->nr_of_channels; channel++) {
-  channelmap[channel]=find_channel_number(&localp->tinfo, tinfo->channelnames[channel]);
-  if (channelmap[channel]== -1) {
-   /* Enter the location this channel will have after add_channels_or_points */
-   channelmap[channel]=localp->tinfo.nr_of_channels+missing_channels;
-   missmap[missing_channels]=channel+1;
-   missing_channels++;
-  }
- }
- missmap[missing_channels]=0;	/* End of list */
-
- if (missing_channels>0) {
-  DATATYPE *new_tsdata=add_channels_or_points(&localp->tinfo, tinfo, /* channel_list= */missmap, ADD_CHANNELS, /* zero_newdata= */TRUE);
-  /* At this point, localp->tinfo.nr_of_channels is already enlarged: */
-  long *new_channelaverages=(long *)realloc(localp->channelaverages, localp->tinfo.nr_of_channels*sizeof(long));
-  long *new_channelweights=(long *)realloc(localp->channelweights, localp->tinfo.nr_of_channels*sizeof(long));
-  if (new_tsdata==NULL || new_channelaverages==NULL || new_channelweights==NULL) {
-   ERREXIT(tinfo->emethods, "average: Error adding new channels\n");
-  }
-  free_pointer((void **)&localp->tinfo.tsdata);
-  localp->tinfo.tsdata=new_tsdata;
-  localp->channelaverages=new_channelaverages;
-  localp->channelweights=new_channelweights;
-  for (channel=localp->tinfo.nr_of_channels-missing_channels; channel<localp->tinfo.nr_of_channels; channel++) {
-   localp->channelaverages[channel]=localp->channelweights[channel]=0;
-  }
-  TRACEMS1(tinfo->emethods, 1, "average: Added %d channels!\n", MSGPARM(missing_channels));
- }
-  free(missmap);
+  channelmap=average_channelmap(tinfo);
  }
 
  /*{{{  Add a new epoch, possibly with statistical analysis*/
@@ -192,6 +247,19 @@ average(transform_info_ptr tinfo) {
   basepoints=tinfo->beforetrig;
  }
  /*}}}  */
+ if (localp->stat_test==STAT_SINGLESIGN && basepoints>0) {
+  if ((sorted_baseline=(DATATYPE *)malloc(basepoints*sizeof(DATATYPE)))==NULL) {
+   ERREXIT(tinfo->emethods, "average: Error allocating baseline memory\n");
+  }
+ }
+
+ /* Count the epoch first so that the running t-test statistics see the
+  * number of values including the current one */
+ for (channel=0; channel<tinfo->nr_of_channels; channel++) {
+  int const target_channel=(channelmap==NULL ? channel : channelmap[channel]);
+  localp->channelaverages[target_channel]++;
+  localp->channelweights[target_channel]+=tinfo->nrofaverages;
+ }
 
  for (freq=0; freq<nfreq; freq++) {
   if (tinfo->data_type==FREQ_DATA) {
@@ -203,102 +271,100 @@ average(transform_info_ptr tinfo) {
    tinfo_array(tinfo, &tsdata);
    tinfo_array(&localp->tinfo, &avg_tsdata);
   }
-  baseline=tsdata; baseline.nr_of_elements=basepoints;
 
   for (itempart=0; itempart<tinfo->itemsize; itempart++) {
+   /* Non-weighted sum for the leaveright (`sum-only') items */
+   DATATYPE const weight=(itempart<tinfo->itemsize-tinfo->leaveright ? tinfo->nrofaverages : 1);
    array_use_item(&tsdata, itempart);
    array_use_item(&avg_tsdata, itempart*varstep);
-   array_use_item(&baseline, itempart);
+   if (!array_get_view(&tsdata, &tsview) || !array_get_view(&avg_tsdata, &avgview)) {
+    ERREXIT(tinfo->emethods, "average: Can't access the epoch data\n");
+   }
 
-   do {	/* For each channel==vector */
-    int const target_channel=(channelmap==NULL ? tsdata.current_vector : channelmap[tsdata.current_vector]);
-    avg_tsdata.current_vector=target_channel;
+   for (channel=0; channel<tsview.nr_of_vectors; channel++) {
+    int const target_channel=(channelmap==NULL ? channel : channelmap[channel]);
+    DATATYPE const * const in=ARRAY_VIEW_VECTOR(&tsview, channel);
+    DATATYPE * const out=ARRAY_VIEW_VECTOR(&avgview, target_channel);
+    long const in_skip=tsview.element_skip, out_skip=avgview.element_skip;
+    int const nr_of_elements=tsview.nr_of_elements;
+    int element;
 
-    do {
-     DATATYPE * const tmpptr=ARRAY_ELEMENT(&avg_tsdata);
-     if (itempart<tinfo->itemsize-tinfo->leaveright) {
-      tmpptr[0]+=array_scan(&tsdata)*tinfo->nrofaverages;
-     } else {
-      /* Non-weighted sum for the leaveright (`sum-only') items */
-      tmpptr[0]+=array_scan(&tsdata);
+    if (in_skip==1 && out_skip==1) {
+     for (element=0; element<nr_of_elements; element++) {
+      out[element]+=in[element]*weight;
+     }
+    } else {
+     for (element=0; element<nr_of_elements; element++) {
+      out[element*out_skip]+=in[element*in_skip]*weight;
      }
-     array_advance(&avg_tsdata);
-    } while (tsdata.message==ARRAY_CONTINUE);
+    }
 
     switch (localp->stat_test) {
      case STAT_SINGLESIGN:
       /*{{{  Do single value comparisons*/
-      array_previousvector(&tsdata);
-      array_previousvector(&avg_tsdata);
-      while (TRUE) {	/* For each element */
-       int votesum=0, nr_of_votes=0;
-       int const tsdata_current_element=tsdata.current_element;
-       DATATYPE * const tmpptr=ARRAY_ELEMENT(&avg_tsdata);
-       DATATYPE const hold=array_scan(&tsdata);
+      /* For each element, the fraction of the other baseline values that
+       * it exceeds. The baseline is sorted once so that this count is a
+       * binary search; the element itself never counts as smaller. */
+      for (element=0; element<basepoints; element++) {
+       sorted_baseline[element]=in[element*in_skip];
+      }
+      qsort(sorted_baseline, basepoints, sizeof(DATATYPE), average_compare_values);
+      for (element=0; element<nr_of_elements; element++) {
+       DATATYPE * const tmpptr=out+element*out_skip;
+       DATATYPE const hold=in[element*in_skip];
+       int const nr_of_votes=basepoints-(element<basepoints ? 1 : 0);
+       int low=0, high=basepoints;
        DATATYPE votemean;
-
-       do {	/* For each baseline element */
-	if (baseline.current_element!=tsdata_current_element) {
-	 /* Don't count a comparison of a baseline value with itself */
-	 if (hold>array_scan(&baseline)) votesum++;
-	 nr_of_votes++;
-	} else {
-	 array_advance(&baseline);
-	}
-       } while (baseline.message==ARRAY_CONTINUE);
-       votemean=((DATATYPE)votesum)/nr_of_votes;
-
+       /* Find the number of baseline values <hold */
+       while (low<high) {
+	int const mid=(low+high)/2;
+	if (sorted_baseline[mid]<hold) low=mid+1;
+	else high=mid;
+       }
+       votemean=((DATATYPE)low)/nr_of_votes;
        tmpptr[1]+=votemean; tmpptr[2]+=(1.0-votemean);
-       array_advance(&avg_tsdata);
-       if (tsdata.message!=ARRAY_CONTINUE) break;
-       array_previousvector(&baseline);
       }
       /*}}}  */
       break;
      case STAT_SIGN:
       /*{{{  Compare against average baseline*/
       {
-      DATATYPE const baseval=array_mean(&baseline);	/* Baseline mean */
-      array_previousvector(&tsdata);
-      array_previousvector(&avg_tsdata);
-      do {	/* For each element */
-       DATATYPE * const tmpptr=ARRAY_ELEMENT(&avg_tsdata);
-       DATATYPE const hold=array_scan(&tsdata);
-       /* Correct the mean to NOT include THIS value if within baseline
-	* This does absolutely nothing to the result.
-	* DATATYPE corrected_baseval=(tsdata.current_element>=1 && tsdata.current_element<=basepoints ?
-	*	(baseval*basepoints-hold)/(basepoints-1) : baseval);
-	*/
-       tmpptr[hold>baseval ? 1 : 2]++;
-       array_advance(&avg_tsdata);
-      } while (tsdata.message==ARRAY_CONTINUE);
+      DATATYPE baseval=0.0;	/* Baseline mean */
+      for (element=0; element<basepoints; element++) {
+       baseval+=in[element*in_skip];
+      }
+      baseval/=basepoints;
+      for (element=0; element<nr_of_elements; element++) {
+       DATATYPE * const tmpptr=out+element*out_skip;
+       tmpptr[in[element*in_skip]>baseval ? 1 : 2]++;
+      }
       }
       /*}}}  */
       break;
      case STAT_TTEST:
-      array_previousvector(&tsdata);
-      array_previousvector(&avg_tsdata);
-      do {	/* For each element */
-       DATATYPE * const tmpptr=ARRAY_ELEMENT(&avg_tsdata);
-       DATATYPE const hold=array_scan(&tsdata);
-       tmpptr[1]+=hold; tmpptr[2]+=hold*hold;
-       array_advance(&avg_tsdata);
-      } while (tsdata.message==ARRAY_CONTINUE);
+      /*{{{  Welford update of mean and sum of squared deviations*/
+      {
+      DATATYPE const n=localp->channelaverages[target_channel];
+      for (element=0; element<nr_of_elements; element++) {
+       DATATYPE * const tmpptr=out+element*out_skip;
+       DATATYPE const hold=in[element*in_skip];
+       DATATYPE const delta=hold-tmpptr[1];
+       tmpptr[1]+=delta/n;
+       tmpptr[2]+=delta*(hold-tmpptr[1]);
+      }
+      }
+      /*}}}  */
       break;
      default:
       break;
     }
-    if (freq==0 && itempart==0) {
-     localp->channelaverages[target_channel]++;
-     localp->channelweights[target_channel]+=tinfo->nrofaverages;
-    }
-   } while (tsdata.message!=ARRAY_ENDOFSCAN);
+   }
   }
  }
  localp->tinfo.z_value+=tinfo->z_value*tinfo->nrofaverages;
  /*}}}  */
 
- if (channelmap!=NULL) free(channelmap);
+ free_pointer((void **)&sorted_baseline);
  free_tinfo(tinfo); /* Free everything from the old epoch */
 
  localp->nr_of_averages+=tinfo->nrofaverages;
@@ -340,11 +406,18 @@ average_exit(transform_info_ptr tinfo) {
      do {
       DATATYPE *const element=ARRAY_ELEMENT(&myarray);
       if (itempart<localp->original_itemsize-localp->original_leaveright) element[0]/=localp->channelweights[myarray.current_vector];
-      if (args[ARGS_TTEST].is_set && !args[ARGS_LEAVE_TPARAMETERS].is_set) {
+      if (localp->stat_test==STAT_TTEST) {
+       /* Accumulated are the mean and the sum of squared deviations */
        long const channelaverages=localp->channelaverages[myarray.current_vector];
-       DATATYPE const datatemp=element[1];
-       element[1]=datatemp/(channelaverages*sqrt((element[2]-datatemp*datatemp/channelaverages)/(channelaverages*(channelaverages-1))));
-       element[2]=student_p(channelaverages-1, fabs(element[1]));
+       DATATYPE const mean=element[1], sumsqdev=element[2];
+       if (args[ARGS_TTEST].is_set && !args[ARGS_LEAVE_TPARAMETERS].is_set) {
+	element[1]=mean/sqrt(sumsqdev/(channelaverages*(channelaverages-1)));
+	element[2]=student_p(channelaverages-1, fabs(element[1]));
+       } else {
+	/* Output sum and sum of squares as the parameters */
+	element[1]=mean*channelaverages;
+	element[2]=sumsqdev+mean*mean*channelaverages;
+       }
       }
       if (args[ARGS_MATCHBYNAME].is_set && matchbyname_addsteps[localp->stat_test]!=0) {
        element[varstep-1]=(args[ARGS_OUTPUT_NROFFILES].is_set ? localp->channelaverages[myarray.current_vector] : localp->channelweights[myarray.current_vector]);
@@ -360,6 +433,8 @@ average_exit(transform_info_ptr tinfo) {
 
  free_pointer((void **)&localp->channelaverages);
  free_pointer((void **)&localp->channelweights);
+ free_pointer((void **)&localp->channelmap);
+ free_pointer((void **)&localp->channelmap_names);
  tinfo->methods->init_done=FALSE;
 }
 /*}}}  */
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996,1998,1999,2001 Bernd Feige
+ * Copyright (C) 1996,1998,1999,2001,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -97,6 +97,7 @@ select_baseline_divide(transform_info_ptr tinfo) {
  tinfo->methods->transform= &baseline_divide;
  tinfo->methods->transform_exit= &baseline_divide_exit;
  tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="baseline_divide";
  tinfo->methods->method_description=
   "Transform method to divide the data by the baseline mean.\n";
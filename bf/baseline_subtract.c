@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996,1998,1999,2001 Bernd Feige
+ * Copyright (C) 1996,1998,1999,2001,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -87,6 +87,7 @@ select_baseline_subtract(transform_info_ptr tinfo) {
  tinfo->methods->transform= &baseline_subtract;
  tinfo->methods->transform_exit= &baseline_subtract_exit;
  tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="baseline_subtract";
  tinfo->methods->method_description=
   "Transform method to subtract the baseline mean from the data.\n";
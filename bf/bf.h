@@ -91,6 +91,17 @@ typedef struct {
  DATATYPE Im;
 } complex;
 
+/*{{{  struct fftfilter_block: Frequency range suppression block of fftfilter*/
+struct fftfilter_block {
+ float start;
+ float nullstart;
+ float nullend;
+ float end;
+ DATATYPE factor; /* Note: This is the full factor x, given by the -x option */
+ int last_block;
+};
+/*}}}  */
+
 /*{{{  The type of individual histogram entries*/
 #define HIST_TYPE DATATYPE
 struct hist_boundary {		/* Struct for histogram definition */
@@ -105,6 +116,58 @@ struct hist_boundary {		/* Struct for histogram definition */
 };
 /*}}}  */
 
+/*{{{  struct channel_operator: Sparse linear map between channel sets*/
+/* Rows in compressed sparse row form (see channel_operator.c). Columns
+ * below nr_of_inputs refer to input channels, column nr_of_inputs+r to
+ * row r, which must be an earlier one. The first nr_of_intermediates rows
+ * are only computed for use by later rows, the others are the outputs. */
+struct channel_operator {
+ int nr_of_inputs;
+ int nr_of_intermediates;
+ int nr_of_rows;
+ growing_buf row_start;	/* int: First entry of each row; the last row ends at the end of entries */
+ growing_buf entries;	/* struct channel_operator_entry */
+};
+struct channel_operator_entry {
+ int column;
+ DATATYPE value;
+};
+#define CHANNEL_OPERATOR_ROW(op, row) ((op)->nr_of_inputs+(row))
+/*}}}  */
+
+/*{{{  struct trigger_epochs: Epoch selection from a file trigger list*/
+/* State of the trigger-driven epoch selection shared by the get_epoch
+ * methods (see trigger_epochs.c). The reader sets the fields up to
+ * points_in_file, everything else is maintained by trigger_epochs_*(). */
+struct trigger_epochs {
+ growing_buf *triggersp;	/* The file trigger list, in file order */
+ void (*build_trigbuffer)(transform_info_ptr tinfo); /* Fills *triggersp on first use */
+ int const *trigcodes;	/* Accepted codes (0-terminated), NULL accepts all */
+ Bool remap_codes;	/* Report accepted codes as their index (1..) in trigcodes */
+ long offset;		/* Shrinks the epoch window on both sides */
+ long points_in_file;	/* Windows must end before this point; <=0: unknown */
+ int current_trigger;	/* Next entry of the list to consider */
+	/* Set by trigger_epochs_next: */
+ long trigger_point;
+ long start_point;
+ long end_point;
+ char *description;
+	/* Position index for range queries, built on demand: */
+ struct trigger_epochs_entry *by_position;
+ int *hits;
+ int nr_listed;	/* Length of the list when by_position was built */
+ int nr_indexed;	/* Entries in by_position */
+};
+/*}}}  */
+
+/*{{{  struct sidecar_file: A file caching information about a data file (see sidecar.c)*/
+struct sidecar_file {
+ FILE *file;
+ char *filename;
+ char *tempfilename;	/* Name while being written */
+};
+/*}}}  */
+
 extern char *bf_lib_timestamp;
 
 /*{{{  Prototypes*/
@@ -118,11 +181,23 @@ complex c_mult(complex cmpl1, complex cmpl2);
 complex c_smult(complex cmpl, DATATYPE factor);
 complex c_konj(complex cmpl);
 complex c_inv(complex cmpl);
-void fourier(complex *data, int nn, int isign);
-void realfft(DATATYPE *data, int nn, int isign);
-void real2fft(DATATYPE *data1, DATATYPE *data2, complex *p1, int n);
+typedef struct fft_plan_struct *fft_plan_ptr;
+fft_plan_ptr fft_plan_get(int n);
+int fft_good_size(int n, Bool round_up);
+Bool fft_execute(fft_plan_ptr plan, complex *data, int isign);
+Bool fft_execute_real(fft_plan_ptr plan, DATATYPE *data, int isign);
+long fft_work_size(fft_plan_ptr plan);
+Bool fft_execute_many(fft_plan_ptr plan, complex *data, int howmany, int isign, complex *work);
+Bool fft_execute_real_many(fft_plan_ptr plan, DATATYPE *data, int howmany, int isign, complex *work);
+Bool fourier(complex *data, int nn, int isign);
+Bool realfft(DATATYPE *data, int nn, int isign);
+Bool real2fft(DATATYPE *data1, DATATYPE *data2, complex *p1, int n);
 void select_fftspect(transform_info_ptr tinfo);
 void select_fftfilter(transform_info_ptr tinfo);
+struct fftfilter_block *fftfilter_parse_blocks(transform_info_ptr tinfo, char const *blocks);
+float fftfilter_block_factor(struct fftfilter_block const *inblocks, float const ratio);
+DATATYPE fftfilter_transfer_factor(struct fftfilter_block const *blockdefs, float const ratio);
+void select_stream_filter(transform_info_ptr tinfo);
 void select_writeasc(transform_info_ptr tinfo);
 void select_readasc(transform_info_ptr tinfo);
 void select_get_mfxepoch(transform_info_ptr tinfo);
@@ -149,6 +224,7 @@ void select_zero_phase(transform_info_ptr tinfo);
 void select_detrend(transform_info_ptr tinfo);
 void select_demean_maps(transform_info_ptr tinfo);
 void select_rereference(transform_info_ptr tinfo);
+void select_spatial_filter(transform_info_ptr tinfo);
 void select_dip_fit(transform_info_ptr tinfo);
 void select_show_memuse(transform_info_ptr tinfo);
 void select_run(transform_info_ptr tinfo);
@@ -195,6 +271,7 @@ void select_read_hdf5(transform_info_ptr tinfo);
 void select_raw_fft(transform_info_ptr tinfo);
 void select_read_generic(transform_info_ptr tinfo);
 void select_write_generic(transform_info_ptr tinfo);
+void select_write_frame(transform_info_ptr tinfo);
 void select_read_tucker(transform_info_ptr tinfo);
 void select_read_vitaport(transform_info_ptr tinfo);
 void select_write_vitaport(transform_info_ptr tinfo);
@@ -262,6 +339,7 @@ long find_pointnearx(transform_info_ptr tinfo, DATATYPE x);
 long decode_xpoint(transform_info_ptr tinfo, char *token);
 void create_xaxis(transform_info_ptr tinfo, char const *unitname);
 void copy_channelinfo(transform_info_ptr tinfo, char **channelnames, double *probepos);
+void select_channelinfo(transform_info_ptr tinfo, Bool const *selected);
 void deepcopy_tinfo(transform_info_ptr to_tinfo, transform_info_ptr from_tinfo);
 void deepfree_tinfo(transform_info_ptr tinfo);
 void free_tinfo(transform_info_ptr tinfo);
@@ -273,11 +351,35 @@ int *get_trigcode_list(char const *const csv);
 int read_trigger_from_trigfile(FILE *triggerfile, DATATYPE sfreq, long *trigpoint, char **descriptionp);
 void push_trigger(growing_buf *triggersp, long position, int code, char *description);
 void clear_triggers(growing_buf *triggersp);
+void join_triggers(growing_buf *triggersp, growing_buf *fromtriggersp, long offset);
+Bool sidecar_open(struct sidecar_file *sidecarp, char const *datafilename, char const *suffix, char const *magic, char const *key);
+void sidecar_close(struct sidecar_file *sidecarp);
+Bool sidecar_create(struct sidecar_file *sidecarp, char const *datafilename, char const *suffix, char const *magic, char const *key);
+Bool sidecar_commit(struct sidecar_file *sidecarp, Bool ok);
+Bool trigger_cache_load(transform_info_ptr tinfo, char const *datafilename, char const *key, growing_buf *triggersp);
+void trigger_cache_save(transform_info_ptr tinfo, char const *datafilename, char const *key, growing_buf *triggersp);
+void trigger_epochs_init(struct trigger_epochs *epochs, growing_buf *triggersp, void (*build_trigbuffer)(transform_info_ptr tinfo));
+int trigger_epochs_next(transform_info_ptr tinfo, struct trigger_epochs *epochs, long beforetrig, long aftertrig);
+void trigger_epochs_transfer(transform_info_ptr tinfo, struct trigger_epochs *epochs, growing_buf *epochtriggersp, long file_start_point, long file_end_point);
+void trigger_epochs_free(struct trigger_epochs *epochs);
+void profile_start(transform_info_ptr tinfo, char const *tracefilename, char const *resultfilename);
+void profile_report(transform_info_ptr tinfo, FILE *outfile);
+void profile_end(transform_info_ptr tinfo);
 void fprint_cstring(FILE *outfile, char const *string);
 void tinfo_array(transform_info_ptr tinfo, array *thisarray);
 void tinfo_array_setshift(transform_info_ptr tinfo, array *thisarray, int shift);
 void tinfo_array_setfreq(transform_info_ptr tinfo, array *thisarray, int freq);
+void tinfo_array_view(transform_info_ptr tinfo, array_view *view);
 int *expand_channel_list(transform_info_ptr tinfo, char const *channelnames);
+void channel_operator_init(struct channel_operator *op);
+void channel_operator_reset(struct channel_operator *op, int nr_of_inputs, int nr_of_intermediates);
+Bool channel_operator_new_row(struct channel_operator *op);
+Bool channel_operator_add(struct channel_operator *op, int column, DATATYPE value);
+Bool channel_operator_apply(struct channel_operator const *op, array_view const *in, array_view *out);
+void channel_operator_free(struct channel_operator *op);
+int get_block_nr_of_channels(transform_info_ptr tinfo, int const *channel_list);
+long get_block(transform_info_ptr tinfo, long start_point, long nr_of_points, int const *channel_list, DATATYPE *dest, enum get_block_layouts layout);
+Bool *expand_channel_selection(transform_info_ptr tinfo, char const *selection, int nr_of_channels, char **channelnames, int *nr_selectedp);
 Bool is_in_channellist(int val, int *list);
 struct source_desc *eg_dip_srcmodule(transform_info_ptr tinfo, char **args);
 struct source_desc *var_random_srcmodule(transform_info_ptr tinfo, char **args);
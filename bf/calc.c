@@ -1,12 +1,13 @@
 /*
- * Copyright (C) 1996-2001,2003,2010,2011 Bernd Feige
+ * Copyright (C) 1996-2001,2003,2010,2011,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
 /*{{{  Description*/
 /*
  * calc is a simple transform method doing elementwise operations on the whole
- * data set using one of the functions defined below
+ * data set using one of the functions defined below. A chain of functions
+ * can be given, which are applied block by block in a single pass.
  * 						-- Bernd Feige 27.08.1993
  */
 /*}}}  */
@@ -22,118 +23,130 @@
 /*}}}  */
 
 /* Definition of the individual data modifier functions:
- * The convention is that the functions access the current array element,
- * but do not change the array pointer */
-LOCAL void calc_log(transform_info_ptr tinfo, array *myarray) {
- WRITE_ELEMENT(myarray, log((double)READ_ELEMENT(myarray)));
+ * Each function is a kernel working on a block of n elements x[0], x[skip],
+ * x[2*skip], ... in place. Functions accessing more than one item get the
+ * address of the first item of each tuple. The loops are written so that
+ * the compiler can vectorize them for skip==1, which is the case if calc
+ * works on all channels and items of a data set. */
+#define CALC_KERNEL1(name, expression) \
+LOCAL void name(transform_info_ptr tinfo, DATATYPE *x, long n, long skip) { \
+ long i; \
+ if (skip==1) { \
+  for (i=0; i<n; i++) { \
+   DATATYPE const v=x[i]; \
+   x[i]=(expression); \
+  } \
+ } else { \
+  for (i=0; i<n; i++) { \
+   DATATYPE const v=x[i*skip]; \
+   x[i*skip]=(expression); \
+  } \
+ } \
 }
-LOCAL void calc_log10(transform_info_ptr tinfo, array *myarray) {
- WRITE_ELEMENT(myarray, log10((double)READ_ELEMENT(myarray)));
-}
-LOCAL void calc_exp(transform_info_ptr tinfo, array *myarray) {
- WRITE_ELEMENT(myarray, exp((double)READ_ELEMENT(myarray)));
-}
-LOCAL void calc_exp10(transform_info_ptr tinfo, array *myarray) {
- WRITE_ELEMENT(myarray, pow(10.0, (double)READ_ELEMENT(myarray)));
-}
-LOCAL void calc_logdB(transform_info_ptr tinfo, array *myarray) {
- /* 1 Bel is log10(Power). Note that we assume a power ratio as input! */
- WRITE_ELEMENT(myarray, log10((double)READ_ELEMENT(myarray))*10.0);
-}
-LOCAL void calc_expdB(transform_info_ptr tinfo, array *myarray) {
- WRITE_ELEMENT(myarray, pow(10.0, (double)READ_ELEMENT(myarray)/10.0));
-}
-LOCAL void calc_atanh(transform_info_ptr tinfo, array *myarray) {
- WRITE_ELEMENT(myarray, atanh((double)READ_ELEMENT(myarray)));
-}
-LOCAL void calc_sqrt(transform_info_ptr tinfo, array *myarray) {
- WRITE_ELEMENT(myarray, sqrt((double)READ_ELEMENT(myarray)));
-}
-LOCAL void calc_square(transform_info_ptr tinfo, array *myarray) {
- DATATYPE const hold=READ_ELEMENT(myarray);
- WRITE_ELEMENT(myarray, hold*hold);
-}
-LOCAL void calc_neg(transform_info_ptr tinfo, array *myarray) {
- WRITE_ELEMENT(myarray, -READ_ELEMENT(myarray));
-}
-LOCAL void calc_fabs(transform_info_ptr tinfo, array *myarray) {
- WRITE_ELEMENT(myarray, fabs((double)READ_ELEMENT(myarray)));
-}
-LOCAL void calc_inv(transform_info_ptr tinfo, array *myarray) {
- WRITE_ELEMENT(myarray, 1.0/READ_ELEMENT(myarray));
-}
-LOCAL void calc_ceil(transform_info_ptr tinfo, array *myarray) {
- WRITE_ELEMENT(myarray, ceil((double)READ_ELEMENT(myarray)));
-}
-LOCAL void calc_floor(transform_info_ptr tinfo, array *myarray) {
- WRITE_ELEMENT(myarray, floor((double)READ_ELEMENT(myarray)));
-}
-LOCAL void calc_rint(transform_info_ptr tinfo, array *myarray) {
- WRITE_ELEMENT(myarray, rint((double)READ_ELEMENT(myarray)));
-}
-LOCAL void calc_abs2(transform_info_ptr tinfo, array *myarray) {
- DATATYPE * const element=ARRAY_ELEMENT(myarray);
- complex const c={element[0], element[1]};
- element[0]=c_abs(c);
- element[1]= 0.0;
+CALC_KERNEL1(calc_log, log((double)v))
+CALC_KERNEL1(calc_log10, log10((double)v))
+CALC_KERNEL1(calc_exp, exp((double)v))
+CALC_KERNEL1(calc_exp10, pow(10.0, (double)v))
+/* 1 Bel is log10(Power). Note that we assume a power ratio as input! */
+CALC_KERNEL1(calc_logdB, log10((double)v)*10.0)
+CALC_KERNEL1(calc_expdB, pow(10.0, (double)v/10.0))
+CALC_KERNEL1(calc_atanh, atanh((double)v))
+CALC_KERNEL1(calc_sqrt, sqrt((double)v))
+CALC_KERNEL1(calc_square, v*v)
+CALC_KERNEL1(calc_neg, -v)
+CALC_KERNEL1(calc_fabs, fabs((double)v))
+CALC_KERNEL1(calc_inv, 1.0/v)
+CALC_KERNEL1(calc_ceil, ceil((double)v))
+CALC_KERNEL1(calc_floor, floor((double)v))
+CALC_KERNEL1(calc_rint, rint((double)v))
+#undef CALC_KERNEL1
+
+LOCAL void calc_abs2(transform_info_ptr tinfo, DATATYPE *x, long n, long skip) {
+ long i;
+ for (i=0; i<n; i++) {
+  DATATYPE * const element=x+i*skip;
+  element[0]=sqrt(element[0]*element[0]+element[1]*element[1]);
+  element[1]= 0.0;
+ }
 }
-LOCAL void calc_square2(transform_info_ptr tinfo, array *myarray) {
- DATATYPE * const element=ARRAY_ELEMENT(myarray);
- complex const c={element[0], element[1]};
- element[0]=c_power(c);
- element[1]= 0.0;
+LOCAL void calc_square2(transform_info_ptr tinfo, DATATYPE *x, long n, long skip) {
+ long i;
+ for (i=0; i<n; i++) {
+  DATATYPE * const element=x+i*skip;
+  element[0]=element[0]*element[0]+element[1]*element[1];
+  element[1]= 0.0;
+ }
 }
-LOCAL void calc_norm2(transform_info_ptr tinfo, array *myarray) {
- DATATYPE * const element=ARRAY_ELEMENT(myarray);
- complex const c={element[0], element[1]};
- DATATYPE const absval=c_abs(c);
- element[0]/=absval;
- element[1]/=absval;
+LOCAL void calc_norm2(transform_info_ptr tinfo, DATATYPE *x, long n, long skip) {
+ long i;
+ for (i=0; i<n; i++) {
+  DATATYPE * const element=x+i*skip;
+  DATATYPE const absval=sqrt(element[0]*element[0]+element[1]*element[1]);
+  element[0]/=absval;
+  element[1]/=absval;
+ }
 }
-LOCAL void calc_phase(transform_info_ptr tinfo, array *myarray) {
- DATATYPE * const element=ARRAY_ELEMENT(myarray);
- complex const c={element[0], element[1]};
- element[0]=c_phase(c);
- element[1]= 0.0;
+LOCAL void calc_phase(transform_info_ptr tinfo, DATATYPE *x, long n, long skip) {
+ long i;
+ for (i=0; i<n; i++) {
+  DATATYPE * const element=x+i*skip;
+  complex const c={element[0], element[1]};
+  element[0]=c_phase(c);
+  element[1]= 0.0;
+ }
 }
-LOCAL void calc_absandphase(transform_info_ptr tinfo, array *myarray) {
- DATATYPE * const element=ARRAY_ELEMENT(myarray);
- complex const c={element[0], element[1]};
- element[0]=c_abs(c);
- element[1]=c_phase(c);
+LOCAL void calc_absandphase(transform_info_ptr tinfo, DATATYPE *x, long n, long skip) {
+ long i;
+ for (i=0; i<n; i++) {
+  DATATYPE * const element=x+i*skip;
+  complex const c={element[0], element[1]};
+  element[0]=c_abs(c);
+  element[1]=c_phase(c);
+ }
 }
-LOCAL void calc_coherence(transform_info_ptr tinfo, array *myarray) {
- DATATYPE * const element=ARRAY_ELEMENT(myarray);
- complex const c={element[0], element[1]};
- long const averages=(tinfo->itemsize==3 ? (long int)rint(element[2]) : tinfo->nrofaverages);
- element[0]=c_abs(c);
- /* This yields a probability measure for he calculated coherence;
-  * 2*averages is the number of independent sections from which the
-  * coherence was calculated and is only correct here if the fftspect
-  * overlap parameter was 1 in the calculation */
- element[1]= pow(1-element[0], 2*averages-1);
+LOCAL void calc_coherence(transform_info_ptr tinfo, DATATYPE *x, long n, long skip) {
+ long i;
+ for (i=0; i<n; i++) {
+  DATATYPE * const element=x+i*skip;
+  complex const c={element[0], element[1]};
+  long const averages=(tinfo->itemsize==3 ? (long int)rint(element[2]) : tinfo->nrofaverages);
+  element[0]=c_abs(c);
+  /* This yields a probability measure for he calculated coherence;
+   * 2*averages is the number of independent sections from which the
+   * coherence was calculated and is only correct here if the fftspect
+   * overlap parameter was 1 in the calculation */
+  element[1]= pow(1-element[0], 2*averages-1);
+ }
 }
-LOCAL void calc_ttest(transform_info_ptr tinfo, array *myarray) {
- DATATYPE * const element=ARRAY_ELEMENT(myarray);
- long const averages=(tinfo->itemsize==4 ? (long int)rint(element[3]) : tinfo->nrofaverages);
- DATATYPE const datatemp=element[1];
- element[1]=datatemp/(averages*sqrt((element[2]-datatemp*datatemp/averages)/(averages*(averages-1))));
- element[2]=student_p(averages-1, fabs(element[1]));
+LOCAL void calc_ttest(transform_info_ptr tinfo, DATATYPE *x, long n, long skip) {
+ long i;
+ for (i=0; i<n; i++) {
+  DATATYPE * const element=x+i*skip;
+  long const averages=(tinfo->itemsize==4 ? (long int)rint(element[3]) : tinfo->nrofaverages);
+  DATATYPE const datatemp=element[1];
+  element[1]=datatemp/(averages*sqrt((element[2]-datatemp*datatemp/averages)/(averages*(averages-1))));
+  element[2]=student_p(averages-1, fabs(element[1]));
+ }
 }
-LOCAL void calc_stddev(transform_info_ptr tinfo, array *myarray) {
- DATATYPE * const element=ARRAY_ELEMENT(myarray);
- long const averages=(tinfo->itemsize==4 ? (long int)rint(element[3]) : tinfo->nrofaverages);
- DATATYPE const datatemp=element[1];
- element[1]=sqrt((element[2]-datatemp*datatemp/averages)/averages); /* sigma */
- element[2]=element[1]/sqrt(averages-1);	/* standard error */
+LOCAL void calc_stddev(transform_info_ptr tinfo, DATATYPE *x, long n, long skip) {
+ long i;
+ for (i=0; i<n; i++) {
+  DATATYPE * const element=x+i*skip;
+  long const averages=(tinfo->itemsize==4 ? (long int)rint(element[3]) : tinfo->nrofaverages);
+  DATATYPE const datatemp=element[1];
+  element[1]=sqrt((element[2]-datatemp*datatemp/averages)/averages); /* sigma */
+  element[2]=element[1]/sqrt(averages-1);	/* standard error */
+ }
 }
 
+typedef void (*calc_kernel)(transform_info_ptr tinfo, DATATYPE *x, long n, long skip);
+
 /* wantitems tells how many items a function needs to access; this is used for
  * checking in calc_init. 
  * Functions which access only one item will be executed on all non-leaveright
  * items automatically, the others won't. */
 LOCAL struct {
- void (*function_pointer)(transform_info_ptr tinfo, array *myarray);
+ calc_kernel function_pointer;
  int wantitems;
 } function_descriptors[]={
  {&calc_log,	1},
@@ -162,6 +175,7 @@ LOCAL struct {
  {&calc_ttest,	3},
  {&calc_stddev,	3}
 };
+
 /* Can't put this into function_descriptors[] because we pass this as selection array */
 LOCAL const char *const function_names[]={
  "log", 
@@ -194,16 +208,24 @@ enum ARGS_ENUM {
  ARGS_BYNAME=0,
  ARGS_ITEMPART, 
  ARGS_FUNCTION, 
+ ARGS_CHAIN, 
  NR_OF_ARGUMENTS
 };
 LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_STRING_WORD, "channelnames: Restrict to these channel names", "n", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_LONG, "nr_of_item: work only on this item # (>=0)", "i", 0, NULL},
- {T_ARGS_TAKES_SELECTION, "Function name", "", 0, function_names}
+ {T_ARGS_TAKES_SELECTION, "Function name", "", 0, function_names},
+ {T_ARGS_TAKES_SENTENCE, "Further single-item functions applied in the same pass, eg: log10 neg", " ", ARGDESC_UNUSED, NULL}
 };
 
+/* The number of elements each function of a chain is applied to before
+ * the next one is; Small enough for the block to stay in the L1 cache */
+#define CALC_CHAIN_BLOCK 512
+
 struct calc_storage {
- void (*function_pointer)(transform_info_ptr tinfo, array *myarray);
+ calc_kernel *functions;
+ int nr_of_functions;
+ int wantitems;
  int *channel_list;
  Bool have_channel_list;
  int fromitem;
@@ -216,7 +238,41 @@ calc_init(transform_info_ptr tinfo) {
  struct calc_storage *local_arg=(struct calc_storage *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
  int const wantitems=function_descriptors[args[ARGS_FUNCTION].arg.i].wantitems;
- local_arg->function_pointer=function_descriptors[args[ARGS_FUNCTION].arg.i].function_pointer;
+
+ /*{{{  Set up the chain of functions*/
+ local_arg->nr_of_functions=1;
+ if (args[ARGS_CHAIN].is_set) {
+  growing_buf buf, tokenbuf;
+  growing_buf_init(&buf);
+  growing_buf_takethis(&buf, args[ARGS_CHAIN].arg.s);
+  growing_buf_init(&tokenbuf);
+  growing_buf_allocate(&tokenbuf, 0);
+  if ((local_arg->functions=(calc_kernel *)malloc((1+growing_buf_count_tokens(&buf))*sizeof(calc_kernel)))==NULL) {
+   ERREXIT(tinfo->emethods, "calc_init: Error allocating function list\n");
+  }
+  growing_buf_get_firsttoken(&buf,&tokenbuf);
+  while (tokenbuf.current_length>0) {
+   int function;
+   for (function=0; function_names[function]!=NULL && strcmp(function_names[function], tokenbuf.buffer_start)!=0; function++);
+   if (function_names[function]==NULL) {
+    ERREXIT1(tinfo->emethods, "calc_init: Unknown function `%s'\n", MSGPARM(tokenbuf.buffer_start));
+   }
+   if (function_descriptors[function].wantitems!=1) {
+    ERREXIT1(tinfo->emethods, "calc_init: Function `%s' accesses multiple items and can only be the first function\n", MSGPARM(tokenbuf.buffer_start));
+   }
+   local_arg->functions[local_arg->nr_of_functions++]=function_descriptors[function].function_pointer;
+   growing_buf_get_nexttoken(&buf,&tokenbuf);
+  }
+  growing_buf_free(&tokenbuf);
+  growing_buf_free(&buf);
+ } else {
+  if ((local_arg->functions=(calc_kernel *)malloc(sizeof(calc_kernel)))==NULL) {
+   ERREXIT(tinfo->emethods, "calc_init: Error allocating function list\n");
+  }
+ }
+ local_arg->functions[0]=function_descriptors[args[ARGS_FUNCTION].arg.i].function_pointer;
+ local_arg->wantitems=wantitems;
+ /*}}}  */
 
  if (args[ARGS_BYNAME].is_set) {
   /* Note that this is NULL if no channel matched, which is why we need have_channel_list as well... */
@@ -248,40 +304,63 @@ calc_init(transform_info_ptr tinfo) {
 }
 /*}}}  */
 
+/*{{{  calc_block(transform_info_ptr tinfo, DATATYPE *x, long n, long skip) {*/
+/* Apply the chain of functions to n elements at x with distance skip.
+ * Multi-item functions can only be first in the chain; the single-item
+ * functions following them work on the item they were applied at. */
+LOCAL void
+calc_block(transform_info_ptr tinfo, DATATYPE *x, long n, long skip) {
+ struct calc_storage *local_arg=(struct calc_storage *)tinfo->methods->local_storage;
+ if (local_arg->nr_of_functions==1) {
+  (*local_arg->functions[0])(tinfo, x, n, skip);
+ } else {
+  long done;
+  for (done=0; done<n; done+=CALC_CHAIN_BLOCK) {
+   long const block=(n-done<CALC_CHAIN_BLOCK ? n-done : CALC_CHAIN_BLOCK);
+   int function;
+   for (function=0; function<local_arg->nr_of_functions; function++) {
+    (*local_arg->functions[function])(tinfo, x+done*skip, block, skip);
+   }
+  }
+ }
+}
+/*}}}  */
+
 /*{{{  calc(transform_info_ptr tinfo) {*/
 METHODDEF DATATYPE *
 calc(transform_info_ptr tinfo) {
  struct calc_storage *local_arg=(struct calc_storage *)tinfo->methods->local_storage;
- transform_info_ptr const tinfoptr=tinfo;
- array myarray;
-
-  int itempart;
-  int shift, nrofshifts=1;
-  DATATYPE *save_tsdata;
+ array_view view;
+ int shift, nrofshifts=1;
+ long const shiftsize=((long)tinfo->nroffreq)*tinfo->nr_of_channels*tinfo->itemsize;
 
-  tinfo_array(tinfoptr, &myarray);	/* The channels are the vectors */
-  save_tsdata=myarray.start;
+ tinfo_array_view(tinfo, &view);	/* The channels are the vectors */
 
-  if (tinfoptr->data_type==FREQ_DATA) {
-   nrofshifts=tinfoptr->nrofshifts;
-  }
-  for (shift=0; shift<nrofshifts; shift++) {
-   myarray.start=save_tsdata+shift*tinfo->nroffreq*tinfo->nr_of_channels*tinfo->itemsize;
-   array_setreadwrite(&myarray);
-   for (itempart=local_arg->fromitem; itempart<=local_arg->toitem; itempart++) {
-    array_use_item(&myarray, itempart);
-    do {
-     if (local_arg->have_channel_list && !is_in_channellist(myarray.current_vector+1, local_arg->channel_list)) {
-      array_nextvector(&myarray);
-      continue;
-     }
-     do {
-      (*local_arg->function_pointer)(tinfo, &myarray);
-      array_advance(&myarray);
-     } while (myarray.message==ARRAY_CONTINUE);
-    } while (myarray.message==ARRAY_ENDOFVECTOR);
+ if (tinfo->data_type==FREQ_DATA) {
+  nrofshifts=tinfo->nrofshifts;
+ }
+ for (shift=0; shift<nrofshifts; shift++) {
+  DATATYPE * const start=view.start+shift*shiftsize;
+  if (local_arg->wantitems==1 && !local_arg->have_channel_list && local_arg->fromitem==0 && local_arg->toitem==tinfo->itemsize-1) {
+   /* All values of the shift are processed: One contiguous block */
+   calc_block(tinfo, start, ((long)view.nr_of_elements)*view.nr_of_vectors*tinfo->itemsize, 1);
+  } else {
+   int channel;
+   for (channel=0; channel<view.nr_of_vectors; channel++) {
+    DATATYPE * const vector=start+channel*view.vector_skip;
+    int itempart;
+    if (local_arg->have_channel_list && !is_in_channellist(channel+1, local_arg->channel_list)) continue;
+    if (view.element_skip==tinfo->itemsize && local_arg->wantitems==1 && local_arg->fromitem==0 && local_arg->toitem==tinfo->itemsize-1) {
+     /* The channel is contiguous (non-multiplexed) */
+     calc_block(tinfo, vector, ((long)view.nr_of_elements)*tinfo->itemsize, 1);
+     continue;
+    }
+    for (itempart=local_arg->fromitem; itempart<=local_arg->toitem; itempart++) {
+     calc_block(tinfo, vector+itempart, view.nr_of_elements, view.element_skip);
+    }
    }
   }
+ }
 
  return tinfo->tsdata;
 }
@@ -293,6 +372,7 @@ calc_exit(transform_info_ptr tinfo) {
  struct calc_storage *local_arg=(struct calc_storage *)tinfo->methods->local_storage;
 
  free_pointer((void **)&local_arg->channel_list);
+ free_pointer((void **)&local_arg->functions);
 
  tinfo->methods->init_done=FALSE;
 }
@@ -305,6 +385,7 @@ select_calc(transform_info_ptr tinfo) {
  tinfo->methods->transform= &calc;
  tinfo->methods->transform_exit= &calc_exit;
  tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="calc";
  tinfo->methods->method_description=
   "Transform method to apply elementwise transformations to the input data\n";
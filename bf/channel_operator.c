@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2026 Bernd Feige
+ * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+ */
+/*{{{}}}*/
+/*{{{  Description*/
+/*
+ * channel_operator.c Sparse linear maps between channel sets, as used by
+ * spatial filters like laplacian and rereference.
+ *
+ * A method compiles its filter once into a struct channel_operator (rows of
+ * (column, value) entries, built by channel_operator_new_row() and
+ * channel_operator_add()) and then applies it to whole epochs with
+ * channel_operator_apply(), which only touches the nonzero entries.
+ * Rows may use the results of earlier rows as inputs; this keeps operators
+ * like the average reference sparse, where each output channel is the input
+ * minus the mean computed once in an intermediate row.
+ */
+/*}}}  */
+
+/*{{{  #includes*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "transform.h"
+#include "bf.h"
+/*}}}  */
+
+/* The number of points processed at a time; the results of all rows for
+ * this many points should fit in the L2 cache */
+#define POINTBLOCK 64
+
+/*{{{  channel_operator_init(struct channel_operator *op) {*/
+GLOBAL void
+channel_operator_init(struct channel_operator *op) {
+ op->nr_of_inputs=op->nr_of_intermediates=op->nr_of_rows=0;
+ growing_buf_init(&op->row_start);
+ growing_buf_init(&op->entries);
+}
+/*}}}  */
+
+/*{{{  channel_operator_reset(struct channel_operator *op, int nr_of_inputs, int nr_of_intermediates) {*/
+/* Start building a new operator, keeping the memory already allocated */
+GLOBAL void
+channel_operator_reset(struct channel_operator *op, int nr_of_inputs, int nr_of_intermediates) {
+ op->nr_of_inputs=nr_of_inputs;
+ op->nr_of_intermediates=nr_of_intermediates;
+ op->nr_of_rows=0;
+ growing_buf_clear(&op->row_start);
+ growing_buf_clear(&op->entries);
+}
+/*}}}  */
+
+/*{{{  channel_operator_new_row(struct channel_operator *op) {*/
+/* Start the next row; subsequent channel_operator_add() calls go there */
+GLOBAL Bool
+channel_operator_new_row(struct channel_operator *op) {
+ int const start=op->entries.current_length/sizeof(struct channel_operator_entry);
+ if (op->row_start.buffer_start==NULL && !growing_buf_allocate(&op->row_start, 0)) return FALSE;
+ if (!growing_buf_append(&op->row_start, (char const *)&start, sizeof(int))) return FALSE;
+ op->nr_of_rows++;
+ return TRUE;
+}
+/*}}}  */
+
+/*{{{  channel_operator_add(struct channel_operator *op, int column, DATATYPE value) {*/
+GLOBAL Bool
+channel_operator_add(struct channel_operator *op, int column, DATATYPE value) {
+ struct channel_operator_entry entry;
+ if (op->nr_of_rows==0 || column<0 || column>=CHANNEL_OPERATOR_ROW(op, op->nr_of_rows-1)) return FALSE;
+ if (op->entries.buffer_start==NULL && !growing_buf_allocate(&op->entries, 0)) return FALSE;
+ entry.column=column;
+ entry.value=value;
+ return growing_buf_append(&op->entries, (char const *)&entry, sizeof(struct channel_operator_entry));
+}
+/*}}}  */
+
+/*{{{  apply_block(struct channel_operator const *op, array_view const *in, array_view *out, int first_point, int nr_of_points, DATATYPE *rows) {*/
+/* Compute all rows for a block of points into rows[row*POINTBLOCK+point]
+ * and write the outputs. All inputs are read before any output is written,
+ * so in and out may be the same memory. */
+LOCAL void
+apply_block(struct channel_operator const *op, array_view const *in, array_view *out, int first_point, int nr_of_points, DATATYPE *rows) {
+ int const *row_start=(int const *)op->row_start.buffer_start;
+ struct channel_operator_entry const *entries=(struct channel_operator_entry const *)op->entries.buffer_start;
+ int const nr_of_entries=op->entries.current_length/sizeof(struct channel_operator_entry);
+ long const in_skip=in->element_skip, out_skip=out->element_skip;
+ int row, point;
+
+ for (row=0; row<op->nr_of_rows; row++) {
+  DATATYPE * const acc=rows+row*POINTBLOCK;
+  int const end=(row+1<op->nr_of_rows ? row_start[row+1] : nr_of_entries);
+  int entry;
+  for (point=0; point<nr_of_points; point++) acc[point]=0.0;
+  for (entry=row_start[row]; entry<end; entry++) {
+   int const column=entries[entry].column;
+   DATATYPE const value=entries[entry].value;
+   if (column<op->nr_of_inputs) {
+    DATATYPE const * const inp=ARRAY_VIEW_VECTOR(in, column)+first_point*in_skip;
+    if (in_skip==1) {
+     for (point=0; point<nr_of_points; point++) acc[point]+=value*inp[point];
+    } else {
+     for (point=0; point<nr_of_points; point++) acc[point]+=value*inp[point*in_skip];
+    }
+   } else {
+    DATATYPE const * const src=rows+(column-op->nr_of_inputs)*POINTBLOCK;
+    for (point=0; point<nr_of_points; point++) acc[point]+=value*src[point];
+   }
+  }
+ }
+ for (row=op->nr_of_intermediates; row<op->nr_of_rows; row++) {
+  DATATYPE const * const acc=rows+row*POINTBLOCK;
+  DATATYPE * const outp=ARRAY_VIEW_VECTOR(out, row-op->nr_of_intermediates)+first_point*out_skip;
+  for (point=0; point<nr_of_points; point++) outp[point*out_skip]=acc[point];
+ }
+}
+/*}}}  */
+
+/*{{{  channel_operator_apply(struct channel_operator const *op, array_view const *in, array_view *out) {*/
+/* The vectors of in are the input channels, those of out the outputs, and
+ * the elements of both are the points. Returns FALSE if the scratch memory
+ * could not be allocated. */
+GLOBAL Bool
+channel_operator_apply(struct channel_operator const *op, array_view const *in, array_view *out) {
+ int const nr_of_points=in->nr_of_elements;
+ int const nr_of_blocks=(nr_of_points+POINTBLOCK-1)/POINTBLOCK;
+ Bool ok=TRUE;
+
+ if (op->nr_of_rows==0 || nr_of_points==0) return TRUE;
+#ifdef _OPENMP
+#pragma omp parallel if ((double)op->entries.current_length/sizeof(struct channel_operator_entry)*nr_of_points>1e6)
+#endif
+ {
+ DATATYPE * const rows=(DATATYPE *)malloc(op->nr_of_rows*POINTBLOCK*sizeof(DATATYPE));
+ int block;
+ if (rows==NULL) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+  ok=FALSE;
+ }
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+ for (block=0; block<nr_of_blocks; block++) {
+  int const first_point=block*POINTBLOCK;
+  if (rows==NULL) continue;
+  apply_block(op, in, out, first_point, (first_point+POINTBLOCK<nr_of_points ? POINTBLOCK : nr_of_points-first_point), rows);
+ }
+ free(rows);
+ }
+ return ok;
+}
+/*}}}  */
+
+/*{{{  channel_operator_free(struct channel_operator *op) {*/
+GLOBAL void
+channel_operator_free(struct channel_operator *op) {
+ growing_buf_free(&op->row_start);
+ growing_buf_free(&op->entries);
+ op->nr_of_inputs=op->nr_of_intermediates=op->nr_of_rows=0;
+}
+/*}}}  */
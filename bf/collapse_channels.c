@@ -7,6 +7,9 @@
 /*
  * collapse_channels collapses all input channels to one output "channel"
  * 						-- Bernd Feige 24.11.1993
+ * Averaging and summation are done by a sparse channel operator with one
+ * row per range.
+ * 						-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
@@ -50,6 +53,7 @@ struct collapse_channels_storage {
  int **ranges;
  int nr_of_ranges;
  int channelnames_len;
+ struct channel_operator op;
 };
 /*}}}  */
 
@@ -115,11 +119,38 @@ collapse_channels_init(transform_info_ptr tinfo) {
   local_arg->ranges=NULL;
   local_arg->channelnames_len=strlen(collapsed_channelname)+1;
  }
+ channel_operator_init(&local_arg->op);
 
  tinfo->methods->init_done=TRUE;
 }
 /*}}}  */
 
+/*{{{  compile_ranges(transform_info_ptr tinfo, Bool averaging) {*/
+/* Averaging and summation are linear: Put one row per range into local_arg->op */
+LOCAL Bool
+compile_ranges(transform_info_ptr tinfo, Bool averaging) {
+ struct collapse_channels_storage *local_arg=(struct collapse_channels_storage *)tinfo->methods->local_storage;
+ int range;
+ channel_operator_reset(&local_arg->op, tinfo->nr_of_channels, 0);
+ for (range=0; range<local_arg->nr_of_ranges; range++) {
+  int channel, chans_in_range;
+  if (!channel_operator_new_row(&local_arg->op)) return FALSE;
+  if (local_arg->ranges==NULL) {
+   for (channel=0; channel<tinfo->nr_of_channels; channel++) {
+    if (!channel_operator_add(&local_arg->op, channel, averaging ? 1.0/tinfo->nr_of_channels : 1.0)) return FALSE;
+   }
+  } else {
+   int const *in_range=local_arg->ranges[range];
+   for (chans_in_range=0; in_range[chans_in_range]!=0; chans_in_range++);
+   for (; *in_range!=0; in_range++) {
+    if (!channel_operator_add(&local_arg->op, *in_range-1, averaging ? 1.0/chans_in_range : 1.0)) return FALSE;
+   }
+  }
+ }
+ return TRUE;
+}
+/*}}}  */
+
 /*{{{  collapse_channels(transform_info_ptr tinfo) {*/
 METHODDEF DATATYPE *
 collapse_channels(transform_info_ptr tinfo) {
@@ -178,62 +209,85 @@ collapse_channels(transform_info_ptr tinfo) {
  /*}}}  */
 
  /*{{{  Collect the data to the new array*/
- for (itempart=0; itempart<tinfo->itemsize; itempart++) {
-  array_use_item(&inarray, itempart);
-  array_use_item(&newarray, itempart);
+ if (local_arg->collapse_choice==COLLAPSE_BY_AVERAGING || local_arg->collapse_choice==COLLAPSE_BY_SUMMATION) {
+  array_view inview, outview;
+  tinfo_array_view(tinfo, &inview);
+  outview.start=newarray.start;
+  outview.nr_of_vectors=local_arg->nr_of_ranges;
+  outview.vector_skip=tinfo->itemsize;
+  outview.nr_of_elements=inview.nr_of_elements;
+  outview.element_skip=local_arg->nr_of_ranges*tinfo->itemsize;
+  for (itempart=0; itempart<tinfo->itemsize; itempart++) {
+   array_view initem=inview, outitem=outview;
+   /* Leaveright items are always summed */
+   if ((itempart==0 || itempart==itemparts)
+    && !compile_ranges(tinfo, local_arg->collapse_choice==COLLAPSE_BY_AVERAGING && itempart<itemparts)) {
+    ERREXIT(tinfo->emethods, "collapse_channels: Error allocating the channel operator\n");
+   }
+   initem.start+=itempart;
+   outitem.start+=itempart;
+   if (!channel_operator_apply(&local_arg->op, &initem, &outitem)) {
+    ERREXIT(tinfo->emethods, "collapse_channels: Error allocating memory.\n");
+   }
+  }
+ } else {
+  for (itempart=0; itempart<tinfo->itemsize; itempart++) {
+   array_use_item(&inarray, itempart);
+   array_use_item(&newarray, itempart);
 
-  do {
    do {
-    DATATYPE accu=0.0;
-    int chans_in_range=0, *in_range=NULL, channel=0;
-    switch (local_arg->collapse_choice) {
-     case COLLAPSE_BY_HIGHEST:
-      accu= -FLT_MAX;
-      break;
-     case COLLAPSE_BY_LOWEST:
-      accu=  FLT_MAX;
-      break;
-     default:
-      break;
-    }
-
-    if (local_arg->ranges!=NULL) in_range=local_arg->ranges[newarray.current_element];
-    inarray.current_vector=newarray.current_vector;
-    /*{{{  Sum over the channels in this range*/
     do {
-     DATATYPE hold;
-     if (local_arg->ranges==NULL) {
-      /* Cycle through all channels if used without arguments */
-      if (++channel>tinfo->nr_of_channels) channel=0;
-     } else {
-      /* Read the given channels */
-      channel= *in_range++;
-     }
-     if (channel==0) break;
-     inarray.current_element=channel-1;
-     hold=READ_ELEMENT(&inarray);
+     DATATYPE accu=0.0;
+     int chans_in_range=0, *in_range=NULL, channel=0;
      switch (local_arg->collapse_choice) {
-      case COLLAPSE_BY_SUMMATION:
-      case COLLAPSE_BY_AVERAGING:
-       accu+=hold;
-       break;
       case COLLAPSE_BY_HIGHEST:
-       if (hold>accu) accu=hold;
+       accu= -FLT_MAX;
        break;
       case COLLAPSE_BY_LOWEST:
-       if (hold<accu) accu=hold;
+       accu=  FLT_MAX;
        break;
       default:
        break;
      }
-     chans_in_range++;
-    } while (1);
-    /*}}}  */
-    if (local_arg->collapse_choice==COLLAPSE_BY_AVERAGING
-     && itempart<itemparts) accu/=chans_in_range;
-    array_write(&newarray, accu);
-   } while (newarray.message==ARRAY_CONTINUE);
-  } while (newarray.message==ARRAY_ENDOFVECTOR);
+
+     if (local_arg->ranges!=NULL) in_range=local_arg->ranges[newarray.current_element];
+     inarray.current_vector=newarray.current_vector;
+     /*{{{  Sum over the channels in this range*/
+     do {
+      DATATYPE hold;
+      if (local_arg->ranges==NULL) {
+       /* Cycle through all channels if used without arguments */
+       if (++channel>tinfo->nr_of_channels) channel=0;
+      } else {
+       /* Read the given channels */
+       channel= *in_range++;
+      }
+      if (channel==0) break;
+      inarray.current_element=channel-1;
+      hold=READ_ELEMENT(&inarray);
+      switch (local_arg->collapse_choice) {
+       case COLLAPSE_BY_SUMMATION:
+       case COLLAPSE_BY_AVERAGING:
+        accu+=hold;
+        break;
+       case COLLAPSE_BY_HIGHEST:
+        if (hold>accu) accu=hold;
+        break;
+       case COLLAPSE_BY_LOWEST:
+        if (hold<accu) accu=hold;
+        break;
+       default:
+        break;
+      }
+      chans_in_range++;
+     } while (1);
+     /*}}}  */
+     if (local_arg->collapse_choice==COLLAPSE_BY_AVERAGING
+      && itempart<itemparts) accu/=chans_in_range;
+     array_write(&newarray, accu);
+    } while (newarray.message==ARRAY_CONTINUE);
+   } while (newarray.message==ARRAY_ENDOFVECTOR);
+  }
  }
  /*}}}  */
 
@@ -268,6 +322,7 @@ collapse_channels_exit(transform_info_ptr tinfo) {
   free_pointer((void **)&local_arg->channelnames[0]);
   free_pointer((void **)&local_arg->channelnames);
  }
+ channel_operator_free(&local_arg->op);
 
  tinfo->methods->init_done=FALSE;
 }
@@ -280,6 +335,7 @@ select_collapse_channels(transform_info_ptr tinfo) {
  tinfo->methods->transform= &collapse_channels;
  tinfo->methods->transform_exit= &collapse_channels_exit;
  tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="collapse_channels";
  tinfo->methods->method_description=
   "Transform method to create a number of output channels by averaging across\n"
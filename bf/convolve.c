@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2005-2007,2010 Bernd Feige
+ * Copyright (C) 2005-2007,2010,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -8,6 +8,10 @@
  * convolve is a transform method heavily based upon sliding_average,
  * used to build simple detectors of a given wave characteristic.
  * 						-- Bernd Feige 19.05.2005
+ * For long waveforms, the sliding products are computed by FFT
+ * overlap-add, with the waveform spectra kept until a new convolve_file
+ * epoch is read.
+ * 						-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
@@ -22,6 +26,7 @@
 enum ARGS_ENUM {
  ARGS_CLOSE=0, 
  ARGS_EVERY, 
+ ARGS_DIRECT, 
  ARGS_FROMEPOCH, 
  ARGS_CONVOLVEFILE,
  ARGS_SSTEP, 
@@ -30,11 +35,15 @@ enum ARGS_ENUM {
 LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_NOTHING, "Close and reopen the file for each epoch", "c", FALSE, NULL},
  {T_ARGS_TAKES_NOTHING, "Read every epoch in convolve_file in turn", "e", FALSE, NULL},
+ {T_ARGS_TAKES_NOTHING, "Direct: Always compute the products in the time domain", "d", FALSE, NULL},
  {T_ARGS_TAKES_LONG, "fromepoch: Start with epoch number fromepoch (>=1)", "f", 1, NULL},
  {T_ARGS_TAKES_FILENAME, "convolve_file", "", ARGDESC_UNUSED, (const char *const *)"*.asc"},
  {T_ARGS_TAKES_STRING_WORD, "sliding_step", "", ARGDESC_UNUSED, (const char *const *)"2.5ms"}
 };
 
+/* Waveforms with at least this many points are convolved by FFT */
+#define CONVOLVE_FFT_MINSIZE 64
+
 typedef struct sliding_data_struct {
  struct transform_info_struct side_tinfo;
  struct transform_methods_struct side_method;
@@ -55,6 +64,17 @@ typedef struct sliding_data_struct {
  int allocated_outpoints;
  int outpoints; /* Set on return */
  /*}}}  */
+
+ /*{{{  FFT overlap-add, see build_kernels()*/
+ Bool kernels_valid;
+ int kernel_ssize;
+ long fftsize;
+ DATATYPE *templates;	/* ssize points for each sidearray vector */
+ DATATYPE *kernels;	/* fftsize+2 spectrum values for each sidearray vector */
+ DATATYPE *fftbuf;
+ DATATYPE *vals;	/* One sum product for each sliding window position */
+ long allocated_vals;
+ /*}}}  */
 } sliding_data;
 
 /* This is used for xdata only: */
@@ -180,6 +200,104 @@ single_convolve(sliding_data *sdata) {
  sdata->outpoints=spoint;
 }
 
+/*{{{  FFT overlap-add*/
+/* The sum products of the window ending at each point with the waveform
+ * are the linear convolution of the data with the reversed waveform. Its
+ * spectrum is computed once for an FFT of fftsize points, the data is
+ * transformed in blocks of fftsize-ssize+1 points and the results added. */
+LOCAL void
+build_kernels(transform_info_ptr tinfo) {
+ sliding_data *local_arg=(sliding_data *)tinfo->methods->local_storage;
+ array * const sidearray= &local_arg->sidearray;
+ int const ssize=local_arg->ssize;
+ long const fftsize=2*fft_good_size(2*ssize, TRUE);
+ DATATYPE const norm=(DATATYPE)(fftsize>>1);
+ int vector, point;
+ long i;
+
+ free_pointer((void **)&local_arg->templates);
+ free_pointer((void **)&local_arg->kernels);
+ free_pointer((void **)&local_arg->fftbuf);
+ if ((local_arg->templates=(DATATYPE *)malloc(sidearray->nr_of_vectors*ssize*sizeof(DATATYPE)))==NULL ||
+     (local_arg->kernels=(DATATYPE *)calloc(sidearray->nr_of_vectors*(fftsize+2),sizeof(DATATYPE)))==NULL ||
+     (local_arg->fftbuf=(DATATYPE *)malloc((fftsize+2)*sizeof(DATATYPE)))==NULL) {
+  ERREXIT(tinfo->emethods, "convolve: Error allocating kernel memory\n");
+ }
+ for (vector=0; vector<sidearray->nr_of_vectors; vector++) {
+  DATATYPE * const template=local_arg->templates+vector*ssize;
+  DATATYPE * const kernel=local_arg->kernels+vector*(fftsize+2);
+  sidearray->current_vector=vector;
+  for (point=0; point<ssize; point++) {
+   sidearray->current_element=point;
+   template[point]=READ_ELEMENT(sidearray);
+   kernel[ssize-1-point]=template[point];
+  }
+  if (!realfft(kernel, fftsize, 1)) {
+   ERREXIT(tinfo->emethods, "convolve: Error allocating FFT memory\n");
+  }
+  for (i=0; i<fftsize+2; i++) {
+   kernel[i]/=norm;
+  }
+ }
+ local_arg->fftsize=fftsize;
+ local_arg->kernel_ssize=ssize;
+ local_arg->kernels_valid=TRUE;
+}
+
+/* Same output as single_convolve() */
+LOCAL Bool
+single_convolve_fft(sliding_data *sdata) {
+ int point, spoint;
+ int const rightover=sdata->ssize/2;
+ int const leftover=(sdata->ssize==1 ? 0 : sdata->ssize-rightover);
+ int const allocated_outpoints=sdata->allocated_outpoints;
+ int const template_vector=sdata->sidearray.current_vector;
+ int const nr_of_vals=sdata->inpoints+(rightover>0 ? sdata->ssize-rightover : 0);
+ long const fftsize=sdata->fftsize, blocksize=fftsize-sdata->ssize+1;
+ DATATYPE const * const template=sdata->templates+template_vector*sdata->ssize;
+ DATATYPE const * const kernel=sdata->kernels+template_vector*(fftsize+2);
+ DATATYPE * const fftbuf=sdata->fftbuf;
+ DATATYPE * const vals=sdata->vals;
+ DATATYPE sum;
+ long blockstart, i;
+ float s;
+
+ memset(vals, 0, (sdata->inpoints+sdata->ssize)*sizeof(DATATYPE));
+ for (blockstart=0; blockstart<sdata->inpoints; blockstart+=blocksize) {
+  long const n=(blockstart+blocksize<=sdata->inpoints ? blocksize : sdata->inpoints-blockstart);
+  DATATYPE const * const from=sdata->fromstart+blockstart*sdata->fromskip;
+  for (i=0; i<n; i++) fftbuf[i]=from[i*sdata->fromskip];
+  for (; i<fftsize; i++) fftbuf[i]=0.0;
+  if (!realfft(fftbuf, fftsize, 1)) return FALSE;
+  for (i=0; i<fftsize+2; i+=2) {
+   DATATYPE const re=fftbuf[i]*kernel[i]-fftbuf[i+1]*kernel[i+1];
+   fftbuf[i+1]=fftbuf[i]*kernel[i+1]+fftbuf[i+1]*kernel[i];
+   fftbuf[i]=re;
+  }
+  if (!realfft(fftbuf, fftsize, -1)) return FALSE;
+  for (i=0; i<n+sdata->ssize-1; i++) vals[blockstart+i]+=fftbuf[i];
+ }
+ /* While the window is growing, single_convolve() aligns the start of the
+  * waveform with the start of the data */
+ for (point=0, sum=0.0; point<sdata->ssize; point++) {
+  sum+=sdata->fromstart[point*sdata->fromskip]*template[point];
+  vals[point]=sum;
+ }
+
+ for (s=sdata->sstep+leftover, point=spoint=0; point<nr_of_vals; point++) {
+  s--;
+  while (s<=0) {
+   /* Protect against memory overflow. This can happen as a rounding problem. */
+   if (spoint<allocated_outpoints)
+   sdata->tostart[spoint*sdata->toskip]=vals[point]/sdata->ssize;
+   s+=sdata->sstep; spoint++;
+  }
+ }
+ sdata->outpoints=spoint;
+ return TRUE;
+}
+/*}}}  */
+
 /*{{{  convolve_init(transform_info_ptr tinfo) {*/
 METHODDEF void
 convolve_init(transform_info_ptr tinfo) {
@@ -211,6 +329,10 @@ convolve_init(transform_info_ptr tinfo) {
 
  side_tinfo->tsdata=NULL;	/* We still have to fetch the data... */
 
+ local_arg->kernels_valid=FALSE;
+ local_arg->templates=local_arg->kernels=local_arg->fftbuf=local_arg->vals=NULL;
+ local_arg->allocated_vals=0;
+
  local_arg->sstep=gettimefloat(tinfo, args[ARGS_SSTEP].arg.s);
  if (local_arg->sstep<=0) {
   ERREXIT(tinfo->emethods, "convolve_init: Sliding_step<=0!\n");
@@ -230,6 +352,7 @@ convolve(transform_info_ptr tinfo) {
  int const new_outpoints=(int)(tinfo->nr_of_points/local_arg->sstep);
  DATATYPE *slidedata, *slide_xdata=NULL;
  float size_factor;
+ Bool use_fft;
 
  if (side_tinfo->tsdata==NULL || args[ARGS_EVERY].is_set) {
   /*{{{  (Try to) Read the next convolve epoch */
@@ -239,6 +362,7 @@ convolve(transform_info_ptr tinfo) {
    ERREXIT(tinfo->emethods, "convolve: convolve_file needs either 1 or as many channels as the input epoch.\n");
   }
   tinfo_array(side_tinfo, &local_arg->sidearray);
+  local_arg->kernels_valid=FALSE;
   /*}}}  */
  }
 
@@ -255,6 +379,18 @@ convolve(transform_info_ptr tinfo) {
   local_arg->ssize=tinfo->nr_of_points;
  }
 
+ use_fft=(!args[ARGS_DIRECT].is_set && local_arg->ssize>=CONVOLVE_FFT_MINSIZE);
+ if (use_fft) {
+  if (!local_arg->kernels_valid || local_arg->kernel_ssize!=local_arg->ssize) build_kernels(tinfo);
+  if (local_arg->allocated_vals<tinfo->nr_of_points+local_arg->ssize) {
+   free_pointer((void **)&local_arg->vals);
+   local_arg->allocated_vals=tinfo->nr_of_points+local_arg->ssize;
+   if ((local_arg->vals=(DATATYPE *)malloc(local_arg->allocated_vals*sizeof(DATATYPE)))==NULL) {
+    ERREXIT(tinfo->emethods, "convolve: Error allocating vals memory\n");
+   }
+  }
+ }
+
  multiplexed(tinfo);
  /*{{{  Allocate the output memory*/
  if ((slidedata=(DATATYPE *)malloc(tinfo->nr_of_channels*new_outpoints*tinfo->itemsize*sizeof(DATATYPE)))==NULL) {
@@ -278,7 +414,13 @@ convolve(transform_info_ptr tinfo) {
    local_arg->fromstart=tinfo->tsdata+channel*tinfo->itemsize+itempart;
    local_arg->tostart  =    slidedata+channel*tinfo->itemsize+itempart;
    local_arg->sidearray.current_vector=(local_arg->sidearray.nr_of_vectors==1 ? 0 : channel);
-   single_convolve(local_arg);
+   if (use_fft) {
+    if (!single_convolve_fft(local_arg)) {
+     ERREXIT(tinfo->emethods, "convolve: Error allocating FFT memory\n");
+    }
+   } else {
+    single_convolve(local_arg);
+   }
   }
  }
  /*}}}  */
@@ -326,6 +468,10 @@ convolve_exit(transform_info_ptr tinfo) {
  free_tinfo(side_tinfo);
  free_methodmem(side_tinfo);
  growing_buf_free(&local_arg->side_argbuf);
+ free_pointer((void **)&local_arg->templates);
+ free_pointer((void **)&local_arg->kernels);
+ free_pointer((void **)&local_arg->fftbuf);
+ free_pointer((void **)&local_arg->vals);
  tinfo->methods->init_done=FALSE;
 }
 /*}}}  */
@@ -343,7 +489,9 @@ select_convolve(transform_info_ptr tinfo) {
   " arbitrary waveform(s) across the current data instead of an (implied)\n"
   " block or rectangular function.\n"
   " sstep can be specified in points (also fractional) or as time by\n"
-  " appending `s' or `ms'.\n";
+  " appending `s' or `ms'.\n"
+  " Waveforms of 64 points or more are convolved by FFT overlap-add\n"
+  " unless -d is given.\n";
  tinfo->methods->local_storage_size=sizeof(sliding_data);
  tinfo->methods->nr_of_arguments=NR_OF_ARGUMENTS;
  tinfo->methods->argument_descriptors=argument_descriptors;
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2002,2004,2005,2007,2010 Bernd Feige
+ * Copyright (C) 2002,2004,2005,2007,2010,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -17,6 +17,9 @@
  * The channel setup of the incoming epoch always remains untouched (ie, there
  * are always just as many output as input channels). When scalars are returned,
  * they are placed in adjacent time points.
+ * As in project, the work is done by array_view_multiply whenever the data
+ * can be accessed directly.
+ *	-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
@@ -78,7 +81,13 @@ struct correlate_args_struct {
  enum correlate_modes correlate_mode;
  int epochs;
  int *channel_list;
+ /* Prepared by correlate_init: The time courses in vectors. Without
+  * have_view, correlate() uses the array access functions. */
+ Bool have_view;
+ array_view vectors_view;
 };
+/* Number of channels to project at once in the subspace modes */
+#define CORRELATE_CHUNK 1024
 /*}}}  */
 
 /*{{{  correlate_init(transform_info_ptr tinfo)*/
@@ -230,6 +239,9 @@ correlate_init(transform_info_ptr tinfo) {
  }
  /*}}}  */
 
+ array_reset(vectors);
+ correlate_args->have_view=array_get_view(vectors, &correlate_args->vectors_view);
+
  (*side_tinfo->methods->transform_exit)(side_tinfo);
  free_methodmem(side_tinfo);
  growing_buf_free(&buf);
@@ -238,12 +250,53 @@ correlate_init(transform_info_ptr tinfo) {
 }
 /*}}}  */
 
+/*{{{  correlate_views(struct correlate_args_struct *correlate_args, array_view *inview, array_view *scalarview)*/
+/* The scalar, SSP and SSPS modes for one item of all channels at once.
+ * inview has the time courses as vectors, scalarview one vector of scalars
+ * per channel. Returns FALSE if the working memory couldn't be allocated. */
+LOCAL Bool
+correlate_views(struct correlate_args_struct *correlate_args, array_view *inview, array_view *scalarview) {
+ int const nr_of_courses=correlate_args->vectors_view.nr_of_vectors;
+ array_view courses=correlate_args->vectors_view, chunk, scalars;
+ DATATYPE *buffer;
+ int channel;
+
+ if (correlate_args->correlate_mode==CORRELATE_MODE_SCALAR) {
+  array_view_multiply(inview, &correlate_args->vectors_view, scalarview, 1.0, 0.0);
+  return TRUE;
+ }
+
+ /* Compute the scalars for a chunk of channels and then replace
+  * (SSP) or reduce (SSPS) the data by the weighted time courses */
+ if ((buffer=(DATATYPE *)malloc(CORRELATE_CHUNK*nr_of_courses*sizeof(DATATYPE)))==NULL) return FALSE;
+ array_view_transpose(&courses); /* Now the elements are the subspace dimensions */
+ scalars.start=buffer;
+ scalars.element_skip=1;
+ scalars.vector_skip=scalars.nr_of_elements=nr_of_courses;
+ for (channel=0; channel<inview->nr_of_vectors; channel+=CORRELATE_CHUNK) {
+  chunk= *inview;
+  chunk.start=ARRAY_VIEW_VECTOR(inview, channel);
+  chunk.nr_of_vectors=(channel+CORRELATE_CHUNK<inview->nr_of_vectors ? CORRELATE_CHUNK : inview->nr_of_vectors-channel);
+  scalars.nr_of_vectors=chunk.nr_of_vectors;
+  array_view_multiply(&chunk, &correlate_args->vectors_view, &scalars, 1.0, 0.0);
+  if (correlate_args->correlate_mode==CORRELATE_MODE_SSP) {
+   array_view_multiply(&scalars, &courses, &chunk, 1.0, 0.0);
+  } else {
+   array_view_multiply(&scalars, &courses, &chunk, -1.0, 1.0);
+  }
+ }
+ free((void *)buffer);
+ return TRUE;
+}
+/*}}}  */
+
 /*{{{  correlate(transform_info_ptr tinfo)*/
 METHODDEF DATATYPE *
 correlate(transform_info_ptr tinfo) {
  struct correlate_args_struct *correlate_args=(struct correlate_args_struct *)tinfo->methods->local_storage;
  DATATYPE *retvalue=tinfo->tsdata;
  array indata, scalars, *vectors= &correlate_args->vectors;
+ array_view inview, scalarview;
  int itempart, itemparts=tinfo->itemsize-tinfo->leaveright;
 
  if (correlate_args->correlate_mode==CORRELATE_MODE_MULTIPLY) {
@@ -265,7 +318,7 @@ correlate(transform_info_ptr tinfo) {
  scalars.nr_of_elements=vectors->nr_of_vectors;
  switch (correlate_args->correlate_mode) {
   case CORRELATE_MODE_SCALAR:
-   scalars.nr_of_vectors=tinfo->nr_of_points;
+   scalars.nr_of_vectors=tinfo->nr_of_channels;
    scalars.element_skip=itemparts;
    break;
   case CORRELATE_MODE_SSP:
@@ -285,10 +338,16 @@ correlate(transform_info_ptr tinfo) {
  }
 
  if (correlate_args->correlate_mode==CORRELATE_MODE_MULTIPLY) {
-  array_transpose(vectors); /* Now the elements are the subspace dimensions */
   for (itempart=0; itempart<itemparts; itempart++) {
    array_use_item(&indata, itempart);
    array_use_item(&scalars, itempart);
+   if (correlate_args->have_view && array_get_view(&indata, &inview) && array_get_view(&scalars, &scalarview)) {
+    array_view courses=correlate_args->vectors_view;
+    array_view_transpose(&courses); /* Now the elements are the subspace dimensions */
+    array_view_multiply(&scalarview, &courses, &inview, 1.0, 0.0);
+    continue;
+   }
+   array_transpose(vectors); /* Now the elements are the subspace dimensions */
    do {
     /*{{{  Build the signal subspace vector*/
     do {
@@ -296,8 +355,8 @@ correlate(transform_info_ptr tinfo) {
     } while (indata.message==ARRAY_CONTINUE);
     /*}}}  */
    } while (indata.message!=ARRAY_ENDOFSCAN);
+   array_transpose(vectors);
   }
-  array_transpose(vectors);
  } else {
 
  if (array_allocate(&scalars)==NULL) {
@@ -309,6 +368,12 @@ correlate(transform_info_ptr tinfo) {
   if (correlate_args->correlate_mode==CORRELATE_MODE_SCALAR) {
    array_use_item(&scalars, itempart);
   }
+  if (correlate_args->have_view && array_get_view(&indata, &inview) && array_get_view(&scalars, &scalarview)) {
+   if (!correlate_views(correlate_args, &inview, &scalarview)) {
+    ERREXIT(tinfo->emethods, "correlate: Can't allocate scalars buffer\n");
+   }
+   continue;
+  }
 
   do {
    /*{{{  Calculate the correlation scalars*/
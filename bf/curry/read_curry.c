@@ -112,8 +112,8 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
 struct read_curry_storage {
  FILE *infile;	/* Input file */
  int *trigcodes;
- int current_trigger;
  growing_buf triggers;
+ struct trigger_epochs trigger_epochs;
  int nr_of_channels;
  int nr_of_binchannels; /* More channels than read by avg_q can be present in the form of a Trigger channel */
  int trigger_channel; /* More channels than read by avg_q can be present in the form of a Trigger channel */
@@ -190,13 +190,6 @@ read_curry_get_filestrings(transform_info_ptr tinfo) {
 }
 /*}}}  */
 
-/*{{{  Maintaining the triggers list*/
-LOCAL void 
-read_curry_reset_triggerbuffer(transform_info_ptr tinfo) {
- struct read_curry_storage *local_arg=(struct read_curry_storage *)tinfo->methods->local_storage;
- local_arg->current_trigger=0;
-}
-/*}}}  */
 /*{{{  read_curry_build_trigbuffer(transform_info_ptr tinfo) {*/
 /* This function has all the knowledge about events in the various file types */
 LOCAL DATATYPE read_value(FILE *infile, struct read_curry_storage *local_arg);
@@ -249,32 +242,6 @@ read_curry_build_trigbuffer(transform_info_ptr tinfo) {
  }
 }
 /*}}}  */
-/*{{{  read_curry_read_trigger(transform_info_ptr tinfo) {*/
-/* This is the highest-level access function: Read the next trigger and
- * advance the trigger counter. If this function is not called at least
- * once, event information is not even touched. */
-LOCAL int
-read_curry_read_trigger(transform_info_ptr tinfo, long *position, char **descriptionp) {
- struct read_curry_storage *local_arg=(struct read_curry_storage *)tinfo->methods->local_storage;
- int code=0;
- if (local_arg->triggers.buffer_start==NULL) {
-  /* Load the event information */
-  read_curry_build_trigbuffer(tinfo);
- }
- {
- int const nevents=local_arg->triggers.current_length/sizeof(struct trigger);
-
- if (local_arg->current_trigger<nevents) {
-  struct trigger * const intrig=((struct trigger *)local_arg->triggers.buffer_start)+local_arg->current_trigger;
-  *position=intrig->position;
-   code    =intrig->code;
-  if (descriptionp!=NULL) *descriptionp=intrig->description;
- }
- }
- local_arg->current_trigger++;
- return code;
-}
-/*}}}  */
 
 /*{{{  read_curry_init(transform_info_ptr tinfo) {*/
 METHODDEF void
@@ -482,7 +449,10 @@ read_curry_init(transform_info_ptr tinfo) {
   }
  }
 
- read_curry_reset_triggerbuffer(tinfo);
+ trigger_epochs_init(&local_arg->trigger_epochs, &local_arg->triggers, &read_curry_build_trigbuffer);
+ local_arg->trigger_epochs.trigcodes=local_arg->trigcodes;
+ local_arg->trigger_epochs.offset=local_arg->offset;
+ local_arg->trigger_epochs.points_in_file=local_arg->points_in_file;
  local_arg->current_point=0;
 
  tinfo->methods->init_done=TRUE;
@@ -568,7 +538,6 @@ read_curry(transform_info_ptr tinfo) {
  transform_argument *args=tinfo->methods->arguments;
  array myarray;
  FILE *const infile=local_arg->infile;
- Bool not_correct_trigger=FALSE;
  long trigger_point, file_start_point, file_end_point;
  char *description=NULL;
 
@@ -592,55 +561,28 @@ read_curry(transform_info_ptr tinfo) {
    trigger_point=file_start_point+tinfo->beforetrig;
    file_end_point=trigger_point+tinfo->aftertrig-1;
    if (local_arg->points_in_file>0 && file_end_point>=local_arg->points_in_file) return NULL;
-   local_arg->current_trigger++;
+   local_arg->trigger_epochs.current_trigger++;
    local_arg->current_point+=tinfo->nr_of_points;
    tinfo->condition=0;
-  } else 
-  do {
-   tinfo->condition=read_curry_read_trigger(tinfo, &trigger_point, &description);
+  } else {
+   tinfo->condition=trigger_epochs_next(tinfo, &local_arg->trigger_epochs, tinfo->beforetrig, tinfo->aftertrig);
    if (tinfo->condition==0) return NULL;	/* No more triggers in file */
-   file_start_point=trigger_point-tinfo->beforetrig+local_arg->offset;
-   file_end_point=trigger_point+tinfo->aftertrig-1-local_arg->offset;
-   
-   if (local_arg->trigcodes==NULL) {
-    not_correct_trigger=FALSE;
-   } else {
-    int trigno=0;
-    not_correct_trigger=TRUE;
-    while (local_arg->trigcodes[trigno]!=0) {
-     if (local_arg->trigcodes[trigno]==tinfo->condition) {
-      not_correct_trigger=FALSE;
-      break;
-     }
-     trigno++;
-    }
-   }
-  } while (not_correct_trigger || file_start_point<0 || (local_arg->points_in_file>0 && file_end_point>=local_arg->points_in_file));
+   trigger_point=local_arg->trigger_epochs.trigger_point;
+   file_start_point=local_arg->trigger_epochs.start_point;
+   file_end_point=local_arg->trigger_epochs.end_point;
+   description=local_arg->trigger_epochs.description;
+  }
  } while (--local_arg->fromepoch>0);
  if (description==NULL) {
-  TRACEMS3(tinfo->emethods, 1, "read_curry: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
+  TRACEMS3(tinfo->emethods, 1, "read_curry: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
  } else {
-  TRACEMS4(tinfo->emethods, 1, "read_curry: Reading around tag %d at %d, condition=%d, description=%s\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition), MSGPARM(description));
+  TRACEMS4(tinfo->emethods, 1, "read_curry: Reading around tag %d at %d, condition=%d, description=%s\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition), MSGPARM(description));
  }
  /*}}}  */
 
  /*{{{  Handle triggers within the epoch (option -T)*/
  if (args[ARGS_TRIGTRANSFER].is_set) {
-  int code;
-  long trigpoint;
-  long const old_current_trigger=local_arg->current_trigger;
-  char *thisdescription;
-
-  /* First trigger entry holds file_start_point */
-  push_trigger(&tinfo->triggers, file_start_point, -1, NULL);
-  read_curry_reset_triggerbuffer(tinfo);
-  for (; (code=read_curry_read_trigger(tinfo, &trigpoint, &thisdescription))!=0;) {
-   if (trigpoint>=file_start_point && trigpoint<=file_end_point) {
-    push_trigger(&tinfo->triggers, trigpoint-file_start_point, code, thisdescription);
-   }
-  }
-  push_trigger(&tinfo->triggers, 0L, 0, NULL); /* End of list */
-  local_arg->current_trigger=old_current_trigger;
+  trigger_epochs_transfer(tinfo, &local_arg->trigger_epochs, &tinfo->triggers, file_start_point, file_end_point);
  }
  /*}}}  */
 
@@ -737,6 +679,7 @@ read_curry_exit(transform_info_ptr tinfo) {
  if (local_arg->infile!=NULL) fclose(local_arg->infile);
  free_pointer((void **)&local_arg->trigcodes);
 
+ trigger_epochs_free(&local_arg->trigger_epochs);
  if (local_arg->triggers.buffer_start!=NULL) {
   clear_triggers(&local_arg->triggers);
   growing_buf_free(&local_arg->triggers);
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996,1998,1999,2001 Bernd Feige
+ * Copyright (C) 1996,1998,1999,2001,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -64,6 +64,7 @@ select_demean_maps(transform_info_ptr tinfo) {
  tinfo->methods->transform= &demean_maps;
  tinfo->methods->transform_exit= &demean_maps_exit;
  tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="demean_maps";
  tinfo->methods->method_description=
   "Transform method to subtract the map mean from each incoming map\n";
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-1999,2001-2003,2010,2011,2013 Bernd Feige
+ * Copyright (C) 1996-1999,2001-2003,2010,2011,2013,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -288,6 +288,7 @@ select_detrend(transform_info_ptr tinfo) {
  tinfo->methods->transform= &detrend;
  tinfo->methods->transform_exit= &detrend_exit;
  tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="detrend";
  tinfo->methods->method_description=
   "Method to de-trend the given data set; This is done by subtracting a linear\n"
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1995-1998,2001,2003,2011 Bernd Feige
+ * Copyright (C) 1995-1998,2001,2003,2011,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /* expand_channel_list.c was derived from the channel selection part of
@@ -12,7 +12,9 @@
 #include "transform.h"
 #include "bf.h"
 
-enum {
+/* The expansion state is kept per thread because method copies running in
+ * parallel (see do_queues) may expand channel lists concurrently */
+_Thread_local enum {
  EXPAND_NOERR=0,
  EXPAND_NONUM,
  EXPAND_INTERVAL,
@@ -33,7 +35,7 @@ LOCAL char *expand_errors[]={
  * The expanded strings are returned with each call to nextexpand.
  * nextexpand returns NULL if no further elements are available.
  */
-static struct {
+static _Thread_local struct {
  char const *currpos;	/* The interpreter position in the input sring */
  int  current_count;
  int  endcount;
@@ -251,6 +253,39 @@ expand_channel_list(transform_info_ptr tinfo, char const *channelnames) {
  return selected_channels;
 }
 
+/*{{{  expand_channel_selection(transform_info_ptr tinfo, char const *selection, int nr_of_channels, char **channelnames, int *nr_selectedp)*/
+/* expand_channel_selection is used by get_epoch methods to resolve a channel
+ * selection against the channels of the file before any data is read.
+ * It returns a malloc'ed array of nr_of_channels flags marking the selected
+ * channels and sets *nr_selectedp to their number. Channels keep their order
+ * in the file, whatever the order within the selection string. */
+GLOBAL Bool *
+expand_channel_selection(transform_info_ptr tinfo, char const *selection, int nr_of_channels, char **channelnames, int *nr_selectedp) {
+ struct transform_info_struct filetinfo= *tinfo;
+ int *channel_list, *in_list;
+ Bool *selected;
+ int nr_selected=0;
+
+ filetinfo.nr_of_channels=nr_of_channels;
+ filetinfo.channelnames=channelnames;
+ if ((channel_list=expand_channel_list(&filetinfo, selection))==NULL) {
+  ERREXIT1(tinfo->emethods, "expand_channel_selection: No channel selected by >%s<\n", MSGPARM(selection));
+ }
+ if ((selected=(Bool *)calloc(nr_of_channels, sizeof(Bool)))==NULL) {
+  ERREXIT(tinfo->emethods, "expand_channel_selection: Error allocating channel map\n");
+ }
+ for (in_list=channel_list; *in_list!=0; in_list++) {
+  if (!selected[*in_list-1]) {
+   selected[*in_list-1]=TRUE;
+   nr_selected++;
+  }
+ }
+ free(channel_list);
+ *nr_selectedp=nr_selected;
+ return selected;
+}
+/*}}}  */
+
 /* Utility function to query whether a channel is mentioned in the list */
 GLOBAL Bool
 is_in_channellist(int val, int *list) {
@@ -0,0 +1,603 @@
+/*
+ * Copyright (C) 2026 Bernd Feige
+ * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+ *
+ * The mixed-radix butterflies, their recursion (mixed_radix_work) and the
+ * factorization order are adapted from KissFFT by Mark Borgerding, which
+ * carries the following notice:
+ *
+ * Copyright (c) 2003-2010, Mark Borgerding. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the author nor the names of any contributors may be used to
+ *    endorse or promote products derived from this software without specific
+ *    prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*{{{}}}*/
+/*{{{  Description*/
+/*
+ * fft_plan.c FFT of arbitrary length with cached per-size plans.
+ *
+ * A plan holds the twiddle factors and the factorization of its size n.
+ * Sizes whose prime factors are 2, 3, 5 and 7 are transformed by a mixed-radix
+ * decimation-in-time algorithm; all other sizes are mapped onto a cyclic
+ * convolution of such a size (Bluestein's chirp-z algorithm).
+ * Plans are created on first use by fft_plan_get() and kept for the lifetime
+ * of the process; they are read-only afterwards and may be shared by threads.
+ * Each plan owns one scratch buffer for the transform; a thread finding it in
+ * use by another thread allocates a temporary one instead.
+ * The transforms return FALSE if such memory could not be allocated.
+ * fft_execute_many() and fft_execute_real_many() transform several signals
+ * stored interleaved point by point at once, in a work space supplied by the
+ * caller; fft_execute() and fft_execute_real() are the case of one signal.
+ *
+ * Sign convention as in the Numerical Recipes routines this replaces:
+ * isign=1 computes sum_j x_j exp(+2*pi*i*j*k/n), isign=-1 uses exp(-...)
+ * and the result is not normalized.
+ */
+/*}}}  */
+
+/*{{{  #includes*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include "transform.h"
+#include "bf.h"
+/*}}}  */
+
+#define FFT_MAXFACTORS 32
+
+struct fft_plan_struct {
+ int n;
+ int factors[2*FFT_MAXFACTORS];	/* Pairs of (radix, remaining length) */
+ complex *twiddles[2];	/* exp(-/+2*pi*i*k/n), k=0..n-1, indexed by (isign>0) */
+ complex *half_twiddles;	/* exp(2*pi*i*k/(2n)), k=0..n, for real transforms of size 2n */
+
+ /* Bluestein's algorithm, used if n has prime factors >7: */
+ int bluestein_size;
+ struct fft_plan_struct *bluestein_plan;
+ complex *chirp;	/* exp(i*pi*k^2/n), k=0..n-1 */
+ complex *bluestein_kernel[2];	/* Transformed, normalized conjugate chirp per sign */
+
+ /* Work space of scratch_size=fft_work_size() points for one transform: The
+  * input copy for the mixed radix recursion or the convolution buffer for
+  * Bluestein's algorithm followed by the work space of its plan */
+ int scratch_size;
+ complex *scratch;
+ atomic_flag scratch_busy;
+
+ struct fft_plan_struct *next;
+};
+
+LOCAL fft_plan_ptr plan_cache=NULL;
+
+/*{{{  Complex arithmetic helpers*/
+#define C_MUL(res, a, b) do { \
+ DATATYPE const c_mul_re=(a).Re*(b).Re-(a).Im*(b).Im; \
+ (res).Im=(a).Re*(b).Im+(a).Im*(b).Re; \
+ (res).Re=c_mul_re; \
+} while (0)
+/*}}}  */
+
+/*{{{  Butterflies*/
+/* The butterflies and the recursion work on H interleaved transforms:
+ * Point k of transform c is at data[k*H+c]. Each twiddle factor is loaded
+ * once and applied to all H transforms in the innermost loop. */
+LOCAL void
+bfly2(complex *Fout, long const fstride, complex const *tw, int const m, int const H) {
+ complex *Fout2=Fout+m*H;
+ int k, c;
+ for (k=0; k<m; k++) {
+  complex const tw1=tw[k*fstride];
+  for (c=0; c<H; c++) {
+   complex t;
+   C_MUL(t, Fout2[c], tw1);
+   Fout2[c].Re=Fout[c].Re-t.Re; Fout2[c].Im=Fout[c].Im-t.Im;
+   Fout[c].Re+=t.Re; Fout[c].Im+=t.Im;
+  }
+  Fout+=H; Fout2+=H;
+ }
+}
+
+LOCAL void
+bfly3(complex *Fout, long const fstride, complex const *tw, int const m, int const H) {
+ int const m1=m*H, m2=2*m*H;
+ DATATYPE const epi3=tw[fstride*m].Im;
+ int k, c;
+ for (k=0; k<m; k++) {
+  complex const tw1=tw[k*fstride], tw2=tw[2*k*fstride];
+  for (c=0; c<H; c++) {
+   complex * const F=Fout+c;
+   complex s0, s1, s2, s3;
+   C_MUL(s1, F[m1], tw1);
+   C_MUL(s2, F[m2], tw2);
+   s3.Re=s1.Re+s2.Re; s3.Im=s1.Im+s2.Im;
+   s0.Re=(s1.Re-s2.Re)*epi3; s0.Im=(s1.Im-s2.Im)*epi3;
+   F[m1].Re=F[0].Re-0.5*s3.Re; F[m1].Im=F[0].Im-0.5*s3.Im;
+   F[0].Re+=s3.Re; F[0].Im+=s3.Im;
+   F[m2].Re=F[m1].Re+s0.Im; F[m2].Im=F[m1].Im-s0.Re;
+   F[m1].Re-=s0.Im; F[m1].Im+=s0.Re;
+  }
+  Fout+=H;
+ }
+}
+
+LOCAL void
+bfly4(complex *Fout, long const fstride, complex const *tw, int const m, int const isign, int const H) {
+ int const m1=m*H, m2=2*m*H, m3=3*m*H;
+ /* Multiplication by +i (isign>0) or -i */
+ DATATYPE const i_sign=(isign>0 ? 1.0 : -1.0);
+ int k, c;
+ for (k=0; k<m; k++) {
+  complex const tw1=tw[k*fstride], tw2=tw[2*k*fstride], tw3=tw[3*k*fstride];
+  for (c=0; c<H; c++) {
+   complex * const F=Fout+c;
+   complex s0, s1, s2, s3, s4, s5;
+   C_MUL(s0, F[m1], tw1);
+   C_MUL(s1, F[m2], tw2);
+   C_MUL(s2, F[m3], tw3);
+   s5.Re=F[0].Re-s1.Re; s5.Im=F[0].Im-s1.Im;
+   F[0].Re+=s1.Re; F[0].Im+=s1.Im;
+   s3.Re=s0.Re+s2.Re; s3.Im=s0.Im+s2.Im;
+   s4.Re=s0.Re-s2.Re; s4.Im=s0.Im-s2.Im;
+   F[m2].Re=F[0].Re-s3.Re; F[m2].Im=F[0].Im-s3.Im;
+   F[0].Re+=s3.Re; F[0].Im+=s3.Im;
+   /* F[m]=s5+i*s4, F[m3]=s5-i*s4 for isign>0 and vice versa */
+   F[m1].Re=s5.Re-i_sign*s4.Im; F[m1].Im=s5.Im+i_sign*s4.Re;
+   F[m3].Re=s5.Re+i_sign*s4.Im; F[m3].Im=s5.Im-i_sign*s4.Re;
+  }
+  Fout+=H;
+ }
+}
+
+LOCAL void
+bfly5(complex *Fout, long const fstride, complex const *tw, int const m, int const H) {
+ complex const ya=tw[fstride*m], yb=tw[fstride*2*m];
+ int const m1=m*H, m2=2*m*H, m3=3*m*H, m4=4*m*H;
+ int u, c;
+ for (u=0; u<m; u++) {
+  complex const tw1=tw[u*fstride], tw2=tw[2*u*fstride], tw3=tw[3*u*fstride], tw4=tw[4*u*fstride];
+  for (c=0; c<H; c++) {
+   complex * const F=Fout+c;
+   complex s0=F[0], s1, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11, s12;
+   C_MUL(s1, F[m1], tw1);
+   C_MUL(s2, F[m2], tw2);
+   C_MUL(s3, F[m3], tw3);
+   C_MUL(s4, F[m4], tw4);
+   s7.Re=s1.Re+s4.Re; s7.Im=s1.Im+s4.Im;
+   s10.Re=s1.Re-s4.Re; s10.Im=s1.Im-s4.Im;
+   s8.Re=s2.Re+s3.Re; s8.Im=s2.Im+s3.Im;
+   s9.Re=s2.Re-s3.Re; s9.Im=s2.Im-s3.Im;
+   F[0].Re+=s7.Re+s8.Re; F[0].Im+=s7.Im+s8.Im;
+
+   s5.Re=s0.Re+s7.Re*ya.Re+s8.Re*yb.Re;
+   s5.Im=s0.Im+s7.Im*ya.Re+s8.Im*yb.Re;
+   s6.Re= s10.Im*ya.Im+s9.Im*yb.Im;
+   s6.Im= -s10.Re*ya.Im-s9.Re*yb.Im;
+   F[m1].Re=s5.Re-s6.Re; F[m1].Im=s5.Im-s6.Im;
+   F[m4].Re=s5.Re+s6.Re; F[m4].Im=s5.Im+s6.Im;
+
+   s11.Re=s0.Re+s7.Re*yb.Re+s8.Re*ya.Re;
+   s11.Im=s0.Im+s7.Im*yb.Re+s8.Im*ya.Re;
+   s12.Re= -s10.Im*yb.Im+s9.Im*ya.Im;
+   s12.Im= s10.Re*yb.Im-s9.Re*ya.Im;
+   F[m2].Re=s11.Re+s12.Re; F[m2].Im=s11.Im+s12.Im;
+   F[m3].Re=s11.Re-s12.Re; F[m3].Im=s11.Im-s12.Im;
+  }
+  Fout+=H;
+ }
+}
+
+/* Used for radix 7; O(p^2) but p is small */
+#define GENERIC_MAXRADIX 7
+LOCAL void
+bfly_generic(complex *Fout, long const fstride, complex const *tw, int const m, int const p, int const n, int const H) {
+ complex scratch[GENERIC_MAXRADIX];
+ int u, q1, q, c;
+ for (u=0; u<m; u++) {
+  for (c=0; c<H; c++) {
+   int k=u;
+   for (q1=0; q1<p; q1++) {
+    scratch[q1]=Fout[k*H+c];
+    k+=m;
+   }
+   k=u;
+   for (q1=0; q1<p; q1++) {
+    complex * const F=Fout+k*H+c;
+    long twidx=0;
+    *F=scratch[0];
+    for (q=1; q<p; q++) {
+     complex t;
+     twidx+=fstride*k;
+     if (twidx>=n) twidx-=n;
+     C_MUL(t, scratch[q], tw[twidx]);
+     F->Re+=t.Re; F->Im+=t.Im;
+    }
+    k+=m;
+   }
+  }
+ }
+}
+/*}}}  */
+
+/*{{{  mixed_radix_work: Recursive decimation in time*/
+LOCAL void
+mixed_radix_work(fft_plan_ptr plan, complex *Fout, complex const *f, long const fstride, int const *factors, int const isign, int const H) {
+ complex const * const tw=plan->twiddles[isign>0];
+ complex * const Fout_beg=Fout;
+ int const p=factors[0], m=factors[1];
+ complex * const Fout_end=Fout+p*m*H;
+
+ if (m==1) {
+  do {
+   memcpy(Fout, f, H*sizeof(complex));
+   f+=fstride*H;
+  } while ((Fout+=H)!=Fout_end);
+ } else {
+  do {
+   mixed_radix_work(plan, Fout, f, fstride*p, factors+2, isign, H);
+   f+=fstride*H;
+  } while ((Fout+=m*H)!=Fout_end);
+ }
+
+ Fout=Fout_beg;
+ switch (p) {
+  case 2: bfly2(Fout, fstride, tw, m, H); break;
+  case 3: bfly3(Fout, fstride, tw, m, H); break;
+  case 4: bfly4(Fout, fstride, tw, m, isign, H); break;
+  case 5: bfly5(Fout, fstride, tw, m, H); break;
+  default: bfly_generic(Fout, fstride, tw, m, p, plan->n, H); break;
+ }
+}
+/*}}}  */
+
+/*{{{  Plan creation*/
+/* Fill plan->factors; returns FALSE if n has prime factors >GENERIC_MAXRADIX */
+LOCAL Bool
+factorize(fft_plan_ptr plan) {
+ int n=plan->n, p=4, nfactors=0;
+ while (n>1) {
+  while (n%p!=0) {
+   switch (p) {
+    case 4: p=2; break;
+    case 2: p=3; break;
+    default: p+=2; break;
+   }
+   if (p>GENERIC_MAXRADIX) return FALSE;
+  }
+  n/=p;
+  plan->factors[2*nfactors]=p;
+  plan->factors[2*nfactors+1]=n;
+  nfactors++;
+ }
+ return TRUE;
+}
+
+LOCAL fft_plan_ptr plan_lookup(int n);
+
+LOCAL void
+plan_free(fft_plan_ptr plan) {
+ free_pointer((void **)&plan->twiddles[0]);
+ free_pointer((void **)&plan->twiddles[1]);
+ free_pointer((void **)&plan->half_twiddles);
+ free_pointer((void **)&plan->chirp);
+ free_pointer((void **)&plan->bluestein_kernel[0]);
+ free_pointer((void **)&plan->bluestein_kernel[1]);
+ free_pointer((void **)&plan->scratch);
+ free(plan);
+}
+
+LOCAL fft_plan_ptr
+plan_create(int n) {
+ fft_plan_ptr plan=(fft_plan_ptr)calloc(1, sizeof(struct fft_plan_struct));
+ int k;
+
+ if (plan==NULL) return NULL;
+ plan->n=n;
+ atomic_flag_clear(&plan->scratch_busy);
+ if ((plan->twiddles[0]=(complex *)malloc(n*sizeof(complex)))==NULL ||
+     (plan->twiddles[1]=(complex *)malloc(n*sizeof(complex)))==NULL ||
+     (plan->half_twiddles=(complex *)malloc((n+1)*sizeof(complex)))==NULL) {
+  plan_free(plan);
+  return NULL;
+ }
+ for (k=0; k<n; k++) {
+  double const phase=2*M_PI*k/n;
+  plan->twiddles[1][k].Re=plan->twiddles[0][k].Re=cos(phase);
+  plan->twiddles[1][k].Im=sin(phase);
+  plan->twiddles[0][k].Im= -plan->twiddles[1][k].Im;
+ }
+ for (k=0; k<=n; k++) {
+  double const phase=M_PI*k/n;
+  plan->half_twiddles[k].Re=cos(phase);
+  plan->half_twiddles[k].Im=sin(phase);
+ }
+
+ if (!factorize(plan)) {
+  /*{{{  Set up Bluestein's algorithm*/
+  int sign;
+  /* The cyclic convolution must hold 2n-1 points without wrap-around */
+  plan->bluestein_size=fft_good_size(2*n-1, TRUE);
+  if ((plan->bluestein_plan=plan_lookup(plan->bluestein_size))==NULL ||
+      (plan->chirp=(complex *)malloc(n*sizeof(complex)))==NULL ||
+      (plan->bluestein_kernel[0]=(complex *)calloc(plan->bluestein_size, sizeof(complex)))==NULL ||
+      (plan->bluestein_kernel[1]=(complex *)calloc(plan->bluestein_size, sizeof(complex)))==NULL) {
+   plan_free(plan);
+   return NULL;
+  }
+  for (k=0; k<n; k++) {
+   /* k^2 mod 2n keeps the argument small for large k */
+   double const phase=M_PI*(double)(((long long)k*k)%(2*n))/n;
+   plan->chirp[k].Re=cos(phase);
+   plan->chirp[k].Im=sin(phase);
+  }
+  for (sign=0; sign<=1; sign++) {
+   complex * const kernel=plan->bluestein_kernel[sign];
+   int const M=plan->bluestein_size;
+   for (k=0; k<n; k++) {
+    /* conj(chirp) for isign>0, chirp otherwise, normalized by 1/M */
+    kernel[k].Re=plan->chirp[k].Re/M;
+    kernel[k].Im=(sign ? -plan->chirp[k].Im : plan->chirp[k].Im)/M;
+    if (k>0) kernel[M-k]=kernel[k];
+   }
+   if (!fft_execute(plan->bluestein_plan, kernel, 1)) {
+    plan_free(plan);
+    return NULL;
+   }
+  }
+  /*}}}  */
+ }
+ plan->scratch_size=fft_work_size(plan);
+ if ((plan->scratch=(complex *)malloc(plan->scratch_size*sizeof(complex)))==NULL) {
+  plan_free(plan);
+  return NULL;
+ }
+ return plan;
+}
+
+/* Find or create the plan for size n. Must be called with the cache locked. */
+LOCAL fft_plan_ptr
+plan_lookup(int n) {
+ fft_plan_ptr plan;
+ for (plan=plan_cache; plan!=NULL; plan=plan->next) {
+  if (plan->n==n) return plan;
+ }
+ if ((plan=plan_create(n))!=NULL) {
+  plan->next=plan_cache;
+  plan_cache=plan;
+ }
+ return plan;
+}
+/*}}}  */
+
+/*{{{  fft_plan_get(int n) {*/
+/* Returns the (cached) plan for complex transforms of n points, or NULL if
+ * memory for the plan could not be allocated. */
+GLOBAL fft_plan_ptr
+fft_plan_get(int n) {
+ fft_plan_ptr plan;
+ if (n<1) return NULL;
+#ifdef _OPENMP
+#pragma omp critical (fft_plan_cache)
+#endif
+ plan=plan_lookup(n);
+ return plan;
+}
+/*}}}  */
+
+/*{{{  fft_good_size(int n, Bool round_up) {*/
+/* Returns the smallest (round_up) or largest (!round_up) size >=n (<=n)
+ * for which the mixed radix transform can be used, ie which has no prime
+ * factors other than 2, 3, 5 and 7. */
+GLOBAL int
+fft_good_size(int n, Bool round_up) {
+ if (n<=1) return 1;
+ for (;; n+=(round_up ? 1 : -1)) {
+  int m=n;
+  while (m%2==0) m/=2;
+  while (m%3==0) m/=3;
+  while (m%5==0) m/=5;
+  while (m%7==0) m/=7;
+  if (m==1) return n;
+ }
+}
+/*}}}  */
+
+/*{{{  Scratch buffer*/
+/* Returns the scratch buffer of the plan if it is free and a newly allocated
+ * one (or NULL) otherwise */
+LOCAL complex *
+scratch_get(fft_plan_ptr plan) {
+ if (!atomic_flag_test_and_set(&plan->scratch_busy)) return plan->scratch;
+ return (complex *)malloc(plan->scratch_size*sizeof(complex));
+}
+LOCAL void
+scratch_release(fft_plan_ptr plan, complex *scratch) {
+ if (scratch==plan->scratch) {
+  atomic_flag_clear(&plan->scratch_busy);
+ } else {
+  free(scratch);
+ }
+}
+/*}}}  */
+
+/*{{{  fft_work_size(fft_plan_ptr plan) {*/
+/* Number of complex points of work space per transform needed by
+ * fft_execute_many() and fft_execute_real_many() */
+GLOBAL long
+fft_work_size(fft_plan_ptr plan) {
+ return (plan->bluestein_size>0 ? 2L*plan->bluestein_size : (long)plan->n);
+}
+/*}}}  */
+
+/*{{{  fft_execute_many(fft_plan_ptr plan, complex *data, int howmany, int isign, complex *work) {*/
+/* In-place complex transforms of plan->n points of howmany interleaved
+ * signals: Point k of signal c is data[k*howmany+c]. work must hold
+ * fft_work_size(plan)*howmany points. */
+GLOBAL Bool
+fft_execute_many(fft_plan_ptr plan, complex *data, int howmany, int isign, complex *work) {
+ int const n=plan->n, H=howmany;
+ if (n==1) return TRUE;
+ if (plan->bluestein_size==0) {
+  memcpy(work, data, (long)n*H*sizeof(complex));
+  mixed_radix_work(plan, data, work, 1, plan->factors, isign, H);
+ } else {
+  /*{{{  Bluestein: X_k=c_k*sum_j (x_j*c_j)*conj(c_{k-j}) with c_k=exp(isign*i*pi*k^2/n)*/
+  int const M=plan->bluestein_size, sign=(isign>0);
+  complex const * const kernel=plan->bluestein_kernel[sign];
+  complex * const buf=work;
+  int k, c;
+  for (k=0; k<n; k++) {
+   complex cp=plan->chirp[k];
+   if (!sign) cp.Im= -cp.Im;
+   for (c=0; c<H; c++) {
+    C_MUL(buf[k*H+c], data[k*H+c], cp);
+   }
+  }
+  memset(buf+(long)n*H, 0, (long)(M-n)*H*sizeof(complex));
+  if (!fft_execute_many(plan->bluestein_plan, buf, H, 1, work+(long)M*H)) return FALSE;
+  for (k=0; k<M; k++) {
+   complex const kk=kernel[k];
+   for (c=0; c<H; c++) {
+    C_MUL(buf[k*H+c], buf[k*H+c], kk);
+   }
+  }
+  if (!fft_execute_many(plan->bluestein_plan, buf, H, -1, work+(long)M*H)) return FALSE;
+  for (k=0; k<n; k++) {
+   complex cp=plan->chirp[k];
+   if (!sign) cp.Im= -cp.Im;
+   for (c=0; c<H; c++) {
+    C_MUL(data[k*H+c], buf[k*H+c], cp);
+   }
+  }
+  /*}}}  */
+ }
+ return TRUE;
+}
+/*}}}  */
+
+/*{{{  fft_execute(fft_plan_ptr plan, complex *data, int isign) {*/
+/* In-place complex transform of plan->n points */
+GLOBAL Bool
+fft_execute(fft_plan_ptr plan, complex *data, int isign) {
+ complex *scratch;
+ Bool ok;
+ if (plan->n==1) return TRUE;
+ if ((scratch=scratch_get(plan))==NULL) return FALSE;
+ ok=fft_execute_many(plan, data, 1, isign, scratch);
+ scratch_release(plan, scratch);
+ return ok;
+}
+/*}}}  */
+
+/*{{{  fft_execute_real_many(fft_plan_ptr plan, DATATYPE *data, int howmany, int isign, complex *work) {*/
+/* Real transforms of nn=2*plan->n points of howmany interleaved signals.
+ * Viewing data as complex, point k of signal c is ((complex *)data)[k*howmany+c]
+ * and holds the real samples 2k and 2k+1 or, in the transformed state, the
+ * coefficient of frequency k. For each signal, this is the format of realfft():
+ * isign=1: The samples 0..nn-1 are replaced by the nn/2+1 complex coefficients
+ *  for frequencies 0..nn/2, so that data must hold (nn+2)*howmany values. The
+ *  imaginary parts of the first and last coefficient are zero.
+ * isign=-1: the inverse; imaginary parts of the first and last coefficient
+ *  are ignored and the result is nn/2 times the original data.
+ * The real data is transformed as plan->n complex points (even samples as real,
+ * odd samples as imaginary parts), the spectra of both halves being separated
+ * afterwards using plan->half_twiddles.
+ * work must hold fft_work_size(plan)*howmany points. */
+GLOBAL Bool
+fft_execute_real_many(fft_plan_ptr plan, DATATYPE *data, int howmany, int isign, complex *work) {
+ int const h=plan->n, H=howmany;
+ complex * const z=(complex *)data;
+ complex const * const w=plan->half_twiddles;
+ int k, c;
+
+ if (isign>0) {
+  if (!fft_execute_many(plan, z, H, 1, work)) return FALSE;
+  for (k=1; 2*k<=h; k++) {
+   int const hk=h-k;
+   for (c=0; c<H; c++) {
+    /* E=(Z_k+conj(Z_{h-k}))/2, O=(Z_k-conj(Z_{h-k}))/(2i); X_k=E+w^k*O */
+    complex const zk=z[k*H+c], zhk=z[hk*H+c];
+    complex e1, o1, e2, o2, t;
+    e1.Re=0.5*(zk.Re+zhk.Re); e1.Im=0.5*(zk.Im-zhk.Im);
+    o1.Re=0.5*(zk.Im+zhk.Im); o1.Im= -0.5*(zk.Re-zhk.Re);
+    C_MUL(t, o1, w[k]);
+    z[k*H+c].Re=e1.Re+t.Re; z[k*H+c].Im=e1.Im+t.Im;
+    if (hk!=k) {
+     e2.Re=0.5*(zhk.Re+zk.Re); e2.Im=0.5*(zhk.Im-zk.Im);
+     o2.Re=0.5*(zhk.Im+zk.Im); o2.Im= -0.5*(zhk.Re-zk.Re);
+     C_MUL(t, o2, w[hk]);
+     z[hk*H+c].Re=e2.Re+t.Re; z[hk*H+c].Im=e2.Im+t.Im;
+    }
+   }
+  }
+  for (c=0; c<H; c++) {
+   /* Frequencies 0 and nn/2 are both real and packed into Z_0 */
+   z[h*H+c].Re=z[c].Re-z[c].Im; z[h*H+c].Im=0.0;
+   z[c].Re=z[c].Re+z[c].Im; z[c].Im=0.0;
+  }
+ } else {
+  for (c=0; c<H; c++) {
+   DATATYPE const x0=z[c].Re, xh=z[h*H+c].Re;
+   z[c].Re=0.5*(x0+xh);
+   z[c].Im=0.5*(x0-xh);
+  }
+  for (k=1; 2*k<=h; k++) {
+   int const hk=h-k;
+   for (c=0; c<H; c++) {
+    /* E_k=(X_k+conj(X_{h-k}))/2, O_k=(X_k-conj(X_{h-k}))*conj(w^k)/2; Z_k=E_k+i*O_k */
+    complex const xk=z[k*H+c], xhk=z[hk*H+c];
+    complex d, o, cw;
+    DATATYPE const ere=0.5*(xk.Re+xhk.Re), eim=0.5*(xk.Im-xhk.Im);
+    d.Re=0.5*(xk.Re-xhk.Re); d.Im=0.5*(xk.Im+xhk.Im);
+    cw.Re=w[k].Re; cw.Im= -w[k].Im;
+    C_MUL(o, d, cw);
+    z[k*H+c].Re=ere-o.Im; z[k*H+c].Im=eim+o.Re;
+    if (hk!=k) {
+     DATATYPE const ere2=0.5*(xhk.Re+xk.Re), eim2=0.5*(xhk.Im-xk.Im);
+     d.Re=0.5*(xhk.Re-xk.Re); d.Im=0.5*(xhk.Im+xk.Im);
+     cw.Re=w[hk].Re; cw.Im= -w[hk].Im;
+     C_MUL(o, d, cw);
+     z[hk*H+c].Re=ere2-o.Im; z[hk*H+c].Im=eim2+o.Re;
+    }
+   }
+  }
+  if (!fft_execute_many(plan, z, H, -1, work)) return FALSE;
+ }
+ return TRUE;
+}
+/*}}}  */
+
+/*{{{  fft_execute_real(fft_plan_ptr plan, DATATYPE *data, int isign) {*/
+/* Real transform of nn=2*plan->n points in the format of realfft(), see
+ * fft_execute_real_many() */
+GLOBAL Bool
+fft_execute_real(fft_plan_ptr plan, DATATYPE *data, int isign) {
+ complex *scratch;
+ Bool ok;
+ if ((scratch=scratch_get(plan))==NULL) return FALSE;
+ ok=fft_execute_real_many(plan, data, 1, isign, scratch);
+ scratch_release(plan, scratch);
+ return ok;
+}
+/*}}}  */
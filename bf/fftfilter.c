@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-2001,2003,2004,2008,2011-2013,2017,2018,2022 Bernd Feige
+ * Copyright (C) 1996-2001,2003,2004,2008,2011-2013,2017,2018,2022,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -38,41 +38,38 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_SENTENCE, "blocks", "", ARGDESC_UNUSED, (const char *const *)"0.6 0.7 1 1"}
 };
 
-/*{{{  struct blockdef {*/
-/* Structure defining a frequency range suppression block. */
-struct blockdef {
- float start;
- float nullstart;
- float nullend;
- float end;
- DATATYPE factor; /* Note: This is the full factor x, given by the -x option */
- int last_block;
-};
-/*}}}  */
-
 struct fftfilter_storage {
- struct blockdef *blockdefs;
+ struct fftfilter_block *blockdefs;
  int *channel_list;
  Bool have_channel_list;
  int fromitem;
  int toitem;
  DATATYPE sfreq; /* To see whether sfreq changed */
+
+ /* The transfer function is evaluated once per FFT size, see build_transfer() */
+ long transfer_fftsize;
+ DATATYPE *transfer;
+ fft_plan_ptr plan;
+ DATATYPE *workbuf;	/* fftsize+2 values of FFTFILTER_BATCH interleaved channels */
+ complex *fftwork;	/* Work space of fft_execute_real_many() */
 };
 
-LOCAL void
-init_fftfilter_storage(transform_info_ptr tinfo) {
- struct fftfilter_storage *local_arg=(struct fftfilter_storage *)tinfo->methods->local_storage;
- transform_argument *args=tinfo->methods->arguments;
+/* Number of channels transformed together by fft_execute_real_many() */
+#define FFTFILTER_BATCH 16
+
+/*{{{  fftfilter_parse_blocks(transform_info_ptr tinfo, char const *blocks) {*/
+/* Parse the `blocks' transfer function definition shared by the filter
+ * methods into a newly allocated array of blockdefs; the last one has
+ * last_block set. Frequencies are converted using tinfo->sfreq. */
+GLOBAL struct fftfilter_block *
+fftfilter_parse_blocks(transform_info_ptr tinfo, char const *blocks) {
+ struct fftfilter_block *blockdefs, *inblocks;
  growing_buf buf, tokenbuf;
- struct blockdef *inblocks;
  int nr_of_blocks=0, block;
  Bool havearg;
 
- local_arg->sfreq=tinfo->sfreq;
- free_pointer((void **)&local_arg->blockdefs);
-
  growing_buf_init(&buf);
- growing_buf_takethis(&buf, args[ARGS_BLOCKS].arg.s);
+ growing_buf_takethis(&buf, blocks);
  growing_buf_init(&tokenbuf);
  growing_buf_allocate(&tokenbuf,0);
 
@@ -84,18 +81,18 @@ init_fftfilter_storage(transform_info_ptr tinfo) {
 
  havearg=growing_buf_get_firsttoken(&buf,&tokenbuf);
  if (!havearg || nr_of_blocks%4!=0) {
-  ERREXIT(tinfo->emethods, "fftfilter_init: Number of args must be divisible by 4.\n");
+  ERREXIT(tinfo->emethods, "fftfilter_parse_blocks: Number of args must be divisible by 4.\n");
  }
  nr_of_blocks/=4;
- if ((local_arg->blockdefs=(struct blockdef *)malloc(nr_of_blocks*sizeof(struct blockdef)))==NULL) {
-  ERREXIT(tinfo->emethods, "fftfilter_init: Error allocating blockdefs memory\n");
+ if ((blockdefs=(struct fftfilter_block *)malloc(nr_of_blocks*sizeof(struct fftfilter_block)))==NULL) {
+  ERREXIT(tinfo->emethods, "fftfilter_parse_blocks: Error allocating blockdefs memory\n");
  }
- for (inblocks=local_arg->blockdefs, block=0; havearg; block++, inblocks++) {
+ for (inblocks=blockdefs, block=0; havearg; block++, inblocks++) {
   if (*tokenbuf.buffer_start=='-') {
    char *endptr;
    inblocks->factor=strtod(tokenbuf.buffer_start+1, &endptr);
    if (*endptr!='\0' || inblocks->factor<0) {
-    ERREXIT1(tinfo->emethods, "fftfilter_init: Invalid factor value: %s\n", MSGPARM(tokenbuf.buffer_start+1));
+    ERREXIT1(tinfo->emethods, "fftfilter_parse_blocks: Invalid factor value: %s\n", MSGPARM(tokenbuf.buffer_start+1));
    }
    growing_buf_get_nexttoken(&buf,&tokenbuf);
   } else {
@@ -106,16 +103,31 @@ init_fftfilter_storage(transform_info_ptr tinfo) {
   inblocks->nullend=getfreqfloat(tinfo, tokenbuf.buffer_start); growing_buf_get_nexttoken(&buf,&tokenbuf);
   inblocks->end=getfreqfloat(tinfo, tokenbuf.buffer_start); havearg=growing_buf_get_nexttoken(&buf,&tokenbuf);
   if (inblocks->start>inblocks->nullstart || inblocks->nullstart>inblocks->nullend || inblocks->nullend>inblocks->end) {
-   ERREXIT1(tinfo->emethods, "fftfilter_init: Block %d is not ascending.\n", MSGPARM(block+1));
+   ERREXIT1(tinfo->emethods, "fftfilter_parse_blocks: Block %d is not ascending.\n", MSGPARM(block+1));
   }
   if (inblocks->start<0.0 || inblocks->end>1.0) {
-    ERREXIT1(tinfo->emethods, "fftfilter_init: Block %d does not consist of numbers between 0 and 1.\n", MSGPARM(block+1));
+    ERREXIT1(tinfo->emethods, "fftfilter_parse_blocks: Block %d does not consist of numbers between 0 and 1.\n", MSGPARM(block+1));
   }
   inblocks->last_block=(block==nr_of_blocks-1);
  }
  growing_buf_free(&tokenbuf);
  growing_buf_free(&buf);
 
+ return blockdefs;
+}
+/*}}}  */
+
+LOCAL void
+init_fftfilter_storage(transform_info_ptr tinfo) {
+ struct fftfilter_storage *local_arg=(struct fftfilter_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+
+ local_arg->sfreq=tinfo->sfreq;
+ local_arg->transfer_fftsize=0;	/* Blocks may have changed */
+ free_pointer((void **)&local_arg->blockdefs);
+
+ local_arg->blockdefs=fftfilter_parse_blocks(tinfo, args[ARGS_BLOCKS].arg.s);
+
  if (args[ARGS_BYNAME].is_set) {
   /* Note that this is NULL if no channel matched, which is why we need have_channel_list as well... */
   local_arg->channel_list=expand_channel_list(tinfo, args[ARGS_BYNAME].arg.s);
@@ -140,46 +152,93 @@ METHODDEF void
 fftfilter_init(transform_info_ptr tinfo) {
  struct fftfilter_storage *local_arg=(struct fftfilter_storage *)tinfo->methods->local_storage;
  local_arg->blockdefs=NULL;
+ local_arg->transfer=local_arg->workbuf=NULL;
+ local_arg->fftwork=NULL;
  init_fftfilter_storage(tinfo);
 
  tinfo->methods->init_done=TRUE;
 }
 /*}}}  */
 
+/*{{{  Transfer function*/
+/* Factor by which block inblocks multiplies the coefficient at relative
+ * frequency ratio (0..1 for 0..sfreq/2) */
+GLOBAL float
+fftfilter_block_factor(struct fftfilter_block const *inblocks, float const ratio) {
+ float factor;
+ if (ratio<inblocks->start || ratio>inblocks->end) return 1.0;
+ /* factor is 1.0 in the middle of the block and 0.0 at the ends */
+ factor=(ratio<inblocks->nullstart ? (ratio-inblocks->start)/(inblocks->nullstart-inblocks->start) :
+       ((ratio>inblocks->nullend) ? 1.0-(ratio-inblocks->nullend)/(inblocks->end-inblocks->nullend) :
+         1.0));
+ /* We interpolate between 1.0 and inblocks->factor, which may also be >1! */
+ return 1.0+(inblocks->factor-1.0)*factor;
+}
+
+/* Factor of the transfer function of all blocks at relative frequency ratio */
+GLOBAL DATATYPE
+fftfilter_transfer_factor(struct fftfilter_block const *blockdefs, float const ratio) {
+ struct fftfilter_block const *inblocks;
+ DATATYPE factor=1.0;
+ for (inblocks=blockdefs; inblocks!=NULL; inblocks++) {
+  factor*=fftfilter_block_factor(inblocks, ratio);
+  if (inblocks->last_block) break;
+ }
+ return factor;
+}
+
+/* Evaluate the transfer function of all blocks for an FFT of fftsize points
+ * once, in the realfft() layout (Re and Im of each frequency). The
+ * normalization of the forward/backward transform pair is included.
+ * The FFT plan and the work buffers for this size are set up as well. */
+LOCAL void
+build_transfer(transform_info_ptr tinfo, long const fftsize) {
+ struct fftfilter_storage *local_arg=(struct fftfilter_storage *)tinfo->methods->local_storage;
+ DATATYPE const norm=(DATATYPE)(fftsize>>1);
+ long i;
+
+ free_pointer((void **)&local_arg->transfer);
+ free_pointer((void **)&local_arg->workbuf);
+ free_pointer((void **)&local_arg->fftwork);
+ if ((local_arg->plan=fft_plan_get(fftsize>>1))==NULL ||
+     (local_arg->transfer=(DATATYPE *)malloc((fftsize+2)*sizeof(DATATYPE)))==NULL ||
+     (local_arg->workbuf=(DATATYPE *)malloc(FFTFILTER_BATCH*(fftsize+2)*sizeof(DATATYPE)))==NULL ||
+     (local_arg->fftwork=(complex *)malloc(FFTFILTER_BATCH*fft_work_size(local_arg->plan)*sizeof(complex)))==NULL) {
+  ERREXIT(tinfo->emethods, "fftfilter: Error allocating transfer function\n");
+ }
+ for (i=0; i<=fftsize; i+=2) {
+  float const ratio=((float)i)/fftsize;
+  DATATYPE const factor=fftfilter_transfer_factor(local_arg->blockdefs, ratio);
+  local_arg->transfer[i]=local_arg->transfer[i+1]=factor/norm;
+ }
+ local_arg->transfer_fftsize=fftsize;
+}
+/*}}}  */
+
 /*{{{  fftfilter(transform_info_ptr tinfo) {*/
 METHODDEF DATATYPE *
 fftfilter(transform_info_ptr tinfo) {
  struct fftfilter_storage *local_arg=(struct fftfilter_storage *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
- int itempart,i;
- transform_info_ptr const tinfoptr=tinfo;
- DATATYPE norm, firstval, lastval;
- struct blockdef *inblocks;
- array myarray, fftarray;
- long datasize=tinfo->nr_of_points, fftsize;
- growing_buf tracebuf;
- if (args[ARGS_VERBOSE].is_set) {
-  growing_buf_init(&tracebuf);
-  growing_buf_allocate(&tracebuf,0);
- }
+ int itempart, channel, b;
+ struct fftfilter_block *inblocks;
+ array_view view;
+ long datasize=tinfo->nr_of_points, fftsize, bufsize, point, i;
 
  /* Re-init if sfreq changed. This is important both for data entered in Hz and
   * in relative-sfreq units. */
  if (tinfo->sfreq!=local_arg->sfreq) init_fftfilter_storage(tinfo);
 
- fftsize=datasize-1;	/* This way, the result will be datasize if datasize is a power of 2 */
- for (i=0; fftsize>>=1; i++);
- fftsize=1<<(i+1);
- fftarray.nr_of_elements=fftsize+2;	/* 2 more for the additional coefficient */
- fftarray.element_skip=fftarray.nr_of_vectors=1;
- if (array_allocate(&fftarray)==NULL) {
-  ERREXIT(tinfo->emethods, "fftfilter: Error allocating temp storage\n");
- }
- fftarray.nr_of_elements=fftsize;	/* This size is used for time domain data */
- norm=(DATATYPE)(fftsize>>1);
+ /* Pad to the next even size that the FFT handles efficiently; this is
+  * datasize itself if it has no prime factors other than 2, 3, 5 and 7 */
+ fftsize=2*fft_good_size((datasize+1)/2, TRUE);
+ bufsize=fftsize+2;	/* 2 more for the additional coefficient */
+ if (fftsize!=local_arg->transfer_fftsize) build_transfer(tinfo, fftsize);
 
  if (args[ARGS_VERBOSE].is_set) {
-  growing_buf_clear(&tracebuf);
+  growing_buf tracebuf;
+  growing_buf_init(&tracebuf);
+  growing_buf_allocate(&tracebuf,0);
   growing_buf_appendf(&tracebuf, "fftfilter: FFT size %ld points, Frequency resolution %gHz\n", fftsize, tinfo->sfreq/fftsize);
   TRACEMS(tinfo->emethods, -1, tracebuf.buffer_start);
   for (inblocks=local_arg->blockdefs; inblocks!=NULL; inblocks++) {
@@ -188,75 +247,81 @@ fftfilter(transform_info_ptr tinfo) {
    TRACEMS(tinfo->emethods, -1, tracebuf.buffer_start);
    if (inblocks->last_block) break;
   }
+  TRACEMS(tinfo->emethods, -1, "fftfilter: Factors");
+  for (inblocks=local_arg->blockdefs; inblocks!=NULL; inblocks++) {
+   for (i=0; i<=fftsize; i+=2) {
+    float const ratio=((float)i)/fftsize;
+    if (ratio<inblocks->start || ratio>inblocks->end) continue;
+    growing_buf_clear(&tracebuf);
+    growing_buf_appendf(&tracebuf, "\t%ld:%g", i/2, fftfilter_block_factor(inblocks, ratio));
+    TRACEMS(tinfo->emethods, -1, tracebuf.buffer_start);
+   }
+   if (inblocks->last_block) break;
+  }
+  TRACEMS(tinfo->emethods, -1, "\n");
+  growing_buf_free(&tracebuf);
  }
  if (args[ARGS_QUIT].is_set) {
   /* Don't actually perform the filter, reject the epoch */
   return NULL;
  }
- 
-  tinfo_array(tinfoptr, &myarray);
-  for (itempart=local_arg->fromitem; itempart<=local_arg->toitem; itempart++) {
-   /* VERBOSE: Show factors only once */
-   Bool show_factors=args[ARGS_VERBOSE].is_set;
-   array_use_item(&myarray, itempart);
-   do {
-    if (local_arg->have_channel_list && !is_in_channellist(myarray.current_vector+1, local_arg->channel_list)) {
-     array_nextvector(&myarray);
-     continue;
+
+ tinfo_array_view(tinfo, &view);
+ for (itempart=local_arg->fromitem; itempart<=local_arg->toitem; itempart++) {
+  channel=0;
+  while (TRUE) {
+   /* Channels are filtered in batches of up to FFTFILTER_BATCH, stored
+    * interleaved: Sample pair (2k,2k+1) of batch member b is complex point
+    * k*nr_in_batch+b, see fft_execute_real_many(). All transforms of a batch
+    * run in one call, and gathering and scattering the batch point by point
+    * reads multiplexed data row-wise. */
+   int batch[FFTFILTER_BATCH], nr_in_batch=0;
+   DATATYPE * const fftdata=local_arg->workbuf;
+   DATATYPE const * const transfer=local_arg->transfer;
+   for (; channel<view.nr_of_vectors && nr_in_batch<FFTFILTER_BATCH; channel++) {
+    if (local_arg->have_channel_list && !is_in_channellist(channel+1, local_arg->channel_list)) continue;
+    batch[nr_in_batch++]=channel;
+   }
+   if (nr_in_batch==0) break;
+
+#define BATCH_INDEX(point, b) (2*(((point)>>1)*nr_in_batch+(b))+((point)&1))
+   for (point=0; point<datasize; point++) {
+    DATATYPE const * const row=view.start+itempart+point*view.element_skip;
+    for (b=0; b<nr_in_batch; b++) {
+     fftdata[BATCH_INDEX(point, b)]=row[batch[b]*view.vector_skip];
     }
-    array_reset(&fftarray);
-    firstval=READ_ELEMENT(&myarray);
-    do {
-     array_write(&fftarray, lastval=array_scan(&myarray));
-    } while (myarray.message==ARRAY_CONTINUE);
-    array_previousvector(&myarray);
-    i=0;
-    while (fftarray.message==ARRAY_CONTINUE) {
-     i++;
+   }
+   for (b=0; b<nr_in_batch; b++) {
+    DATATYPE const firstval=fftdata[BATCH_INDEX(0, b)], lastval=fftdata[BATCH_INDEX(datasize-1, b)];
+    for (point=datasize; point<fftsize; point++) {
      /* Pad with linear interpolation between lastval and firstval */
-     array_write(&fftarray, lastval+(firstval-lastval)*i/(fftsize-datasize+1));
+     fftdata[BATCH_INDEX(point, b)]=lastval+(firstval-lastval)*(point-datasize+1)/(fftsize-datasize+1);
     }
-    realfft(fftarray.start, fftsize, 1);
-
-    if (show_factors) {
-     TRACEMS(tinfo->emethods, -1, "fftfilter: Factors");
-    }
-    for (inblocks=local_arg->blockdefs; inblocks!=NULL; inblocks++) {
-     for (i=0; i<=fftsize; i+=2) {
-      float ratio=((float)i)/fftsize, factor;
-      if (ratio<inblocks->start || ratio>inblocks->end) continue;
-      /* factor is 1.0 in the middle of the block and 0.0 at the ends */
-      factor=(ratio<inblocks->nullstart ? (ratio-inblocks->start)/(inblocks->nullstart-inblocks->start) :
-            ((ratio>inblocks->nullend) ? 1.0-(ratio-inblocks->nullend)/(inblocks->end-inblocks->nullend) :
-              1.0));
-      /* We interpolate between 1.0 and inblocks->factor, which may also be >1! */
-      factor=1.0+(inblocks->factor-1.0)*factor;
-      fftarray.start[i  ]*=factor;
-      fftarray.start[i+1]*=factor;
-      if (show_factors) {
-       growing_buf_clear(&tracebuf);
-       growing_buf_appendf(&tracebuf, "\t%d:%g", i/2, factor);
-       TRACEMS(tinfo->emethods, -1, tracebuf.buffer_start);
-      }
-     }
-     if (inblocks->last_block) break;
+   }
+   if (!fft_execute_real_many(local_arg->plan, fftdata, nr_in_batch, 1, local_arg->fftwork)) {
+    ERREXIT(tinfo->emethods, "fftfilter: Error allocating FFT memory\n");
+   }
+   for (i=0; i<bufsize; i+=2) {
+    /* Re and Im of frequency i/2 for all channels of the batch */
+    DATATYPE const factor=transfer[i];
+    DATATYPE * const coeffs=fftdata+i*nr_in_batch;
+    for (b=0; b<2*nr_in_batch; b++) {
+     coeffs[b]*=factor;
     }
-    if (show_factors) {
-     TRACEMS(tinfo->emethods, -1, "\n");
-     show_factors=FALSE;
+   }
+   if (!fft_execute_real_many(local_arg->plan, fftdata, nr_in_batch, -1, local_arg->fftwork)) {
+    ERREXIT(tinfo->emethods, "fftfilter: Error allocating FFT memory\n");
+   }
+   for (point=0; point<datasize; point++) {
+    DATATYPE * const row=view.start+itempart+point*view.element_skip;
+    for (b=0; b<nr_in_batch; b++) {
+     row[batch[b]*view.vector_skip]=fftdata[BATCH_INDEX(point, b)];
     }
-
-    realfft(fftarray.start, fftsize, -1);
-    do {
-     array_write(&myarray,  array_scan(&fftarray)/norm);
-    } while (myarray.message==ARRAY_CONTINUE);
-   } while (myarray.message==ARRAY_ENDOFVECTOR);
+   }
+#undef BATCH_INDEX
   }
- array_free(&fftarray);
-
- if (args[ARGS_VERBOSE].is_set) {
-  growing_buf_free(&tracebuf);
  }
+
  return tinfo->tsdata;
 }
 /*}}}  */
@@ -268,6 +333,9 @@ fftfilter_exit(transform_info_ptr tinfo) {
 
  free_pointer((void **)&local_arg->blockdefs);
  free_pointer((void **)&local_arg->channel_list);
+ free_pointer((void **)&local_arg->transfer);
+ free_pointer((void **)&local_arg->workbuf);
+ free_pointer((void **)&local_arg->fftwork);
 
  tinfo->methods->init_done=FALSE;
 }
@@ -280,6 +348,7 @@ select_fftfilter(transform_info_ptr tinfo) {
  tinfo->methods->transform= &fftfilter;
  tinfo->methods->transform_exit= &fftfilter_exit;
  tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="fftfilter";
  tinfo->methods->method_description=
   "Transform method to cut out part of the Fourier coefficients of each\n"
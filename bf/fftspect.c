@@ -42,7 +42,16 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_LONG, "overlaps", "", 1, NULL}
 };
 
+/* The window function, cached between calls */
+typedef struct {
+ long wlength;
+ DATATYPE *window;
+ DATATYPE sumw;	/* The window sum */
+ DATATYPE sumw2;	/* The (squared window) sum */
+} welch_window;
+
 struct fftspect_storage {
+ welch_window window;
  int padto;
  int refchannel;
  int overlaps;
@@ -60,35 +69,30 @@ square(DATATYPE arg) {
 }
 
 /*{{{  Window function*/
-LOCAL long oldwlength;
-LOCAL DATATYPE *window=(DATATYPE *)NULL;
-LOCAL DATATYPE sumw;	/* The window sum */
-LOCAL DATATYPE sumw2;	/* The (squared window) sum */
-
 /*
  * Welch window
  */
 
 LOCAL void
-mkwindow(long wlength) {
+mkwindow(welch_window *win, long wlength) {
  long i;
  DATATYPE Nplus1d2, w;
 
- if (window) {
+ if (win->window) {
   /* old wlength is the same as new: nothing to do */
-  if (oldwlength==wlength) return;
-  free(window);
+  if (win->wlength==wlength) return;
+  free(win->window);
  }
- if ((window=(DATATYPE *)malloc(wlength*sizeof(DATATYPE)))==NULL) return;
+ if ((win->window=(DATATYPE *)malloc(wlength*sizeof(DATATYPE)))==NULL) return;
 
  Nplus1d2=(wlength+1)/2.0;
- sumw=sumw2=0.0;
+ win->sumw=win->sumw2=0.0;
  for (i=0; i<wlength; i++) {
-  window[i]=w=1.0-square((i+1-Nplus1d2)/Nplus1d2);
-  sumw+=w;
-  sumw2+=square(w);
+  win->window[i]=w=1.0-square((i+1-Nplus1d2)/Nplus1d2);
+  win->sumw+=w;
+  win->sumw2+=square(w);
  }
- oldwlength=wlength;
+ win->wlength=wlength;
 }
 /*}}}  */
 
@@ -98,13 +102,13 @@ mkwindow(long wlength) {
  * indata must contain mm=2*m real data points for each segment
  * 2*k is the number of segments to average
  * ovrlap=1 lets the segments (fft windows) overlap by one half
- * dwin is the number of data points in each segment <= mm=2**n
- * indata contains dwin points (not necessarily power 2) for each segment
+ * dwin is the number of data points in each segment <= mm
+ * indata contains dwin points for each segment
  * If dwin<mm, the data will be zero-padded to the fourier window size mm
  */
 
 LOCAL void 
-spect1(transform_info_ptr tinfo, DATATYPE *indata, DATATYPE *p, int dwin, int m, int k, int ovrlap) {
+spect1(transform_info_ptr tinfo, welch_window *win, DATATYPE *indata, DATATYPE *p, int dwin, int m, int k, int ovrlap) {
  int mm,m41,m4,kk,joff,j2,j;
  int n, dwin2=dwin*2, dwind2=dwin/2;
  DATATYPE w,*w1,den=0.0;
@@ -117,8 +121,8 @@ spect1(transform_info_ptr tinfo, DATATYPE *indata, DATATYPE *p, int dwin, int m,
  	ERREXIT2(tinfo->emethods, "spect1: Wrong dwin value %d, mm=%d\n", MSGPARM(dwin), MSGPARM(mm));
  m41=(m4=mm+mm)+1;
  w1=(DATATYPE *)malloc(m4*sizeof(DATATYPE));
- mkwindow(dwin);	/* Prepare window function in window[dwin] and sumw2 */
- if (w1==NULL || window==NULL)
+ mkwindow(win, dwin);	/* Prepare window function in window[dwin] and sumw2 */
+ if (w1==NULL || win->window==NULL)
 	ERREXIT(tinfo->emethods, "spect1: Error allocating temporary memory\n");
 
  for (j=0;j< m;j++) p[j]=0.0;
@@ -137,7 +141,7 @@ spect1(transform_info_ptr tinfo, DATATYPE *indata, DATATYPE *p, int dwin, int m,
   /*{{{  Multiply with window and zero-pad to m4 data points*/
   for (j=0;j<dwin;j++) {
    j2=j+j;
-   w=window[j];
+   w=win->window[j];
    w1[j2] *= w;
    w1[j2+1] *= w;
   }
@@ -145,14 +149,16 @@ spect1(transform_info_ptr tinfo, DATATYPE *indata, DATATYPE *p, int dwin, int m,
    w1[j]=0.0;
   }
   /*}}}  */
-  fourier((complex *)w1,mm,1);
+  if (!fourier((complex *)w1,mm,1)) {
+   ERREXIT(tinfo->emethods, "fftspect: Error allocating FFT memory\n");
+  }
   p[0] += (square(w1[0])+square(w1[1]));
   for (j=1;j<m;j++) {
    j2=j+j;
    p[j] += (square(w1[j2])+square(w1[j2+1])
         +square(w1[m4-j2])+square(w1[m41-j2]));
   }
-  den += sumw2;
+  den += win->sumw2;
   /*}}}  */
  }
  den *= m4;
@@ -198,9 +204,9 @@ typedef struct {
  int is_normalized;
 } complex_spectrum;
 
-/*{{{  cspect(transform_info_ptr tinfo, DATATYPE *indata, complex_spectrum *cspec, int dwin, int m, int k, int ovrlap) {*/
+/*{{{  cspect(transform_info_ptr tinfo, welch_window *win, DATATYPE *indata, complex_spectrum *cspec, int dwin, int m, int k, int ovrlap) {*/
 LOCAL void
-cspect(transform_info_ptr tinfo, DATATYPE *indata, complex_spectrum *cspec, int dwin, int m, int k, int ovrlap) {
+cspect(transform_info_ptr tinfo, welch_window *win, DATATYPE *indata, complex_spectrum *cspec, int dwin, int m, int k, int ovrlap) {
  int m1,mm,mm2,m4,kk,joff,j;
  int dwind2=dwin/2;
  DATATYPE *w1,*wp;
@@ -225,8 +231,8 @@ cspect(transform_info_ptr tinfo, DATATYPE *indata, complex_spectrum *cspec, int
   spectdest=cspec->current_spectrum;
  }
  w1=(DATATYPE *)malloc(m4*sizeof(DATATYPE));
- mkwindow(dwin);	/* Prepare window function in window[dwin] and sumw */
- if (w1==NULL || spectdest==NULL || window==NULL)
+ mkwindow(win, dwin);	/* Prepare window function in window[dwin] and sumw */
+ if (w1==NULL || spectdest==NULL || win->window==NULL)
 	ERREXIT(tinfo->emethods, "cspect: Error allocating temporary memory\n");
 
  for (kk=0;kk<k;kk++) {
@@ -236,12 +242,14 @@ cspect(transform_info_ptr tinfo, DATATYPE *indata, complex_spectrum *cspec, int
    /* Fit a line to the data to eliminate longwave effects (de-trending) */
    linreg(data, dwin, 1, &linreg_const, &linreg_fact);
    for (j=0;j<dwin;j++) {
-    *wp++ = (*data++ -linreg_const-j*linreg_fact)*window[j];
+    *wp++ = (*data++ -linreg_const-j*linreg_fact)*win->window[j];
    }
    for (;j<mm;j++) *wp++=0.0;	/* Zero-pad to mm values */
    if (ovrlap) data-=dwind2; /* Shift back by half the datawin size */
   }
-  real2fft(w1, w1+mm, spectdest, mm);
+  if (!real2fft(w1, w1+mm, spectdest, mm)) {
+   ERREXIT(tinfo->emethods, "fftspect: Error allocating FFT memory\n");
+  }
   /* Just store each complex spectrum */
   spectdest+=mm2;
   /*}}}  */
@@ -250,9 +258,9 @@ cspect(transform_info_ptr tinfo, DATATYPE *indata, complex_spectrum *cspec, int
 }
 /*}}}  */
 
-/*{{{  calc_refspectrum(transform_info_ptr tinfo, complex_spectrum *cspec, complex_spectrum *normspec, int refchannel, complex *p, enum norm_types norm_type) {*/
+/*{{{  calc_refspectrum(transform_info_ptr tinfo, welch_window *win, complex_spectrum *cspec, complex_spectrum *normspec, int refchannel, complex *p, enum norm_types norm_type) {*/
 LOCAL void
-calc_refspectrum(transform_info_ptr tinfo, complex_spectrum *cspec, complex_spectrum *normspec, int refchannel, complex *p, enum norm_types norm_type) {
+calc_refspectrum(transform_info_ptr tinfo, welch_window *win, complex_spectrum *cspec, complex_spectrum *normspec, int refchannel, complex *p, enum norm_types norm_type) {
  int m1,kk,joff,k,i,j;
  DATATYPE den=0.0;
  complex *phaseref, *cwp, *pr;
@@ -314,10 +322,10 @@ calc_refspectrum(transform_info_ptr tinfo, complex_spectrum *cspec, complex_spec
  /*{{{  Divide the resulting spectrum by window sum, spectrum count and winlength*/
  switch (norm_type) {
   case NORM_CROSS_SPECTRUM:
-   den = 0.5/sumw/sumw/k;
+   den = 0.5/win->sumw/win->sumw/k;
    break;
   case NORM_PHASEALIGNED:
-   den = 0.5/sumw/k;
+   den = 0.5/win->sumw/k;
    break;
   case NORM_COHERENCE:
    /* In the case of coherence spectra, division by window weight is not necessary */
@@ -332,27 +340,14 @@ calc_refspectrum(transform_info_ptr tinfo, complex_spectrum *cspec, complex_spec
 /*}}}  */
 /*}}}  */
 
-/*{{{  LOCAL void spect_exit(void)*/
+/*{{{  LOCAL void spect_exit(welch_window *win)*/
 LOCAL void
-spect_exit(void) {
- free(window);
- window=NULL;
+spect_exit(welch_window *win) {
+ free_pointer((void **)&win->window);
 }
 /*}}}  */
 /*}}}  */
 
-/*{{{  LOCAL int roundbase2(register long value)*/
-/*
- * roundbase2 rounds the argument down to a power of 2
- */
-LOCAL int 
-roundbase2(register long value) {
- int i;
- for (i=0; value>>=1; i++);
- return 1<<i;
-}
-/*}}}  */
-
 /*{{{  fftspect_init(transform_info_ptr tinfo)*/
 METHODDEF void
 fftspect_init(transform_info_ptr tinfo) {
@@ -370,6 +365,7 @@ fftspect_init(transform_info_ptr tinfo) {
  if (tinfo->itemsize>1) {
   ERREXIT(tinfo->emethods, "fftspect_init: Sorry, this method does not handle tuple data.\n");
  }
+ local_arg->window.window=NULL;
 
  /*{{{  Parse arguments that can be in seconds*/
  tinfo->windowsize=gettimeslice(tinfo, args[ARGS_WINDOWSIZE].arg.s);
@@ -416,7 +412,8 @@ fftspect_init(transform_info_ptr tinfo) {
 
  if (local_arg->padto<tinfo->windowsize) local_arg->padto=tinfo->windowsize;
  ptsperfreq=2*local_arg->overlaps+1;
- freqs=roundbase2(local_arg->padto/ptsperfreq);
+ /* Round down to a size the FFT handles efficiently */
+ freqs=fft_good_size(local_arg->padto/ptsperfreq, FALSE);
 
  if (tinfo->nrofshifts<=1) {
   int newoverlaps;
@@ -511,7 +508,7 @@ fftspect(transform_info_ptr tinfo) {
     cspec.is_normalized=FALSE;
     /*{{{  Get the 2*k (overlaps) complex spectra for all channels*/
     for (channel=0; channel<channels; channel++) {
-     cspect(tinfo, data+channel*tinfo->nr_of_points+i*wshift,
+     cspect(tinfo, &local_arg->window, data+channel*tinfo->nr_of_points+i*wshift,
       &cspec, 2*(tinfo->windowsize/ptsperfreq), nfreq-1, local_arg->overlaps, 1);
      cspec.current_spectrum+=cspec.sizeof_spectrum;
     }
@@ -522,7 +519,7 @@ fftspect(transform_info_ptr tinfo) {
      cspec.current_spectrum=cspec.first_spectrum;
      normspec.is_normalized=FALSE;
      for (channel=0; channel<channels; channel++) {
-      calc_refspectrum(tinfo, &cspec, &normspec, refchan,
+      calc_refspectrum(tinfo, &local_arg->window, &cspec, &normspec, refchan,
        cspects+(i+refchan-fromchan)*channels*nfreq+channel*nfreq, (enum norm_types)args[ARGS_CROSS_MODE].arg.i);
       cspec.current_spectrum+=cspec.sizeof_spectrum;
      }
@@ -541,7 +538,7 @@ fftspect(transform_info_ptr tinfo) {
   if ((spects=(DATATYPE *)malloc(tinfo->length_of_output_region*sizeof(DATATYPE)))!=NULL) {
    for (i=0; i<nspect; i++) {
     for (channel=0; channel<channels; channel++) {
-     spect1(tinfo, data+channel*tinfo->nr_of_points+i*wshift, 
+     spect1(tinfo, &local_arg->window, data+channel*tinfo->nr_of_points+i*wshift, 
       spects+i*channels*nfreq+channel*nfreq, 2*(tinfo->windowsize/ptsperfreq), nfreq, local_arg->overlaps, 1);
     }
    }
@@ -557,7 +554,8 @@ fftspect(transform_info_ptr tinfo) {
 /*{{{  fftspect_exit(transform_info_ptr tinfo)*/
 METHODDEF void
 fftspect_exit(transform_info_ptr tinfo) {
- spect_exit();
+ struct fftspect_storage *local_arg=(struct fftspect_storage *)tinfo->methods->local_storage;
+ spect_exit(&local_arg->window);
  tinfo->methods->init_done=FALSE;
 }
 /*}}}  */
@@ -573,6 +571,7 @@ select_fftspect(transform_info_ptr tinfo) {
  tinfo->methods->method_description=
   "Transform method to analyze the data in the frequency domain.\n";
  tinfo->methods->local_storage_size=sizeof(struct fftspect_storage);
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->nr_of_arguments=NR_OF_ARGUMENTS;
  tinfo->methods->argument_descriptors=argument_descriptors;
 }
@@ -77,6 +77,7 @@ enum ARGS_ENUM {
  ARGS_FILEOFFSET,
  ARGS_BLOCKGAP,
  ARGS_DECIMAL_SEPARATOR,
+ ARGS_CHANNELNAMES,
  ARGS_IFILE,
  ARGS_BEFORETRIG,
  ARGS_AFTERTRIG,
@@ -100,6 +101,7 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_LONG, "File_offset: Skip this many bytes (`string':Lines) at the start", "O", 0, NULL},
  {T_ARGS_TAKES_LONG, "Block_gap: Skip this many bytes between (point/channel) blocks", "B", 0, NULL},
  {T_ARGS_TAKES_STRING_WORD, "Decimal_separator: Read floating point values with this separator", "D", ARGDESC_UNUSED, (const char *const *)"."},
+ {T_ARGS_TAKES_STRING_WORD, "channelnames: Only read these channels (named 1..Channels)", "n", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_FILENAME, "Input file", "", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_STRING_WORD, "beforetrig", "", ARGDESC_UNUSED, (const char *const *)"1s"},
  {T_ARGS_TAKES_STRING_WORD, "aftertrig", "", ARGDESC_UNUSED, (const char *const *)"1s"},
@@ -110,9 +112,12 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
 struct read_generic_storage {
  FILE *infile;
  int *trigcodes;
- int current_trigger;
  growing_buf triggers;
+ struct trigger_epochs trigger_epochs;
  int nr_of_channels;
+ Bool *channel_selected;	/* NULL if all channels are read */
+ int nr_of_selected;
+ Bool seekable;	/* Unselected channels can be skipped by seeking */
  int itemsize;
  long points_in_file;
  long bytes_per_point;
@@ -135,13 +140,6 @@ struct read_generic_storage {
 };
 /*}}}  */
 
-/*{{{  Maintaining the triggers list*/
-LOCAL void 
-read_generic_reset_triggerbuffer(transform_info_ptr tinfo) {
- struct read_generic_storage *local_arg=(struct read_generic_storage *)tinfo->methods->local_storage;
- local_arg->current_trigger=0;
-}
-/*}}}  */
 /*{{{  read_generic_build_trigbuffer(transform_info_ptr tinfo) {*/
 /* This function has all the knowledge about events in the various file types */
 LOCAL void 
@@ -174,32 +172,6 @@ read_generic_build_trigbuffer(transform_info_ptr tinfo) {
  }
 }
 /*}}}  */
-/*{{{  read_generic_read_trigger(transform_info_ptr tinfo) {*/
-/* This is the highest-level access function: Read the next trigger and
- * advance the trigger counter. If this function is not called at least
- * once, event information is not even touched. */
-LOCAL int
-read_generic_read_trigger(transform_info_ptr tinfo, long *position, char **descriptionp) {
- struct read_generic_storage *local_arg=(struct read_generic_storage *)tinfo->methods->local_storage;
- int code=0;
- if (local_arg->triggers.buffer_start==NULL) {
-  /* Load the event information */
-  read_generic_build_trigbuffer(tinfo);
- }
- {
- int const nevents=local_arg->triggers.current_length/sizeof(struct trigger);
-
- if (local_arg->current_trigger<nevents) {
-  struct trigger * const intrig=((struct trigger *)local_arg->triggers.buffer_start)+local_arg->current_trigger;
-  *position=intrig->position;
-   code    =intrig->code;
-  if (descriptionp!=NULL) *descriptionp=intrig->description;
- }
- }
- local_arg->current_trigger++;
- return code;
-}
-/*}}}  */
 
 /*{{{  read_generic_init(transform_info_ptr tinfo) {*/
 METHODDEF void
@@ -250,6 +222,7 @@ read_generic_init(transform_info_ptr tinfo) {
   growing_buf_init(&local_arg->stringbuf);
   growing_buf_allocate(&local_arg->stringbuf, 0);
   local_arg->new_line=TRUE;
+  local_arg->seekable=FALSE;
  } else {
   if (args[ARGS_DECIMAL_SEPARATOR].is_set) {
    ERREXIT(tinfo->emethods, "read_generic_init: Decimal_separator is specific to the `string' datatype.\n");
@@ -289,6 +262,7 @@ read_generic_init(transform_info_ptr tinfo) {
   if (statbuff.st_size<=local_arg->fileoffset && !S_ISFIFO(statbuff.st_mode)) {
    ERREXIT(tinfo->emethods, "read_generic_init: Input file length <= fileoffset!\n");
   }
+  local_arg->seekable=S_ISREG(statbuff.st_mode);
   local_arg->bytes_per_point=(local_arg->nr_of_channels*local_arg->itemsize+(args[ARGS_XCHANNELNAME].is_set ? 1 : 0))*datatype_size[local_arg->datatype]+local_arg->block_gap;
   if (statbuff.st_size==0) {
    local_arg->points_in_file = 0;
@@ -300,6 +274,21 @@ read_generic_init(transform_info_ptr tinfo) {
  }
  tinfo->points_in_file=local_arg->points_in_file;
 
+ /*{{{  Resolve the channel selection against the default channel names*/
+ local_arg->channel_selected=NULL;
+ local_arg->nr_of_selected=local_arg->nr_of_channels;
+ if (args[ARGS_CHANNELNAMES].is_set) {
+  struct transform_info_struct filetinfo= *tinfo;
+  filetinfo.nr_of_channels=local_arg->nr_of_channels;
+  filetinfo.channelnames=NULL; filetinfo.probepos=NULL;
+  create_channelgrid(&filetinfo);
+  local_arg->channel_selected=expand_channel_selection(tinfo, args[ARGS_CHANNELNAMES].arg.s, local_arg->nr_of_channels, filetinfo.channelnames, &local_arg->nr_of_selected);
+  free(filetinfo.channelnames[0]);
+  free(filetinfo.channelnames);
+  free(filetinfo.probepos);
+ }
+ /*}}}  */
+
  local_arg->trigcodes=NULL;
  if (!args[ARGS_CONTINUOUS].is_set) {
   /* The actual trigger file is read when the first event is accessed! */
@@ -319,8 +308,10 @@ read_generic_init(transform_info_ptr tinfo) {
   }
  }
 
- read_generic_reset_triggerbuffer(tinfo);
- local_arg->current_trigger=0;
+ trigger_epochs_init(&local_arg->trigger_epochs, &local_arg->triggers, &read_generic_build_trigbuffer);
+ local_arg->trigger_epochs.trigcodes=local_arg->trigcodes;
+ local_arg->trigger_epochs.offset=local_arg->offset;
+ local_arg->trigger_epochs.points_in_file=local_arg->points_in_file;
  local_arg->current_point=0;
 
  tinfo->methods->init_done=TRUE;
@@ -440,6 +431,31 @@ read_value(FILE *infile,
 }
 /*}}}  */
 
+/*{{{  read_generic_skip_channels: Pass over channels not selected*/
+/* Starting with file channel `channel', skip the data of all channels not
+ * selected, each `points' points long and followed by `gap' bytes.
+ * Returns the next selected channel or nr_of_channels. */
+LOCAL int
+read_generic_skip_channels(transform_info_ptr tinfo, int channel, long points, long gap) {
+ struct read_generic_storage *local_arg=(struct read_generic_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+
+ if (local_arg->channel_selected==NULL) return channel;
+ for (; channel<local_arg->nr_of_channels && !local_arg->channel_selected[channel]; channel++) {
+  long nr_of_values=points*local_arg->itemsize;
+  if (local_arg->seekable) {
+   fseek(local_arg->infile, nr_of_values*datatype_size[local_arg->datatype], SEEK_CUR);
+  } else {
+   for (; nr_of_values>0; nr_of_values--) {
+    read_value(local_arg->infile, local_arg, args[ARGS_SWAPBYTEORDER].is_set);
+   }
+  }
+  if (gap!=0) fseek(local_arg->infile, gap, SEEK_CUR);
+ }
+ return channel;
+}
+/*}}}  */
+
 /*{{{  read_generic(transform_info_ptr tinfo) {*/
 METHODDEF DATATYPE *
 read_generic(transform_info_ptr tinfo) {
@@ -447,15 +463,15 @@ read_generic(transform_info_ptr tinfo) {
  transform_argument *args=tinfo->methods->arguments;
  array myarray;
  FILE *infile=local_arg->infile;
- Bool not_correct_trigger=FALSE;
  long trigger_point, file_start_point, file_end_point;
  char *description=NULL;
+ int channel;
 
  if (local_arg->epochs--==0) return NULL;
  tinfo->beforetrig=local_arg->beforetrig;
  tinfo->aftertrig=local_arg->aftertrig;
  tinfo->nr_of_points=local_arg->beforetrig+local_arg->aftertrig;
- tinfo->nr_of_channels=local_arg->nr_of_channels;
+ tinfo->nr_of_channels=local_arg->nr_of_selected;
  tinfo->nrofaverages=1;
  if (tinfo->nr_of_points<=0) {
   ERREXIT1(tinfo->emethods, "read_generic: Invalid nr_of_points %d\n", MSGPARM(tinfo->nr_of_points));
@@ -471,55 +487,28 @@ read_generic(transform_info_ptr tinfo) {
    trigger_point=file_start_point+tinfo->beforetrig;
    file_end_point=trigger_point+tinfo->aftertrig-1;
    if (local_arg->points_in_file>0 && file_end_point>=local_arg->points_in_file) return NULL;
-   local_arg->current_trigger++;
+   local_arg->trigger_epochs.current_trigger++;
    local_arg->current_point+=tinfo->nr_of_points;
    tinfo->condition=0;
-  } else 
-  do {
-   tinfo->condition=read_generic_read_trigger(tinfo, &trigger_point, &description);
+  } else {
+   tinfo->condition=trigger_epochs_next(tinfo, &local_arg->trigger_epochs, tinfo->beforetrig, tinfo->aftertrig);
    if (tinfo->condition==0) return NULL;	/* No more triggers in file */
-   file_start_point=trigger_point-tinfo->beforetrig+local_arg->offset;
-   file_end_point=trigger_point+tinfo->aftertrig-1-local_arg->offset;
-   
-   if (local_arg->trigcodes==NULL) {
-    not_correct_trigger=FALSE;
-   } else {
-    int trigno=0;
-    not_correct_trigger=TRUE;
-    while (local_arg->trigcodes[trigno]!=0) {
-     if (local_arg->trigcodes[trigno]==tinfo->condition) {
-      not_correct_trigger=FALSE;
-      break;
-     }
-     trigno++;
-    }
-   }
-  } while (not_correct_trigger || file_start_point<0 || (local_arg->points_in_file>0 && file_end_point>=local_arg->points_in_file));
+   trigger_point=local_arg->trigger_epochs.trigger_point;
+   file_start_point=local_arg->trigger_epochs.start_point;
+   file_end_point=local_arg->trigger_epochs.end_point;
+   description=local_arg->trigger_epochs.description;
+  }
  } while (--local_arg->fromepoch>0);
  if (description==NULL) {
-  TRACEMS3(tinfo->emethods, 1, "read_generic: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
+  TRACEMS3(tinfo->emethods, 1, "read_generic: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
  } else {
-  TRACEMS4(tinfo->emethods, 1, "read_generic: Reading around tag %d at %d, condition=%d, description=%s\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition), MSGPARM(description));
+  TRACEMS4(tinfo->emethods, 1, "read_generic: Reading around tag %d at %d, condition=%d, description=%s\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition), MSGPARM(description));
  }
  /*}}}  */
 
  /*{{{  Handle triggers within the epoch (option -T)*/
  if (args[ARGS_TRIGTRANSFER].is_set) {
-  int code;
-  long trigpoint;
-  long const old_current_trigger=local_arg->current_trigger;
-  char *thisdescription;
-
-  /* First trigger entry holds file_start_point */
-  push_trigger(&tinfo->triggers, file_start_point, -1, NULL);
-  read_generic_reset_triggerbuffer(tinfo);
-  for (; (code=read_generic_read_trigger(tinfo, &trigpoint, &thisdescription))!=0;) {
-   if (trigpoint>=file_start_point && trigpoint<=file_end_point) {
-    push_trigger(&tinfo->triggers, trigpoint-file_start_point, code, thisdescription);
-   }
-  }
-  push_trigger(&tinfo->triggers, 0, 0, NULL); /* End of list */
-  local_arg->current_trigger=old_current_trigger;
+  trigger_epochs_transfer(tinfo, &local_arg->trigger_epochs, &tinfo->triggers, file_start_point, file_end_point);
  }
  /*}}}  */
 
@@ -564,13 +553,23 @@ read_generic(transform_info_ptr tinfo) {
    }
 
    local_arg->first_in_epoch=TRUE;
+   channel=0;
    do {
-    if (args[ARGS_XCHANNELNAME].is_set && !args[ARGS_POINTSFASTEST].is_set) {
-     tinfo->xdata[myarray.current_vector]=read_value(infile, local_arg, args[ARGS_SWAPBYTEORDER].is_set);
+    if (args[ARGS_POINTSFASTEST].is_set) {
+     /* Nonmultiplexed: Pass over whole blocks of unselected channels */
+     channel=read_generic_skip_channels(tinfo, channel, tinfo->nr_of_points, local_arg->block_gap);
+    } else {
+     if (args[ARGS_XCHANNELNAME].is_set) {
+      tinfo->xdata[myarray.current_vector]=read_value(infile, local_arg, args[ARGS_SWAPBYTEORDER].is_set);
+     }
+     channel=0;
     }
     do {
      DATATYPE * const item0_addr=ARRAY_ELEMENT(&myarray);
      int itempart;
+     if (!args[ARGS_POINTSFASTEST].is_set) {
+      channel=read_generic_skip_channels(tinfo, channel, 1, 0)+1;
+     }
      /* Multiple items are always stored side by side: */
      for (itempart=0; itempart<tinfo->itemsize; itempart++) {
       item0_addr[itempart]=read_value(infile, local_arg, args[ARGS_SWAPBYTEORDER].is_set);
@@ -578,8 +577,16 @@ read_generic(transform_info_ptr tinfo) {
      array_advance(&myarray);
      local_arg->first_in_epoch=FALSE;
     } while (myarray.message==ARRAY_CONTINUE);
+    if (args[ARGS_POINTSFASTEST].is_set) {
+     channel++;
+    } else {
+     read_generic_skip_channels(tinfo, channel, 1, 0);
+    }
     if (local_arg->block_gap!=0) fseek(infile, local_arg->block_gap, SEEK_CUR);
    } while (myarray.message!=ARRAY_ENDOFSCAN);
+   if (args[ARGS_POINTSFASTEST].is_set) {
+    read_generic_skip_channels(tinfo, channel, tinfo->nr_of_points, local_arg->block_gap);
+   }
    break;
   case ERR_READ:
    if (local_arg->points_in_file==0) {
@@ -601,7 +608,9 @@ read_generic(transform_info_ptr tinfo) {
  /* Force create_channelgrid to really allocate the channel info anew.
   * Otherwise, deepfree_tinfo will free someone else's data ! */
  tinfo->channelnames=NULL; tinfo->probepos=NULL;
+ tinfo->nr_of_channels=local_arg->nr_of_channels;
  create_channelgrid(tinfo); /* Create defaults for any missing channel info */
+ if (local_arg->channel_selected!=NULL) select_channelinfo(tinfo, local_arg->channel_selected);
 
  tinfo->file_start_point=file_start_point;
  tinfo->z_label=NULL;
@@ -627,7 +636,9 @@ read_generic_exit(transform_info_ptr tinfo) {
  if (local_arg->infile!=NULL && local_arg->infile!=stdin) fclose(local_arg->infile);
  local_arg->infile=NULL;
  free_pointer((void **)&local_arg->trigcodes);
+ free_pointer((void **)&local_arg->channel_selected);
 
+ trigger_epochs_free(&local_arg->trigger_epochs);
  if (local_arg->triggers.buffer_start!=NULL) {
   clear_triggers(&local_arg->triggers);
   growing_buf_free(&local_arg->triggers);
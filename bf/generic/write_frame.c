@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2026 Bernd Feige
+ * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+ */
+/*{{{}}}*/
+/*{{{  Description*/
+/*
+ * write_frame.c writes each epoch as a self-describing binary frame, meant
+ * to be mapped directly into arrays by a client (see python/avg_q/frame.py)
+ * rather than parsed. A frame consists of
+ *  - 8 bytes magic "AVGQFRM1"
+ *  - uint64 length of the header text in bytes (a multiple of 8)
+ *  - uint64 length of the data in bytes
+ *  - the header text: key=value lines, padded with NUL bytes
+ *  - nr_of_points doubles of x axis data
+ *  - nr_of_points*nr_of_channels*itemsize doubles of data, multiplexed
+ *    (points vary slowest, items fastest)
+ * All numbers are little-endian, and both data blocks start at offsets that
+ * are multiples of 8 from the start of the frame. When frames are written
+ * to a file (eg below /dev/shm), the reader can memory-map it and use the
+ * arrays in place.
+ *	-- Bernd Feige 17.10.2026
+ */
+/*}}}  */
+
+/*{{{  #includes*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef __GNUC__
+#include <unistd.h>
+#endif
+#ifdef __MINGW32__
+#include <fcntl.h>
+#include <io.h>
+#endif
+#include <string.h>
+#include <Intel_compat.h>
+#include "transform.h"
+#include "bf.h"
+/*}}}  */
+
+#define FRAME_MAGIC "AVGQFRM1"
+#define FRAME_ALIGN 8
+/* The number of points converted and written in one block */
+#define FRAME_BLOCKPOINTS 1024
+
+enum ARGS_ENUM {
+ ARGS_APPEND=0,
+ ARGS_CLOSE,
+ ARGS_OFILE,
+ NR_OF_ARGUMENTS
+};
+LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
+ {T_ARGS_TAKES_NOTHING, "Append data if file exists", "a", FALSE, NULL},
+ {T_ARGS_TAKES_NOTHING, "Close the file after writing each epoch (and open it again next time)", "c", FALSE, NULL},
+ {T_ARGS_TAKES_FILENAME, "Output file", "", ARGDESC_UNUSED, NULL}
+};
+
+/*{{{  struct write_frame_storage {*/
+struct write_frame_storage {
+ FILE *outfile;
+ growing_buf header;
+ double *outbuffer;
+ long outbuffer_size;
+ Bool file_started;	/* Reopened files are appended to */
+};
+/*}}}  */
+
+/*{{{  Local open_file and close_file routines*/
+LOCAL void
+write_frame_open_file(transform_info_ptr tinfo) {
+ struct write_frame_storage *local_arg=(struct write_frame_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+
+ if (strcmp(args[ARGS_OFILE].arg.s, "stdout")==0) {
+  local_arg->outfile=stdout;
+#ifdef __MINGW32__
+  if (_setmode( _fileno( stdout ), _O_BINARY ) == -1) {
+   ERREXIT(tinfo->emethods, "write_frame_open_file: Can't set binary mode for stdout\n");
+  }
+#endif
+ } else {
+  Bool const append=(args[ARGS_APPEND].is_set || local_arg->file_started);
+  if ((local_arg->outfile=fopen(args[ARGS_OFILE].arg.s, append ? "ab" : "wb"))==NULL) {
+   ERREXIT1(tinfo->emethods, "write_frame_open_file: Can't open %s\n", MSGPARM(args[ARGS_OFILE].arg.s));
+  }
+  TRACEMS2(tinfo->emethods, 1, "write_frame_open_file: %s file %s\n", MSGPARM(append ? "Appending to" : "Creating"), MSGPARM(args[ARGS_OFILE].arg.s));
+ }
+ local_arg->file_started=TRUE;
+}
+LOCAL void
+write_frame_close_file(transform_info_ptr tinfo) {
+ struct write_frame_storage *local_arg=(struct write_frame_storage *)tinfo->methods->local_storage;
+ if (local_arg->outfile!=stdout) {
+  fclose(local_arg->outfile);
+ } else {
+  fflush(local_arg->outfile);
+ }
+ local_arg->outfile=NULL;
+}
+/*}}}  */
+
+/*{{{  write_frame_init(transform_info_ptr tinfo) {*/
+METHODDEF void
+write_frame_init(transform_info_ptr tinfo) {
+ struct write_frame_storage *local_arg=(struct write_frame_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+
+ growing_buf_init(&local_arg->header);
+ growing_buf_allocate(&local_arg->header, 0);
+ local_arg->outbuffer=NULL;
+ local_arg->outbuffer_size=0;
+ local_arg->file_started=FALSE;
+ if (!args[ARGS_CLOSE].is_set) write_frame_open_file(tinfo);
+
+ tinfo->methods->init_done=TRUE;
+}
+/*}}}  */
+
+/*{{{  Header*/
+/* Append a string value; Line breaks would end the value, so they are replaced */
+LOCAL void
+write_frame_append_text(growing_buf *header, char const *value) {
+ if (value!=NULL) {
+  char const *in;
+  for (in=value; *in!='\0'; in++) {
+   growing_buf_appendf(header, "%c", (*in=='\n' || *in=='\r' ? ' ' : *in));
+  }
+ }
+}
+LOCAL void
+write_frame_header_string(growing_buf *header, char const *key, char const *value) {
+ growing_buf_appendf(header, "%s=", key);
+ write_frame_append_text(header, value);
+ growing_buf_appendf(header, "\n");
+}
+LOCAL void
+write_frame_build_header(transform_info_ptr tinfo, growing_buf *header) {
+ int channel;
+ growing_buf_clear(header);
+ growing_buf_appendf(header, "nr_of_points=%d\nnr_of_channels=%d\nitemsize=%d\n", tinfo->nr_of_points, tinfo->nr_of_channels, tinfo->itemsize);
+ growing_buf_appendf(header, "sfreq=%.17g\nbeforetrig=%d\nleaveright=%d\nnrofaverages=%d\ncondition=%d\n", tinfo->sfreq, tinfo->beforetrig, tinfo->leaveright, tinfo->nrofaverages, tinfo->condition);
+ if (tinfo->data_type==FREQ_DATA) {
+  growing_buf_appendf(header, "nroffreq=%d\nbasefreq=%.17g\n", tinfo->nroffreq, tinfo->basefreq);
+ }
+ if (tinfo->z_label!=NULL) {
+  write_frame_header_string(header, "z_label", tinfo->z_label);
+  growing_buf_appendf(header, "z_value=%.17g\n", tinfo->z_value);
+ }
+ if (tinfo->comment!=NULL) write_frame_header_string(header, "comment", tinfo->comment);
+ write_frame_header_string(header, "xchannelname", tinfo->xchannelname);
+ growing_buf_appendf(header, "channelnames=");
+ for (channel=0; channel<tinfo->nr_of_channels; channel++) {
+  growing_buf_appendf(header, "%s%s", (channel>0 ? "\t" : ""), tinfo->channelnames[channel]);
+ }
+ growing_buf_appendf(header, "\n");
+ if (tinfo->probepos!=NULL) {
+  growing_buf_appendf(header, "channelpositions=");
+  for (channel=0; channel<tinfo->nr_of_channels; channel++) {
+   double const * const pos=tinfo->probepos+3*channel;
+   growing_buf_appendf(header, "%s%g %g %g", (channel>0 ? "\t" : ""), pos[0], pos[1], pos[2]);
+  }
+  growing_buf_appendf(header, "\n");
+ }
+ if (tinfo->triggers.buffer_start!=NULL) {
+  struct trigger const *intrig=(struct trigger const *)tinfo->triggers.buffer_start;
+  growing_buf_appendf(header, "file_start_point=%ld\n", intrig->position);
+  for (intrig++; intrig->code!=0; intrig++) {
+   growing_buf_appendf(header, "trigger=%ld\t%d", intrig->position, intrig->code);
+   if (intrig->description!=NULL) {
+    growing_buf_appendf(header, "\t");
+    write_frame_append_text(header, intrig->description);
+   }
+   growing_buf_appendf(header, "\n");
+  }
+ }
+ /* Drop the terminating zero and pad to the alignment */
+ header->current_length--;
+ while (header->current_length%FRAME_ALIGN!=0) growing_buf_appendchar(header, '\0');
+}
+/*}}}  */
+
+/*{{{  write_frame(transform_info_ptr tinfo) {*/
+METHODDEF DATATYPE *
+write_frame(transform_info_ptr tinfo) {
+ struct write_frame_storage *local_arg=(struct write_frame_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+ long const nr_of_values=((long)tinfo->nr_of_channels)*tinfo->itemsize;
+ long const blockpoints=(tinfo->nr_of_points<FRAME_BLOCKPOINTS ? tinfo->nr_of_points : FRAME_BLOCKPOINTS);
+ uint64_t lengths[2];
+ array_view view;
+ long point;
+ Bool write_error=FALSE;
+
+ if (args[ARGS_CLOSE].is_set) write_frame_open_file(tinfo);
+ if (tinfo->xdata==NULL) create_xaxis(tinfo, NULL);
+
+ write_frame_build_header(tinfo, &local_arg->header);
+ lengths[0]=local_arg->header.current_length;
+ lengths[1]=((uint64_t)tinfo->nr_of_points)*(1+nr_of_values)*sizeof(double);
+#ifndef LITTLE_ENDIAN
+ Intel_int64(&lengths[0]);
+ Intel_int64(&lengths[1]);
+#endif
+ if (fwrite(FRAME_MAGIC, 1, 8, local_arg->outfile)!=8
+  || fwrite(lengths, sizeof(uint64_t), 2, local_arg->outfile)!=2
+  || (long)fwrite(local_arg->header.buffer_start, 1, local_arg->header.current_length, local_arg->outfile)!=local_arg->header.current_length) {
+  write_error=TRUE;
+ }
+
+ /* Make sure the conversion buffer can hold a block of points */
+ if (local_arg->outbuffer_size<blockpoints*nr_of_values || local_arg->outbuffer_size<tinfo->nr_of_points) {
+  local_arg->outbuffer_size=(blockpoints*nr_of_values>tinfo->nr_of_points ? blockpoints*nr_of_values : tinfo->nr_of_points);
+  free_pointer((void **)&local_arg->outbuffer);
+  if ((local_arg->outbuffer=(double *)malloc(local_arg->outbuffer_size*sizeof(double)))==NULL) {
+   ERREXIT(tinfo->emethods, "write_frame: Error allocating output buffer\n");
+  }
+ }
+
+ /*{{{  x axis data*/
+ for (point=0; point<tinfo->nr_of_points; point++) {
+  local_arg->outbuffer[point]=tinfo->xdata[point];
+#ifndef LITTLE_ENDIAN
+  Intel_double(&local_arg->outbuffer[point]);
+#endif
+ }
+ if (!write_error && (long)fwrite(local_arg->outbuffer, sizeof(double), tinfo->nr_of_points, local_arg->outfile)!=tinfo->nr_of_points) {
+  write_error=TRUE;
+ }
+ /*}}}  */
+
+ /*{{{  Data, multiplexed*/
+ tinfo_array_view(tinfo, &view);
+#if defined(LITTLE_ENDIAN) && !defined(FLOAT_DATATYPE)
+ if (tinfo->multiplexed) {
+  /* The data is already in the output order */
+  if (!write_error && (long)fwrite(tinfo->tsdata, sizeof(double), tinfo->nr_of_points*nr_of_values, local_arg->outfile)!=tinfo->nr_of_points*nr_of_values) {
+   write_error=TRUE;
+  }
+ } else
+#endif
+ for (point=0; point<tinfo->nr_of_points && !write_error; point+=blockpoints) {
+  long const npoints=(point+blockpoints<=tinfo->nr_of_points ? blockpoints : tinfo->nr_of_points-point);
+  double *out=local_arg->outbuffer;
+  long p;
+  for (p=point; p<point+npoints; p++) {
+   int channel;
+   for (channel=0; channel<tinfo->nr_of_channels; channel++) {
+    DATATYPE const * const in=view.start+p*view.element_skip+channel*view.vector_skip;
+    int itempart;
+    for (itempart=0; itempart<tinfo->itemsize; itempart++) {
+     *out=in[itempart];
+#ifndef LITTLE_ENDIAN
+     Intel_double(out);
+#endif
+     out++;
+    }
+   }
+  }
+  if ((long)fwrite(local_arg->outbuffer, sizeof(double), npoints*nr_of_values, local_arg->outfile)!=npoints*nr_of_values) {
+   write_error=TRUE;
+  }
+ }
+ /*}}}  */
+
+ if (write_error) {
+  ERREXIT(tinfo->emethods, "write_frame: Error writing data\n");
+ }
+ if (args[ARGS_CLOSE].is_set) {
+  write_frame_close_file(tinfo);
+ } else if (local_arg->outfile==stdout) {
+  /* The reader at the other end of the pipe waits for complete frames */
+  fflush(local_arg->outfile);
+ }
+ return tinfo->tsdata;	/* Simply to return something `useful' */
+}
+/*}}}  */
+
+/*{{{  write_frame_exit(transform_info_ptr tinfo) {*/
+METHODDEF void
+write_frame_exit(transform_info_ptr tinfo) {
+ struct write_frame_storage *local_arg=(struct write_frame_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+
+ if (!args[ARGS_CLOSE].is_set) write_frame_close_file(tinfo);
+ growing_buf_free(&local_arg->header);
+ free_pointer((void **)&local_arg->outbuffer);
+ local_arg->outbuffer_size=0;
+
+ tinfo->methods->init_done=FALSE;
+}
+/*}}}  */
+
+/*{{{  select_write_frame(transform_info_ptr tinfo) {*/
+GLOBAL void
+select_write_frame(transform_info_ptr tinfo) {
+ tinfo->methods->transform_init= &write_frame_init;
+ tinfo->methods->transform= &write_frame;
+ tinfo->methods->transform_exit= &write_frame_exit;
+ tinfo->methods->method_type=PUT_EPOCH_METHOD;
+ tinfo->methods->method_name="write_frame";
+ tinfo->methods->method_description=
+  "Put-epoch method writing each epoch as a binary frame with a text header\n"
+  " (dimensions, sfreq, channel names and positions, triggers) followed by\n"
+  " the x axis and the multiplexed data as little-endian doubles, for\n"
+  " clients that map the data into arrays without parsing. The output file\n"
+  " can be `stdout' or, for memory-mapped access, a file eg below /dev/shm.\n";
+ tinfo->methods->local_storage_size=sizeof(struct write_frame_storage);
+ tinfo->methods->nr_of_arguments=NR_OF_ARGUMENTS;
+ tinfo->methods->argument_descriptors=argument_descriptors;
+}
+/*}}}  */
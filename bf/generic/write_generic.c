@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008,2010,2012-2014,2025 Bernd Feige
+ * Copyright (C) 2008,2010,2012-2014,2025,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -75,6 +75,18 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_SELECTION, "data_type", "", DT_INT16, datatype_choice}
 };
 
+/* Size in bytes of one value of each binary data type */
+LOCAL int const datatype_size[]={
+ sizeof(uint8_t),
+ sizeof(int8_t),
+ sizeof(int16_t),
+ sizeof(int32_t),
+ sizeof(float),
+ sizeof(double),
+};
+/* Binary output is converted into a buffer of this size and written in blocks */
+#define WRITE_GENERIC_BUFFERSIZE (1<<20)
+
 /*{{{  struct write_generic_storage {*/
 struct write_generic_storage {
  FILE *outfile;
@@ -82,6 +94,8 @@ struct write_generic_storage {
  Bool last_was_newline;
  Bool beginning_of_file;
  growing_buf epochsep;
+ char *outbuffer;
+ long outbuffer_used;
 
  jmp_buf error_jmp;
 };
@@ -190,6 +204,14 @@ write_generic_init(transform_info_ptr tinfo) {
  }
  /*}}}  */
 
+ local_arg->outbuffer=NULL;
+ local_arg->outbuffer_used=0;
+ if (local_arg->datatype!=DT_STRING) {
+  if ((local_arg->outbuffer=(char *)malloc(WRITE_GENERIC_BUFFERSIZE))==NULL) {
+   ERREXIT(tinfo->emethods, "write_generic_init: Error allocating output buffer\n");
+  }
+ }
+
  if (!args[ARGS_CLOSE].is_set) write_generic_open_file(tinfo);
 
  local_arg->last_was_newline=TRUE;
@@ -198,66 +220,102 @@ write_generic_init(transform_info_ptr tinfo) {
 }
 /*}}}  */
 
+/*{{{  Binary output buffer*/
+/* Write out the buffered binary data */
 LOCAL void
-write_value(DATATYPE dat, FILE *outfile, 
- struct write_generic_storage *local_arg, 
- Bool swap_byteorder, Bool string_output_newline) {
- Bool err=FALSE;
- switch (local_arg->datatype) {
+write_generic_flush(struct write_generic_storage *local_arg) {
+ if (local_arg->outbuffer_used>0) {
+  if ((long)fwrite(local_arg->outbuffer, 1, local_arg->outbuffer_used, local_arg->outfile)!=local_arg->outbuffer_used) {
+   longjmp(local_arg->error_jmp, TRUE);
+  }
+  local_arg->outbuffer_used=0;
+  local_arg->beginning_of_file=FALSE;
+ }
+}
+
+/* Convert n values in[0], in[skip], ... to the binary data type at out */
+LOCAL void
+write_generic_convert(enum DATATYPE_ENUM datatype, DATATYPE const *in, long n, long skip, Bool swap_byteorder, void *out) {
+ long i;
+ switch (datatype) {
   case DT_UINT8: {
-   unsigned char c= (unsigned char)rint(dat);
-   err=(fwrite(&c, sizeof(c), 1, outfile)!=1);
+   unsigned char * const c=(unsigned char *)out;
+   for (i=0; i<n; i++) c[i]=(unsigned char)rint(in[i*skip]);
    }
    break;
   case DT_INT8: {
-   signed char c= (signed char)rint(dat);
-   err=(fwrite(&c, sizeof(c), 1, outfile)!=1);
+   signed char * const c=(signed char *)out;
+   for (i=0; i<n; i++) c[i]=(signed char)rint(in[i*skip]);
    }
    break;
   case DT_INT16: {
-   int16_t c= (int16_t)rint(dat);
-   if (swap_byteorder) Intel_int16((uint16_t *)&c);
-   err=(fwrite(&c, sizeof(c), 1, outfile)!=1);
+   int16_t * const c=(int16_t *)out;
+   for (i=0; i<n; i++) c[i]=(int16_t)rint(in[i*skip]);
+   if (swap_byteorder) for (i=0; i<n; i++) Intel_int16((uint16_t *)&c[i]);
    }
    break;
   case DT_INT32: {
-   int32_t c= (int32_t)rint(dat);
-   if (swap_byteorder) Intel_int32((uint32_t *)&c);
-   err=(fwrite(&c, sizeof(c), 1, outfile)!=1);
+   int32_t * const c=(int32_t *)out;
+   for (i=0; i<n; i++) c[i]=(int32_t)rint(in[i*skip]);
+   if (swap_byteorder) for (i=0; i<n; i++) Intel_int32((uint32_t *)&c[i]);
    }
    break;
   case DT_FLOAT32: {
-   float c=dat;
-   if (swap_byteorder) Intel_float(&c);
-   err=(fwrite(&c, sizeof(c), 1, outfile)!=1);
+   float * const c=(float *)out;
+   for (i=0; i<n; i++) c[i]=in[i*skip];
+   if (swap_byteorder) for (i=0; i<n; i++) Intel_float(&c[i]);
    }
    break;
   case DT_FLOAT64: {
-   double c=dat;
-   if (swap_byteorder) Intel_double(&c);
-   err=(fwrite(&c, sizeof(c), 1, outfile)!=1);
+   double * const c=(double *)out;
+   for (i=0; i<n; i++) c[i]=in[i*skip];
+   if (swap_byteorder) for (i=0; i<n; i++) Intel_double(&c[i]);
    }
    break;
-  case DT_STRING: {
-   double c=dat;
-   if (!local_arg->last_was_newline) {
-    fputs("\t", outfile);
-   }
-   fprintf(outfile, "%g", c);
-   if (string_output_newline) {
-    fputs("\n", outfile);
-    local_arg->last_was_newline=TRUE;
-   } else {
-    local_arg->last_was_newline=FALSE;
-   }
-   err=FALSE;
-   }
+  case DT_STRING:
    break;
  }
- if (err) {
-  longjmp(local_arg->error_jmp, err);
+}
+
+/* Append n values in[0], in[skip], ... to the binary output buffer */
+LOCAL void
+write_generic_put_block(struct write_generic_storage *local_arg, DATATYPE const *in, long n, long skip, Bool swap_byteorder) {
+ int const size=datatype_size[local_arg->datatype];
+ while (n>0) {
+  long room=(WRITE_GENERIC_BUFFERSIZE-local_arg->outbuffer_used)/size;
+  if (room==0) {
+   write_generic_flush(local_arg);
+   room=WRITE_GENERIC_BUFFERSIZE/size;
+  }
+  if (room>n) room=n;
+  write_generic_convert(local_arg->datatype, in, room, skip, swap_byteorder, local_arg->outbuffer+local_arg->outbuffer_used);
+  local_arg->outbuffer_used+=room*size;
+  in+=room*skip;
+  n-=room;
+ }
+}
+/*}}}  */
+
+LOCAL void
+write_value(DATATYPE dat, FILE *outfile, 
+ struct write_generic_storage *local_arg, 
+ Bool swap_byteorder, Bool string_output_newline) {
+ if (local_arg->datatype==DT_STRING) {
+  double c=dat;
+  if (!local_arg->last_was_newline) {
+   fputs("\t", outfile);
+  }
+  fprintf(outfile, "%g", c);
+  if (string_output_newline) {
+   fputs("\n", outfile);
+   local_arg->last_was_newline=TRUE;
+  } else {
+   local_arg->last_was_newline=FALSE;
+  }
+  local_arg->beginning_of_file=FALSE;
+ } else {
+  write_generic_put_block(local_arg, &dat, 1, 1, swap_byteorder);
  }
- local_arg->beginning_of_file=FALSE;
 }
 
 /*{{{  write_generic(transform_info_ptr tinfo) {*/
@@ -266,7 +324,6 @@ write_generic(transform_info_ptr tinfo) {
  struct write_generic_storage *local_arg=(struct write_generic_storage *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
  FILE *outfile;
- array myarray;
 
  if (args[ARGS_CLOSE].is_set) {
   write_generic_open_file(tinfo);
@@ -281,7 +338,6 @@ write_generic(transform_info_ptr tinfo) {
   fputs(local_arg->epochsep.buffer_start, outfile);
  }
 
- tinfo_array(tinfo, &myarray);
  switch (setjmp(local_arg->error_jmp)) {
   case FALSE:
    if (args[ARGS_POINTSFASTEST].is_set) {
@@ -369,13 +425,25 @@ write_generic(transform_info_ptr tinfo) {
       }
      }
     }
-    array_transpose(&myarray);	/* channels are the elements */
    }
 
-   do {
-    DATATYPE * const item0_addr=ARRAY_ELEMENT(&myarray);
-    int itempart;
-    if (args[ARGS_WRITE_COMMENT].is_set && myarray.current_element==0) {
+   {
+   /* Output rows are channels with -P, else points */
+   array_view view;
+   long row, nr_of_rows, row_skip, nr_of_elements, element_skip;
+   int const itemsize=tinfo->itemsize;
+   tinfo_array_view(tinfo, &view);
+   if (args[ARGS_POINTSFASTEST].is_set) {
+    nr_of_rows=view.nr_of_vectors; row_skip=view.vector_skip;
+    nr_of_elements=view.nr_of_elements; element_skip=view.element_skip;
+   } else {
+    nr_of_rows=view.nr_of_elements; row_skip=view.element_skip;
+    nr_of_elements=view.nr_of_vectors; element_skip=view.vector_skip;
+   }
+   for (row=0; row<nr_of_rows; row++) {
+    DATATYPE const * const in=view.start+row*row_skip;
+    long element;
+    if (args[ARGS_WRITE_COMMENT].is_set) {
      if (local_arg->datatype==DT_STRING) {
       if (!local_arg->last_was_newline) {
        fputs("\t", outfile);
@@ -386,30 +454,42 @@ write_generic(transform_info_ptr tinfo) {
       write_value(atof(tinfo->comment), outfile, local_arg, args[ARGS_SWAPBYTEORDER].is_set, FALSE);
      }
     }
-    if (args[ARGS_WRITE_Z_VALUE].is_set && myarray.current_element==0) {
+    if (args[ARGS_WRITE_Z_VALUE].is_set) {
      write_value(tinfo->z_value, outfile, local_arg, args[ARGS_SWAPBYTEORDER].is_set, FALSE);
     }
-    if (args[ARGS_WRITE_XDATA].is_set && !args[ARGS_POINTSFASTEST].is_set && myarray.current_element==0) {
-     write_value(tinfo->xdata[myarray.current_vector], outfile, local_arg, args[ARGS_SWAPBYTEORDER].is_set, FALSE);
+    if (args[ARGS_WRITE_XDATA].is_set && !args[ARGS_POINTSFASTEST].is_set) {
+     write_value(tinfo->xdata[row], outfile, local_arg, args[ARGS_SWAPBYTEORDER].is_set, FALSE);
     }
-    if (args[ARGS_WRITE_CHANNELNAMES].is_set && args[ARGS_POINTSFASTEST].is_set && myarray.current_element==0) {
+    if (args[ARGS_WRITE_CHANNELNAMES].is_set && args[ARGS_POINTSFASTEST].is_set) {
      if (local_arg->datatype==DT_STRING) {
       if (!local_arg->last_was_newline) {
        fputs("\t", outfile);
       }
-      fputs(tinfo->channelnames[myarray.current_vector], outfile);
+      fputs(tinfo->channelnames[row], outfile);
       local_arg->last_was_newline=FALSE;
      } else {
-      write_value(atof(tinfo->channelnames[myarray.current_vector]), outfile, local_arg, args[ARGS_SWAPBYTEORDER].is_set, FALSE);
+      write_value(atof(tinfo->channelnames[row]), outfile, local_arg, args[ARGS_SWAPBYTEORDER].is_set, FALSE);
      }
     }
-    /* We do that here so that it is easy to know whether we are writing the last element: */
-    array_advance(&myarray);
     /* If multiple items are present, output them side by side: */
-    for (itempart=0; itempart<tinfo->itemsize; itempart++) {
-     write_value(item0_addr[itempart], outfile, local_arg, args[ARGS_SWAPBYTEORDER].is_set, myarray.message!=ARRAY_CONTINUE && itempart+1==tinfo->itemsize);
+    if (local_arg->datatype==DT_STRING) {
+     for (element=0; element<nr_of_elements; element++) {
+      int itempart;
+      for (itempart=0; itempart<itemsize; itempart++) {
+       write_value(in[element*element_skip+itempart], outfile, local_arg, args[ARGS_SWAPBYTEORDER].is_set, element+1==nr_of_elements && itempart+1==itemsize);
+      }
+     }
+    } else if (itemsize==1 || element_skip==itemsize) {
+     /* One block for the whole row */
+     write_generic_put_block(local_arg, in, nr_of_elements*itemsize, (itemsize==1 ? element_skip : 1), args[ARGS_SWAPBYTEORDER].is_set);
+    } else {
+     for (element=0; element<nr_of_elements; element++) {
+      write_generic_put_block(local_arg, in+element*element_skip, itemsize, 1, args[ARGS_SWAPBYTEORDER].is_set);
+     }
     }
-   } while (myarray.message!=ARRAY_ENDOFSCAN);
+   }
+   write_generic_flush(local_arg);
+   }
    break;
   case TRUE:
    ERREXIT(tinfo->emethods, "write_generic: Error writing data\n");
@@ -429,6 +509,7 @@ write_generic_exit(transform_info_ptr tinfo) {
 
  if (!args[ARGS_CLOSE].is_set) write_generic_close_file(tinfo);
  growing_buf_free(&local_arg->epochsep);
+ free_pointer((void **)&local_arg->outbuffer);
 
  tinfo->methods->init_done=FALSE;
 }
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2026 Bernd Feige
+ * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+ */
+/*{{{}}}*/
+/*{{{  Description*/
+/*
+ * get_block.c The block interface of get_epoch methods, reading a range of
+ * points for a selection of channels at once (see transform.h).
+ *
+ * Readers implement get_block natively with large reads converting whole
+ * file blocks at a time; get_block() calls that if available and otherwise
+ * emulates it by the single point interface (seek_point and
+ * get_singlepoint), so that callers need not care which one a method has.
+ */
+/*}}}  */
+
+/*{{{  #includes*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "transform.h"
+#include "bf.h"
+/*}}}  */
+
+/*{{{  get_block_nr_of_channels(transform_info_ptr tinfo, int const *channel_list) {*/
+/* The number of channels a get_block call delivers per point */
+GLOBAL int
+get_block_nr_of_channels(transform_info_ptr tinfo, int const *channel_list) {
+ int n=0;
+ if (channel_list==NULL) return tinfo->nr_of_channels;
+ while (channel_list[n]!=0) n++;
+ return n;
+}
+/*}}}  */
+
+/*{{{  get_block(transform_info_ptr tinfo, long start_point, long nr_of_points, int const *channel_list, DATATYPE *dest, enum get_block_layouts layout) {*/
+GLOBAL long
+get_block(transform_info_ptr tinfo, long start_point, long nr_of_points, int const *channel_list, DATATYPE *dest, enum get_block_layouts layout) {
+ int const nr_of_outchannels=get_block_nr_of_channels(tinfo, channel_list);
+ array point_array;
+ long point;
+
+ if (tinfo->methods->get_block!=NULL) {
+  return (*tinfo->methods->get_block)(tinfo, start_point, nr_of_points, channel_list, dest, layout);
+ }
+ if (tinfo->methods->get_singlepoint==NULL || tinfo->methods->seek_point==NULL) {
+  ERREXIT1(tinfo->emethods, "get_block: Method %s has no point interface\n", MSGPARM(tinfo->methods->method_name));
+ }
+
+ /* get_singlepoint always delivers all channels of the reader */
+ point_array.nr_of_elements=tinfo->nr_of_channels;
+ point_array.nr_of_vectors=1;
+ point_array.element_skip=1;
+ if (array_allocate(&point_array)==NULL) {
+  ERREXIT(tinfo->emethods, "get_block: Error allocating point buffer\n");
+ }
+ (*tinfo->methods->seek_point)(tinfo, start_point);
+ for (point=0; point<nr_of_points; point++) {
+  int channel;
+  array_reset(&point_array);
+  if ((*tinfo->methods->get_singlepoint)(tinfo, &point_array)!=0) break;
+  for (channel=0; channel<nr_of_outchannels; channel++) {
+   DATATYPE const value=point_array.start[channel_list==NULL ? channel : channel_list[channel]-1];
+   if (layout==GET_BLOCK_MULTIPLEXED) {
+    dest[point*nr_of_outchannels+channel]=value;
+   } else {
+    dest[channel*nr_of_points+point]=value;
+   }
+  }
+ }
+ array_free(&point_array);
+ return point;
+}
+/*}}}  */
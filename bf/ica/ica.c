@@ -12,22 +12,55 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <time.h>
 #include <math.h>
 #include "ica.h"
 
-#ifdef R250
-#include "r250.h"
-#endif
 
-/* Global and externally accessible variables */
-integer extendedflag, extblocks, pdfsize, nsub;
-#ifndef FOR_AVG_Q
-integer verbose;
-#endif
-integer block, maxsteps;
+/************************** Initialize an ICA context *************************/
+/* Set the configuration in ctx to the default values defined in ica.h.       */
+/* block and lrate are left 0 to be set from the data size, annealstep 0 to   */
+/* be set according to extendedflag.                                          */
+/*                                                                            */
+/* ctx: ica_context (output)                                                  */
+
+void ica_init_context(ica_context *ctx) {
+	ctx->extendedflag = DEFAULT_EXTENDED;
+	ctx->extblocks    = DEFAULT_EXTBLOCKS;
+	ctx->pdfsize      = MAX_PDFSIZE;
+	ctx->nsub         = DEFAULT_NSUB;
+	ctx->block        = 0;
+	ctx->maxsteps     = DEFAULT_MAXSTEPS;
+	ctx->verbose      = DEFAULT_VERBOSE;
+	ctx->lrate        = 0.0;
+	ctx->annealstep   = 0.0;
+	ctx->annealdeg    = DEFAULT_ANNEALDEG;
+	ctx->nochange     = DEFAULT_STOP;
+	ctx->momentum     = DEFAULT_MOMENTUM;
+	ctx->seed         = 0;
+	ctx->message      = NULL;
+	ctx->message_data = NULL;
+	ctx->steps        = 0;
+	ctx->change       = 0.0;
+	ctx->error_message = NULL;
+}
 
-doublereal lrate, annealstep, annealdeg, nochange, momentum;
+
+/************************** Output a progress message *************************/
+/* Format a message like printf and pass it to ctx->message, or print it to   */
+/* stdout if that is NULL. Callers check ctx->verbose.                        */
+
+void ica_message(ica_context *ctx, const char *format, ...) {
+	char buffer[256];
+	va_list ap;
+
+	va_start(ap, format);
+	vsnprintf(buffer, sizeof(buffer), format, ap);
+	va_end(ap);
+	if (ctx->message) (*ctx->message)(ctx, buffer);
+	else fputs(buffer, stdout);
+}
 
 
 /***************************** Zero-fill a array ******************************/
@@ -77,18 +110,22 @@ void initperm(integer *perm, integer n) {
 /* data. The designated elements of data are projected by trsf employing the  */
 /* bias, if not NULL. k denotes the number of elements of perm left to be     */
 /* extracted; perm is updated while calling routine must update k. The        */
-/* resulting projections are returned in proj.                                */
+/* resulting projections are returned in proj. The data points are gathered */
+/* in sample first so that the whole block is projected by a single matrix    */
+/* product.                                                                   */
 /*                                                                            */
-/* data: double array [m,?] (input)                                           */
-/* trsf: double array [m,m] (input)                                           */
-/* bias: double array [m] or NULL (input)                                     */
-/* perm: integer array [k>] (input/output)                                    */
-/* m:    integer (input)                                                      */
-/* n:    integer (input)                                                      */
-/* k:    integer (input)                                                      */
-/* proj: double array [m,n] (output)                                          */
+/* ctx:    ica_context (input/output)                                         */
+/* data:   double array [m,?] (input)                                         */
+/* trsf:   double array [m,m] (input)                                         */
+/* bias:   double array [m] or NULL (input)                                   */
+/* perm:   integer array [k>] (input/output)                                  */
+/* m:      integer (input)                                                    */
+/* n:      integer (input)                                                    */
+/* k:      integer (input)                                                    */
+/* sample: double array [m,n] (workspace)                                     */
+/* proj:   double array [m,n] (output)                                        */
 
-void randperm(doublereal *data, doublereal *trsf, doublereal *bias, integer *perm, integer m, integer n, integer k, doublereal *proj) {
+void randperm(ica_context *ctx, doublereal *data, doublereal *trsf, doublereal *bias, integer *perm, integer m, integer n, integer k, doublereal *sample, doublereal *proj) {
 	integer i, im, swap, inc = 1;
 	doublereal alpha = 1.0, beta;
 	char trans='N';
@@ -101,10 +138,11 @@ void randperm(doublereal *data, doublereal *trsf, doublereal *bias, integer *per
 		beta = 0.0;
 
 	for (i=0,im=0 ; i<n ; i++,im+=m) {
-		swap = RAND()%k;
-		dgemv_(&trans,&m,&m,&alpha,trsf,&m,&data[perm[swap]*m],&inc,&beta,&proj[im],&inc,1);
+		swap = RAND(ctx)%k;
+		dcopy_(&m,&data[perm[swap]*m],&inc,&sample[im],&inc);
 		perm[swap] = perm[--k];
 	}
+	dgemm_(&trans,&trans,&m,&n,&m,&alpha,trsf,&m,sample,&m,&beta,proj,&m,1,1);
 }
 
 
@@ -115,6 +153,7 @@ void randperm(doublereal *data, doublereal *trsf, doublereal *bias, integer *per
 /* epochs. The designated elements of data are projected by trsf employing    */
 /* the bias, if not NULL. The resulting projections are returned in proj.     */
 /*                                                                            */
+/* ctx:    ica_context (input/output)                                         */
 /* data:   double array [m,?] (input)                                         */
 /* trsf:   double array [m,m] (input)                                         */
 /* bias:   double array [m] or NULL (input)                                   */
@@ -122,9 +161,10 @@ void randperm(doublereal *data, doublereal *trsf, doublereal *bias, integer *per
 /* n:      integer (input)                                                    */
 /* frames: integer (input)                                                    */
 /* epochs: integer (input)                                                    */
+/* sample: double array [m,n] (workspace)                                     */
 /* proj:   double array [m,n] (output)                                        */
 
-void probperm(doublereal *data, doublereal *trsf, doublereal *bias, integer m, integer n, integer frames, integer epochs, doublereal *proj) {
+void probperm(ica_context *ctx, doublereal *data, doublereal *trsf, doublereal *bias, integer m, integer n, integer frames, integer epochs, doublereal *sample, doublereal *proj) {
 	integer i, im, idx, norm, prob, inc = 1;
 	doublereal alpha = 1.0, beta;
 	char trans='N';
@@ -139,7 +179,7 @@ void probperm(doublereal *data, doublereal *trsf, doublereal *bias, integer m, i
 	norm = (1<<((frames+1)/2+1))-2*((frames%2)-1);
 
 	for (i=0,im=0 ; i<n ; i++,im+=m) {
-		prob = RAND()%norm;
+		prob = RAND(ctx)%norm;
 
 		if (prob & 1) {
 			idx = 0;
@@ -158,9 +198,10 @@ void probperm(doublereal *data, doublereal *trsf, doublereal *bias, integer m, i
 			}
 		}
 
-		idx += frames*(RAND()%epochs);
-		dgemv_(&trans,&m,&m,&alpha,trsf,&m,&data[idx*m],&inc,&beta,&proj[im],&inc,1);
+		idx += frames*(RAND(ctx)%epochs);
+		dcopy_(&m,&data[idx*m],&inc,&sample[im],&inc);
 	}
+	dgemm_(&trans,&trans,&m,&n,&m,&alpha,trsf,&m,sample,&m,&beta,proj,&m,1,1);
 }
 
 
@@ -172,6 +213,7 @@ void probperm(doublereal *data, doublereal *trsf, doublereal *bias, integer m, i
 /* perm is updated while calling routine must update k. The resulting         */
 /* PDF estimate is returned in kk.                                            */
 /*                                                                            */
+/* ctx:  ica_context (input/output)                                           */
 /* data: double array [m,? or n] (input)                                      */
 /* trsf: double array [m,m] (input)                                           */
 /* perm: integer array [k>] (input/output) or NULL                            */
@@ -180,7 +222,7 @@ void probperm(doublereal *data, doublereal *trsf, doublereal *bias, integer m, i
 /* k:    integer (input)                                                      */
 /* kk:   double array [m,n] (output)                                          */
 
-void pdf(doublereal *data, doublereal *trsf, integer *perm, integer m, integer n, integer k, doublereal *kk) {
+void pdf(ica_context *ctx, doublereal *data, doublereal *trsf, integer *perm, integer m, integer n, integer k, doublereal *kk) {
 	integer i, j, im, swap, inc = 1;
 	doublereal alpha = 1.0, beta = 0.0, tmp;
 	char trans='N';
@@ -190,7 +232,7 @@ void pdf(doublereal *data, doublereal *trsf, integer *perm, integer m, integer n
 
     for (i=0,im=0 ; i<n ; i++,im+=m) {
         if (perm) {
-            swap = RAND()%k;
+            swap = RAND(ctx)%k;
             dgemv_(&trans,&m,&m,&alpha,trsf,&m,&data[perm[swap]*m],&inc,&beta,kk,&inc,1);
             perm[swap] = perm[--k];
         }
@@ -213,7 +255,7 @@ void pdf(doublereal *data, doublereal *trsf, integer *perm, integer m, integer n
 
 	for (i=0,im=0 ; i<n ; i++,im+=m) {
 		if (perm) {
-			swap = RAND()%k;
+			swap = RAND(ctx)%k;
 			dgemv_(&trans,&m,&m,&alpha,trsf,&m,&data[perm[swap]*m],&inc,&beta,kk,&inc,1);
 			perm[swap] = perm[--k];
 		}
@@ -301,6 +343,7 @@ int compar(const void *x, const void *y) {
 /* weights and sphere or pseudoinverse of weights, sphere, and eigv. Reorder  */
 /* data and weights accordingly. Also if not NULL, reorder bias and signs.    */
 /*                                                                            */
+/* ctx:     ica_context (input)                                               */
 /* data:    double array [m,n] (input/output)                                 */
 /* weights: double array [m,m] (input/output)                                 */
 /* sphere:  double array [m,m] (input)                                        */
@@ -311,7 +354,7 @@ int compar(const void *x, const void *y) {
 /* n:       integer (input)                                                   */
 /* k:       integer (input)                                                   */
 
-void varsort(doublereal *data, doublereal *weights, doublereal *sphere, doublereal *eigv, doublereal *bias, integer *signs, integer m, integer n, integer k) {
+void varsort(ica_context *ctx, doublereal *data, doublereal *weights, doublereal *sphere, doublereal *eigv, doublereal *bias, integer *signs, integer m, integer n, integer k) {
 	char name[] = "DGETRI\0", opts[] = "\0";
 	doublereal alpha = 1.0, beta = 0.0;
 	integer i, j, l, jm, ik, info = 0, ispec = 1, na = -1;
@@ -363,14 +406,14 @@ void varsort(doublereal *data, doublereal *weights, doublereal *sphere, doublere
 		
 		meanvar[i].idx = i;
 		meanvar[i].val = dsum_(&n,sum,&inc);
-		if (verbose) printf("%d ",(int)(i+1));
+		if (ctx->verbose) ica_message(ctx,"%d ",(int)(i+1));
 	}
-	if (verbose) printf("\n");
+	if (ctx->verbose) ica_message(ctx,"\n");
 	
 /* Sort meanvar */
 	qsort(meanvar,m,sizeof(idxelm),compar);
 
-	if (verbose) printf("Permuting the activation wave forms ...\n");
+	if (ctx->verbose) ica_message(ctx,"Permuting the activation wave forms ...\n");
 
 /* Perform in-place reordering of weights, data, bias, and signs */
 	for (i=0 ; i<m-1 ; i++) {
@@ -521,13 +564,14 @@ void pca(doublereal *data, integer m, integer n, doublereal *trsf) {
 /* Project data using trsf. Negate components and their corresponding weights */
 /* to assure positive RMS. Returns projections in proj.                       */
 /*                                                                            */
+/* ctx:  ica_context (input)                                                  */
 /* data: double array [m,n] (input)                                           */
 /* trsf: double array [m,m] (input/output)                                    */
 /* m:    integer (input)                                                      */
 /* n:    integer (input)                                                      */
 /* proj: double array [m,n] (output)                                          */
 
-void posact(doublereal *data, doublereal *trsf, integer m, integer n, doublereal *proj) {
+void posact(ica_context *ctx, doublereal *data, doublereal *trsf, integer m, integer n, doublereal *proj) {
 	char trans='N';
 	doublereal alpha = 1.0;
 	doublereal beta = 0.0;
@@ -536,7 +580,7 @@ void posact(doublereal *data, doublereal *trsf, integer m, integer n, doublereal
 	
 	dgemm_(&trans,&trans,&m,&n,&m,&alpha,trsf,&m,data,&m,&beta,proj,&m,1,1);
 
-	if (verbose) printf("Inverting negative activations: ");
+	if (ctx->verbose) ica_message(ctx,"Inverting negative activations: ");
 	for (i=0 ; i<m ; i++) {
 		posrms = 0.0; negrms = 0.0;
 		pos = 0; neg = 0;
@@ -551,25 +595,28 @@ void posact(doublereal *data, doublereal *trsf, integer m, integer n, doublereal
 			}
 
 		if (negrms*(doublereal)pos > posrms*(doublereal)neg) {
-			if (verbose) printf("-");
+			if (ctx->verbose) ica_message(ctx,"-");
 			for (j=i ; j<m*n ; j+=m) proj[j] = -proj[j];
 			for (j=i ; j<m*m ; j+=m) trsf[j] = -trsf[j];
 		}
-		if (verbose) printf("%d ",(int)(i+1));
+		if (ctx->verbose) ica_message(ctx,"%d ",(int)(i+1));
 	}
-	printf("\n");
+	if (ctx->verbose) ica_message(ctx,"\n");
 }
 
 
 /******************************* Perform infomax ******************************/
 /* Perform infomax or extended-infomax on data. If any elements of weights    */
 /* are none-zero use weights as starting weights else use identity matrix.    */
-/* If bias not NULL employ biasing. The following externally accessible       */
-/* variables are assumed initialized: extended, extblocks, pdfsize, nsub,     */
-/* verbose, block, maxsteps, lrate, annealstep, annealdeg, nochange, and      */
-/* momentum. If the boolean variable extended is set, signs must be defined   */
-/* (i.e. not NULL)                                                            */
+/* If bias not NULL employ biasing. The configuration in ctx is assumed       */
+/* complete, i.e. block, lrate and annealstep set. If ctx->extendedflag is    */
+/* set, signs must be defined (i.e. not NULL). ctx->lrate, ctx->extblocks and */
+/* ctx->pdfsize may be modified during training. Returns 1 on success, 0 if   */
+/* training failed, with ctx->error_message set.                              */
+/* Only ctx and the arrays passed are used, so that several decompositions    */
+/* can run concurrently.                                                      */
 /*                                                                            */
+/* ctx:     ica_context (input/output)                                        */
 /* data:    double array [chans,frames*epoch] (input)                         */
 /* weights: double array [chans,chans] (input/output)                         */
 /* chans:   integer (input)                                                   */
@@ -578,9 +625,9 @@ void posact(doublereal *data, doublereal *trsf, integer m, integer n, doublereal
 /* bias:    double array [chans] (output) or NULL                             */
 /* signs:   integer array [chans] (output) or NULL                            */
 
-void runica(doublereal *data, doublereal *weights, integer chans, integer frames, integer epochs, doublereal *bias, integer *signs) {
+int runica(ica_context *ctx, doublereal *data, doublereal *weights, integer chans, integer frames, integer epochs, doublereal *bias, integer *signs) {
 	doublereal alpha = 1.0, beta = 0.0, gamma = -1.0, epsilon;
-	doublereal change, oldchange, angledelta;
+	doublereal change = 0.0, oldchange = 0.0, angledelta = 0.0;
 	char uplo='U', transn='N', transt='T';
 	integer i, j, t = 0, inc = 1;
 	
@@ -603,8 +650,9 @@ void runica(doublereal *data, doublereal *weights, integer chans, integer frames
 	doublereal *tmpweights = (doublereal*)malloc(chxch*sizeof(doublereal));
 	doublereal *delta = (doublereal*)malloc(chxch*sizeof(doublereal));
 	doublereal *olddelta = (doublereal*)malloc(chxch*sizeof(doublereal));
-	doublereal *u = (doublereal*)malloc(chans*block*sizeof(doublereal));
-	doublereal *y = (doublereal*)malloc(chans*block*sizeof(doublereal));
+	doublereal *sample = (doublereal*)malloc(chans*ctx->block*sizeof(doublereal));
+	doublereal *u = (doublereal*)malloc(chans*ctx->block*sizeof(doublereal));
+	doublereal *y = (doublereal*)malloc(chans*ctx->block*sizeof(doublereal));
 	doublereal *yu = (doublereal*)malloc(chxch*sizeof(doublereal));
 	doublereal *prevweights, *prevwtchange;
 	doublereal *bsum, *kk, *old_kk;
@@ -618,7 +666,7 @@ void runica(doublereal *data, doublereal *weights, integer chans, integer frames
 	if (weights[idamax_(&chxch,weights,&inc)-1] == 0.0) eye(chans,weights);
 
 /* Allocate and initialize arrays and variables needed for momentum */
-	if (momentum > 0.0) {
+	if (ctx->momentum > 0.0) {
 		prevweights = (doublereal*)malloc(chxch*sizeof(doublereal));
 		prevwtchange = (doublereal*)malloc(chxch*sizeof(doublereal));
 		dcopy_(&chxch,weights,&inc,prevweights,&inc);
@@ -636,16 +684,16 @@ void runica(doublereal *data, doublereal *weights, integer chans, integer frames
 		bsum = NULL;
 
 /* Allocate and initialize arrays and variables needed for extended-ICA */
-	if (extendedflag) {
+	if (ctx->extendedflag) {
 		oldsigns = (integer*)malloc(chans*sizeof(integer));
 		for (i=0 ; i<chans ; i++) oldsigns[i] = -1;
-		for (i=0 ; i<nsub ; i++) signs[i] = 1;
-		for (i=nsub ; i<chans ; i++) signs[i] = 0;
+		for (i=0 ; i<ctx->nsub ; i++) signs[i] = 1;
+		for (i=ctx->nsub ; i<chans ; i++) signs[i] = 0;
 		
-		if (pdfsize < datalength)
+		if (ctx->pdfsize < datalength)
 			pdfperm = (integer*)malloc(datalength*sizeof(integer));
 		else {
-			pdfsize = datalength;
+			ctx->pdfsize = datalength;
 			pdfperm = NULL;
 		}
 		
@@ -657,82 +705,85 @@ void runica(doublereal *data, doublereal *weights, integer chans, integer frames
 		old_kk = (doublereal*)malloc(chans*sizeof(doublereal));
 		zero(chans,old_kk);
 
-		if (extblocks<0 && verbose) {
-			printf("Fixed extended-ICA sign assignments:  ");
-			for (i=0 ; i<chans ; i++) printf("%d ",(int)(signs[i]));
-			printf("\n");
+		if (ctx->extblocks<0 && ctx->verbose) {
+			ica_message(ctx,"Fixed extended-ICA sign assignments:  ");
+			for (i=0 ; i<chans ; i++) ica_message(ctx,"%d ",(int)(signs[i]));
+			ica_message(ctx,"\n");
 		}
 	}
 	else {
 		oldsigns = pdfperm = NULL;
 		old_kk = kk = NULL;
 	}
-	urextblocks = extblocks;
+	urextblocks = ctx->extblocks;
 
 /*************************** Initialize ICA training **************************/
 
+	ctx->error_message = NULL;
+	ctx->steps = 0;
+
 	dcopy_(&chxch,weights,&inc,startweights,&inc);
 	dcopy_(&chxch,weights,&inc,oldweights,&inc);
 	
-	if (verbose) {
-		printf("Beginning ICA training ...");
-		if (extendedflag) printf(" first training step may be slow ...\n");
-		else printf("\n");
+	if (ctx->verbose) {
+		ica_message(ctx,"Beginning ICA training ...");
+		if (ctx->extendedflag) ica_message(ctx," first training step may be slow ...\n");
+		else ica_message(ctx,"\n");
 	}
 
 #ifdef FIX_SEED	
-	SRAND(1);
+	SRAND(ctx,1);
 #else
-	SRAND((int)time(NULL));
+	SRAND(ctx,ctx->seed ? (int)ctx->seed : (int)time(NULL));
 #endif
 
-	while (step < maxsteps) {
+	while (step < ctx->maxsteps) {
 
 #ifndef PROB_WINDOW
 		initperm(dataperm,datalength);
 #endif
 
 /***************************** ICA training block *****************************/
-		for (t=0 ; t<datalength-block && !wts_blowup ; t+=block) {
+		for (t=0 ; t<datalength-ctx->block && !wts_blowup ; t+=ctx->block) {
 
 #ifdef PROB_WINDOW
-			probperm(data,weights,bias,chans,block,frames,epochs,u);
+			probperm(ctx,data,weights,bias,chans,ctx->block,frames,epochs,sample,u);
 #else
-			randperm(data,weights,bias,dataperm,chans,block,datalength-t,u);
+			randperm(ctx,data,weights,bias,dataperm,chans,ctx->block,datalength-t,sample,u);
 #endif
 
-			if (!extendedflag) {
+			if (!ctx->extendedflag) {
 /************************* Logistic ICA weight update *************************/
-				for (i=0 ; i<chans*block ; i++)
+				for (i=0 ; i<chans*ctx->block ; i++)
 /*					y[i] = 1.0 - 2.0 / (1.0+exp(-u[i]));*/
 					y[i] = -tanh(u[i]/2.0);
 
 /*Bias sum for logistic ICA */
 				if (bias)
 					for (i=0 ; i<chans ; i++)
-						bsum[i] = dsum_(&block,&y[i],&chans);
+						bsum[i] = dsum_(&ctx->block,&y[i],&chans);
 
 /* Compute: (1-2*y) * u' */
-				dgemm_(&transn,&transt,&chans,&chans,&block,&alpha,y,&chans,u,&chans,&beta,yu,&chans,1,1);
+				dgemm_(&transn,&transt,&chans,&chans,&ctx->block,&alpha,y,&chans,u,&chans,&beta,yu,&chans,1,1);
 			}
 			else {
 /************************* Extended-ICA weight update *************************/
-				for (i=0 ; i<chans*block ; i++)
+				for (i=0 ; i<chans*ctx->block ; i++)
 					y[i] = tanh(u[i]);
 
 /* Bias sum for extended-ICA */
 				if (bias)
 					for (i=0 ; i<chans ; i++)
-						bsum[i] = -2*dsum_(&block,&y[i],&chans);
+						bsum[i] = -2*dsum_(&ctx->block,&y[i],&chans);
 
 /* Apply sign matrix */
 				for (i=0 ; i<chans ; i++)
 					if (signs[i])
-						for (j=i ; j<block*chans ; j+=chans)
+						for (j=i ; j<ctx->block*chans ; j+=chans)
 							y[j] = -y[j];
 
 /* Compute: u * u' */
-				dsyrk_(&uplo,&transn,&chans,&block,&alpha,u,&chans,&beta,yu,&chans,1,1);
+				dsyrk_(&uplo,&transn,&chans,&ctx->block,&alpha,u,&chans,&beta,yu,&chans,1,1);
 
 				j = chxch - 2;
 				for (i=1 ; i<chans ; i++) {
@@ -741,40 +792,41 @@ void runica(doublereal *data, doublereal *weights, integer chans, integer frames
 				}
 
 /* Compute: -y * u' -u*u' */
-				dgemm_(&transn,&transt,&chans,&chans,&block,&gamma,y,&chans,u,&chans,&gamma,yu,&chans,1,1);
+				dgemm_(&transn,&transt,&chans,&chans,&ctx->block,&gamma,y,&chans,u,&chans,&gamma,yu,&chans,1,1);
 			}
 			
 /* Add block identity matix */
 			for (i=0 ; i<chxch ; i+=(chans+1))
-				yu[i] += (doublereal)block;
+				yu[i] += (doublereal)ctx->block;
 
 /* Apply weight change */
 			dcopy_(&chxch,weights,&inc,tmpweights,&inc);
-			dgemm_(&transn,&transn,&chans,&chans,&chans,&lrate,yu,&chans,tmpweights,&chans,&alpha,weights,&chans,1,1);
+			dgemm_(&transn,&transn,&chans,&chans,&chans,&ctx->lrate,yu,&chans,tmpweights,&chans,&alpha,weights,&chans,1,1);
 
 /* Apply bias change */
-			if (bias) daxpy_(&chans,&lrate,bsum,&inc,bias,&inc);
+			if (bias) daxpy_(&chans,&ctx->lrate,bsum,&inc,bias,&inc);
 			
 /******************************** Add momentum ********************************/
-			if (momentum > 0.0) {
-				daxpy_(&chxch,&momentum,prevwtchange,&inc,weights,&inc);
+			if (ctx->momentum > 0.0) {
+				daxpy_(&chxch,&ctx->momentum,prevwtchange,&inc,weights,&inc);
 				for (i=0 ; i<chxch ; i++)
 					prevwtchange[i] = weights[i] - prevweights[i];
 
 				dcopy_(&chxch,weights,&inc,prevweights,&inc);
 			}
 			
-			if (abs(weights[idamax_(&chxch,weights,&inc)-1]) > MAX_WEIGHT)
+			/* Also catches NaN */
+			if (!(fabs(weights[idamax_(&chxch,weights,&inc)-1]) <= MAX_WEIGHT))
 				wts_blowup = 1;
 
-			if (extendedflag && !wts_blowup && extblocks>0 && blockno%extblocks==0) {
-				if (pdfperm && pleft < pdfsize) {
+			if (ctx->extendedflag && !wts_blowup && ctx->extblocks>0 && blockno%ctx->extblocks==0) {
+				if (pdfperm && pleft < ctx->pdfsize) {
 					initperm(pdfperm,datalength);
 					pleft = datalength;
 				}
 				
-				pdf(data,weights,pdfperm,chans,pdfsize,pleft,kk);
-				pleft -= pdfsize;
+				pdf(ctx,data,weights,pdfperm,chans,ctx->pdfsize,pleft,kk);
+				pleft -= ctx->pdfsize;
 				
 				if (extmomentum > 0.0) {
 					epsilon = 1.0-extmomentum;
@@ -794,7 +846,7 @@ void runica(doublereal *data, doublereal *weights, integer chans, integer frames
 					oldsigns[i] = signs[i];
 								
 				if (signcount >= SIGNCOUNT_THRESHOLD) {
-					extblocks = (integer)(extblocks * SIGNCOUNT_STEP);
+					ctx->extblocks = (integer)(ctx->extblocks * SIGNCOUNT_STEP);
 					signcount = 0;
 				}
 			}
@@ -803,6 +855,7 @@ void runica(doublereal *data, doublereal *weights, integer chans, integer frames
 
 		if (!wts_blowup) {
 			step++;
+			ctx->steps++;
 			angledelta = 0.0;
 			
 			for (i=0 ; i<chxch ; i++)
@@ -813,35 +866,38 @@ void runica(doublereal *data, doublereal *weights, integer chans, integer frames
 		
 /************************* Restart if weights blow up *************************/
 		if (wts_blowup) {
-			printf("\a");
 			step = 0;
-			change = nochange;
+			ctx->steps = 0;
+			change = ctx->nochange;
 			wts_blowup = 0;
 			blockno = 1;
-			extblocks = urextblocks;
-			lrate = lrate*DEFAULT_RESTART_FAC;
+			ctx->extblocks = urextblocks;
+			ctx->lrate = ctx->lrate*DEFAULT_RESTART_FAC;
 			dcopy_(&chxch,startweights,&inc,weights,&inc);
 			zero(chxch,delta);
 			zero(chxch,olddelta);
 
 			if (bias) zero(chans,bias);
 			
-			if (momentum > 0.0) {
+			if (ctx->momentum > 0.0) {
 				dcopy_(&chxch,startweights,&inc,oldweights,&inc);
 				dcopy_(&chxch,startweights,&inc,prevweights,&inc);
 				zero(chxch,prevwtchange);
 			}
 						
-			if (extendedflag) {
+			if (ctx->extendedflag) {
 				for (i=0 ; i<chans ; i++) oldsigns[i] = -1;
-				for (i=0 ; i<nsub ; i++) signs[i] = 1;
-				for (i=nsub ; i<chans ; i++) signs[i] = 0;
+				for (i=0 ; i<ctx->nsub ; i++) signs[i] = 1;
+				for (i=ctx->nsub ; i<chans ; i++) signs[i] = 0;
 			}
 			
-			if (lrate > MIN_LRATE)
-				printf("Lowering learning rate to %g and starting again.\n",lrate);
-			else
-				error("QUITTING - weight matrix may not be invertible!\n");
+			if (ctx->lrate > MIN_LRATE) {
+				if (ctx->verbose) ica_message(ctx,"Lowering learning rate to %g and starting again.\n",ctx->lrate);
+			}
+			else {
+				ctx->error_message = "QUITTING - weight matrix may not be invertible!";
+				break;
+			}
 		}
 		else {
 /*********************** Print weight update information **********************/
@@ -849,22 +905,22 @@ void runica(doublereal *data, doublereal *weights, integer chans, integer frames
 				epsilon = ddot_(&chxch,delta,&inc,olddelta,&inc);
 				angledelta = acos(epsilon/sqrt(change*oldchange));
 
-				if (verbose) {
-					if (!extendedflag)
-						printf("step %d - lrate %5f, wchange %7.6f, angledelta %4.1f deg\n",step,lrate,change,DEGCONST*angledelta);
+				if (ctx->verbose) {
+					if (!ctx->extendedflag)
+						ica_message(ctx,"step %d - lrate %5f, wchange %7.6f, angledelta %4.1f deg\n",(int)step,ctx->lrate,change,DEGCONST*angledelta);
 					else {
 						for (i=0,j=0 ; i<chans ; i++) j += signs[i];
-						printf("step %d - lrate %5f, wchange %7.6f, angledelta %4.1f deg, %d subgauss\n",step,lrate,change,DEGCONST*angledelta,j);
+						ica_message(ctx,"step %d - lrate %5f, wchange %7.6f, angledelta %4.1f deg, %d subgauss\n",(int)step,ctx->lrate,change,DEGCONST*angledelta,(int)j);
 					}
 				}
 			}
 			else
-				if (verbose) {
-					if (!extendedflag)
-						printf("step %d - lrate %5f, wchange %7.6f\n",step,lrate,change);
+				if (ctx->verbose) {
+					if (!ctx->extendedflag)
+						ica_message(ctx,"step %d - lrate %5f, wchange %7.6f\n",(int)step,ctx->lrate,change);
 					else {
 						for (i=0,j=0 ; i<chans ; i++) j += signs[i];
-						printf("step %d - lrate %5f, wchange %7.6f, %d subgauss\n",step,lrate,change,j);
+						ica_message(ctx,"step %d - lrate %5f, wchange %7.6f, %d subgauss\n",(int)step,ctx->lrate,change,(int)j);
 					}
 				}
 		}
@@ -872,9 +928,9 @@ void runica(doublereal *data, doublereal *weights, integer chans, integer frames
 /**************************** Save current values *****************************/
 		dcopy_(&chxch,weights,&inc,oldweights,&inc);
 		
-		if (DEGCONST*angledelta > annealdeg) {
+		if (DEGCONST*angledelta > ctx->annealdeg) {
 			dcopy_(&chxch,delta,&inc,olddelta,&inc);
-			lrate = lrate*annealstep;
+			ctx->lrate = ctx->lrate*ctx->annealstep;
 			oldchange = change;
 		}
 		else
@@ -883,11 +939,11 @@ void runica(doublereal *data, doublereal *weights, integer chans, integer frames
 				oldchange = change;
 			}
 
-		if (step > 2 && change < nochange)
-			step = maxsteps;
+		if (step > 2 && change < ctx->nochange)
+			step = ctx->maxsteps;
 		else
 			if (change > DEFAULT_BLOWUP)
-				lrate = lrate*DEFAULT_BLOWUP_FAC;
+				ctx->lrate = ctx->lrate*DEFAULT_BLOWUP_FAC;
 	}
 
 	if (bsum) free(bsum);
@@ -904,10 +960,14 @@ void runica(doublereal *data, doublereal *weights, integer chans, integer frames
 	if (yu) free(yu);
 	if (y) free(y);
 	if (u) free(u);
+	if (sample) free(sample);
 	if (pdfperm) free(pdfperm);
 
 #ifndef PROB_WINDOW
 	if (dataperm) free(dataperm);
 #endif
+
+	ctx->change = change;
+	return ctx->error_message == NULL;
 }
 
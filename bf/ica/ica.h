@@ -14,19 +14,8 @@
 #define __defs_h
 
 #include "f2c.h"
+#include "r250.h"
 
-#ifdef FOR_AVG_Q
-#define complex bf_complex
-#include <bf.h>
-#undef complex
-extern transform_info_ptr tinfo_for_ica;
-extern void ica_printf(const char *format, ...);
-#define printf ica_printf
-#define error ica_error
-#define verbose 1
-#else
-extern integer verbose;
-#endif
 /* This is for log and sqrt, used in DEFAULT_LRATE and DEFAULT_BLOCK */
 #include <math.h>
 
@@ -108,11 +97,11 @@ extern integer verbose;
 /* #define FIX_SEED */
 
 #ifdef R250
-#define SRAND(seed) r250_init(seed)
-#define RAND        r250
+#define SRAND(ctx,seed) r250_init_r(&(ctx)->random,seed)
+#define RAND(ctx)        r250_r(&(ctx)->random)
 #else
-#define SRAND(seed) srand(seed)
-#define RAND        rand
+#define SRAND(ctx,seed) ((ctx)->random_seed=(seed))
+#define RAND(ctx)        rand_r(&(ctx)->random_seed)
 #endif
 
 typedef struct {
@@ -125,12 +114,37 @@ typedef struct {
     void *prev;
 } key;
 
-extern integer extendedflag, extblocks, pdfsize, nsub;
-extern integer block, maxsteps;
-
-extern doublereal lrate, annealstep, annealdeg, nochange, momentum;
+/* All configuration and state of one decomposition, so that several
+ * decompositions can run concurrently in different threads.
+ * ica_init_context() sets the configuration to its defaults. */
+typedef struct ica_context {
+    /* Configuration */
+    integer extendedflag, extblocks, pdfsize, nsub;
+    integer block, maxsteps, verbose;
+    doublereal lrate, annealstep, annealdeg, nochange, momentum;
+    /* Seed for the random permutations; 0 seeds from the clock */
+    unsigned int seed;
+    /* Output of progress messages (if verbose), NULL for stdout;
+     * message_data is free for use by the caller */
+    void (*message)(struct ica_context *ctx, const char *text);
+    void *message_data;
+
+    /* Results of runica */
+    integer steps;
+    doublereal change;
+    /* Set if runica failed, otherwise NULL */
+    const char *error_message;
+
+    /* Random number generator state */
+#ifdef R250
+    struct r250_state random;
+#else
+    unsigned int random_seed;
+#endif
+} ica_context;
 
-extern void error(char*);
+extern void ica_init_context(ica_context *ctx);
+extern void ica_message(ica_context *ctx, const char *format, ...);
 
 extern void zero(integer, doublereal*);
 extern void eye(integer, doublereal*);
@@ -138,15 +152,15 @@ extern void rmmean(doublereal*, integer, integer);
 extern void syproj(doublereal*, doublereal*, integer, integer, doublereal*);
 extern void geproj(doublereal*, doublereal*, integer, integer, doublereal*);
 extern void pcaproj(doublereal*, doublereal*, integer, integer, integer, doublereal*);
-extern void varsort(doublereal*, doublereal*, doublereal*, doublereal*, doublereal*, integer*, integer, integer, integer);
+extern void varsort(ica_context*, doublereal*, doublereal*, doublereal*, doublereal*, doublereal*, integer*, integer, integer, integer);
 extern void do_sphere(doublereal*, integer, integer, doublereal*);
 extern void pca(doublereal*, integer, integer, doublereal*);
-extern void posact(doublereal*, doublereal*, integer, integer, doublereal*);
-extern void runica(doublereal*, doublereal*, integer, integer, integer, doublereal*, integer*);
+extern void posact(ica_context*, doublereal*, doublereal*, integer, integer, doublereal*);
+extern int runica(ica_context*, doublereal*, doublereal*, integer, integer, integer, doublereal*, integer*);
 extern void initperm(integer *perm, integer n);
-extern void randperm(doublereal *data, doublereal *trsf, doublereal *bias, integer *perm, integer m, integer n, integer k, doublereal *proj);
-extern void probperm(doublereal *data, doublereal *trsf, doublereal *bias, integer m, integer n, integer frames, integer epochs, doublereal *proj);
-extern void pdf(doublereal *data, doublereal *trsf, integer *perm, integer m, integer n, integer k, doublereal *kk);
+extern void randperm(ica_context *ctx, doublereal *data, doublereal *trsf, doublereal *bias, integer *perm, integer m, integer n, integer k, doublereal *sample, doublereal *proj);
+extern void probperm(ica_context *ctx, doublereal *data, doublereal *trsf, doublereal *bias, integer m, integer n, integer frames, integer epochs, doublereal *sample, doublereal *proj);
+extern void pdf(ica_context *ctx, doublereal *data, doublereal *trsf, integer *perm, integer m, integer n, integer k, doublereal *kk);
 extern int compar(const void *x, const void *y);
 
 /* Local */
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1999-2001,2004,2008 Bernd Feige
+ * Copyright (C) 1999-2001,2004,2008,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -13,76 +13,33 @@
  * adjacent `points'. The activations can be calculated using the `project' 
  * method (with option -n).
  * 						-- Bernd Feige 14.03.1999
+ * The ICA code keeps its configuration and state in an ica_context now, so
+ * that option -r can run several decompositions with different random
+ * sequences concurrently. Since Infomax may end up in different local optima,
+ * the solution most similar to the others is kept.
+ * 						-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
 /*{{{  #includes*/
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include "ica.h"
+/* f2c.h has its own complex type */
+#define complex bf_complex
 #include "transform.h"
+#include "bf.h"
+#undef complex
 #include "growing_buf.h"
 /*}}}  */
 
-GLOBAL transform_info_ptr tinfo_for_ica;
-/* vvvvvvvv This segment is from interfc.c */
-/* Globally defined variables */
-integer pcaflag, sphering, posactflag, biasflag;
-
-
-/**************************** Initialize variables ****************************/
-/* Initialize global and external variables to their default values as        */
-/* defined in ica.h                                                           */
-
-LOCAL void 
-initdefaults (void) {
-	pcaflag    = DEFAULT_PCAFLAG;
-	sphering   = DEFAULT_SPHEREFLAG;
-	posactflag = DEFAULT_POSACT;
-	biasflag   = DEFAULT_BIASFLAG;
-	
-	block      = 0;
-	lrate      = 0.0;
-	annealdeg  = DEFAULT_ANNEALDEG;
-	annealstep = 0.0;
-	nochange   = DEFAULT_STOP;
-	momentum   = DEFAULT_MOMENTUM;
-	maxsteps   = DEFAULT_MAXSTEPS;
-	
-	extendedflag   = DEFAULT_EXTENDED;
-	extblocks  = DEFAULT_EXTBLOCKS;
- 	pdfsize    = MAX_PDFSIZE;
-	nsub       = DEFAULT_NSUB;
-}
-/* ^^^^^^^^ This segment is from interfc.c */
-
-#include <stdarg.h>
-GLOBAL void 
-ica_printf(const char *format, ...) {
-#define BUFFER_SIZE 128
- char buffer[BUFFER_SIZE], *inbuf;
- va_list ap;
- va_start(ap, format);
- vsnprintf(buffer, BUFFER_SIZE, format, ap);
- va_end(ap);
- inbuf=buffer;
- while (*inbuf!='\0') {
-  if (*inbuf=='') *inbuf=' ';
-  inbuf++;
- }
- TRACEMS(tinfo_for_ica->emethods, -2, buffer);
-}
-GLOBAL void 
-ica_error(char *message) {
- char buffer[BUFFER_SIZE];
- snprintf(buffer, BUFFER_SIZE, "%s\n", message);
- ERREXIT(tinfo_for_ica->emethods, buffer);
-#undef BUFFER_SIZE
-}
-
 enum ARGS_ENUM {
  ARGS_EXTENDED=0, 
  ARGS_LRATE, 
+ ARGS_RESTARTS,
+ ARGS_SEED,
  ARGS_SPHEREFILE, 
  ARGS_NCOMPONENTS, 
  NR_OF_ARGUMENTS
@@ -90,31 +47,136 @@ enum ARGS_ENUM {
 LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_LONG, "n: Perform an `extended ICA' with PDF estimation every n blocks", "e", 1, NULL},
  {T_ARGS_TAKES_DOUBLE, "lrate: Specify the initial learning rate (0<lrate<<1, ~1e-4)", "l", 0.0001, NULL},
+ {T_ARGS_TAKES_LONG, "nr_of_restarts: Run this many decompositions in parallel and keep the most stable one", "r", 4, NULL},
+ {T_ARGS_TAKES_LONG, "seed: Seed the random sequence for reproducible results", "S", 1, NULL},
  {T_ARGS_TAKES_FILENAME, "sphere_file: Sphere the data and output the sphering matrix to this file", "s", ARGDESC_UNUSED, (char const *const *)"*.asc"},
  {T_ARGS_TAKES_LONG, "n_components", "", 3, NULL}
 };
 
+struct icadecomp_storage {
+ /* The configuration for runica; each epoch and restart works on a copy */
+ ica_context ica;
+ int nr_of_restarts;
+ /* vvvvvvvv These flags are from interfc.c */
+ integer pcaflag, sphering, posactflag, biasflag;
+};
+
+/*{{{  icadecomp_message(ica_context *ctx, const char *text) {*/
+/* Output of the ICA progress messages; message_data is our tinfo */
+LOCAL void
+icadecomp_message(ica_context *ctx, const char *text) {
+ transform_info_ptr tinfo=(transform_info_ptr)ctx->message_data;
+ /* Restarts running in parallel must not mix their output */
+#ifdef _OPENMP
+#pragma omp critical (icadecomp_message)
+#endif
+ TRACEMS(tinfo->emethods, -2, text);
+}
+/*}}}  */
+
+/*{{{  most_stable_restart(doublereal *cov, doublereal **weights, int nr_of_restarts, integer ncomps, double *stability) {*/
+/* The similarity of two components is the absolute correlation of their
+ * activations, |w1 C w2'|/sqrt(w1 C w1' * w2 C w2'), C being the covariance
+ * matrix of the data that the ncomps x ncomps weights apply to. The
+ * stability of a restart is the similarity of each of its components to the
+ * best-matching component of another restart, averaged across components
+ * and the other restarts. Failed restarts have weights[restart]==NULL.
+ * Returns the restart with the highest stability or -1 if all failed. */
+LOCAL int
+most_stable_restart(doublereal *cov, doublereal **weights, int nr_of_restarts, integer ncomps, double *stability) {
+ integer const nxn=ncomps*ncomps;
+ doublereal alpha=1.0, beta=0.0;
+ char side='R', uplo='U', transn='N', transt='T';
+ doublereal *wc=(doublereal *)malloc(nr_of_restarts*nxn*sizeof(doublereal));
+ doublereal *var=(doublereal *)malloc(nr_of_restarts*ncomps*sizeof(doublereal));
+ doublereal *cross=(doublereal *)malloc(nxn*sizeof(doublereal));
+ int a, b, best= -1;
+ integer i, j;
+
+ if (wc==NULL || var==NULL || cross==NULL) {
+  free(cross); free(var); free(wc);
+  return -1;
+ }
+ /* wc=W*C; the activation variances are the diagonal of W*C*W' */
+ for (a=0; a<nr_of_restarts; a++) {
+  if (weights[a]==NULL) continue;
+  dsymm_(&side,&uplo,&ncomps,&ncomps,&alpha,cov,&ncomps,weights[a],&ncomps,&beta,wc+a*nxn,&ncomps,1,1);
+  for (i=0; i<ncomps; i++) {
+   doublereal sum=0.0;
+   for (j=0; j<ncomps; j++) sum+=wc[a*nxn+i+j*ncomps]*weights[a][i+j*ncomps];
+   var[a*ncomps+i]=sum;
+  }
+ }
+ for (a=0; a<nr_of_restarts; a++) {
+  double sum=0.0;
+  int n=0;
+  stability[a]=0.0;
+  if (weights[a]==NULL) continue;
+  for (b=0; b<nr_of_restarts; b++) {
+   if (b==a || weights[b]==NULL) continue;
+   /* cross[i+j*ncomps] is the covariance of component i of a with component j of b */
+   dgemm_(&transn,&transt,&ncomps,&ncomps,&ncomps,&alpha,wc+a*nxn,&ncomps,weights[b],&ncomps,&beta,cross,&ncomps,1,1);
+   for (i=0; i<ncomps; i++) {
+    doublereal maxcorr=0.0;
+    for (j=0; j<ncomps; j++) {
+     doublereal const corr=fabs(cross[i+j*ncomps])/sqrt(var[a*ncomps+i]*var[b*ncomps+j]);
+     if (corr>maxcorr) maxcorr=corr;
+    }
+    sum+=maxcorr;
+   }
+   n++;
+  }
+  /* A single successful restart is trivially the most stable one */
+  stability[a]=(n>0 ? sum/(n*ncomps) : 1.0);
+  if (best<0 || stability[a]>stability[best]) best=a;
+ }
+ free(cross); free(var); free(wc);
+ return best;
+}
+/*}}}  */
+
 /*{{{  icadecomp_init(transform_info_ptr tinfo) {*/
 METHODDEF void
 icadecomp_init(transform_info_ptr tinfo) {
+ struct icadecomp_storage *local_arg=(struct icadecomp_storage *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
- initdefaults();
- extblocks=extendedflag=0;
+ ica_context *ica= &local_arg->ica;
+
+ ica_init_context(ica);
+ ica->message= &icadecomp_message;
+ ica->message_data=tinfo;
+ local_arg->pcaflag   =DEFAULT_PCAFLAG;
+ local_arg->posactflag=DEFAULT_POSACT;
+ local_arg->biasflag  =DEFAULT_BIASFLAG;
+ ica->extblocks=ica->extendedflag=0;
  if (args[ARGS_EXTENDED].is_set && args[ARGS_EXTENDED].arg.i!=0) {
-  extendedflag=1;
-  extblocks=args[ARGS_EXTENDED].arg.i;
+  ica->extendedflag=1;
+  ica->extblocks=args[ARGS_EXTENDED].arg.i;
  }
  if (args[ARGS_SPHEREFILE].is_set) {
-  sphering=1;
+  local_arg->sphering=1;
  } else {
-  sphering=0;
+  local_arg->sphering=0;
  }
  if (args[ARGS_LRATE].is_set) {
-  lrate = args[ARGS_LRATE].arg.d;
-  if (lrate<=0 || lrate>=1) {
+  ica->lrate = args[ARGS_LRATE].arg.d;
+  if (ica->lrate<=0 || ica->lrate>=1) {
    ERREXIT(tinfo->emethods, "icadecomp_init: lrate needs to be between 0 and 1.\n");
   }
  }
+ local_arg->nr_of_restarts=1;
+ if (args[ARGS_RESTARTS].is_set) {
+  local_arg->nr_of_restarts=args[ARGS_RESTARTS].arg.i;
+  if (local_arg->nr_of_restarts<1) {
+   ERREXIT(tinfo->emethods, "icadecomp_init: nr_of_restarts must be at least 1.\n");
+  }
+ }
+ if (args[ARGS_SEED].is_set) {
+  ica->seed=(unsigned int)args[ARGS_SEED].arg.i;
+  if (ica->seed==0) {
+   ERREXIT(tinfo->emethods, "icadecomp_init: The seed must not be 0.\n");
+  }
+ }
  tinfo->methods->init_done=TRUE;
 }
 /*}}}  */
@@ -122,7 +184,10 @@ icadecomp_init(transform_info_ptr tinfo) {
 /*{{{  icadecomp(transform_info_ptr tinfo) {*/
 METHODDEF DATATYPE *
 icadecomp(transform_info_ptr tinfo) {
+ struct icadecomp_storage *local_arg=(struct icadecomp_storage *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
+ ica_context ica=local_arg->ica;
+ integer pcaflag=local_arg->pcaflag, sphering=local_arg->sphering;
  array myarray, maps;
  doublereal *in_doubledata;
 
@@ -138,8 +203,6 @@ icadecomp(transform_info_ptr tinfo) {
   ERREXIT(tinfo->emethods, "icadecomp: Currently, only itemsize==1 is supported.\n");
  }
 
- tinfo_for_ica=tinfo;
-
  ncomps=args[ARGS_NCOMPONENTS].arg.i;
  /* Allow negative entries to mean a dimensionality reduction by this many dims */
  if (ncomps<0) ncomps+=tinfo->nr_of_channels;
@@ -155,58 +218,58 @@ icadecomp(transform_info_ptr tinfo) {
  }
 
  /* vvvvvvvv This segment is from interfc.c */
-	if (chans < 2) error("invalid number of channels");
-	if (frames < 3) error("invalid data length");
+	if (chans < 2) ERREXIT(tinfo->emethods, "icadecomp: invalid number of channels\n");
+	if (frames < 3) ERREXIT(tinfo->emethods, "icadecomp: invalid data length\n");
 
-	if (lrate == 0.0) lrate = DEFAULT_LRATE(chans);
-	if (block == 0) block = DEFAULT_BLOCK(frames);
+	if (ica.lrate == 0.0) ica.lrate = DEFAULT_LRATE(chans);
+	if (ica.block == 0) ica.block = DEFAULT_BLOCK(frames);
 	if (ncomps == 0) ncomps = chans;
 
-	if (ncomps > chans || ncomps < 1) error("invalid number of components");
-	if (frames < chans) error("data length less than data channels");
-	if (block < 2) error("block size too small!");
-	if (block > frames) error("block size exceeds data length!");
-	if (nsub > ncomps) error("sub-Gaussian components exceeds total number of components!");
+	if (ncomps > chans || ncomps < 1) ERREXIT(tinfo->emethods, "icadecomp: invalid number of components\n");
+	if (frames < chans) ERREXIT(tinfo->emethods, "icadecomp: data length less than data channels\n");
+	if (ica.block < 2) ERREXIT(tinfo->emethods, "icadecomp: block size too small!\n");
+	if (ica.block > frames) ERREXIT(tinfo->emethods, "icadecomp: block size exceeds data length!\n");
+	if (ica.nsub > ncomps) ERREXIT(tinfo->emethods, "icadecomp: sub-Gaussian components exceeds total number of components!\n");
 
-	if (annealstep == 0.0)
-		annealstep = (extendedflag) ? DEFAULT_EXTANNEAL : DEFAULT_ANNEALSTEP;
+	if (ica.annealstep == 0.0)
+		ica.annealstep = (ica.extendedflag) ? DEFAULT_EXTANNEAL : DEFAULT_ANNEALSTEP;
 
-	if (extendedflag && extblocks>0) {
- 		pdfsize = MIN(pdfsize,frames);
- 		if (pdfsize < MIN_PDFSIZE)
-			printf("warning, PDF values are inexact\n");
+	if (ica.extendedflag && ica.extblocks>0) {
+ 		ica.pdfsize = MIN(ica.pdfsize,frames);
+ 		if (ica.pdfsize < MIN_PDFSIZE)
+			ica_message(&ica,"warning, PDF values are inexact\n");
 	}
 
-	if (verbose) {
-		printf("\nICA %s\n",VER_INFO);
-		printf("\nInput data size [%d,%d] = %d channels, %d frames.\n",chans,frames,chans,frames);
+	if (ica.verbose) {
+		ica_message(&ica,"\nICA %s\n",VER_INFO);
+		ica_message(&ica,"\nInput data size [%d,%d] = %d channels, %d frames.\n",chans,frames,chans,frames);
 
-		if (pcaflag) printf("After PCA dimension reduction,\n  finding ");
-		else printf("Finding ");
+		if (pcaflag) ica_message(&ica,"After PCA dimension reduction,\n  finding ");
+		else ica_message(&ica,"Finding ");
 	
-		if (!extendedflag)
-			printf("%d ICA components using logistic ICA.\n",ncomps);
+		if (!ica.extendedflag)
+			ica_message(&ica,"%d ICA components using logistic ICA.\n",ncomps);
 		else {
-			printf("%d ICA components using extendedflag ICA.\n",ncomps);
+			ica_message(&ica,"%d ICA components using extendedflag ICA.\n",ncomps);
 			
-			if (extblocks > 0)
- 				printf("PDF will be calculated initially every %d blocks using %d data points.\n",extblocks,pdfsize);
+			if (ica.extblocks > 0)
+ 				ica_message(&ica,"PDF will be calculated initially every %d blocks using %d data points.\n",(int)ica.extblocks,(int)ica.pdfsize);
 			else
- 				printf("PDF will not be calculated. Exactly %d sub-Gaussian components assumed.\n",nsub);
+ 				ica_message(&ica,"PDF will not be calculated. Exactly %d sub-Gaussian components assumed.\n",(int)ica.nsub);
 		}
 		
-		printf("Initial learning rate will be %g, block size %d.\n",lrate,block);
+		ica_message(&ica,"Initial learning rate will be %g, block size %d.\n",ica.lrate,(int)ica.block);
 		
-		if (momentum > 0.0)
-			printf("Momentum will be %g.\n",momentum);
+		if (ica.momentum > 0.0)
+			ica_message(&ica,"Momentum will be %g.\n",ica.momentum);
 			
-		printf("Learning rate will be multiplied by %g whenever angledelta >= %g deg.\n",annealstep,annealdeg);
-		printf("Training will end when wchange < %g or after %d steps.\n",nochange,maxsteps);
+		ica_message(&ica,"Learning rate will be multiplied by %g whenever angledelta >= %g deg.\n",ica.annealstep,ica.annealdeg);
+		ica_message(&ica,"Training will end when wchange < %g or after %d steps.\n",ica.nochange,(int)ica.maxsteps);
 		
-		if (biasflag)
-			printf("Online bias adjustment will be used.\n");
+		if (local_arg->biasflag)
+			ica_message(&ica,"Online bias adjustment will be used.\n");
 		else
-			printf("Online bias adjustment will not be used.\n");
+			ica_message(&ica,"Online bias adjustment will not be used.\n");
 	}
 
 	dataA = (doublereal*)malloc(chans*frames*sizeof(doublereal));
@@ -223,7 +286,7 @@ icadecomp(transform_info_ptr tinfo) {
 	weights = (doublereal*)malloc(ncomps*chans*sizeof(doublereal));
 #if 0
 	if (weights_in_f!=NULL) {
-		if (verbose) printf("Loading weights from %s\n",weights_in_f);
+		if (ica.verbose) ica_message(&ica,"Loading weights from %s\n",weights_in_f);
 		fb_matread(weights_in_f,ncomps*ncomps,weights);
 	}
 	else
@@ -232,25 +295,25 @@ icadecomp(transform_info_ptr tinfo) {
 
 	sphere = (doublereal*)malloc(chans*chans*sizeof(doublereal));
 
-	if (biasflag)
+	if (local_arg->biasflag)
 		bias = (doublereal*)malloc(ncomps*sizeof(doublereal));
 	else
 		bias = NULL;
 	
-	if (extendedflag)
+	if (ica.extendedflag)
 		signs = (integer*)malloc(ncomps*sizeof(integer));
 	else
 		signs = NULL;
 
 
 /************************** Remove overall row means **************************/
-	if (verbose) printf("Removing mean of each channel ...\n");
+	if (ica.verbose) ica_message(&ica,"Removing mean of each channel ...\n");
 	rmmean(dataA,(integer)chans,(integer)frames);
 
 
 /**************************** Perform PCA reduction ***************************/
 	if (pcaflag) {
-		if (verbose) printf("Reducing the data to %d principal dimensions...\n",ncomps);
+		if (ica.verbose) ica_message(&ica,"Reducing the data to %d principal dimensions...\n",ncomps);
 
 		eigv = (doublereal*)malloc(chans*chans*sizeof(doublereal));
 		pca(dataA,(integer)chans,(integer)frames,eigv);
@@ -271,10 +334,10 @@ icadecomp(transform_info_ptr tinfo) {
 	
 /**************************** Apply sphering matrix ***************************/
 	if (sphering == 1) {
-		if (verbose) printf("Computing the sphering matrix...\n");
+		if (ica.verbose) ica_message(&ica,"Computing the sphering matrix...\n");
 		do_sphere(dataA,(integer)ncomps,(integer)frames,sphere);
 		
-		if (verbose) printf("Sphering the data ...\n");
+		if (ica.verbose) ica_message(&ica,"Sphering the data ...\n");
 
 #ifdef MMAP
 		dataB = (doublereal*)mapmalloc(ncomps*frames*sizeof(doublereal));
@@ -289,33 +352,129 @@ icadecomp(transform_info_ptr tinfo) {
 	}
 	else if (sphering == 0) {
 		if (weights_in_f==NULL) {
-			if (verbose) printf("Using the sphering matrix as the starting weight matrix ...\n");
+			if (ica.verbose) ica_message(&ica,"Using the sphering matrix as the starting weight matrix ...\n");
 			do_sphere(dataA,(integer)ncomps,(integer)frames,weights);
 		}
 
-		if (verbose) printf("Returning the identity matrix in variable \"sphere\" ...\n");
+		if (ica.verbose) ica_message(&ica,"Returning the identity matrix in variable \"sphere\" ...\n");
 		eye((integer)ncomps,sphere);
 	}
 	else if (sphering == -2) {
-		if (verbose) printf("Returning the identity matrix in variable \"sphere\" ...\n");
+		if (ica.verbose) ica_message(&ica,"Returning the identity matrix in variable \"sphere\" ...\n");
 		eye((integer)ncomps,sphere);
 	}
+ /* ^^^^^^^^ This segment is from interfc.c */
 
-	runica(dataA,weights,(integer)ncomps,(integer)frames,1,bias,signs);
+ /*{{{  Run the decomposition, possibly several times in parallel*/
+ {
+ int const nr_of_restarts=local_arg->nr_of_restarts;
+ unsigned int const seed=(ica.seed!=0 ? ica.seed : (unsigned int)time(NULL));
+ ica_context *restart_ica=(ica_context *)malloc(nr_of_restarts*sizeof(ica_context));
+ doublereal **restart_weights=(doublereal **)calloc(nr_of_restarts, sizeof(doublereal *));
+ doublereal **restart_bias=(doublereal **)calloc(nr_of_restarts, sizeof(doublereal *));
+ integer **restart_signs=(integer **)calloc(nr_of_restarts, sizeof(integer *));
+ double *stability=(double *)malloc(nr_of_restarts*sizeof(double));
+ int restart, best=0;
+
+ if (restart_ica==NULL || restart_weights==NULL || restart_bias==NULL || restart_signs==NULL || stability==NULL) {
+  ERREXIT(tinfo->emethods, "icadecomp: Error allocating memory\n");
+ }
+ /* Restart 0 works on the arrays above, the others on copies */
+ restart_weights[0]=weights;
+ restart_bias[0]=bias;
+ restart_signs[0]=signs;
+ for (restart=0; restart<nr_of_restarts; restart++) {
+  restart_ica[restart]=ica;
+  restart_ica[restart].seed=seed+restart;
+  if (restart_ica[restart].seed==0) restart_ica[restart].seed=1;
+  /* Only the summary below is informative for parallel runs */
+  if (nr_of_restarts>1) restart_ica[restart].verbose=0;
+  if (restart==0) continue;
+  if ((restart_weights[restart]=(doublereal *)malloc(ncomps*ncomps*sizeof(doublereal)))==NULL ||
+      (bias!=NULL && (restart_bias[restart]=(doublereal *)malloc(ncomps*sizeof(doublereal)))==NULL) ||
+      (signs!=NULL && (restart_signs[restart]=(integer *)malloc(ncomps*sizeof(integer)))==NULL)) {
+   ERREXIT(tinfo->emethods, "icadecomp: Error allocating memory\n");
+  }
+  memcpy(restart_weights[restart], weights, ncomps*ncomps*sizeof(doublereal));
+ }
 
+ /* runica only reads dataA, so that the restarts can share it */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1) if (nr_of_restarts>1)
+#endif
+ for (restart=0; restart<nr_of_restarts; restart++) {
+  runica(&restart_ica[restart],dataA,restart_weights[restart],(integer)ncomps,(integer)frames,1,restart_bias[restart],restart_signs[restart]);
+ }
 
+ if (nr_of_restarts==1) {
+  if (restart_ica[0].error_message!=NULL) {
+   ERREXIT1(tinfo->emethods, "icadecomp: %s\n", MSGPARM(restart_ica[0].error_message));
+  }
+ } else {
+  doublereal *cov=(doublereal *)malloc(ncomps*ncomps*sizeof(doublereal));
+  doublereal **candidates=(doublereal **)malloc(nr_of_restarts*sizeof(doublereal *));
+  doublereal alpha=1.0/(frames-1), beta=0.0;
+  char uplo='U', transn='N';
+  integer n=ncomps, t=frames;
+#define BUFFER_SIZE 160
+  char buffer[BUFFER_SIZE];
+  if (cov==NULL || candidates==NULL) {
+   ERREXIT(tinfo->emethods, "icadecomp: Error allocating memory\n");
+  }
+  for (restart=0; restart<nr_of_restarts; restart++) {
+   candidates[restart]=(restart_ica[restart].error_message==NULL ? restart_weights[restart] : NULL);
+  }
+  /* Covariance of the (sphered) data the weights apply to */
+  dsyrk_(&uplo,&transn,&n,&t,&alpha,dataA,&n,&beta,cov,&n,1,1);
+  best=most_stable_restart(cov,candidates,nr_of_restarts,n,stability);
+  free(candidates);
+  free(cov);
+  for (restart=0; restart<nr_of_restarts; restart++) {
+   if (restart_ica[restart].error_message!=NULL) {
+    snprintf(buffer, BUFFER_SIZE, "icadecomp: Restart %d (seed %u) failed: %s\n", restart+1, restart_ica[restart].seed, restart_ica[restart].error_message);
+   } else {
+    snprintf(buffer, BUFFER_SIZE, "icadecomp: Restart %d (seed %u): %d steps, lrate %g, wchange %g, stability %g%s\n", restart+1, restart_ica[restart].seed, (int)restart_ica[restart].steps, restart_ica[restart].lrate, restart_ica[restart].change, stability[restart], (restart==best ? " *" : ""));
+   }
+   TRACEMS(tinfo->emethods, 1, buffer);
+  }
+#undef BUFFER_SIZE
+  if (best<0) {
+   ERREXIT1(tinfo->emethods, "icadecomp: All restarts failed: %s\n", MSGPARM(restart_ica[0].error_message));
+  }
+  /* Move the most stable solution to the result arrays */
+  if (best!=0) {
+   memcpy(weights, restart_weights[best], ncomps*ncomps*sizeof(doublereal));
+   if (bias!=NULL) memcpy(bias, restart_bias[best], ncomps*sizeof(doublereal));
+   if (signs!=NULL) memcpy(signs, restart_signs[best], ncomps*sizeof(integer));
+  }
+ }
+ ica=restart_ica[best];
+ for (restart=1; restart<nr_of_restarts; restart++) {
+  free_pointer((void **)&restart_weights[restart]);
+  free_pointer((void **)&restart_bias[restart]);
+  free_pointer((void **)&restart_signs[restart]);
+ }
+ free(stability);
+ free(restart_signs);
+ free(restart_bias);
+ free(restart_weights);
+ free(restart_ica);
+ }
+ /*}}}  */
+
+ /* vvvvvvvv This segment is from interfc.c */
 /*************** Orient components toward positive activations ****************/
 #ifdef MMAP
 	dataB = (doublereal*)mapmalloc(ncomps*frames*sizeof(doublereal));
 		
-	if (posactflag) posact(dataA,weights,(integer)ncomps,(integer)frames,dataB);
+	if (local_arg->posactflag) posact(&ica,dataA,weights,(integer)ncomps,(integer)frames,dataB);
 	else geproj(dataA,weights,(integer)ncomps,(integer)frames,dataB);
 
 	mapfree(dataA,ncomps*frames*sizeof(doublereal));
 #else
 	dataB = (doublereal*)malloc(ncomps*frames*sizeof(doublereal));
 		
-	if (posactflag) posact(dataA,weights,(integer)ncomps,(integer)frames,dataB);
+	if (local_arg->posactflag) posact(&ica,dataA,weights,(integer)ncomps,(integer)frames,dataB);
 	else geproj(dataA,weights,(integer)ncomps,(integer)frames,dataB);
 
 	free(dataA);
@@ -324,20 +483,20 @@ icadecomp(transform_info_ptr tinfo) {
 
 
 /******* Sort components in descending order of max projected variance ********/
-	if (verbose) {
+	if (ica.verbose) {
 		if (pcaflag) {
-			printf("Composing the eigenvector, weights, and sphere matrices\n");
-			printf("  into a single rectangular weights matrix; sphere=eye(%d)\n",chans);
+			ica_message(&ica,"Composing the eigenvector, weights, and sphere matrices\n");
+			ica_message(&ica,"  into a single rectangular weights matrix; sphere=eye(%d)\n",chans);
 		}
-		printf("Sorting components in descending order of mean projected variance ...\n");
+		ica_message(&ica,"Sorting components in descending order of mean projected variance ...\n");
 	}
 	
 	if (eigv) {
-		varsort(dataA,weights,sphere,&eigv[chans*(chans-ncomps)],bias,signs,(integer)ncomps,(integer)frames,(integer)chans);
+		varsort(&ica,dataA,weights,sphere,&eigv[chans*(chans-ncomps)],bias,signs,(integer)ncomps,(integer)frames,(integer)chans);
 		eye((integer)chans,sphere);
 	}
 	else
-		varsort(dataA,weights,sphere,NULL,bias,signs,(integer)ncomps,(integer)frames,(integer)chans);
+		varsort(&ica,dataA,weights,sphere,NULL,bias,signs,(integer)ncomps,(integer)frames,(integer)chans);
  /* ^^^^^^^^ This segment is from interfc.c */
 
  /* Store the sphering matrix */
@@ -377,6 +536,7 @@ icadecomp(transform_info_ptr tinfo) {
   (*tmptinfo.methods->transform_exit)(&tmptinfo);
   growing_buf_free(&buf);
   array_free(&maps);
+#undef BUFFER_SIZE
  }
 
  /* Store the result */
@@ -440,7 +600,7 @@ select_icadecomp(transform_info_ptr tinfo) {
   " icadecomp returns the resulting component maps in adjacent `points'.\n"
   " The activations can be calculated using the `project' method. n_components is\n"
   " the number of PCA components to which to reduce the data before the analysis.\n";
- tinfo->methods->local_storage_size=0;
+ tinfo->methods->local_storage_size=sizeof(struct icadecomp_storage);
  tinfo->methods->nr_of_arguments=NR_OF_ARGUMENTS;
  tinfo->methods->argument_descriptors=argument_descriptors;
 }
@@ -42,6 +42,9 @@
 
 /* Globally defined variables */
 integer pcaflag, sphering, posactflag, biasflag;
+ica_context ctx;
+
+void error(char *str);
 
 
 /**************************** Initialize variables ****************************/
@@ -52,21 +55,9 @@ void initdefaults () {
 	pcaflag    = DEFAULT_PCAFLAG;
 	sphering   = DEFAULT_SPHEREFLAG;
 	posactflag = DEFAULT_POSACT;
-	verbose    = DEFAULT_VERBOSE;
 	biasflag   = DEFAULT_BIASFLAG;
 	
-	block      = 0;
-	lrate      = 0.0;
-	annealdeg  = DEFAULT_ANNEALDEG;
-	annealstep = 0.0;
-	nochange   = DEFAULT_STOP;
-	momentum   = DEFAULT_MOMENTUM;
-	maxsteps   = DEFAULT_MAXSTEPS;
-	
-	extendedflag   = DEFAULT_EXTENDED;
-	extblocks  = DEFAULT_EXTBLOCKS;
-	pdfsize    = MAX_PDFSIZE;
-	nsub       = DEFAULT_NSUB;
+	ica_init_context(&ctx);
 }
 
 
@@ -389,50 +380,50 @@ void doit(key *keys) {
 
 /* Keyword: lrate */
 		else if (!strcmp(keyword,"lrate")) {
-			lrate = atof(value);
-			if (lrate>MAX_LRATE || lrate<MIN_LRATE)
+			ctx.lrate = atof(value);
+			if (ctx.lrate>MAX_LRATE || ctx.lrate<MIN_LRATE)
 				error("lrate value is out of bounds");
 		}
 
 /* Keywords: block, blocksize */
 		else if (!strcmp(keyword,"block") || !strcmp(keyword,"blocksize")) {
-			block = atoi(value);
-			if (block < 0)
+			ctx.block = atoi(value);
+			if (ctx.block < 0)
 				error("block size value must be positive");
 		}
 		
 /* Keywords: stop, nochange */
 		else if (!strcmp(keyword,"stop") || !strcmp(keyword,"nochange") || !strcmp(keyword,"stopping")) {
-			nochange = atof(value);
-			if (nochange < 0.0)
+			ctx.nochange = atof(value);
+			if (ctx.nochange < 0.0)
 				error("stop wchange value must be positive");
 		}
 
 /* Keywords: maxsteps, steps */
 		else if (!strcmp(keyword,"maxsteps") || !strcmp(keyword,"steps")) {
-				maxsteps = atoi(value);
-				if (maxsteps < 0)
+				ctx.maxsteps = atoi(value);
+				if (ctx.maxsteps < 0)
 					error("maxsteps value must be a positive integer");
 		}
 
 /* Keywords: anneal, annealstep */
 		else if (!strcmp(keyword,"anneal") || !strcmp(keyword,"annealstep")) {
-			annealstep = atof(value);
-			if (annealstep<=0 || annealstep>1)
+			ctx.annealstep = atof(value);
+			if (ctx.annealstep<=0 || ctx.annealstep>1)
 				error("anneal step value must be (0,1]");
 		}
 
 /* Keywords: annealdeg, degrees */
 		else if (!strcmp(keyword,"annealdeg") || !strcmp(keyword,"degrees")) {
-			annealdeg = atof(value);
-			if (annealdeg>180 || annealdeg<0)
+			ctx.annealdeg = atof(value);
+			if (ctx.annealdeg>180 || ctx.annealdeg<0)
 				error("annealdeg value is out of bounds [0,180]");
 		}
 
 /* Keyword: momentum */
 		else if (!strcmp(keyword,"momentum")) {
-			momentum = atof(value);
-			if (momentum>1.0 || momentum<0.0)
+			ctx.momentum = atof(value);
+			if (ctx.momentum>1.0 || ctx.momentum<0.0)
 				error("momentum value is out of bounds [0,1]");
 		}
 
@@ -449,12 +440,12 @@ void doit(key *keys) {
 
 /* Keywords: extended, extend */
 		else if (!strcmp(keyword,"extended") || !strcmp(keyword,"extend")) {
-			extblocks = atoi(value);
-			extendedflag = 1;
+			ctx.extblocks = atoi(value);
+			ctx.extendedflag = 1;
 					
-			if (extblocks == 0) extendedflag = 0;
+			if (ctx.extblocks == 0) ctx.extendedflag = 0;
 			else
-				if (extblocks < 0) nsub = -extblocks;
+				if (ctx.extblocks < 0) ctx.nsub = -ctx.extblocks;
 		}
 
 /* Keyword: posact */
@@ -465,8 +456,8 @@ void doit(key *keys) {
 			
 /* Keyword: verbose */
 		else if (!strcmp(keyword,"verbose")) {
-			verbose = swtch(value);
-			if (verbose < 0) error("verbose flag value must be on or off");
+			ctx.verbose = swtch(value);
+			if (ctx.verbose < 0) error("verbose flag value must be on or off");
 		}
 		
 #ifdef PVM
@@ -524,23 +515,23 @@ void doit(key *keys) {
 	if (chans < 2) error("invalid number of channels");
 	if (datasize < 3) error("invalid data length");
 
-	if (lrate == 0.0) lrate = DEFAULT_LRATE(chans);
-	if (block == 0) block = DEFAULT_BLOCK(datasize);
+	if (ctx.lrate == 0.0) ctx.lrate = DEFAULT_LRATE(chans);
+	if (ctx.block == 0) ctx.block = DEFAULT_BLOCK(datasize);
 	if (ncomps == 0) ncomps = chans;
 
 	if (ncomps > chans || ncomps < 1) error("invalid number of components");
 	if (datasize < chans) error("data length less than data channels");
-	if (block < 2) error("block size too small!");
-	if (block > datasize) error("block size exceeds data length!");
-	if (nsub > ncomps) error("sub-Gaussian components exceeds total number of components!");
+	if (ctx.block < 2) error("block size too small!");
+	if (ctx.block > datasize) error("block size exceeds data length!");
+	if (ctx.nsub > ncomps) error("sub-Gaussian components exceeds total number of components!");
 
-	if (annealstep == 0.0)
-		annealstep = (extendedflag) ? DEFAULT_EXTANNEAL : DEFAULT_ANNEALSTEP;
+	if (ctx.annealstep == 0.0)
+		ctx.annealstep = (ctx.extendedflag) ? DEFAULT_EXTANNEAL : DEFAULT_ANNEALSTEP;
 
 
-	if (extendedflag && extblocks>0) {
-		pdfsize = MIN(pdfsize,datalength);
-		if (pdfsize < MIN_PDFSIZE)
+	if (ctx.extendedflag && ctx.extblocks>0) {
+		ctx.pdfsize = MIN(ctx.pdfsize,datalength);
+		if (ctx.pdfsize < MIN_PDFSIZE)
 			fprintf(stderr,"ica: warning, PDF values are inexact\n");
 	}
 
@@ -572,7 +563,7 @@ void doit(key *keys) {
 		error("sign file not writable");
 
 /****************************** Process the data ******************************/
-	if (verbose) {
+	if (ctx.verbose) {
 #ifdef PVM
 		printf("\nInput data size [%d,%d] = %d channels, %d epoch of %d frames.\n",chans,datalength,chans,epochs,frames);
 #else
@@ -581,24 +572,24 @@ void doit(key *keys) {
 		if (pcaflag) printf("After PCA dimension reduction,\n  finding ");
 		else printf("Finding ");
 	
-		if (!extendedflag)
+		if (!ctx.extendedflag)
 			printf("%d ICA components using logistic ICA.\n",ncomps);
 		else {
 			printf("%d ICA components using extended ICA.\n",ncomps);
 			
-			if (extblocks > 0)
-				printf("PDF will be calculated initially every %d blocks using %d data points.\n",extblocks,pdfsize);
+			if (ctx.extblocks > 0)
+				printf("PDF will be calculated initially every %d blocks using %d data points.\n",ctx.extblocks,ctx.pdfsize);
 			else
-				printf("PDF will not be calculated. Exactly %d sub-Gaussian components assumed.\n",nsub);
+				printf("PDF will not be calculated. Exactly %d sub-Gaussian components assumed.\n",ctx.nsub);
 		}
 		
-		printf("Initial learning rate will be %g, block size %d.\n",lrate,block);
+		printf("Initial learning rate will be %g, block size %d.\n",ctx.lrate,ctx.block);
 		
-		if (momentum > 0.0)
-			printf("Momentum will be %g.\n",momentum);
+		if (ctx.momentum > 0.0)
+			printf("Momentum will be %g.\n",ctx.momentum);
 			
-		printf("Learning rate will be multiplied by %g whenever angledelta >= %g deg.\n",annealstep,annealdeg);
-		printf("Training will end when wchange < %g or after %d steps.\n",nochange,maxsteps);
+		printf("Learning rate will be multiplied by %g whenever angledelta >= %g deg.\n",ctx.annealstep,ctx.annealdeg);
+		printf("Training will end when wchange < %g or after %d steps.\n",ctx.nochange,ctx.maxsteps);
 		
 		if (biasflag)
 			printf("Online bias adjustment will be used.\n");
@@ -607,7 +598,7 @@ void doit(key *keys) {
 	}
 	
 /******************************* Allocate memory ******************************/
-	if (verbose) printf("\nLoading data from %s\n",data_f);
+	if (ctx.verbose) printf("\nLoading data from %s\n",data_f);
 
 #ifdef MMAP
 	dataA = (doublereal*)mapmalloc(chans*datalength*sizeof(doublereal));
@@ -619,7 +610,7 @@ void doit(key *keys) {
 
 	weights = (doublereal*)malloc(ncomps*chans*sizeof(doublereal));
 	if (weights_in_f!=NULL) {
-		if (verbose) printf("Loading weights from %s\n",weights_in_f);
+		if (ctx.verbose) printf("Loading weights from %s\n",weights_in_f);
 		fb_matread(weights_in_f,ncomps*ncomps,weights);
 	}
 	else
@@ -632,20 +623,20 @@ void doit(key *keys) {
 	else
 		bias = NULL;
 	
-	if (extendedflag)
+	if (ctx.extendedflag)
 		signs = (integer*)malloc(ncomps*sizeof(integer));
 	else
 		signs = NULL;
 
 
 /************************** Remove overall row means **************************/
-	if (verbose) printf("Removing mean of each channel ...\n");
+	if (ctx.verbose) printf("Removing mean of each channel ...\n");
 	rmmean(dataA,(integer)chans,(integer)datalength);
 
 
 /**************************** Perform PCA reduction ***************************/
 	if (pcaflag) {
-		if (verbose) printf("Reducing the data to %d principal dimensions...\n",ncomps);
+		if (ctx.verbose) printf("Reducing the data to %d principal dimensions...\n",ncomps);
 
 		eigv = (doublereal*)malloc(chans*chans*sizeof(doublereal));
 		pca(dataA,(integer)chans,(integer)datalength,eigv);
@@ -666,10 +657,10 @@ void doit(key *keys) {
 	
 /**************************** Apply sphering matrix ***************************/
 	if (sphering == 1) {
-		if (verbose) printf("Computing the sphering matrix...\n");
+		if (ctx.verbose) printf("Computing the sphering matrix...\n");
 		do_sphere(dataA,(integer)ncomps,(integer)datalength,sphere);
 		
-		if (verbose) printf("Sphering the data ...\n");
+		if (ctx.verbose) printf("Sphering the data ...\n");
 
 #ifdef MMAP
 		dataB = (doublereal*)mapmalloc(ncomps*datalength*sizeof(doublereal));
@@ -684,15 +675,15 @@ void doit(key *keys) {
 	}
 	else if (sphering == 0) {
 		if (weights_in_f==NULL) {
-			if (verbose) printf("Using the sphering matrix as the starting weight matrix ...\n");
+			if (ctx.verbose) printf("Using the sphering matrix as the starting weight matrix ...\n");
 			do_sphere(dataA,(integer)ncomps,(integer)datalength,weights);
 		}
 
-		if (verbose) printf("Returning the identity matrix in variable \"sphere\" ...\n");
+		if (ctx.verbose) printf("Returning the identity matrix in variable \"sphere\" ...\n");
 		eye((integer)ncomps,sphere);
 	}
 	else if (sphering == -2) {
-		if (verbose) printf("Returning the identity matrix in variable \"sphere\" ...\n");
+		if (ctx.verbose) printf("Returning the identity matrix in variable \"sphere\" ...\n");
 		eye((integer)ncomps,sphere);
 	}
 
@@ -702,20 +693,21 @@ void doit(key *keys) {
 	fnames[2] = sign_f;
 	pvmica(dataA,weights,sphere,eigv,(integer)chans,(integer)ncomps,(integer)frames,(integer)epochs,window,bias,signs,fnames);
 #else
-	runica(dataA,weights,(integer)ncomps,(integer)datalength,1,bias,signs);
+	if (!runica(&ctx,dataA,weights,(integer)ncomps,(integer)datalength,1,bias,signs))
+		error((char *)ctx.error_message);
 
 /*************** Orient components toward positive activations ****************/
 #ifdef MMAP
 	dataB = (doublereal*)mapmalloc(ncomps*datalength*sizeof(doublereal));
 
-	if (posactflag) posact(dataA,weights,(integer)ncomps,(integer)datalength,dataB);
+	if (posactflag) posact(&ctx,dataA,weights,(integer)ncomps,(integer)datalength,dataB);
 	else geproj(dataA,weights,(integer)ncomps,(integer)datalength,dataB);
 
 	mapfree(dataA,ncomps*datalength*sizeof(doublereal));
 #else
 	dataB = (doublereal*)malloc(ncomps*datalength*sizeof(doublereal));
 		
-	if (posactflag) posact(dataA,weights,(integer)ncomps,(integer)datalength,dataB);
+	if (posactflag) posact(&ctx,dataA,weights,(integer)ncomps,(integer)datalength,dataB);
 	else geproj(dataA,weights,(integer)ncomps,(integer)datalength,dataB);
 
 	free(dataA);
@@ -724,7 +716,7 @@ void doit(key *keys) {
 
 
 /******* Sort components in descending order of max projected variance ********/
-	if (verbose) {
+	if (ctx.verbose) {
 		if (pcaflag) {
 			printf("Composing the eigenvector, weights, and sphere matrices\n");
 			printf("  into a single rectangular weights matrix; sphere=eye(%d)\n",chans);
@@ -733,35 +725,35 @@ void doit(key *keys) {
 	}
 	
 	if (eigv) {
-		varsort(dataA,weights,sphere,&eigv[chans*(chans-ncomps)],bias,signs,(integer)ncomps,(integer)datalength,(integer)chans);
+		varsort(&ctx,dataA,weights,sphere,&eigv[chans*(chans-ncomps)],bias,signs,(integer)ncomps,(integer)datalength,(integer)chans);
 		eye((integer)chans,sphere);
 	}
 	else
-		varsort(dataA,weights,sphere,NULL,bias,signs,(integer)ncomps,(integer)datalength,(integer)chans);
+		varsort(&ctx,dataA,weights,sphere,NULL,bias,signs,(integer)ncomps,(integer)datalength,(integer)chans);
 
 
 /**************************** Write results to disk ***************************/
-	if (verbose) printf("Storing weights in %s\n",weights_out_f);
+	if (ctx.verbose) printf("Storing weights in %s\n",weights_out_f);
 	fb_matwrite(weights_out_f,ncomps*chans,weights);
 	
 	if (act_f!=NULL) {
-		if (verbose) printf("Storing activations in %s\n",act_f);
+		if (ctx.verbose) printf("Storing activations in %s\n",act_f);
 		fb_matwrite(act_f,ncomps*datalength,dataA);
 	}
 	
 	if (bias_f!=NULL && bias) {
-		if (verbose) printf("Storing bias vector in %s\n",bias_f);
+		if (ctx.verbose) printf("Storing bias vector in %s\n",bias_f);
 		fb_matwrite(bias_f,ncomps,bias);
 	}
 	
 	if (sign_f!=NULL && signs) {
-		if (verbose) printf("Storing sign vector in %s\n",sign_f);
+		if (ctx.verbose) printf("Storing sign vector in %s\n",sign_f);
 		for (i=0 ; i<ncomps ; i++) signs[i] = (signs[i]) ? (-1) : 1;
 		ia_matwrite(sign_f,ncomps,signs);
 	}
 #endif
 
-	if (verbose) printf("Storing sphering matrix in %s\n",sphere_f);
+	if (ctx.verbose) printf("Storing sphering matrix in %s\n",sphere_f);
 	fb_matwrite(sphere_f,chans*chans,sphere);
 
 #ifdef MMAP
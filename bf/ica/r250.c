@@ -19,15 +19,9 @@ static char rcsid[] __attribute__((unused)) = "@(#)r250.c	1.2 15:50:31 11/21/94
 
 #include "r250.h"
 
-/* set the following if you trust rand(), otherwise the minimal standard
-   generator is used
-*/
-/* #define TRUST_RAND */
-
-
-#ifndef TRUST_RAND
+/* The minimal standard generator is used for initialization rather than
+   rand(), so that the generator can be used reentrantly */
 #include "randlcg.h"
-#endif
 
 /* defines to allow for 16 or 32 bit integers */
 #define BITS 31
@@ -64,8 +58,8 @@ static char rcsid[] __attribute__((unused)) = "@(#)r250.c	1.2 15:50:31 11/21/94
 #define STEP        11
 #endif
 
-static unsigned int r250_buffer[ 250 ];
-static int r250_index;
+/* The state used by the non-reentrant interface */
+static struct r250_state r250_default_state;
 
 #ifdef NO_PROTO
 void r250_init(sd)
@@ -74,43 +68,42 @@ int seed;
 void r250_init(int sd)
 #endif
 {
-	int j, k;
-	unsigned int mask, msb;
-
-#ifdef TRUST_RAND        
+	r250_init_r(&r250_default_state, sd);
+}
 
-#if BITS == 32 || BITS == 31       
-	srand48( sd );
-#else
-	srand( sd );
-#endif	
+unsigned int r250(void)		/* returns a random unsigned integer */
+{
+	return r250_r(&r250_default_state);
+}
 
+double dr250(void)		/* returns a random double in range 0..1 */
+{
+	return dr250_r(&r250_default_state);
+}
 
+/* Reentrant versions keeping all state in *state. These always use the
+   minimal standard generator for initialization, since rand() has global
+   state */
+#ifdef NO_PROTO
+void r250_init_r(state, sd)
+struct r250_state *state;
+int sd;
 #else
-	set_seed( sd );
+void r250_init_r(struct r250_state *state, int sd)
 #endif
-	
-	r250_index = 0;
+{
+	int j, k;
+	unsigned int mask, msb;
+	long int seed = sd;
+
+	state->index = 0;
 	for (j = 0; j < 250; j++)      /* fill r250 buffer with BITS-1 bit values */
-#ifdef TRUST_RAND
-#if BITS == 32 || BITS == 31
-		r250_buffer[j] = (unsigned int)lrand48();
-#else
-		r250_buffer[j] = rand();
-#endif
-#else
-		r250_buffer[j] = randlcg();
-#endif
+		state->buffer[j] = randlcg_r(&seed);
 
 
 	for (j = 0; j < 250; j++)	/* set some MSBs to 1 */
-#ifdef TRUST_RAND
-		if ( rand() > HALF_RANGE )
-			r250_buffer[j] |= MSB;
-#else
-		if ( randlcg() > HALF_RANGE )
-			r250_buffer[j] |= MSB;
-#endif
+		if ( randlcg_r(&seed) > HALF_RANGE )
+			state->buffer[j] |= MSB;
 
 
 	msb = MSB;	        /* turn on diagonal bit */
@@ -119,57 +112,49 @@ void r250_init(int sd)
 	for (j = 0; j < BITS; j++)
 	{
 		k = STEP * j + 3;	/* select a word to operate on */
-		r250_buffer[k] &= mask; /* turn off bits left of the diagonal */
-		r250_buffer[k] |= msb;	/* turn on the diagonal bit */
+		state->buffer[k] &= mask; /* turn off bits left of the diagonal */
+		state->buffer[k] |= msb;	/* turn on the diagonal bit */
 		mask >>= 1;
 		msb  >>= 1;
 	}
 
 }
 
-unsigned int r250(void)		/* returns a random unsigned integer */
+#ifdef NO_PROTO
+unsigned int r250_r(state)
+struct r250_state *state;
+#else
+unsigned int r250_r(struct r250_state *state)
+#endif
 {
 	register int	j;
 	register unsigned int new_rand;
 
-	if ( r250_index >= 147 )
-		j = r250_index - 147;	/* wrap pointer around */
+	if ( state->index >= 147 )
+		j = state->index - 147;	/* wrap pointer around */
 	else
-		j = r250_index + 103;
+		j = state->index + 103;
 
-	new_rand = r250_buffer[ r250_index ] ^ r250_buffer[ j ];
-	r250_buffer[ r250_index ] = new_rand;
+	new_rand = state->buffer[ state->index ] ^ state->buffer[ j ];
+	state->buffer[ state->index ] = new_rand;
 
-	if ( r250_index >= 249 )	/* increment pointer for next time */
-		r250_index = 0;
+	if ( state->index >= 249 )	/* increment pointer for next time */
+		state->index = 0;
 	else
-		r250_index++;
+		state->index++;
 
 	return new_rand;
 
 }
 
-
-double dr250(void)		/* returns a random double in range 0..1 */
+#ifdef NO_PROTO
+double dr250_r(state)
+struct r250_state *state;
+#else
+double dr250_r(struct r250_state *state)
+#endif
 {
-	register int	j;
-	register unsigned int new_rand;
-
-	if ( r250_index >= 147 )
-		j = r250_index - 147;	/* wrap pointer around */
-	else
-		j = r250_index + 103;
-
-	new_rand = r250_buffer[ r250_index ] ^ r250_buffer[ j ];
-	r250_buffer[ r250_index ] = new_rand;
-
-	if ( r250_index >= 249 )	/* increment pointer for next time */
-		r250_index = 0;
-	else
-		r250_index++;
-
-	return (double)new_rand / ALL_BITS;
-
+	return (double)r250_r(state) / ALL_BITS;
 }
 
 #ifdef MAIN
@@ -18,15 +18,27 @@
 extern "C" {
 #endif
 
+/* The state of one generator for the reentrant interface */
+struct r250_state {
+	unsigned int buffer[ 250 ];
+	int index;
+};
+
 #ifdef NO_PROTO
 void         r250_init();
 unsigned int r250();
 double      dr250();
+void         r250_init_r();
+unsigned int r250_r();
+double      dr250_r();
 
 #else
 void         r250_init(int seed);
 unsigned int r250( void );
 double       dr250( void );
+void         r250_init_r(struct r250_state *state, int seed);
+unsigned int r250_r(struct r250_state *state);
+double       dr250_r(struct r250_state *state);
 #endif
 
 #ifdef __cplusplus
@@ -29,23 +29,29 @@ long get_seed(void)
 
 unsigned long int randlcg(void)       /* returns a random unsigned integer */
 {
-        if ( seed_val <= quotient )
-                seed_val = (seed_val * 16807L) % LONG_MAX;
+        return randlcg_r(&seed_val);
+}
+
+/* Reentrant version working on the caller's seed */
+unsigned long int randlcg_r(long int *seed)
+{
+        if ( *seed <= quotient )
+                *seed = (*seed * 16807L) % LONG_MAX;
         else
         {
-                long int high_part = seed_val / quotient;
-                long int low_part  = seed_val % quotient;
+                long int high_part = *seed / quotient;
+                long int low_part  = *seed % quotient;
 
                 long int test = 16807L * low_part - remain * high_part;
 
                 if ( test > 0 )
-                        seed_val = test;
+                        *seed = test;
                 else
-                        seed_val = test + LONG_MAX;
+                        *seed = test + LONG_MAX;
 
         }
 
-        return seed_val;
+        return *seed;
 }
 
 
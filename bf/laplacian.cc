@@ -11,6 +11,10 @@
  *  by solving a set of linear equations by SVD backsubstitution. The second-
  *  order derivatives are finally summed and output as the Laplacian estimation.
  *	-- Bernd Feige 26.12.1996 (draft), 7.04.1997 (first version)
+ * The filter is compiled into a sparse channel operator at init, so that
+ * each epoch is processed in one pass over the data instead of a
+ * backsubstitution per point and channel.
+ *	-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
@@ -69,9 +73,8 @@ public:
  LaplacianChannels(transform_info_ptr tinfo, int chan, TPoints* tp, Boundary* surrounding);
  ~LaplacianChannels();
  void calculate_x(void);
- void calculate_x(array* indata);
- void write_laplacian(array* indata, array* outdata);
  void construct_matrix(array* D);
+ Bool compile(struct channel_operator* op);
  int channel;
 private:
 // A pointer into local_arg->tp (not our own copy!):
@@ -100,6 +103,7 @@ struct laplacian_storage {
  int nr_of_laplacian_channels;
  int nr_of_copied_channels;
  LaplacianChannels* laplacian_channels;
+ struct channel_operator op;
 };
 
 /*{{{  Implementation of LaplacianChannels*/
@@ -154,7 +158,7 @@ LaplacianChannels::LaplacianChannels(transform_info_ptr tinfo, int chan, TPoints
 
  /* Construct a 2-dimensional coordinate system normal to the mean of all
   * adjacent triangle normals */
- while ((thistr=thistr->find(tp))!=(Triangles*)Empty) {
+ while (thistr!=(Triangles*)Empty && (thistr=thistr->find(tp))!=(Triangles*)Empty) {
   normal=normal+thistr->normal();
   thistr=(Triangles*)thistr->next();
  }
@@ -225,57 +229,6 @@ void LaplacianChannels::calculate_x(void) {
  } while (v.message!=ARRAY_ENDOFSCAN);
  /*}}}  */
 }
-void LaplacianChannels::calculate_x(array* indata) {
- /*{{{  Calculate the derivatives by backsubstitution of the actual potentials*/
- /* Note that indata->current_vector is not modified. */
- /* The solution in x is (dP/dx, dP/dy, d^{2}P/dx^2, d^{2}P/dy^2) */
- /* Fill the potential data vector b from indata */
- DATATYPE midpoint_value;
- indata->current_element=channel;
- midpoint_value=READ_ELEMENT(indata);
- array_reset(&b);
- do {
-  indata->current_element=surrounding_channels[b.current_element];
-  /* A plus towards the central point should be counted positive */
-  array_write(&b, midpoint_value-READ_ELEMENT(indata));
- } while (b.message==ARRAY_CONTINUE);
- /* Perform the backsubstitution */
- calculate_x();
- /*}}}  */
-}
-void LaplacianChannels::write_laplacian(array* indata, array* outdata) {
- /* This method processes ALL LaplacianChannels connected to the one it
-  * is called upon, not only THIS one. 
-  * Only the current vector of indata is accessed, and one vector of
-  * outdata written and advanced. */
- LaplacianChannels* laplacian_channels=(LaplacianChannels*)this->first();
- while (laplacian_channels!=(LaplacianChannels*)Empty) {
-  DATATYPE ddx, ddy;
-  laplacian_channels->calculate_x(indata);
-  switch (laplacian_variant) {
-   case METHOD_NORMAL:
-    /* Sum up only the second derivatives */
-    laplacian_channels->x.current_element=2; // Second derivative in x direction
-    ddx=array_scan(&laplacian_channels->x);
-    ddy=array_scan(&laplacian_channels->x);
-    array_write(outdata, ddx+ddy);
-    break;
-   case METHOD_LOCAL_REFERENCE:
-    array_write(outdata, array_scan(&laplacian_channels->x));
-    break;
-   case METHOD_ALL_DERIVATIVES:
-    /* Write all derivatives as independent items of the output */
-    array_reset(&laplacian_channels->x);
-    do {
-     array_use_item(outdata, laplacian_channels->x.current_element);
-     WRITE_ELEMENT(outdata, array_scan(&laplacian_channels->x));
-    } while (laplacian_channels->x.message==ARRAY_CONTINUE);
-    array_advance(outdata);
-    break;
-  }
-  laplacian_channels=(LaplacianChannels*)laplacian_channels->next();
- }
-}
 void LaplacianChannels::construct_matrix(array* D) {
  /* This method processes ALL LaplacianChannels connected to the one it
   * is called upon, not only THIS one.
@@ -325,6 +278,59 @@ void LaplacianChannels::construct_matrix(array* D) {
   laplacian_channels=(LaplacianChannels*)laplacian_channels->next();
  }
 }
+Bool LaplacianChannels::compile(struct channel_operator* op) {
+ /* Like construct_matrix, this processes ALL LaplacianChannels connected to
+  * the one it is called upon. The backsubstitution is done for the center
+  * and each surrounding channel only, giving the sparse filter rows; these
+  * are added to op in output order, one row per output item. */
+ int const nr_of_x=(laplacian_variant==METHOD_LOCAL_REFERENCE ? 1 : NR_OF_TAYLOR_PARAMETERS);
+ LaplacianChannels* laplacian_channels=(LaplacianChannels*)this->first();
+
+ while (laplacian_channels!=(LaplacianChannels*)Empty) {
+  int const n=laplacian_channels->n_surrounding;
+  /* coefficients[input*nr_of_x+k] is the contribution of input (0: The
+   * center channel, else surrounding_channels[input-1]) to x[k] */
+  DATATYPE* const coefficients=new DATATYPE[(n+1)*nr_of_x];
+  Bool ok=TRUE;
+  int input, k;
+
+  for (input=0; input<=n; input++) {
+   array_reset(&laplacian_channels->b);
+   do {
+    array_write(&laplacian_channels->b, input==0 ? 1.0 : (laplacian_channels->b.current_element==input-1 ? -1.0 : 0.0));
+   } while (laplacian_channels->b.message==ARRAY_CONTINUE);
+   laplacian_channels->calculate_x();
+   array_reset(&laplacian_channels->x);
+   for (k=0; k<nr_of_x; k++) {
+    coefficients[input*nr_of_x+k]=array_scan(&laplacian_channels->x);
+   }
+  }
+
+  switch (laplacian_variant) {
+   case METHOD_NORMAL:
+    /* Sum up only the second derivatives */
+    ok=channel_operator_new_row(op);
+    for (input=0; ok && input<=n; input++) {
+     ok=channel_operator_add(op, input==0 ? laplacian_channels->channel : laplacian_channels->surrounding_channels[input-1], coefficients[input*nr_of_x+2]+coefficients[input*nr_of_x+3]);
+    }
+    break;
+   case METHOD_LOCAL_REFERENCE:
+   case METHOD_ALL_DERIVATIVES:
+    for (k=0; ok && k<nr_of_x; k++) {
+     ok=channel_operator_new_row(op);
+     for (input=0; ok && input<=n; input++) {
+      ok=channel_operator_add(op, input==0 ? laplacian_channels->channel : laplacian_channels->surrounding_channels[input-1], coefficients[input*nr_of_x+k]);
+     }
+    }
+    break;
+  }
+  delete[] coefficients;
+  if (!ok) return FALSE;
+
+  laplacian_channels=(LaplacianChannels*)laplacian_channels->next();
+ }
+ return TRUE;
+}
 /*}}}  */
 /*}}}  */
 
@@ -372,7 +378,12 @@ laplacian_init(transform_info_ptr tinfo) {
  tpoint=0;
  for (channel=0; channel<tinfo->nr_of_channels; channel++) {
   if (!local_arg->have_channel_list || is_in_channellist(channel+1, local_arg->channel_list)) {
-   local_arg->tp=(TPoints*)local_arg->tp->addmember(new TPoints(tinfo->probepos[3*channel], tinfo->probepos[3*channel+1], tinfo->probepos[3*channel+2]));
+   TPoints* const newtp=new TPoints(tinfo->probepos[3*channel], tinfo->probepos[3*channel+1], tinfo->probepos[3*channel+2]);
+   /* Methods can't be called on Empty lists, see TriAn_init() */
+   if (local_arg->tp==(TPoints*)Empty)
+    local_arg->tp=newtp;
+   else
+    local_arg->tp=(TPoints*)local_arg->tp->addmember(newtp);
    local_arg->active_channels_list[tpoint]=channel;
    tpoint++;
   }
@@ -398,7 +409,8 @@ laplacian_init(transform_info_ptr tinfo) {
     Triangles* newtr=((Triangles*)local_arg->cm->tr->first())->find(tp,p3);
 
     if (newtr!=(Triangles*)Empty && newtr==tr) {
-     newtr=((Triangles*)tr->next())->find(tp,p3);
+     newtr=(Triangles*)tr->next();
+     if (newtr!=(Triangles*)Empty) newtr=newtr->find(tp,p3);
     }
     tr=newtr;
     if (tr==(Triangles*)Empty) break;
@@ -408,17 +420,47 @@ laplacian_init(transform_info_ptr tinfo) {
    }
 
    if (tr!=(Triangles*)Empty) {
-    local_arg->laplacian_channels=(LaplacianChannels*)local_arg->laplacian_channels->addmember(new LaplacianChannels(tinfo, channel, tp, surrounding));
+    LaplacianChannels* const newchannel=new LaplacianChannels(tinfo, channel, tp, surrounding);
+    if (local_arg->laplacian_channels==(LaplacianChannels*)Empty)
+     local_arg->laplacian_channels=newchannel;
+    else
+     local_arg->laplacian_channels=(LaplacianChannels*)local_arg->laplacian_channels->addmember(newchannel);
    }
 
    delete surrounding;
    tp=(TPoints*)tp->next();
   }
  }
+ if (local_arg->laplacian_channels==(LaplacianChannels*)Empty) {
+  ERREXIT(tinfo->emethods, "laplacian_init: No channel is surrounded by a closed path.\n");
+ }
  local_arg->laplacian_channels=(LaplacianChannels*)local_arg->laplacian_channels->first();
  local_arg->nr_of_laplacian_channels=local_arg->laplacian_channels->nr_of_members();
  /*}}}  */
 
+ /*{{{  Compile the filter into a channel operator with one row per output item*/
+ {
+ int const output_itemsize=(laplacian_variant==METHOD_ALL_DERIVATIVES ? NR_OF_TAYLOR_PARAMETERS : 1);
+ Bool ok;
+ channel_operator_init(&local_arg->op);
+ channel_operator_reset(&local_arg->op, tinfo->nr_of_channels, 0);
+ ok=local_arg->laplacian_channels->compile(&local_arg->op);
+ /* The copied channels go to item 0, any other items stay 0 */
+ for (channel=0; ok && channel<tinfo->nr_of_channels; channel++) {
+  if (local_arg->have_channel_list && !is_in_channellist(channel+1, local_arg->channel_list)) {
+   int item;
+   ok=channel_operator_new_row(&local_arg->op) && channel_operator_add(&local_arg->op, channel, 1.0);
+   for (item=1; ok && item<output_itemsize; item++) {
+    ok=channel_operator_new_row(&local_arg->op);
+   }
+  }
+ }
+ if (!ok) {
+  ERREXIT(tinfo->emethods, "laplacian_init: Error allocating the channel operator\n");
+ }
+ }
+ /*}}}  */
+
  if (args[ARGS_OUTPUT_MATRIX].is_set) {
   FILE *outfile;
 
@@ -458,7 +500,7 @@ laplacian_init(transform_info_ptr tinfo) {
   local_arg->laplacian_channels->construct_matrix(&D);
   /* construct_matrix will only fill the LaplacianChannel part of the matrix: */
   for (channel=0; channel<tinfo->nr_of_channels; channel++) {
-   if (!local_arg->have_channel_list && !is_in_channellist(channel+1, local_arg->channel_list)) {
+   if (local_arg->have_channel_list && !is_in_channellist(channel+1, local_arg->channel_list)) {
     D.current_element=channel;
     WRITE_ELEMENT(&D, 1.0);
     array_nextvector(&D);
@@ -478,7 +520,8 @@ laplacian_init(transform_info_ptr tinfo) {
 METHODDEF DATATYPE *
 laplacian(transform_info_ptr tinfo) {
  struct laplacian_storage *local_arg=(struct laplacian_storage *)tinfo->methods->local_storage;
- array indata, outdata;
+ array outdata;
+ array_view inview, outview;
  LaplacianChannels* laplacian_channels=local_arg->laplacian_channels;
  char **new_channelnames=NULL, *in_buffer=NULL;
  int stringlength=0;
@@ -540,24 +583,17 @@ laplacian(transform_info_ptr tinfo) {
  }
  /*}}}  */
 
- tinfo_array(tinfo, &indata);
- array_transpose(&indata);	/* Vectors are maps */
- 
- laplacian_channels=local_arg->laplacian_channels;
- do {
-  /* Fill the data array by doing backsubstitution with the SVD info */
-  laplacian_channels->write_laplacian(&indata, &outdata);
-  if (local_arg->have_channel_list) {
-   for (channel=0; channel<tinfo->nr_of_channels; channel++) {
-    if (!is_in_channellist(channel+1, local_arg->channel_list)) {
-     indata.current_element=channel;
-     array_use_item(&outdata, 0);
-     array_write(&outdata, READ_ELEMENT(&indata));
-    }
-   }
-  }
-  array_nextvector(&indata);
- } while (outdata.message!=ARRAY_ENDOFSCAN);
+ /* Output row r of the operator is item r%output_itemsize of output
+  * channel r/output_itemsize, ie the output memory is multiplexed */
+ tinfo_array_view(tinfo, &inview);
+ outview.start=outdata.start;
+ outview.nr_of_vectors=nr_of_output_channels*output_itemsize;
+ outview.vector_skip=1;
+ outview.nr_of_elements=inview.nr_of_elements;
+ outview.element_skip=nr_of_output_channels*output_itemsize;
+ if (!channel_operator_apply(&local_arg->op, &inview, &outview)) {
+  ERREXIT(tinfo->emethods, "laplacian: Error allocating memory\n");
+ }
 
  free_pointer((void **)&tinfo->channelnames[0]);
  free_pointer((void **)&tinfo->channelnames);
@@ -585,6 +621,7 @@ laplacian_exit(transform_info_ptr tinfo) {
  local_arg->cm=(ConvexMesh*)Empty;
  local_arg->tp->delall();
  local_arg->tp=(TPoints*)Empty;
+ channel_operator_free(&local_arg->op);
 
  tinfo->methods->init_done=FALSE;
 }
@@ -88,6 +88,8 @@ LOCAL void (* const method_selects[])(transform_info_ptr)={
  select_show_memuse,
 #endif
  select_sliding_average,
+ select_spatial_filter,
+ select_stream_filter,
  select_subtract,
  select_svdecomp,
  select_swap_fc,
@@ -105,6 +107,7 @@ LOCAL void (* const method_selects[])(transform_info_ptr)={
 
  select_writeasc,
  select_write_brainvision,
+ select_write_frame,
  select_write_freiburg,
  select_write_generic,
 #ifdef AVG_Q_WITH_HDF
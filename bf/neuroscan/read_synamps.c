@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-2001,2003,2004,2006-2010,2012-2014,2018,2024 Bernd Feige
+ * Copyright (C) 1996-2001,2003,2004,2006-2010,2012-2014,2018,2024,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -8,6 +8,9 @@
  * read_synamps.c module to read data from Neuroscan `SynAmps' files
  * part of this code was taken from Patrick Berg's `3sycorr.c'.
  *	-- Bernd Feige 14.06.1995
+ * Continuous data is read through the block interface, converting up to
+ * a megabyte of file blocks per fread.
+ *	-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
@@ -32,8 +35,10 @@
 enum ARGS_ENUM {
  ARGS_NOREJECTED=0, 
  ARGS_NOBADCHANS, 
+ ARGS_CHANNELNAMES, 
  ARGS_CONTINUOUS, 
  ARGS_TRIGTRANSFER, 
+ ARGS_SINGLEPOINT, 
  ARGS_KN_REMAP, 
  ARGS_TRIGLIST, 
  ARGS_FROMEPOCH, 
@@ -48,8 +53,10 @@ enum ARGS_ENUM {
 LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_NOTHING, "Reject epochs marked as rejected (.EEG files only)", "r", FALSE, NULL},
  {T_ARGS_TAKES_NOTHING, "Ignore channels marked as Bad", "B", FALSE, NULL},
+ {T_ARGS_TAKES_STRING_WORD, "channelnames: Only read these channels (in file order)", "n", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_NOTHING, "Continuous mode. Read the file in chunks of the given size without triggers", "c", FALSE, NULL},
  {T_ARGS_TAKES_NOTHING, "Transfer a list of triggers within the read epoch", "T", FALSE, NULL},
+ {T_ARGS_TAKES_NOTHING, "Read continuous data point by point rather than in blocks (slow)", "p", FALSE, NULL},
  {T_ARGS_TAKES_NOTHING, "Konstanz remapping of trigger_list values to 1...n", "K", FALSE, NULL},
  {T_ARGS_TAKES_STRING_WORD, "trigger_list: Restrict epochs to these `StimTypes'. Eg: 1,2", "t", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_LONG, "fromepoch: Specify start epoch beginning with 1", "f", 1, NULL},
@@ -69,11 +76,13 @@ struct read_synamps_storage {
  ELECTLOC *Channels;
  int bytes_per_sample;	/* Can be 2 or 4 for 16 or 32-bit raw data */
  int nchannels;
+ Bool *channel_skip;	/* Data channels not read: Bad (-B) or not selected (-n) */
  long filesize;
  long SizeofHeader;          /* no. of bytes in header of source file */
  unsigned long BufferCount;	/* Buffer size */
  int *trigcodes;
  int current_trigger;
+ struct trigger_epochs trigger_epochs;
  growing_buf triggers;
  long current_point;
  long first_point_in_buffer;
@@ -102,22 +111,19 @@ point2offset(transform_info_ptr tinfo, long point) {
 }
 /*}}}  */
 
-/*{{{  Single point interface*/
+/*{{{  Single point and block interface*/
 
 /*{{{  read_synamps_get_filestrings: Allocate and set strings and probepos array*/
 LOCAL void
 read_synamps_get_filestrings(transform_info_ptr tinfo) {
  struct read_synamps_storage *local_arg=(struct read_synamps_storage *)tinfo->methods->local_storage;
- transform_argument *args=tinfo->methods->arguments;
  char *innamebuf;
  int channel, namelen=0;
  ELECTLOC *inChannels=local_arg->Channels;
 
  tinfo->xchannelname=tinfo->z_label=NULL;
  for (channel=0; channel<local_arg->nchannels; channel++) {
-  if (args[ARGS_NOBADCHANS].is_set) {
-   while (inChannels->bad) inChannels++;
-  }
+  while (local_arg->channel_skip[inChannels-local_arg->Channels]) inChannels++;
   namelen+=strlen(inChannels->lab)+1;
   inChannels++;
  }
@@ -130,9 +136,7 @@ read_synamps_get_filestrings(transform_info_ptr tinfo) {
 
  inChannels=local_arg->Channels;
  for (channel=0; channel<local_arg->nchannels; channel++) {
-  if (args[ARGS_NOBADCHANS].is_set) {
-   while (inChannels->bad) inChannels++;
-  }
+  while (local_arg->channel_skip[inChannels-local_arg->Channels]) inChannels++;
   strcpy(innamebuf, inChannels->lab);
   tinfo->channelnames[channel]=innamebuf;
   innamebuf+=strlen(innamebuf)+1;
@@ -197,7 +201,6 @@ read_synamps_seek_point(transform_info_ptr tinfo, long point) {
 LOCAL int
 read_synamps_get_singlepoint(transform_info_ptr tinfo, array *toarray) {
  struct read_synamps_storage *local_arg=(struct read_synamps_storage *)tinfo->methods->local_storage;
- transform_argument *args=tinfo->methods->arguments;
 
  if (local_arg->current_point>=local_arg->EEG.NumSamples) return -1;
  read_synamps_seek_point(tinfo, local_arg->current_point);
@@ -208,7 +211,7 @@ read_synamps_get_singlepoint(transform_info_ptr tinfo, array *toarray) {
    int channel=0;
    do {
     *pdata^=0x8000;	/* Exclusive or to convert to signed... */
-    if (args[ARGS_NOBADCHANS].is_set && local_arg->Channels[channel].bad) {
+    if (local_arg->channel_skip[channel]) {
      toarray->message=ARRAY_CONTINUE;
     } else {
      array_write(toarray, NEUROSCAN_CONVSHORT(&local_arg->Channels[channel], *((signed short *)pdata)));
@@ -224,7 +227,7 @@ read_synamps_get_singlepoint(transform_info_ptr tinfo, array *toarray) {
    int channel=0;
    do {
     DATATYPE val;
-    if (args[ARGS_NOBADCHANS].is_set && local_arg->Channels[channel].bad) {
+    if (local_arg->channel_skip[channel]) {
      toarray->message=ARRAY_CONTINUE;
     } else {
      if (local_arg->bytes_per_sample==2) {
@@ -256,17 +259,118 @@ read_synamps_get_singlepoint(transform_info_ptr tinfo, array *toarray) {
  return 0;
 }
 /*}}}  */
-/*}}}  */
 
-/*{{{  read_synamps_nexttrigger(transform_info_ptr tinfo, long *trigpoint) {*/
-/*{{{  Maintaining the triggers list*/
-LOCAL void 
-read_synamps_reset_triggerbuffer(transform_info_ptr tinfo) {
- struct read_synamps_storage * const local_arg=(struct read_synamps_storage *)tinfo->methods->local_storage;
- local_arg->current_trigger=0;
+/*{{{  read_synamps_get_block(transform_info_ptr tinfo, long start_point, long nr_of_points, int const *channel_list, DATATYPE *dest, enum get_block_layouts layout) {*/
+/* The native block interface: Reads as many whole buffer blocks as fit
+ * into BLOCK_READ_BYTES with a single fread and converts them to dest in
+ * one pass. Unlike get_singlepoint, this leaves local_arg->buffer alone. */
+#define BLOCK_READ_BYTES (1<<20)
+LOCAL long
+read_synamps_get_block(transform_info_ptr tinfo, long start_point, long nr_of_points, int const *channel_list, DATATYPE *dest, enum get_block_layouts layout) {
+ struct read_synamps_storage *local_arg=(struct read_synamps_storage *)tinfo->methods->local_storage;
+ int const nr_of_outchannels=get_block_nr_of_channels(tinfo, channel_list);
+ int const points_per_buf=local_arg->EEG.ChannelOffset/local_arg->bytes_per_sample;
+ /* Within a block, sample (point, file_channel) is at file_channel*points_per_buf+point */
+ long const block_bytes=(long)local_arg->EEG.ChannelOffset*local_arg->EEG.nchannels;
+ long const blocks_per_read=(block_bytes>=BLOCK_READ_BYTES ? 1 : BLOCK_READ_BYTES/block_bytes);
+ /* The first file channel is the marker channel in DC-MES */
+ int const first_data_channel=(local_arg->SubType==NST_DCMES ? 1 : 0);
+ long const end_point=(start_point+nr_of_points<local_arg->EEG.NumSamples ? start_point+nr_of_points : local_arg->EEG.NumSamples);
+ int *file_channels;
+ void *readbuf;
+ long point=start_point;
+
+ switch(local_arg->SubType) {
+  case NST_CONT0:
+  case NST_DCMES:
+  case NST_CONTINUOUS:
+  case NST_SYNAMPS:
+   break;
+  default:
+   ERREXIT1(tinfo->emethods, "read_synamps_get_block: Format `%s' is not yet supported\n", MSGPARM(neuroscan_subtype_names[local_arg->SubType]));
+   break;
+ }
+ if (local_arg->bytes_per_sample!=2 && local_arg->bytes_per_sample!=4) {
+  ERREXIT(tinfo->emethods, "read_synamps: Unknown bytes_per_sample\n");
+ }
+ if (end_point<=start_point) return 0;
+
+ /*{{{  Map the output channels to file channels*/
+ if ((file_channels=(int *)malloc((tinfo->nr_of_channels+nr_of_outchannels)*sizeof(int)))==NULL) {
+  ERREXIT(tinfo->emethods, "read_synamps_get_block: Error allocating channel map\n");
+ }
+ {int channel, data_channel=0;
+ /* First all channels read, in the upper part... */
+ for (channel=0; channel<tinfo->nr_of_channels; channel++, data_channel++) {
+  while (local_arg->channel_skip[data_channel]) data_channel++;
+  file_channels[nr_of_outchannels+channel]=data_channel;
+ }
+ /* ... then the selection of them */
+ for (channel=0; channel<nr_of_outchannels; channel++) {
+  file_channels[channel]=file_channels[nr_of_outchannels+(channel_list==NULL ? channel : channel_list[channel]-1)];
+ }
+ }
+ /*}}}  */
+
+ if ((readbuf=malloc(blocks_per_read*block_bytes))==NULL) {
+  free(file_channels);
+  ERREXIT(tinfo->emethods, "read_synamps_get_block: Error allocating read buffer\n");
+ }
+ while (point<end_point) {
+  long const first_block=point/points_per_buf;
+  long const last_block=(end_point-1)/points_per_buf;
+  long const nr_of_blocks=(last_block-first_block+1<blocks_per_read ? last_block-first_block+1 : blocks_per_read);
+  long const chunk_end=((first_block+nr_of_blocks)*points_per_buf<end_point ? (first_block+nr_of_blocks)*points_per_buf : end_point);
+
+  fseek(local_arg->SCAN,local_arg->SizeofHeader+first_block*block_bytes,SEEK_SET);
+  if ((long)fread(readbuf,block_bytes,nr_of_blocks,local_arg->SCAN)!=nr_of_blocks) {
+   free(readbuf);
+   free(file_channels);
+   ERREXIT(tinfo->emethods, "read_synamps_get_block: Error reading data\n");
+  }
+  for (; point<chunk_end; point++) {
+   long const in_block=point%points_per_buf;
+   long const sample0=(point/points_per_buf-first_block)*local_arg->EEG.nchannels*points_per_buf+in_block;
+   long const outpoint=point-start_point;
+   int channel;
+   for (channel=0; channel<nr_of_outchannels; channel++) {
+    int const data_channel=file_channels[channel];
+    long const sample=sample0+(long)(data_channel+first_data_channel)*points_per_buf;
+    long raw;
+    DATATYPE val;
+    if (local_arg->bytes_per_sample==2) {
+     uint16_t word=((uint16_t *)readbuf)[sample];
+#    ifndef LITTLE_ENDIAN
+     Intel_int16(&word);
+#    endif
+     /* DC-MES data is unsigned; Exclusive or to convert to signed */
+     if (first_data_channel==1) word^=0x8000;
+     raw=(int16_t)word;
+    } else {
+     uint32_t dword=((uint32_t *)readbuf)[sample];
+#    ifndef LITTLE_ENDIAN
+     Intel_int32(&dword);
+#    endif
+     raw=(int32_t)dword;
+    }
+    val=NEUROSCAN_CONVSHORT(&local_arg->Channels[data_channel], raw);
+    if (layout==GET_BLOCK_MULTIPLEXED) {
+     dest[outpoint*nr_of_outchannels+channel]=val;
+    } else {
+     dest[channel*nr_of_points+outpoint]=val;
+    }
+   }
+  }
+ }
+ free(readbuf);
+ free(file_channels);
+ local_arg->current_point=end_point;
+ return end_point-start_point;
 }
 /*}}}  */
+/*}}}  */
 
+/*{{{  read_synamps_nexttrigger(transform_info_ptr tinfo, long *trigpoint) {*/
 /*{{{  read_synamps_push_keys(transform_info_ptr tinfo, long *trigpoint) {*/
 /* This subroutine encapsulates the coding of the different event codes
  * into a unified signed code */
@@ -297,6 +401,9 @@ LOCAL void
 read_synamps_build_trigbuffer(transform_info_ptr tinfo) {
  struct read_synamps_storage * const local_arg=(struct read_synamps_storage *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
+ /* Identifies the trigger list in the cache: options that change it go here.
+  * The channel selection (-n, -B) does not, the markers are always read. */
+ char const * const cachekey=(args[ARGS_NOREJECTED].is_set ? "read_synamps -r" : "read_synamps");
 
  if (local_arg->triggers.buffer_start==NULL) {
   growing_buf_allocate(&local_arg->triggers, 0);
@@ -318,7 +425,7 @@ read_synamps_build_trigbuffer(transform_info_ptr tinfo) {
    free_pointer((void **)&description);
   }
   if (triggerfile!=stdin) fclose(triggerfile);
- } else {
+ } else if (!trigger_cache_load(tinfo, args[ARGS_IFILE].arg.s, cachekey, &local_arg->triggers)) {
   switch(local_arg->SubType) {
    case NST_CONTINUOUS:
    case NST_SYNAMPS: {
@@ -374,13 +481,15 @@ read_synamps_build_trigbuffer(transform_info_ptr tinfo) {
    case NST_CONT0: {
     /*{{{  CONT0: Two trailing marker channels*/
     long current_triggerpoint=0;
+    /* The markers follow all data channels in the file, whether read or not */
+    int const marker_channel=local_arg->EEG.nchannels-2;
     unsigned short *pdata;
     TRACEMS(tinfo->emethods, 1, "read_synamps_build_trigbuffer: Analyzing CONT0 marker channels\n");
     while (current_triggerpoint<local_arg->EEG.NumSamples) {
      int TrigVal=0, KeyPad=0, KeyBoard=0;
      enum NEUROSCAN_ACCEPTVALUES Accept=(enum NEUROSCAN_ACCEPTVALUES)0;
      read_synamps_seek_point(tinfo, current_triggerpoint);
-     pdata=(unsigned short *)local_arg->buffer+current_triggerpoint-local_arg->first_point_in_buffer+local_arg->nchannels;
+     pdata=(unsigned short *)local_arg->buffer+current_triggerpoint-local_arg->first_point_in_buffer+marker_channel;
      TrigVal =pdata[0]&0xff; 
      KeyBoard=pdata[1]&0xf; if (KeyBoard>13) KeyBoard=0;
      if (TrigVal!=0 || KeyBoard!=0) {
@@ -389,12 +498,14 @@ read_synamps_build_trigbuffer(transform_info_ptr tinfo) {
       while (current_triggerpoint<local_arg->EEG.NumSamples) {
        int This_TrigVal, This_KeyBoard;
        read_synamps_seek_point(tinfo, current_triggerpoint);
-       pdata=(unsigned short *)local_arg->buffer+current_triggerpoint-local_arg->first_point_in_buffer+local_arg->nchannels;
+       pdata=(unsigned short *)local_arg->buffer+current_triggerpoint-local_arg->first_point_in_buffer+marker_channel;
        This_TrigVal =pdata[0]&0xff; 
        This_KeyBoard=pdata[1]&0xf; if (This_KeyBoard>13) This_KeyBoard=0;
        if (This_TrigVal!=TrigVal || This_KeyBoard!=KeyBoard) break;
        current_triggerpoint++;
       }
+     } else {
+      current_triggerpoint++;
      }
     }
     /*}}}  */
@@ -424,6 +535,8 @@ read_synamps_build_trigbuffer(transform_info_ptr tinfo) {
        if (This_TrigVal!=TrigVal || This_KeyBoard!=KeyBoard) break;
        current_triggerpoint++;
       }
+     } else {
+      current_triggerpoint++;
      }
     }
     /*}}}  */
@@ -432,36 +545,11 @@ read_synamps_build_trigbuffer(transform_info_ptr tinfo) {
    default:
     break;
   }
+  trigger_cache_save(tinfo, args[ARGS_IFILE].arg.s, cachekey, &local_arg->triggers);
  }
 }
 /*}}}  */
 
-/* This is the highest-level access function: Read the next trigger and
- * advance the trigger counter. If this function is not called at least
- * once, event information is not even touched. */
-LOCAL int
-read_synamps_read_trigger(transform_info_ptr tinfo, long *position, char **descriptionp) {
- struct read_synamps_storage *local_arg=(struct read_synamps_storage *)tinfo->methods->local_storage;
- int code=0;
- if (local_arg->triggers.buffer_start==NULL) {
-  /* Load the event information */
-  read_synamps_build_trigbuffer(tinfo);
- }
- {
- int const nevents=local_arg->triggers.current_length/sizeof(struct trigger);
-
- if (local_arg->current_trigger<nevents) {
-  struct trigger * const intrig=((struct trigger *)local_arg->triggers.buffer_start)+local_arg->current_trigger;
-  *position=intrig->position;
-   code    =intrig->code;
-  if (descriptionp!=NULL) *descriptionp=intrig->description;
- }
- }
- local_arg->current_trigger++;
- return code;
-}
-/*}}}  */
-
 /*{{{  read_synamps_init(transform_info_ptr tinfo) {*/
 METHODDEF void
 read_synamps_init(transform_info_ptr tinfo) {
@@ -533,13 +621,38 @@ read_synamps_init(transform_info_ptr tinfo) {
    * channels. */
   local_arg->EEG.nchannels+=2;
  }
- if (args[ARGS_NOBADCHANS].is_set) {
-  int badchans=0;
+ /*{{{  Determine the data channels to skip*/
+ {int skipchans=0;
+ if ((local_arg->channel_skip=(Bool *)calloc(local_arg->nchannels, sizeof(Bool)))==NULL) {
+  ERREXIT(tinfo->emethods, "read_synamps_init: Error allocating channel map\n");
+ }
+ if (args[ARGS_CHANNELNAMES].is_set) {
+  char **channelnames=(char **)malloc(local_arg->nchannels*sizeof(char *));
+  Bool *selected;
+  int nr_selected;
+  if (channelnames==NULL) {
+   ERREXIT(tinfo->emethods, "read_synamps_init: Error allocating channelnames\n");
+  }
+  for (channel=0; channel<local_arg->nchannels; channel++) {
+   channelnames[channel]=local_arg->Channels[channel].lab;
+  }
+  selected=expand_channel_selection(tinfo, args[ARGS_CHANNELNAMES].arg.s, local_arg->nchannels, channelnames, &nr_selected);
   for (channel=0; channel<local_arg->nchannels; channel++) {
-   if (local_arg->Channels[channel].bad) badchans++;
+   local_arg->channel_skip[channel]= !selected[channel];
   }
-  local_arg->nchannels-=badchans;
+  free(selected);
+  free(channelnames);
+ }
+ for (channel=0; channel<local_arg->nchannels; channel++) {
+  if (args[ARGS_NOBADCHANS].is_set && local_arg->Channels[channel].bad) local_arg->channel_skip[channel]=TRUE;
+  if (local_arg->channel_skip[channel]) skipchans++;
  }
+ if (skipchans==local_arg->nchannels) {
+  ERREXIT(tinfo->emethods, "read_synamps_init: No channels left to read\n");
+ }
+ local_arg->nchannels-=skipchans;
+ }
+ /*}}}  */
  tinfo->nr_of_channels=local_arg->nchannels;
  tinfo->itemsize=1;
  /*{{{  Parse arguments that can be in seconds*/
@@ -602,7 +715,9 @@ read_synamps_init(transform_info_ptr tinfo) {
     * ChannelOffset value is not modified, which would severely perturb the data
     * as read by read_synamps! */
    if (local_arg->EEG.ChannelOffset<=1 || local_arg->SubType!=NST_SYNAMPS) local_arg->EEG.ChannelOffset=local_arg->bytes_per_sample;
-   local_arg->BufferCount = local_arg->EEG.ChannelOffset*NoOfChannels;
+   /* EEG.nchannels rather than NoOfChannels, so that the buffer also
+    * holds the CONT0 marker channels */
+   local_arg->BufferCount = local_arg->EEG.ChannelOffset*local_arg->EEG.nchannels;
    if ((local_arg->buffer=malloc(local_arg->BufferCount))==NULL) {
     ERREXIT(tinfo->emethods, "read_synamps_init: Error allocating buffer memory\n");
    }
@@ -631,7 +746,13 @@ read_synamps_init(transform_info_ptr tinfo) {
   local_arg->trigcodes=NULL;
  }
 
- read_synamps_reset_triggerbuffer(tinfo);
+ trigger_epochs_init(&local_arg->trigger_epochs, &local_arg->triggers, &read_synamps_build_trigbuffer);
+ local_arg->trigger_epochs.trigcodes=local_arg->trigcodes;
+ local_arg->trigger_epochs.remap_codes=args[ARGS_KN_REMAP].is_set;
+ local_arg->trigger_epochs.offset=local_arg->offset;
+ local_arg->trigger_epochs.points_in_file=local_arg->EEG.NumSamples;
+ /* get_block() then falls back to the single point interface */
+ if (args[ARGS_SINGLEPOINT].is_set) tinfo->methods->get_block=NULL;
  local_arg->SCAN=SCAN;
  local_arg->current_trigger=0;
  local_arg->current_point=0;
@@ -680,35 +801,22 @@ read_synamps(transform_info_ptr tinfo) {
      trigger_point=file_start_point+tinfo->beforetrig;
      file_end_point=trigger_point+tinfo->aftertrig-1;
      if (file_end_point>=local_arg->EEG.NumSamples) return NULL;
-     local_arg->current_trigger++;
+     local_arg->trigger_epochs.current_trigger++;
      marker=0;
-    } else 
-    do {
-     marker=read_synamps_read_trigger(tinfo, &trigger_point, &description);
+    } else {
+     /* With -K, trigger_epochs_next remaps the codes to 1...n */
+     marker=trigger_epochs_next(tinfo, &local_arg->trigger_epochs, tinfo->beforetrig, tinfo->aftertrig);
      if (marker==0) return NULL;	/* No more triggers in file */
-     file_start_point=trigger_point-tinfo->beforetrig+local_arg->offset;
-     file_end_point=trigger_point+tinfo->aftertrig-1-local_arg->offset;
-     
-     if (local_arg->trigcodes==NULL) {
-      not_correct_trigger=FALSE;
-     } else {
-      int trigno=0;
-      not_correct_trigger=TRUE;
-      while (local_arg->trigcodes[trigno]!=0) {
-       if (local_arg->trigcodes[trigno]==marker) {
-   	not_correct_trigger=FALSE;
-   	if (args[ARGS_KN_REMAP].is_set) marker=trigno+1; /* Remap trigger codes */
-   	break;
-       }
-       trigno++;
-      }
-     }
-    } while (not_correct_trigger || file_start_point<0 || file_end_point>=local_arg->EEG.NumSamples);
+     trigger_point=local_arg->trigger_epochs.trigger_point;
+     file_start_point=local_arg->trigger_epochs.start_point;
+     file_end_point=local_arg->trigger_epochs.end_point;
+     description=local_arg->trigger_epochs.description;
+    }
    } while (--local_arg->fromepoch>0);
    if (description==NULL) {
-    TRACEMS3(tinfo->emethods, 1, "read_synamps: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(marker));
+    TRACEMS3(tinfo->emethods, 1, "read_synamps: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(marker));
    } else {
-    TRACEMS4(tinfo->emethods, 1, "read_synamps: Reading around tag %d at %d, condition=%d, description=%s\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(marker), MSGPARM(description));
+    TRACEMS4(tinfo->emethods, 1, "read_synamps: Reading around tag %d at %d, condition=%d, description=%s\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(marker), MSGPARM(description));
    }
 
    tinfo->condition=marker;
@@ -716,21 +824,7 @@ read_synamps(transform_info_ptr tinfo) {
 
    /*{{{  Handle triggers within the epoch (option -T)*/
    if (args[ARGS_TRIGTRANSFER].is_set) {
-    int code;
-    long trigpoint;
-    long const old_current_trigger=local_arg->current_trigger;
-    char *thisdescription;
-
-    /* First trigger entry holds file_start_point */
-    push_trigger(&tinfo->triggers, file_start_point, -1, NULL);
-    read_synamps_reset_triggerbuffer(tinfo);
-    for (; (code=read_synamps_read_trigger(tinfo, &trigpoint, &thisdescription))!=0;) {
-     if (trigpoint>=file_start_point && trigpoint<=file_end_point) {
-      push_trigger(&tinfo->triggers, trigpoint-file_start_point, code, thisdescription);
-     }
-    }
-    push_trigger(&tinfo->triggers, 0, 0, NULL); /* End of list */
-    local_arg->current_trigger=old_current_trigger;
+    trigger_epochs_transfer(tinfo, &local_arg->trigger_epochs, &tinfo->triggers, file_start_point, file_end_point);
    }
    /*}}}  */
 
@@ -749,10 +843,9 @@ read_synamps(transform_info_ptr tinfo) {
    tinfo->multiplexed=TRUE;
    /*}}}  */
 
-   local_arg->current_point=file_start_point;
-   do {
-    read_synamps_get_singlepoint(tinfo, &myarray);
-   } while (myarray.message!=ARRAY_ENDOFSCAN);
+   if (get_block(tinfo, file_start_point, tinfo->nr_of_points, NULL, myarray.start, GET_BLOCK_MULTIPLEXED)!=tinfo->nr_of_points) {
+    ERREXIT(tinfo->emethods, "read_synamps: Epoch extends beyond the end of the file\n");
+   }
    tinfo->file_start_point=file_start_point;
    }
    break;
@@ -832,7 +925,7 @@ read_synamps(transform_info_ptr tinfo) {
     }
     do {
      DATATYPE val;
-     if (args[ARGS_NOBADCHANS].is_set && local_arg->Channels[channel].bad) {
+     if (local_arg->channel_skip[channel]) {
       myarray.message=ARRAY_CONTINUE;
      } else {
       if (local_arg->bytes_per_sample==2) {
@@ -901,7 +994,7 @@ read_synamps(transform_info_ptr tinfo) {
     ERREXIT(tinfo->emethods, "read_synamps: Error allocating AVG buffer memory\n");
    }
    do {
-    if (args[ARGS_NOBADCHANS].is_set && local_arg->Channels[channel].bad) {
+    if (local_arg->channel_skip[channel]) {
      myarray.message=ARRAY_ENDOFVECTOR;
     } else {
     fseek(local_arg->SCAN,5+start_point*sizeof(float)+channel*(5+local_arg->EEG.pnts*sizeof(float))+local_arg->SizeofHeader,SEEK_SET);
@@ -986,8 +1079,10 @@ read_synamps_exit(transform_info_ptr tinfo) {
  if (local_arg->SubType==NST_DCMES) local_arg->Channels--;
 
  free_pointer((void **)&local_arg->Channels);
+ free_pointer((void **)&local_arg->channel_skip);
  free_pointer((void **)&local_arg->buffer);
  free_pointer((void **)&local_arg->trigcodes);
+ trigger_epochs_free(&local_arg->trigger_epochs);
  if (local_arg->triggers.buffer_start!=NULL) {
   clear_triggers(&local_arg->triggers);
   growing_buf_free(&local_arg->triggers);
@@ -1006,6 +1101,7 @@ select_read_synamps(transform_info_ptr tinfo) {
  tinfo->methods->transform_exit= &read_synamps_exit;
  tinfo->methods->get_singlepoint= &read_synamps_get_singlepoint;
  tinfo->methods->seek_point= &read_synamps_seek_point;
+ tinfo->methods->get_block= &read_synamps_get_block;
  tinfo->methods->get_filestrings= &read_synamps_get_filestrings;
  tinfo->methods->method_type=GET_EPOCH_METHOD;
  tinfo->methods->method_name="read_synamps";
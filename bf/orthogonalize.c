@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2010 Bernd Feige
+ * Copyright (C) 2010,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -8,6 +8,11 @@
  * orthogonalize transform method to successively orthogonalize the input
  * vectors. The first vector remains unmodified.
  * 						-- Bernd Feige 6.08.2010
+ * Option -s performs symmetric (Loewdin) orthogonalization instead, which
+ * does not depend on the order of the vectors: The normalized vectors A=USV'
+ * are replaced by UV', the orthonormal set closest to them in the least
+ * squares sense, and scaled back to their original lengths.
+ * 						-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
@@ -21,10 +26,12 @@
 
 enum ARGS_ENUM {
  ARGS_ORTHOGONALIZE_MAPS=0,
+ ARGS_SYMMETRIC,
  NR_OF_ARGUMENTS
 };
 LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_NOTHING, "Orthogonalize maps instead of time courses", "m", FALSE, NULL},
+ {T_ARGS_TAKES_NOTHING, "Symmetric orthogonalization, treating all vectors alike", "s", FALSE, NULL},
 };
 
 /*{{{  orthogonalize_init(transform_info_ptr tinfo) {*/
@@ -34,6 +41,63 @@ orthogonalize_init(transform_info_ptr tinfo) {
 }
 /*}}}  */
 
+/*{{{  orthogonalize_symmetric(array *a) {*/
+/* Replace the vectors of a by the closest orthogonal set with the same
+ * vector lengths. Sets a->message to ARRAY_ERROR if the vectors are
+ * linearly dependent. */
+LOCAL void
+orthogonalize_symmetric(array *a) {
+ array norms, u, w, v;
+ DATATYPE hold;
+
+ norms.nr_of_elements=u.nr_of_vectors=v.nr_of_vectors=v.nr_of_elements=w.nr_of_elements=a->nr_of_vectors;
+ u.nr_of_elements=a->nr_of_elements;
+ norms.nr_of_vectors=w.nr_of_vectors=1;
+ norms.element_skip=u.element_skip=v.element_skip=w.element_skip=1;
+ if (array_allocate(&norms)==NULL || array_allocate(&u)==NULL || array_allocate(&v)==NULL || array_allocate(&w)==NULL) {
+  array_free(&w); array_free(&v); array_free(&u); array_free(&norms);
+  a->message=ARRAY_ERROR; return;
+ }
+
+ /* Normalize the vectors so that long vectors don't dominate the result */
+ array_reset(a);
+ do {
+  hold=array_abs(a);
+  if (hold==0.0) {
+   array_free(&w); array_free(&v); array_free(&u); array_free(&norms);
+   a->message=ARRAY_ERROR; return;
+  }
+  array_write(&norms, hold);
+  array_previousvector(a);
+  array_scale(a, 1.0/hold);
+ } while (a->message!=ARRAY_ENDOFSCAN);
+
+ array_copy(a, &u);
+ array_svd_leading(&u, &w, &v, u.nr_of_vectors, FALSE);
+ array_reset(&w);
+ if (u.message==ARRAY_ERROR || array_min(&w)<=1e-10*array_max(&w)) {
+  array_free(&w); array_free(&v); array_free(&u); array_free(&norms);
+  a->message=ARRAY_ERROR; return;
+ }
+
+ /* a=U*V' */
+ array_transpose(&u);
+ array_transpose(&v);
+ array_reset(a);
+ do {
+  array_write(a, array_multiply(&u, &v, MULT_SAMESIZE));
+ } while (a->message!=ARRAY_ENDOFSCAN);
+
+ array_reset(&norms);
+ do {
+  array_scale(a, array_scan(&norms));
+ } while (a->message!=ARRAY_ENDOFSCAN);
+ array_reset(a);
+
+ array_free(&w); array_free(&v); array_free(&u); array_free(&norms);
+}
+/*}}}  */
+
 /*{{{  orthogonalize(transform_info_ptr tinfo) {*/
 METHODDEF DATATYPE *
 orthogonalize(transform_info_ptr tinfo) {
@@ -44,7 +108,11 @@ orthogonalize(transform_info_ptr tinfo) {
  if (args[ARGS_ORTHOGONALIZE_MAPS].is_set) {
   array_transpose(&myarray);
  }
- array_make_orthogonal(&myarray);
+ if (args[ARGS_SYMMETRIC].is_set) {
+  orthogonalize_symmetric(&myarray);
+ } else {
+  array_make_orthogonal(&myarray);
+ }
  if (myarray.message==ARRAY_ERROR) {
   ERREXIT(tinfo->emethods, "orthogonalize: Error orthogonalizing vectors\n");
  }
@@ -70,7 +138,9 @@ select_orthogonalize(transform_info_ptr tinfo) {
  tinfo->methods->method_name="orthogonalize";
  tinfo->methods->method_description=
   "Transform method orthogonalizing time courses (default)\n"
-  "or maps\n";
+  "or maps. By default, the vectors are orthogonalized successively\n"
+  "(Gram-Schmidt), leaving the first unmodified; option -s treats all\n"
+  "vectors alike.\n";
  tinfo->methods->local_storage_size=0;
  tinfo->methods->nr_of_arguments=NR_OF_ARGUMENTS;
  tinfo->methods->argument_descriptors=argument_descriptors;
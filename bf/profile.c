@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2026 Bernd Feige
+ * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+ */
+/*
+ * profile.c implements a simple profiler for the methods of a queue. It is
+ * installed as the execution_callback of the external methods (chaining to
+ * a callback that was already set) and accumulates for each method of the
+ * script the number of calls, the data sets it returned or rejected, wall
+ * and CPU time of transform() and of init+exit, and the amount of tsdata
+ * memory that was newly allocated. The throughput of each method is counted
+ * in samples (points*channels*items) of the data set it received, or, for
+ * get-epoch methods, of the data set it delivered. profile_report() prints
+ * this as a table sorted by wall time. The same numbers can be appended to a
+ * result file as tab-separated values, to compare runs of the benchmark
+ * scripts between builds. Optionally, each call is also written as an event to
+ * a trace file in the Chrome trace event format (JSON), which can be
+ * inspected with chrome://tracing or https://ui.perfetto.dev .
+ *	-- Bernd Feige 17.10.2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "transform.h"
+#include "bf.h"
+
+struct profile_entry {
+ int script_number;
+ int line_of_script;
+ char const *method_name;
+ enum method_types method_type;
+ long calls;
+ long accepted;	/* Calls that returned a data set */
+ long rejected;	/* Calls of transform or reject methods that returned none */
+ double wall;	/* Seconds spent in transform() */
+ double cpu;
+ double setup_wall;	/* Seconds spent in init() and exit() */
+ double allocated;	/* Bytes of tsdata newly allocated */
+ double samples;	/* Samples processed by transform() */
+};
+
+LOCAL growing_buf profile_entries;
+LOCAL void (*profile_chained_callback)(const transform_info_ptr tinfo, const execution_callback_place where)=NULL;
+LOCAL FILE *profile_tracefile=NULL;
+LOCAL FILE *profile_resultfile=NULL;
+LOCAL Bool profile_first_event;
+LOCAL double profile_t0, profile_script_t0;
+
+/* Start of the currently executing call, per thread */
+LOCAL double profile_call_wall, profile_call_cpu;
+LOCAL DATATYPE *profile_call_tsdata;
+LOCAL double profile_call_samples;
+#ifdef _OPENMP
+#pragma omp threadprivate(profile_call_wall, profile_call_cpu, profile_call_tsdata, profile_call_samples)
+#endif
+
+/*{{{  Clocks*/
+LOCAL double
+profile_wall_time(void) {
+#ifdef CLOCK_MONOTONIC
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC, &ts);
+ return ts.tv_sec+ts.tv_nsec*1e-9;
+#else
+ return (double)time(NULL);
+#endif
+}
+/* CPU time of the calling thread */
+LOCAL double
+profile_cpu_time(void) {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+ struct timespec ts;
+ clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+ return ts.tv_sec+ts.tv_nsec*1e-9;
+#else
+ return ((double)clock())/CLOCKS_PER_SEC;
+#endif
+}
+/*}}}  */
+
+/*{{{  profile_find_entry(transform_methods_ptr methods)*/
+/* Methods are identified by their script and line, since the parallel
+ * section of the iterated queue runs on copies of the method structs */
+LOCAL struct profile_entry *
+profile_find_entry(transform_methods_ptr methods) {
+ int const nr_of_entries=profile_entries.current_length/sizeof(struct profile_entry);
+ struct profile_entry *entry=(struct profile_entry *)profile_entries.buffer_start;
+ struct profile_entry newentry;
+ int i;
+ for (i=0; i<nr_of_entries; i++, entry++) {
+  if (entry->script_number==methods->script_number && entry->line_of_script==methods->line_of_script && entry->method_name==methods->method_name) return entry;
+ }
+ memset(&newentry, 0, sizeof(newentry));
+ newentry.script_number=methods->script_number;
+ newentry.line_of_script=methods->line_of_script;
+ newentry.method_name=methods->method_name;
+ newentry.method_type=methods->method_type;
+ growing_buf_append(&profile_entries, (char *)&newentry, sizeof(newentry));
+ return ((struct profile_entry *)profile_entries.buffer_start)+nr_of_entries;
+}
+/*}}}  */
+
+/*{{{  profile_trace_event(transform_methods_ptr methods, char const *phase, double start, double duration)*/
+LOCAL void
+profile_trace_event(transform_methods_ptr methods, char const *phase, double start, double duration) {
+ int thread=0;
+#ifdef _OPENMP
+ thread=omp_get_thread_num();
+#endif
+ fprintf(profile_tracefile, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"line\":%d}}",
+  (profile_first_event ? "" : ","), methods->method_name, phase, (start-profile_t0)*1e6, duration*1e6, methods->script_number, thread, methods->line_of_script);
+ profile_first_event=FALSE;
+}
+/*}}}  */
+
+/*{{{  profile_callback(const transform_info_ptr tinfo, const execution_callback_place where)*/
+LOCAL void
+profile_callback(const transform_info_ptr tinfo, const execution_callback_place where) {
+ if (profile_chained_callback!=NULL) (*profile_chained_callback)(tinfo, where);
+ switch (where) {
+  case E_CALLBACK_BEFORE_INIT:
+  case E_CALLBACK_BEFORE_EXEC:
+  case E_CALLBACK_BEFORE_EXIT:
+   profile_call_tsdata=tinfo->tsdata;
+   profile_call_samples=(tinfo->tsdata!=NULL ? ((double)tinfo->nr_of_points)*tinfo->nr_of_channels*tinfo->itemsize : 0.0);
+   profile_call_cpu=profile_cpu_time();
+   profile_call_wall=profile_wall_time();
+   break;
+  case E_CALLBACK_AFTER_INIT:
+  case E_CALLBACK_AFTER_EXEC:
+  case E_CALLBACK_AFTER_EXIT: {
+   double const wall=profile_wall_time()-profile_call_wall;
+   double const cpu=profile_cpu_time()-profile_call_cpu;
+#ifdef _OPENMP
+#pragma omp critical (profile_callback)
+#endif
+   {
+   struct profile_entry * const entry=profile_find_entry(tinfo->methods);
+   if (where==E_CALLBACK_AFTER_EXEC) {
+    entry->calls++;
+    entry->wall+=wall;
+    entry->cpu+=cpu;
+    /* The queue has already stored the result in tinfo->tsdata */
+    if (tinfo->tsdata!=NULL) {
+     entry->accepted++;
+     if (tinfo->tsdata!=profile_call_tsdata) entry->allocated+=((double)tinfo->length_of_output_region)*sizeof(DATATYPE);
+     if (profile_call_samples==0.0) profile_call_samples=((double)tinfo->nr_of_points)*tinfo->nr_of_channels*tinfo->itemsize;
+    } else if (entry->method_type==TRANSFORM_METHOD || entry->method_type==REJECT_METHOD) {
+     entry->rejected++;
+    }
+    entry->samples+=profile_call_samples;
+   } else {
+    entry->setup_wall+=wall;
+   }
+   if (profile_tracefile!=NULL) {
+    profile_trace_event(tinfo->methods, (where==E_CALLBACK_AFTER_INIT ? "init" : where==E_CALLBACK_AFTER_EXEC ? "exec" : "exit"), profile_call_wall, wall);
+   }
+   }
+   }
+   break;
+ }
+}
+/*}}}  */
+
+/*{{{  profile_start(transform_info_ptr tinfo, char const *tracefilename, char const *resultfilename)*/
+/* Install the profiler in tinfo->emethods. If tracefilename is not NULL,
+ * a trace event file is written as well. If resultfilename is not NULL,
+ * the reports are appended to this file as tab-separated values; a header
+ * line is written if the file is new. */
+GLOBAL void
+profile_start(transform_info_ptr tinfo, char const *tracefilename, char const *resultfilename) {
+ external_methods_ptr const emeth=tinfo->emethods;
+ growing_buf_init(&profile_entries);
+ growing_buf_allocate(&profile_entries, 0);
+ profile_chained_callback=emeth->execution_callback;
+ set_external_methods(emeth, emeth->error_exit, emeth->trace_message, &profile_callback);
+ profile_t0=profile_script_t0=profile_wall_time();
+ if (tracefilename!=NULL) {
+  if ((profile_tracefile=fopen(tracefilename, "w"))==NULL) {
+   ERREXIT1(emeth, "profile_start: Can't open trace file %s\n", MSGPARM(tracefilename));
+  }
+  fprintf(profile_tracefile, "{\"traceEvents\":[");
+  profile_first_event=TRUE;
+ }
+ if (resultfilename!=NULL) {
+  if ((profile_resultfile=fopen(resultfilename, "a"))==NULL) {
+   ERREXIT1(emeth, "profile_start: Can't open result file %s\n", MSGPARM(resultfilename));
+  }
+  fseek(profile_resultfile, 0L, SEEK_END);
+  if (ftell(profile_resultfile)==0) {
+   fprintf(profile_resultfile, "script\tline\tmethod\tcalls\taccepted\trejected\twall_s\tcpu_s\tsetup_s\talloc_bytes\tsamples\tsamples_per_s\n");
+  }
+ }
+}
+/*}}}  */
+
+/*{{{  profile_report(transform_info_ptr tinfo, FILE *outfile)*/
+LOCAL int
+profile_compare_wall(const void *a, const void *b) {
+ struct profile_entry const * const ea=(struct profile_entry const *)a;
+ struct profile_entry const * const eb=(struct profile_entry const *)b;
+ if (ea->wall!=eb->wall) return (ea->wall>eb->wall ? -1 : 1);
+ return ea->line_of_script-eb->line_of_script;
+}
+LOCAL double
+profile_samples_per_s(struct profile_entry const *entry) {
+ return (entry->wall>0.0 ? entry->samples/entry->wall : 0.0);
+}
+/* Print the table for the methods executed since the last report, sorted by
+ * the wall time spent in them, and start a new one. In parallel execution,
+ * the times of all threads are summed. */
+GLOBAL void
+profile_report(transform_info_ptr tinfo, FILE *outfile) {
+ int const nr_of_entries=profile_entries.current_length/sizeof(struct profile_entry);
+ struct profile_entry * const entries=(struct profile_entry *)profile_entries.buffer_start;
+ double const now=profile_wall_time();
+ int i;
+
+ if (nr_of_entries==0) return;
+ qsort(entries, nr_of_entries, sizeof(struct profile_entry), profile_compare_wall);
+ fprintf(outfile, "Profile of script %d: %.3fs wall time\n", entries[0].script_number, now-profile_script_t0);
+ fprintf(outfile, "%5s %-22s %8s %8s %8s %10s %10s %10s %10s %10s\n", "Line", "Method", "Calls", "Accepted", "Rejected", "Wall[s]", "CPU[s]", "Setup[s]", "Alloc[MB]", "MSamples/s");
+ for (i=0; i<nr_of_entries; i++) {
+  struct profile_entry const * const entry=entries+i;
+  fprintf(outfile, "%5d %-22s %8ld %8ld %8ld %10.4f %10.4f %10.4f %10.2f %10.2f\n", entry->line_of_script, entry->method_name, entry->calls, entry->accepted, entry->rejected, entry->wall, entry->cpu, entry->setup_wall, entry->allocated/(1024.0*1024.0), profile_samples_per_s(entry)*1e-6);
+  if (profile_resultfile!=NULL) {
+   fprintf(profile_resultfile, "%d\t%d\t%s\t%ld\t%ld\t%ld\t%.6f\t%.6f\t%.6f\t%.0f\t%.0f\t%.1f\n", entry->script_number, entry->line_of_script, entry->method_name, entry->calls, entry->accepted, entry->rejected, entry->wall, entry->cpu, entry->setup_wall, entry->allocated, entry->samples, profile_samples_per_s(entry));
+  }
+ }
+ if (profile_resultfile!=NULL) fflush(profile_resultfile);
+ growing_buf_clear(&profile_entries);
+ profile_script_t0=now;
+}
+/*}}}  */
+
+/*{{{  profile_end(transform_info_ptr tinfo)*/
+/* Uninstall the profiler and close the trace and result files */
+GLOBAL void
+profile_end(transform_info_ptr tinfo) {
+ external_methods_ptr const emeth=tinfo->emethods;
+ set_external_methods(emeth, emeth->error_exit, emeth->trace_message, profile_chained_callback);
+ if (profile_tracefile!=NULL) {
+  fprintf(profile_tracefile, "\n]}\n");
+  fclose(profile_tracefile);
+  profile_tracefile=NULL;
+ }
+ if (profile_resultfile!=NULL) {
+  fclose(profile_resultfile);
+  profile_resultfile=NULL;
+ }
+ growing_buf_free(&profile_entries);
+}
+/*}}}  */
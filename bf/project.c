@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-2001,2004,2010,2014 Bernd Feige
+ * Copyright (C) 1996-2001,2004,2010,2014,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -20,6 +20,10 @@
  * output is the input projected onto the subspace spanned by the maps
  * (signal-space projection). In the latter case, the size of the epoch
  * remains the same.
+ * The projections are done as matrix products over all points of an item
+ * by array_view_multiply (BLAS dgemm if available) whenever the data can
+ * be accessed directly; the vectors are prepared for this in project_init.
+ *	-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
@@ -90,7 +94,17 @@ struct project_args_struct {
  int epochs;
  int points;
  int *channel_list;
+ /* Prepared by project_init: vectors_view describes the maps in vectors;
+  * scalar_view the maps to form the scalar products with, which are copied
+  * to scalar_vectors if they must be restricted to channel_list.
+  * Without have_views, project() uses the array access functions. */
+ array scalar_vectors;
+ Bool have_views;
+ array_view vectors_view;
+ array_view scalar_view;
 };
+/* Number of points to project at once in the subspace modes */
+#define PROJECT_CHUNK 1024
 /*}}}  */
 
 /*{{{  project_init(transform_info_ptr tinfo)*/
@@ -292,6 +306,30 @@ project_init(transform_info_ptr tinfo) {
  }
  /*}}}  */
 
+ /*{{{  Prepare the matrices for project()*/
+ array_reset(vectors);
+ project_args->have_views=array_get_view(vectors, &project_args->vectors_view);
+ project_args->scalar_vectors.start=NULL;
+ if (project_args->channel_list!=NULL && project_args->project_mode!=PROJECT_MODE_MULTIPLY) {
+  /* Unselected channels simply don't contribute to the scalar products */
+  array * const scalar_vectors= &project_args->scalar_vectors;
+  scalar_vectors->nr_of_vectors=vectors->nr_of_vectors;
+  scalar_vectors->nr_of_elements=vectors->nr_of_elements;
+  scalar_vectors->element_skip=1;
+  if (array_allocate(scalar_vectors)==NULL) {
+   ERREXIT(tinfo->emethods, "project_init: Error allocating vectors memory\n");
+  }
+  do {
+   DATATYPE const hold=array_scan(vectors);
+   array_write(scalar_vectors, is_in_channellist(scalar_vectors->current_element+1, project_args->channel_list) ? hold : 0.0);
+  } while (vectors->message!=ARRAY_ENDOFSCAN);
+  array_reset(scalar_vectors);
+  if (!array_get_view(scalar_vectors, &project_args->scalar_view)) project_args->have_views=FALSE;
+ } else {
+  project_args->scalar_view=project_args->vectors_view;
+ }
+ /*}}}  */
+
  (*side_tinfo->methods->transform_exit)(side_tinfo);
  free_methodmem(side_tinfo);
  growing_buf_free(&buf);
@@ -300,6 +338,46 @@ project_init(transform_info_ptr tinfo) {
 }
 /*}}}  */
 
+/*{{{  project_views(struct project_args_struct *project_args, array_view *inview, array_view *scalarview)*/
+/* The scalar, SSP and SSPS modes for one item of all points at once.
+ * inview has the maps as vectors, scalarview one vector of scalars per
+ * point. Returns FALSE if the working memory couldn't be allocated. */
+LOCAL Bool
+project_views(struct project_args_struct *project_args, array_view *inview, array_view *scalarview) {
+ int const nr_of_maps=project_args->vectors_view.nr_of_vectors;
+ array_view maps=project_args->vectors_view, chunk, scalars;
+ DATATYPE *buffer;
+ int point;
+
+ if (project_args->project_mode==PROJECT_MODE_SCALAR) {
+  array_view_multiply(inview, &project_args->scalar_view, scalarview, 1.0, 0.0);
+  return TRUE;
+ }
+
+ /* Compute the scalars for a chunk of points and then replace
+  * (SSP) or reduce (SSPS) the data by the weighted maps */
+ if ((buffer=(DATATYPE *)malloc(PROJECT_CHUNK*nr_of_maps*sizeof(DATATYPE)))==NULL) return FALSE;
+ array_view_transpose(&maps); /* Now the elements are the subspace dimensions */
+ scalars.start=buffer;
+ scalars.element_skip=1;
+ scalars.vector_skip=scalars.nr_of_elements=nr_of_maps;
+ for (point=0; point<inview->nr_of_vectors; point+=PROJECT_CHUNK) {
+  chunk= *inview;
+  chunk.start=ARRAY_VIEW_VECTOR(inview, point);
+  chunk.nr_of_vectors=(point+PROJECT_CHUNK<inview->nr_of_vectors ? PROJECT_CHUNK : inview->nr_of_vectors-point);
+  scalars.nr_of_vectors=chunk.nr_of_vectors;
+  array_view_multiply(&chunk, &project_args->scalar_view, &scalars, 1.0, 0.0);
+  if (project_args->project_mode==PROJECT_MODE_SSP) {
+   array_view_multiply(&scalars, &maps, &chunk, 1.0, 0.0);
+  } else {
+   array_view_multiply(&scalars, &maps, &chunk, -1.0, 1.0);
+  }
+ }
+ free((void *)buffer);
+ return TRUE;
+}
+/*}}}  */
+
 /*{{{  project(transform_info_ptr tinfo)*/
 METHODDEF DATATYPE *
 project(transform_info_ptr tinfo) {
@@ -307,6 +385,7 @@ project(transform_info_ptr tinfo) {
  transform_argument *args=tinfo->methods->arguments;
  DATATYPE *retvalue=tinfo->tsdata;
  array indata, scalars, *vectors= &project_args->vectors;
+ array_view inview, scalarview;
  int itempart, itemparts=tinfo->itemsize-tinfo->leaveright;
 
  if (project_args->project_mode==PROJECT_MODE_MULTIPLY) {
@@ -356,10 +435,16 @@ project(transform_info_ptr tinfo) {
  }
 
  if (project_args->project_mode==PROJECT_MODE_MULTIPLY) {
-  array_transpose(vectors); /* Now the elements are the subspace dimensions */
   for (itempart=0; itempart<itemparts; itempart++) {
    array_use_item(&indata, itempart);
    array_use_item(&scalars, itempart);
+   if (project_args->have_views && array_get_view(&indata, &inview) && array_get_view(&scalars, &scalarview)) {
+    array_view maps=project_args->vectors_view;
+    array_view_transpose(&maps); /* Now the elements are the subspace dimensions */
+    array_view_multiply(&scalarview, &maps, &inview, 1.0, 0.0);
+    continue;
+   }
+   array_transpose(vectors); /* Now the elements are the subspace dimensions */
    do {
     /*{{{  Build the signal subspace vector*/
     do {
@@ -367,8 +452,8 @@ project(transform_info_ptr tinfo) {
     } while (indata.message==ARRAY_CONTINUE);
     /*}}}  */
    } while (indata.message!=ARRAY_ENDOFSCAN);
+   array_transpose(vectors);
   }
-  array_transpose(vectors);
  } else {
 
  if (array_allocate(&scalars)==NULL) {
@@ -380,6 +465,12 @@ project(transform_info_ptr tinfo) {
   if (project_args->project_mode==PROJECT_MODE_SCALAR) {
    array_use_item(&scalars, itempart);
   }
+  if (project_args->have_views && array_get_view(&indata, &inview) && array_get_view(&scalars, &scalarview)) {
+   if (!project_views(project_args, &inview, &scalarview)) {
+    ERREXIT(tinfo->emethods, "project: Can't allocate scalars buffer\n");
+   }
+   continue;
+  }
 
   do {
    /*{{{  Calculate the projection scalars*/
@@ -482,6 +573,9 @@ project_exit(transform_info_ptr tinfo) {
  struct project_args_struct *project_args=(struct project_args_struct *)tinfo->methods->local_storage;
 
  array_free(&project_args->vectors);
+ if (project_args->scalar_vectors.start!=NULL) {
+  array_free(&project_args->scalar_vectors);
+ }
  if (project_args->project_mode==PROJECT_MODE_MULTIPLY) {
   if (project_args->save_side_tinfo.channelnames!=NULL) {
    free_pointer((void **)&project_args->save_side_tinfo.channelnames[0]);
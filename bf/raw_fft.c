@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-1999 Bernd Feige
+ * Copyright (C) 1996-1999,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -38,11 +38,9 @@ raw_fft(transform_info_ptr tinfo) {
    tinfo->nrofshifts=1;
   }
   datasize=tinfo->nroffreq;
-  fftsize=datasize-3;
-  for (i=0; fftsize>>=1; i++);
-  fftsize=1<<(i+2);
-  if (datasize!=fftsize/2+1 || tinfo->nrofshifts!=1) {
-   ERREXIT(tinfo->emethods, "raw_fft: Input spectra must have 2^n+1 frequencies, 2 items and 1 shift\n");
+  fftsize=2*(datasize-1);
+  if (datasize<2 || tinfo->nrofshifts!=1) {
+   ERREXIT(tinfo->emethods, "raw_fft: Input spectra must have n/2+1 frequencies, 2 items and 1 shift\n");
   }
 
   fftarray.nr_of_elements=fftsize;
@@ -60,7 +58,9 @@ raw_fft(transform_info_ptr tinfo) {
   do {
    myarray.current_element=0;
    myarray.current_vector=fftarray.current_vector;
-   realfft(ARRAY_ELEMENT(&myarray), fftsize, -1);
+   if (!realfft(ARRAY_ELEMENT(&myarray), fftsize, -1)) {
+    ERREXIT(tinfo->emethods, "raw_fft: Error allocating FFT memory\n");
+   }
    do {
     array_write(&fftarray, array_scan(&myarray));
    } while (fftarray.message==ARRAY_CONTINUE);
@@ -74,9 +74,9 @@ raw_fft(transform_info_ptr tinfo) {
   if (tinfo->itemsize!=1) {
    ERREXIT(tinfo->emethods, "raw_fft: This method only works on time domain data with 1 item\n");
   }
-  fftsize=datasize-1;	/* This way, the result will be datasize if datasize is a power of 2 */
-  for (i=0; fftsize>>=1; i++);
-  fftsize=1<<(i+1);
+  /* The result will be datasize if datasize is even and has no prime factors
+   * other than 2, 3, 5 and 7 */
+  fftsize=2*fft_good_size((datasize+1)/2, TRUE);
 
   fftarray.nr_of_elements=fftsize+2;	/* 2 more for the additional coefficient */
   fftarray.element_skip=1;
@@ -104,7 +104,9 @@ raw_fft(transform_info_ptr tinfo) {
     array_write(&fftarray, lastval+(firstval-lastval)*i/(fftsize-datasize+1));
    }
    array_previousvector(&fftarray);
-   realfft(ARRAY_ELEMENT(&fftarray), fftsize, 1);
+   if (!realfft(ARRAY_ELEMENT(&fftarray), fftsize, 1)) {
+    ERREXIT(tinfo->emethods, "raw_fft: Error allocating FFT memory\n");
+   }
   } while (myarray.message==ARRAY_ENDOFVECTOR);
   tinfo->itemsize=2;
   tinfo->nr_of_points=tinfo->nroffreq=fftarray.nr_of_elements/2;
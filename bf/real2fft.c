@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1993,1994 Bernd Feige
+ * Copyright (C) 1993,1994,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 #define _XOPEN_SOURCE
@@ -11,9 +11,10 @@
  * real2fft takes two real arrays of length n and returns a complex array p1 
  * of length n+2 containing the positive-frequency parts of both spectra
  * including the coefficients for frequency 0.
+ * Returns FALSE if memory for the transform could not be allocated.
  */
 
-GLOBAL void 
+GLOBAL Bool 
 real2fft(DATATYPE *data1, DATATYPE *data2, complex *p1, int n) {
  int nd2=(n>>1)+1, j;  /* nd2 is the number of complex points per spect */
  int nd2m2=nd2-2;
@@ -24,7 +25,7 @@ real2fft(DATATYPE *data1, DATATYPE *data2, complex *p1, int n) {
   p1[j].Re=data1[j];
   p1[j].Im=data2[j];
  }
- fourier(p1,n,1);
+ if (!fourier(p1,n,1)) return FALSE;
  /* The resulting spectrum will take n points, but when separating it into
   * two positive half spectra, the 0 and maximum frequencies will be doubled
   * because they appear only once in the fourier array.
@@ -51,4 +52,5 @@ real2fft(DATATYPE *data1, DATATYPE *data2, complex *p1, int n) {
   p2[j].Re=  aip;
   p2[j].Im= -rem;
  }
+ return TRUE;
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-2003,2005,2007,2009-2014,2017,2018,2024 Bernd Feige
+ * Copyright (C) 1996-2003,2005,2007,2009-2014,2017,2018,2024,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -8,6 +8,11 @@
  * read_rec.c module to read data from REC format files [Kemp:92]
  * (Data is always continuous)
  *	-- Bernd Feige 17.06.1996
+ * Where available, the file is memory-mapped and epochs are decoded
+ * record by record and channel by channel. Continuous reading declares
+ * the mapping sequential; epochs around triggers access it randomly, and
+ * the records of each epoch are requested ahead of decoding.
+ *	-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
@@ -20,6 +25,9 @@
 #include <unistd.h>
 #endif
 #include <sys/stat.h>
+#ifdef AVG_Q_WITH_MMAP
+#include <sys/mman.h>
+#endif
 #include <read_struct.h>
 #include <Intel_compat.h>
 #include "transform.h"
@@ -36,6 +44,7 @@ enum ARGS_ENUM {
  ARGS_FROMEPOCH, 
  ARGS_EPOCHS,
  ARGS_OFFSET,
+ ARGS_CHANNELNAMES,
  ARGS_IFILE,
  ARGS_BEFORETRIG,
  ARGS_AFTERTRIG,
@@ -49,6 +58,7 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_LONG, "fromepoch: Specify start epoch beginning with 1", "f", 1, NULL},
  {T_ARGS_TAKES_LONG, "epochs: Specify maximum number of epochs to get", "e", 1, NULL},
  {T_ARGS_TAKES_STRING_WORD, "offset: The zero point 'beforetrig' is shifted by offset", "o", ARGDESC_UNUSED, NULL},
+ {T_ARGS_TAKES_STRING_WORD, "channelnames: Only read these channels (in file order)", "n", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_FILENAME, "Input file", "", ARGDESC_UNUSED, (const char *const *)"*.rec"},
  {T_ARGS_TAKES_STRING_WORD, "beforetrig", "", ARGDESC_UNUSED, (const char *const *)"0s"},
  {T_ARGS_TAKES_STRING_WORD, "aftertrig", "", ARGDESC_UNUSED, (const char *const *)"30s"},
@@ -57,10 +67,12 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
 /*{{{  Definition of read_rec_storage*/
 struct read_rec_storage {
  FILE *infile;
+ uint8_t *mapped_file;	/* The whole file if memory-mapped, else NULL */
  int *trigcodes;
- int current_trigger;
  growing_buf triggers;
+ struct trigger_epochs trigger_epochs;
  uint8_t **recordbuf;
+ long *channel_offset;	/* Offset of each channel's samples in a record */
  float *sampling_step;
  int *samples_per_record;
  int total_samples_per_record;
@@ -82,6 +94,9 @@ struct read_rec_storage {
 
  int nr_of_channels;
  int nr_of_signals; /* nr_of_channels minus annotation channels */
+ Bool *signal_selected;	/* Signals selected by -n, NULL if all are read */
+ Bool *channel_selected;	/* The same per channel, FALSE for annotation channels */
+ int nr_of_selected;
  long beforetrig;
  long aftertrig;
  long offset;
@@ -152,13 +167,114 @@ parse_annotation(char **in_annotationp, char *end_annotation, DATATYPE sfreq, lo
  return 1;
 }
 
-/*{{{  Maintaining the triggers list*/
-LOCAL void 
-read_rec_reset_triggerbuffer(transform_info_ptr tinfo) {
+#ifdef AVG_Q_WITH_MMAP
+/*{{{  read_rec_willneed(transform_info_ptr tinfo, long first_record, long last_record) {*/
+/* Tell the kernel that the mapped records first_record..last_record are
+ * about to be read */
+LOCAL void
+read_rec_willneed(transform_info_ptr tinfo, long first_record, long last_record) {
  struct read_rec_storage *local_arg=(struct read_rec_storage *)tinfo->methods->local_storage;
- local_arg->current_trigger=0;
+ long const record_length=local_arg->total_samples_per_record*local_arg->bytes_per_sample;
+ long const pagesize=sysconf(_SC_PAGESIZE);
+ long start=local_arg->bytes_in_header+first_record*record_length;
+ long end=local_arg->bytes_in_header+(last_record+1)*record_length;
+
+ if (end>local_arg->filesize) end=local_arg->filesize;
+ start-=start%pagesize;
+ if (end>start) madvise(local_arg->mapped_file+start, end-start, MADV_WILLNEED);
 }
 /*}}}  */
+#endif
+
+/*{{{  read_rec_get_record(transform_info_ptr tinfo, long record) {*/
+/* Return a pointer to the data of the given record, either within the
+ * memory-mapped file or loaded into recordbuf. NULL if it cannot be read. */
+LOCAL uint8_t *
+read_rec_get_record(transform_info_ptr tinfo, long record) {
+ struct read_rec_storage *local_arg=(struct read_rec_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+ long const record_length=local_arg->total_samples_per_record*local_arg->bytes_per_sample;
+
+ if (local_arg->mapped_file!=NULL) {
+  if (record>=local_arg->nr_of_records) return NULL;
+  return local_arg->mapped_file+local_arg->bytes_in_header+record*record_length;
+ }
+ if (record!=local_arg->current_record) {
+  long samples_read;
+  fseek(local_arg->infile, local_arg->bytes_in_header+record*record_length, SEEK_SET);
+  samples_read=fread(local_arg->recordbuf[0], local_arg->bytes_per_sample, local_arg->total_samples_per_record, local_arg->infile);
+  /* Keep on readin' until an error occurs... That should be EOF... */
+  if (samples_read!=local_arg->total_samples_per_record) {
+   if (samples_read!=0) {
+    TRACEMS1(tinfo->emethods, 0, "read_rec warning: REC file %s appears to be truncated.\n", MSGPARM(args[ARGS_IFILE].arg.s));
+   }
+   local_arg->current_record= -1;
+   return NULL;
+  }
+  local_arg->current_record=record;
+ }
+ return local_arg->recordbuf[0];
+}
+/*}}}  */
+
+/*{{{  read_rec_get_annotation(transform_info_ptr tinfo, long record, int channel) {*/
+/* Read only the bytes of one (annotation) channel of a record. This uses
+ * positioned reads also when the file is mapped, so that scanning the
+ * annotations of a long recording does not page in the whole file. */
+LOCAL char *
+read_rec_get_annotation(transform_info_ptr tinfo, long record, int channel) {
+ struct read_rec_storage *local_arg=(struct read_rec_storage *)tinfo->methods->local_storage;
+ long const record_length=local_arg->total_samples_per_record*local_arg->bytes_per_sample;
+ long const annotation_length=local_arg->samples_per_record[channel]*local_arg->bytes_per_sample;
+ uint8_t * const annotation=local_arg->recordbuf[0]+local_arg->channel_offset[channel];
+
+ if (record>=local_arg->nr_of_records) return NULL;
+ /* recordbuf doesn't hold a complete record any more */
+ local_arg->current_record= -1;
+ fseek(local_arg->infile, local_arg->bytes_in_header+record*record_length+local_arg->channel_offset[channel], SEEK_SET);
+ if ((long)fread(annotation, 1, annotation_length, local_arg->infile)!=annotation_length) return NULL;
+ return (char *)annotation;
+}
+/*}}}  */
+
+/*{{{  Decoding samples*/
+/* Convert n samples of one channel, taken at the sample positions
+ * (int)(i*step) for i=first..first+n-1, to physical units. step==1 (the
+ * channel with the highest sampling rate) is decoded in a plain loop. */
+LOCAL void
+read_rec_decode(uint8_t const *channeldata, int bytes_per_sample, long first, long n, float step, DATATYPE offset, DATATYPE factor, DATATYPE *out) {
+ long i;
+ if (bytes_per_sample==2) {
+  int16_t const *in=(int16_t const *)channeldata;
+  if (step==1.0) {
+   in+=first;
+   for (i=0; i<n; i++) {
+    int16_t sample16=in[i];
+#   ifndef LITTLE_ENDIAN
+    Intel_int16((uint16_t *)&sample16);
+#   endif
+    out[i]=offset+factor*(int32_t)sample16;
+   }
+  } else {
+   for (i=0; i<n; i++) {
+    int16_t sample16=in[(int)((first+i)*step)];
+#   ifndef LITTLE_ENDIAN
+    Intel_int16((uint16_t *)&sample16);
+#   endif
+    out[i]=offset+factor*(int32_t)sample16;
+   }
+  }
+ } else {
+  /* 24 bit little-endian, sign-extended */
+  for (i=0; i<n; i++) {
+   uint8_t const * const samplepos=channeldata+3*(step==1.0 ? first+i : (int)((first+i)*step));
+   int32_t const sample=(int32_t)((uint32_t)samplepos[0] | ((uint32_t)samplepos[1]<<8) | ((uint32_t)samplepos[2]<<16) | ((samplepos[2]&0x80) ? 0xff000000U : 0U));
+   out[i]=offset+factor*sample;
+  }
+ }
+}
+/*}}}  */
+
 /*{{{  read_rec_build_trigbuffer(transform_info_ptr tinfo) {*/
 /* This function has all the knowledge about events in the various file types */
 LOCAL void 
@@ -189,32 +305,27 @@ read_rec_build_trigbuffer(transform_info_ptr tinfo) {
  } else {
   if (local_arg->nr_of_channels==local_arg->nr_of_signals) {
    TRACEMS(tinfo->emethods, 0, "read_rec_build_trigbuffer: No trigger source known.\n");
-  } else {
+  } else if (!trigger_cache_load(tinfo, args[ARGS_IFILE].arg.s, "read_rec", &local_arg->triggers)) {
    long startrecord=0;
    growing_buf description;
    growing_buf_init(&description);
    growing_buf_allocate(&description,0);
-   /* We have to read the whole file... */
+   /* We have to visit every record, but only the annotation bytes are read */
+   TRACEMS(tinfo->emethods, 1, "read_rec_build_trigbuffer: Scanning annotations\n");
    while (startrecord<local_arg->nr_of_records) {
-    long const filepos=local_arg->bytes_in_header+startrecord*local_arg->total_samples_per_record*local_arg->bytes_per_sample;
-    long samples_read;
     int channel;
-    fseek(local_arg->infile, filepos, SEEK_SET);
-    samples_read=fread(local_arg->recordbuf[0], local_arg->bytes_per_sample, local_arg->total_samples_per_record, local_arg->infile);
-    /* Keep on readin' until an error occurs... That should be EOF... */
-    if (samples_read!=local_arg->total_samples_per_record) {
-     if (samples_read!=0) {
-      TRACEMS1(tinfo->emethods, 0, "read_rec warning: REC file %s appears to be truncated.\n", MSGPARM(args[ARGS_IFILE].arg.s));
-     }
-     break;
-    }
     for (channel=0; channel<local_arg->nr_of_channels; channel++) {
      if (is_annotation(local_arg,channel)) {
-      char * in_annotation=(char *)local_arg->recordbuf[channel];
-      /* Last byte of annotation! */
-      char * const end_annotation=in_annotation+local_arg->bytes_per_sample*local_arg->samples_per_record[channel]-1;
+      char * in_annotation=read_rec_get_annotation(tinfo, startrecord, channel);
+      char * end_annotation;
       int code;
       long trigpoint=0L, duration=0L;
+      if (in_annotation==NULL) {
+       /* Don't leave a truncated trigger list behind in the cache */
+       ERREXIT1(tinfo->emethods, "read_rec_build_trigbuffer: Error reading annotations of record %ld\n", MSGPARM(startrecord));
+      }
+      /* Last byte of annotation! */
+      end_annotation=in_annotation+local_arg->bytes_per_sample*local_arg->samples_per_record[channel]-1;
       while (TRUE) {
        growing_buf_clear(&description);
        if ((code=parse_annotation(&in_annotation,end_annotation,tinfo->sfreq,&trigpoint,&duration,&description))==0) break;
@@ -230,36 +341,11 @@ read_rec_build_trigbuffer(transform_info_ptr tinfo) {
     startrecord++;
    }
    growing_buf_free(&description);
+   trigger_cache_save(tinfo, args[ARGS_IFILE].arg.s, "read_rec", &local_arg->triggers);
   }
  }
 }
 /*}}}  */
-/*{{{  read_rec_read_trigger(transform_info_ptr tinfo) {*/
-/* This is the highest-level access function: Read the next trigger and
- * advance the trigger counter. If this function is not called at least
- * once, event information is not even touched. */
-LOCAL int
-read_rec_read_trigger(transform_info_ptr tinfo, long *position, char **descriptionp) {
- struct read_rec_storage *local_arg=(struct read_rec_storage *)tinfo->methods->local_storage;
- int code=0;
- if (local_arg->triggers.buffer_start==NULL) {
-  /* Load the event information */
-  read_rec_build_trigbuffer(tinfo);
- }
- {
- int const nevents=local_arg->triggers.current_length/sizeof(struct trigger);
-
- if (local_arg->current_trigger<nevents) {
-  struct trigger * const intrig=((struct trigger *)local_arg->triggers.buffer_start)+local_arg->current_trigger;
-  *position=intrig->position;
-   code    =intrig->code;
-  if (descriptionp!=NULL) *descriptionp=intrig->description;
- }
- }
- local_arg->current_trigger++;
- return code;
-}
-/*}}}  */
 
 /*{{{  read_rec_init(transform_info_ptr tinfo) {*/
 METHODDEF void
@@ -356,7 +442,8 @@ read_rec_init(transform_info_ptr tinfo) {
      (local_arg->recordbuf[0]=(uint8_t *)malloc(local_arg->total_samples_per_record*local_arg->bytes_per_sample))==NULL) {
   ERREXIT(tinfo->emethods, "read_rec_init: Error allocating recordbuf memory\n");
  }
- if ((local_arg->sampling_step=(float *)malloc(local_arg->nr_of_channels*sizeof(float)))==NULL) {
+ if ((local_arg->sampling_step=(float *)malloc(local_arg->nr_of_channels*sizeof(float)))==NULL ||
+     (local_arg->channel_offset=(long *)malloc(local_arg->nr_of_channels*sizeof(long)))==NULL) {
   ERREXIT(tinfo->emethods, "read_rec_init: Error allocating sampling_step array\n");
  }
  /* We're at the start, need to load a fresh data record */
@@ -382,6 +469,7 @@ read_rec_init(transform_info_ptr tinfo) {
   if (channel>=1) {
    local_arg->recordbuf[channel]=local_arg->recordbuf[channel-1]+local_arg->bytes_per_sample*local_arg->samples_per_record[channel-1];
   }
+  local_arg->channel_offset[channel]=local_arg->recordbuf[channel]-local_arg->recordbuf[0];
   
   local_arg->sampling_step[channel]=((float)local_arg->samples_per_record[channel])/local_arg->max_samples_per_record;
  }
@@ -390,6 +478,32 @@ read_rec_init(transform_info_ptr tinfo) {
  free((void *)channelheader.label);
  /*}}}  */
 
+ /*{{{  Resolve the channel selection against the signal (non-annotation) channels*/
+ {char **signalnames=(char **)malloc(local_arg->nr_of_signals*sizeof(char *));
+ int signal=0;
+ if ((local_arg->channel_selected=(Bool *)malloc(local_arg->nr_of_channels*sizeof(Bool)))==NULL || signalnames==NULL) {
+  ERREXIT(tinfo->emethods, "read_rec_init: Error allocating channel map\n");
+ }
+ for (channel=0; channel<local_arg->nr_of_channels; channel++) {
+  if (!is_annotation(local_arg,channel)) signalnames[signal++]=local_arg->channelnames[channel];
+ }
+ local_arg->signal_selected=NULL;
+ local_arg->nr_of_selected=local_arg->nr_of_signals;
+ if (args[ARGS_CHANNELNAMES].is_set) {
+  local_arg->signal_selected=expand_channel_selection(tinfo, args[ARGS_CHANNELNAMES].arg.s, local_arg->nr_of_signals, signalnames, &local_arg->nr_of_selected);
+ }
+ free(signalnames);
+ for (signal=channel=0; channel<local_arg->nr_of_channels; channel++) {
+  if (is_annotation(local_arg,channel)) {
+   local_arg->channel_selected[channel]=FALSE;
+  } else {
+   local_arg->channel_selected[channel]=(local_arg->signal_selected==NULL || local_arg->signal_selected[signal]);
+   signal++;
+  }
+ }
+ }
+ /*}}}  */
+
  /*{{{  Determine the file size*/
  if (ftell(local_arg->infile)!=local_arg->bytes_in_header) {
   TRACEMS2(tinfo->emethods, 0, "read_rec_init: Position after header is %d, bytes_in_header field was %d\n", MSGPARM(ftell(local_arg->infile)), MSGPARM(local_arg->bytes_in_header));
@@ -409,6 +523,21 @@ read_rec_init(transform_info_ptr tinfo) {
  local_arg->points_in_file=tinfo->points_in_file=local_arg->nr_of_records*local_arg->max_samples_per_record;
  /*}}}  */
 
+ local_arg->mapped_file=NULL;
+#ifdef AVG_Q_WITH_MMAP
+ /*{{{  Map the file into memory if possible, otherwise records are read with fread*/
+ if (local_arg->filesize>0) {
+  void * const mapped=mmap(NULL, local_arg->filesize, PROT_READ, MAP_PRIVATE, fileno(local_arg->infile), 0);
+  if (mapped==MAP_FAILED) {
+   TRACEMS(tinfo->emethods, 1, "read_rec_init: Cannot map the file, reading records instead.\n");
+  } else {
+   local_arg->mapped_file=(uint8_t *)mapped;
+   madvise(mapped, local_arg->filesize, args[ARGS_CONTINUOUS].is_set ? MADV_SEQUENTIAL : MADV_RANDOM);
+  }
+ }
+ /*}}}  */
+#endif
+
  TRACEMS3(tinfo->emethods, 1, "read_rec_init: Opened REC file %s with %d channels, Sfreq=%d.\n", MSGPARM(args[ARGS_IFILE].arg.s), MSGPARM(local_arg->nr_of_channels), MSGPARM(local_arg->sfreq));
  
  /*{{{  Process arguments that can be in seconds*/
@@ -436,8 +565,10 @@ read_rec_init(transform_info_ptr tinfo) {
   }
  }
 
- read_rec_reset_triggerbuffer(tinfo);
- local_arg->current_trigger=0;
+ trigger_epochs_init(&local_arg->trigger_epochs, &local_arg->triggers, &read_rec_build_trigbuffer);
+ local_arg->trigger_epochs.trigcodes=local_arg->trigcodes;
+ local_arg->trigger_epochs.offset=local_arg->offset;
+ local_arg->trigger_epochs.points_in_file=local_arg->points_in_file;
  local_arg->current_record= -1; /* No record is currently loaded */
  local_arg->current_point=0;
 
@@ -453,7 +584,7 @@ read_rec(transform_info_ptr tinfo) {
  char *innamebuf;
  int channel, point, signal;
  array myarray;
- Bool not_correct_trigger=FALSE;
+ array_view view;
  long trigger_point, file_start_point, file_end_point;
  char *description=NULL;
 
@@ -461,7 +592,7 @@ read_rec(transform_info_ptr tinfo) {
  tinfo->beforetrig=local_arg->beforetrig;
  tinfo->aftertrig=local_arg->aftertrig;
  tinfo->nr_of_points=local_arg->beforetrig+local_arg->aftertrig;
- tinfo->nr_of_channels=local_arg->nr_of_signals;
+ tinfo->nr_of_channels=local_arg->nr_of_selected;
  tinfo->nrofaverages=1;
  if (tinfo->nr_of_points<=0) {
   ERREXIT1(tinfo->emethods, "read_rec: Invalid nr_of_points %d\n", MSGPARM(tinfo->nr_of_points));
@@ -477,120 +608,74 @@ read_rec(transform_info_ptr tinfo) {
    trigger_point=file_start_point+tinfo->beforetrig;
    file_end_point=trigger_point+tinfo->aftertrig-1;
    if (local_arg->points_in_file>0 && file_end_point>=local_arg->points_in_file) return NULL;
-   local_arg->current_trigger++;
+   local_arg->trigger_epochs.current_trigger++;
    local_arg->current_point+=tinfo->nr_of_points;
    tinfo->condition=0;
-  } else 
-  do {
-   tinfo->condition=read_rec_read_trigger(tinfo, &trigger_point, &description);
+  } else {
+   tinfo->condition=trigger_epochs_next(tinfo, &local_arg->trigger_epochs, tinfo->beforetrig, tinfo->aftertrig);
    if (tinfo->condition==0) return NULL;	/* No more triggers in file */
-   file_start_point=trigger_point-tinfo->beforetrig+local_arg->offset;
-   file_end_point=trigger_point+tinfo->aftertrig-1-local_arg->offset;
-   
-   if (local_arg->trigcodes==NULL) {
-    not_correct_trigger=FALSE;
-   } else {
-    int trigno=0;
-    not_correct_trigger=TRUE;
-    while (local_arg->trigcodes[trigno]!=0) {
-     if (local_arg->trigcodes[trigno]==tinfo->condition) {
-      not_correct_trigger=FALSE;
-      break;
-     }
-     trigno++;
-    }
-   }
-  } while (not_correct_trigger || file_start_point<0 || (local_arg->points_in_file>0 && file_end_point>=local_arg->points_in_file));
+   trigger_point=local_arg->trigger_epochs.trigger_point;
+   file_start_point=local_arg->trigger_epochs.start_point;
+   file_end_point=local_arg->trigger_epochs.end_point;
+   description=local_arg->trigger_epochs.description;
+  }
  } while (--local_arg->fromepoch>0);
  if (description==NULL) {
-  TRACEMS3(tinfo->emethods, 1, "read_rec: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
+  TRACEMS3(tinfo->emethods, 1, "read_rec: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
  } else {
-  TRACEMS4(tinfo->emethods, 1, "read_rec: Reading around tag %d at %d, condition=%d, description=%s\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition), MSGPARM(description));
+  TRACEMS4(tinfo->emethods, 1, "read_rec: Reading around tag %d at %d, condition=%d, description=%s\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition), MSGPARM(description));
  }
  /*}}}  */
 
  /*{{{  Handle triggers within the epoch (option -T)*/
  if (args[ARGS_TRIGTRANSFER].is_set) {
-  int code;
-  long trigpoint;
-  long const old_current_trigger=local_arg->current_trigger;
-  char *thisdescription;
-
-  /* First trigger entry holds file_start_point */
-  push_trigger(&tinfo->triggers, file_start_point, -1, NULL);
-  read_rec_reset_triggerbuffer(tinfo);
-  for (; (code=read_rec_read_trigger(tinfo, &trigpoint, &thisdescription))!=0;) {
-   if (trigpoint>=file_start_point && trigpoint<=file_end_point) {
-    push_trigger(&tinfo->triggers, trigpoint-file_start_point, code, thisdescription);
-   }
-  }
-  push_trigger(&tinfo->triggers, 0, 0, NULL); /* End of list */
-  local_arg->current_trigger=old_current_trigger;
+  trigger_epochs_transfer(tinfo, &local_arg->trigger_epochs, &tinfo->triggers, file_start_point, file_end_point);
  }
  /*}}}  */
 
  /*{{{  Setup and allocate myarray*/
  myarray.element_skip=tinfo->itemsize=1;
- myarray.nr_of_vectors=tinfo->nr_of_points;
- myarray.nr_of_elements=tinfo->nr_of_channels;
+ myarray.nr_of_vectors=tinfo->nr_of_channels;
+ myarray.nr_of_elements=tinfo->nr_of_points;
  if (tinfo->nr_of_points<=0) {
   ERREXIT1(tinfo->emethods, "read_rec: Invalid nr_of_points %d\n", MSGPARM(tinfo->nr_of_points));
  }
  tinfo->length_of_output_region=tinfo->nr_of_points*tinfo->nr_of_channels;
- if (array_allocate(&myarray)==NULL) {
+ if (array_allocate(&myarray)==NULL || !array_get_view(&myarray, &view)) {
   ERREXIT(tinfo->emethods, "read_rec: Error allocating data\n");
  }
- /* Byte order is multiplexed, ie channels fastest */
- tinfo->multiplexed=TRUE;
+ /* Each channel is decoded as a whole, so that the data is not multiplexed */
+ tinfo->multiplexed=FALSE;
  /*}}}  */
 
- for (point=0; point<tinfo->nr_of_points; point++) {
-  long samples_read;
-  /*{{{  Read a new record if necessary*/
+ /*{{{  Decode the epoch record by record*/
+#ifdef AVG_Q_WITH_MMAP
+ if (local_arg->mapped_file!=NULL && !args[ARGS_CONTINUOUS].is_set) {
+  read_rec_willneed(tinfo, file_start_point/local_arg->max_samples_per_record, (file_start_point+tinfo->nr_of_points-1)/local_arg->max_samples_per_record);
+ }
+#endif
+ for (point=0; point<tinfo->nr_of_points; ) {
   ldiv_t const d=ldiv(file_start_point+point, local_arg->max_samples_per_record);
-  long const startrecord=d.quot;
-  local_arg->current_sample=d.rem;
-  if (startrecord!=local_arg->current_record) {
-   long const filepos=local_arg->bytes_in_header+startrecord*local_arg->total_samples_per_record*local_arg->bytes_per_sample;
-   fseek(local_arg->infile, filepos, SEEK_SET);
-   samples_read=fread(local_arg->recordbuf[0], local_arg->bytes_per_sample, local_arg->total_samples_per_record, local_arg->infile);
-   /* Keep on readin' until an error occurs... That should be EOF... */
-   if (samples_read!=local_arg->total_samples_per_record) {
-    if (samples_read!=0) {
-     TRACEMS1(tinfo->emethods, 0, "read_rec warning: REC file %s appears to be truncated.\n", MSGPARM(args[ARGS_IFILE].arg.s));
-    }
-    array_free(&myarray);
-    return NULL;
-   }
-   local_arg->current_record=startrecord;
+  long const n=(local_arg->max_samples_per_record-d.rem<tinfo->nr_of_points-point ? local_arg->max_samples_per_record-d.rem : tinfo->nr_of_points-point);
+  uint8_t * const record=read_rec_get_record(tinfo, d.quot);
+  if (record==NULL) {
+   array_free(&myarray);
+   return NULL;
   }
-  /*}}}  */
-  for (channel=0; channel<local_arg->nr_of_channels; channel++) {
-   if (!is_annotation(local_arg,channel)) {
-    int32_t sample;
-    uint8_t * const samplepos=local_arg->recordbuf[channel]+(int)(local_arg->current_sample*local_arg->sampling_step[channel])*local_arg->bytes_per_sample;
-    if (local_arg->bytes_per_sample==3) {
-     memcpy(&sample,samplepos,3);
-     ((uint8_t *)&sample)[3]=((((uint8_t *)&sample)[2]&'\x80') ? '\xff' : '\x00');
-#   ifndef LITTLE_ENDIAN
-     Intel_int32((uint32_t *)&sample);
-#   endif
-    } else {
-     int16_t sample16=*(int16_t *)samplepos;
-#   ifndef LITTLE_ENDIAN
-     Intel_int16((uint16_t *)&sample16);
-#   endif
-     sample=(int32_t)sample16;
-    }
-    array_write(&myarray, local_arg->rec_offset[channel]+local_arg->rec_factor[channel]*sample);
+  for (signal=channel=0; channel<local_arg->nr_of_channels; channel++) {
+   if (local_arg->channel_selected[channel]) {
+    read_rec_decode(record+local_arg->channel_offset[channel], local_arg->bytes_per_sample, d.rem, n, local_arg->sampling_step[channel], local_arg->rec_offset[channel], local_arg->rec_factor[channel], ARRAY_VIEW_VECTOR(&view, signal)+point);
+    signal++;
    }
   }
-  local_arg->current_sample++;
+  point+=n;
  }
+ /*}}}  */
  
  /*{{{  Allocate and copy channelnames and comment; Set positions on a grid*/
  tinfo->xdata=NULL;
  tinfo->probepos=NULL;
+ tinfo->nr_of_channels=local_arg->nr_of_signals;
  if ((tinfo->channelnames=(char **)malloc(tinfo->nr_of_channels*sizeof(char *)))==NULL ||
      (tinfo->comment=(char *)malloc(strlen(local_arg->comment)+1))==NULL ||
      (innamebuf=(char *)malloc(local_arg->channelnames_length))==NULL) {
@@ -604,6 +689,7 @@ read_rec(transform_info_ptr tinfo) {
   }
  }
  create_channelgrid(tinfo);
+ if (local_arg->signal_selected!=NULL) select_channelinfo(tinfo, local_arg->signal_selected);
  strcpy(tinfo->comment, local_arg->comment);
  /*}}}  */
 
@@ -626,12 +712,21 @@ read_rec_exit(transform_info_ptr tinfo) {
  struct read_rec_storage *local_arg=(struct read_rec_storage *)tinfo->methods->local_storage;
 
  fclose(local_arg->infile);
+#ifdef AVG_Q_WITH_MMAP
+ if (local_arg->mapped_file!=NULL) {
+  munmap((void *)local_arg->mapped_file, local_arg->filesize);
+  local_arg->mapped_file=NULL;
+ }
+#endif
  if (local_arg->recordbuf!=NULL) {
   free_pointer((void **)&local_arg->recordbuf[0]);
   free_pointer((void **)&local_arg->recordbuf);
  }
  free_pointer((void **)&local_arg->samples_per_record);
  free_pointer((void **)&local_arg->sampling_step);
+ free_pointer((void **)&local_arg->channel_offset);
+ free_pointer((void **)&local_arg->channel_selected);
+ free_pointer((void **)&local_arg->signal_selected);
  if (local_arg->channelnames!=NULL) {
   free_pointer((void **)&local_arg->channelnames[0]);
   free_pointer((void **)&local_arg->channelnames);
@@ -641,6 +736,7 @@ read_rec_exit(transform_info_ptr tinfo) {
  free_pointer((void **)&local_arg->comment);
  free_pointer((void **)&local_arg->trigcodes);
 
+ trigger_epochs_free(&local_arg->trigger_epochs);
  if (local_arg->triggers.buffer_start!=NULL) {
   clear_triggers(&local_arg->triggers);
   growing_buf_free(&local_arg->triggers);
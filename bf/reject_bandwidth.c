@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-1999,2001,2003,2004,2013,2017,2025 Bernd Feige
+ * Copyright (C) 1996-1999,2001,2003,2004,2013,2017,2025,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -340,6 +340,7 @@ select_reject_bandwidth(transform_info_ptr tinfo) {
  tinfo->methods->transform= &reject_bandwidth;
  tinfo->methods->transform_exit= &reject_bandwidth_exit;
  tinfo->methods->method_type=REJECT_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="reject_bandwidth";
  tinfo->methods->method_description=
   "Rejection method to reject any epoch with a bandwidth (max-min value) of\n"
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-1999,2001 Bernd Feige
+ * Copyright (C) 1996-1999,2001,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -60,6 +60,7 @@ select_reject_flor(transform_info_ptr tinfo) {
  tinfo->methods->transform= &reject_flor;
  tinfo->methods->transform_exit= &reject_flor_exit;
  tinfo->methods->method_type=REJECT_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="reject_flor";
  tinfo->methods->method_description=
   "Rejection method to reject any epoch containing the Tuebingen error"
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-2001,2003,2004,2013 Bernd Feige
+ * Copyright (C) 1996-2001,2003,2004,2013,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -304,6 +304,7 @@ select_remove_channel(transform_info_ptr tinfo) {
  tinfo->methods->transform= &remove_channel;
  tinfo->methods->transform_exit= &remove_channel_exit;
  tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="remove_channel";
  tinfo->methods->method_description=
   "Transform method to remove a single channel or a range of\n"
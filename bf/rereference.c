@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-1999,2001,2019 Bernd Feige
+ * Copyright (C) 1996-1999,2001,2019,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -8,6 +8,10 @@
  * rereference.c method to subtract the mean across a number of reference
  *  channels from all channels
  *	-- Bernd Feige 29.12.1995
+ * The subtraction is compiled into a sparse channel operator for each epoch,
+ * so that the reference mean is computed once per point instead of looking
+ * up the channel lists for each value.
+ *	-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
@@ -36,6 +40,7 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
 struct rereference_args_struct {
  int *refchannel_numbers;
  int *excludechannel_numbers;
+ struct channel_operator op;
 };
 /*}}}  */
 
@@ -46,6 +51,7 @@ rereference_init(transform_info_ptr tinfo) {
 
  rereference_args->refchannel_numbers=NULL;
  rereference_args->excludechannel_numbers=NULL;
+ channel_operator_init(&rereference_args->op);
 
  tinfo->methods->init_done=TRUE;
 }
@@ -56,9 +62,9 @@ METHODDEF DATATYPE *
 rereference(transform_info_ptr tinfo) {
  struct rereference_args_struct *rereference_args=(struct rereference_args_struct *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
- int itempart;
- transform_info_ptr const tinfoptr=tinfo;
- array indata;
+ int itempart, channel, nr_of_refs;
+ array_view view;
+ Bool ok;
 
  /* Re-do the channel lists for each epoch since the channel names could change between epochs */
  free_pointer((void **)&rereference_args->refchannel_numbers);
@@ -76,34 +82,39 @@ rereference(transform_info_ptr tinfo) {
   rereference_args->excludechannel_numbers=NULL;
  }
 
-  tinfo_array(tinfoptr, &indata);
-  array_transpose(&indata);	/* Vector=map */
-  for (itempart=0; itempart<tinfoptr->itemsize-tinfoptr->leaveright; itempart++) {
-   array_use_item(&indata, itempart);
-   do {
-    DATATYPE mean=0;
-    int n=0;
+ /*{{{  Compile the operator: The sum of the reference channels is computed
+  * once in an intermediate row, the output rows subtract its mean*/
+ nr_of_refs=0;
+ for (channel=0; channel<tinfo->nr_of_channels; channel++) {
+  if (is_in_channellist(channel+1, rereference_args->refchannel_numbers)) nr_of_refs++;
+ }
+ channel_operator_reset(&rereference_args->op, tinfo->nr_of_channels, 1);
+ ok=channel_operator_new_row(&rereference_args->op);
+ for (channel=0; ok && channel<tinfo->nr_of_channels; channel++) {
+  if (is_in_channellist(channel+1, rereference_args->refchannel_numbers)) {
+   ok=channel_operator_add(&rereference_args->op, channel, 1.0);
+  }
+ }
+ for (channel=0; ok && channel<tinfo->nr_of_channels; channel++) {
+  ok=channel_operator_new_row(&rereference_args->op) && channel_operator_add(&rereference_args->op, channel, 1.0);
+  if (ok && !(args[ARGS_EXCLUDEOTHER].is_set && !is_in_channellist(channel+1, rereference_args->refchannel_numbers))
+   && !is_in_channellist(channel+1, rereference_args->excludechannel_numbers)) {
+   ok=channel_operator_add(&rereference_args->op, CHANNEL_OPERATOR_ROW(&rereference_args->op, 0), -1.0/nr_of_refs);
+  }
+ }
+ if (!ok) {
+  ERREXIT(tinfo->emethods, "rereference: Error allocating the channel operator\n");
+ }
+ /*}}}  */
 
-    do {
-     if (is_in_channellist(indata.current_element+1, rereference_args->refchannel_numbers)) {
-      mean+=array_scan(&indata);
-      n++;
-     } else {
-      array_advance(&indata);
-     }
-    } while (indata.message==ARRAY_CONTINUE);
-    mean/=n;
-    array_previousvector(&indata);
-    do {
-     if ((args[ARGS_EXCLUDEOTHER].is_set && !is_in_channellist(indata.current_element+1, rereference_args->refchannel_numbers)) 
-      || is_in_channellist(indata.current_element+1, rereference_args->excludechannel_numbers)) {
-      array_advance(&indata);
-     } else {
-      array_write(&indata, READ_ELEMENT(&indata)-mean);
-     }
-    } while (indata.message==ARRAY_CONTINUE);
-   } while (indata.message!=ARRAY_ENDOFSCAN);
+ tinfo_array_view(tinfo, &view);
+ for (itempart=0; itempart<tinfo->itemsize-tinfo->leaveright; itempart++) {
+  array_view itemview=view;
+  itemview.start+=itempart;
+  if (!channel_operator_apply(&rereference_args->op, &itemview, &itemview)) {
+   ERREXIT(tinfo->emethods, "rereference: Error allocating memory\n");
   }
+ }
 
  return tinfo->tsdata;
 }
@@ -116,6 +127,7 @@ rereference_exit(transform_info_ptr tinfo) {
 
  free_pointer((void **)&rereference_args->refchannel_numbers);
  free_pointer((void **)&rereference_args->excludechannel_numbers);
+ channel_operator_free(&rereference_args->op);
 
  tinfo->methods->init_done=FALSE;
 }
@@ -128,6 +140,7 @@ select_rereference(transform_info_ptr tinfo) {
  tinfo->methods->transform= &rereference;
  tinfo->methods->transform_exit= &rereference_exit;
  tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="rereference";
  tinfo->methods->method_description=
   "Method to subtract the mean of a number of reference channels from\n"
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-1999,2001-2005,2009,2011,2014 Bernd Feige
+ * Copyright (C) 1996-1999,2001-2005,2009,2011,2014,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -348,6 +348,7 @@ select_scale_by(transform_info_ptr tinfo) {
  tinfo->methods->transform= &scale_by;
  tinfo->methods->transform_exit= &scale_by_exit;
  tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="scale_by";
  tinfo->methods->method_description=
   "Method to scale (multiply) the incoming epochs either by\n"
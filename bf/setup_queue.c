@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-2004,2006-2009,2011,2013,2016,2023 Bernd Feige
+ * Copyright (C) 1996-2004,2006-2009,2011,2013,2016,2023,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*
@@ -45,6 +45,16 @@
  * each initialized method in a queue are called after the last run through
  * that queue, ie the exit calls have a chance to modify the final
  * result.
+ *
+ * If emethods->nr_of_threads>1, do_queues executes iter_queue in batches:
+ * The get_epoch methods (and their branches) deliver a batch of epochs in
+ * order, the run of parallel_safe TRANSFORM/REJECT methods following them is
+ * executed on the epochs of the batch concurrently by a team of threads,
+ * each thread working with its own copies of these methods (ie separate
+ * local_storage, initialized and exited separately), and the remaining
+ * methods including the collect method are executed serially on the
+ * results in the original epoch order. If the first method after the
+ * get_epoch methods is not parallel_safe, the serial path is used.
  */
 /*}}}  */
 
@@ -54,6 +64,12 @@
 #include <string.h>
 #include "transform.h"
 #include "bf.h"
+#ifdef FP_EXCEPTION
+#include "bfmath.h"
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 /*}}}  */
 
 /*{{{  Allocate/free methodmem*/
@@ -438,6 +454,11 @@ setup_queue_from_buffer(transform_info_ptr tinfo, void (* const *m_selects)(tran
 
    /*{{{  Locate the method and configure it*/
    for (m_select=m_selects; *m_select!=NULL; m_select++) {
+    tinfo->methods->parallel_safe=FALSE;
+    /* get_block() relies on these being NULL if not set by the method */
+    tinfo->methods->get_singlepoint=NULL;
+    tinfo->methods->seek_point=NULL;
+    tinfo->methods->get_block=NULL;
     (**m_select)(tinfo);
     if (strcmp(tokenbuf.buffer_start, tinfo->methods->method_name)==0) break;
    }
@@ -581,7 +602,7 @@ dump_queue(queue_desc *queue, FILE *dumpfile, char *prefix) {
    }
    fprintf(dumpfile, 
     "{select_%s, NULL, NULL,\n"
-    " NULL, NULL, NULL, NULL,\n"
+    " NULL, NULL, NULL, NULL, NULL,\n"
     " \"%s\", NULL, %d, %d, NULL, %s, %d, NULL, FALSE, %d, %d,\n"
     " %d, %d"
     "},\n",
@@ -619,6 +640,7 @@ init_queue_from_dump(transform_info_ptr tinfo, queue_desc *queue) {
   /* The dump initializes the 'init' pointer to the select call... */
   void (* const method_select)(transform_info_ptr)=queue->start[i].transform_init;
   tinfo->methods=queue->start+i;
+  tinfo->methods->parallel_safe=FALSE;
   (*method_select)(tinfo);
   tinfo->methods->local_storage=NULL;
   if (tinfo->methods->local_storage_size>0) {
@@ -876,15 +898,15 @@ printhelp(transform_info_ptr tinfo, void (* const *m_selects)(transform_info_ptr
 /*}}}  */
 
 /*{{{  do_queue(transform_info_ptr tinfo, queue_desc *queue, int *last_method_nrp) {*/
-GLOBAL DATATYPE *
-do_queue(transform_info_ptr tinfo, queue_desc *queue, int *last_method_nrp) {
- const transform_methods_ptr storemethods=tinfo->methods;
- const DATATYPE *storetsdata=tinfo->tsdata;
+/* do_queue_range executes the methods of queue from method_nr up to (but
+ * excluding) end_method_nr. Leaves tinfo->methods and tinfo->tsdata modified;
+ * this is the caller's responsibility. */
+LOCAL DATATYPE *
+do_queue_range(transform_info_ptr tinfo, queue_desc *queue, int method_nr, int const end_method_nr, int *last_method_nrp) {
  DATATYPE *newtsdata=NULL;
- int method_nr=queue->current_get_epoch_method;
 
  /* Execute the process chain with possible rejection. */
- while (method_nr<queue->nr_of_methods) {
+ while (method_nr<end_method_nr) {
   tinfo->methods=queue->start+method_nr;
   /* Save an index to the last executed method, so that the caller may
    * determine which method caused the exit if the return value is NULL */
@@ -913,19 +935,27 @@ do_queue(transform_info_ptr tinfo, queue_desc *queue, int *last_method_nrp) {
    growing_buf_init(&tinfo->triggers);
   }
   if (tinfo->methods->init_done==FALSE) {
+   /* Init functions may use non-reentrant helpers; let the copies of a method
+    * in a parallel team initialize one at a time */
+#ifdef _OPENMP
+#pragma omp critical (do_queue_init)
+#endif
+   {
    trafo_std_defaults(tinfo);
    if (tinfo->emethods->execution_callback!=NULL) (*tinfo->emethods->execution_callback)(tinfo, E_CALLBACK_BEFORE_INIT);
    (*tinfo->methods->transform_init)(tinfo);
    if (tinfo->emethods->execution_callback!=NULL) (*tinfo->emethods->execution_callback)(tinfo, E_CALLBACK_AFTER_INIT);
+   }
   }
   if (tinfo->emethods->execution_callback!=NULL) (*tinfo->emethods->execution_callback)(tinfo, E_CALLBACK_BEFORE_EXEC);
   newtsdata=(*tinfo->methods->transform)(tinfo);
-  if (tinfo->emethods->execution_callback!=NULL) (*tinfo->emethods->execution_callback)(tinfo, E_CALLBACK_AFTER_EXEC);
   /* Free everything from the old tinfo if it was rejected */
   if (newtsdata==NULL) free_tinfo(tinfo);
   /* Free the old tsdata if a new data set was allocated */
   if (newtsdata!=tinfo->tsdata && tinfo->tsdata!=NULL) free(tinfo->tsdata);
   tinfo->tsdata=newtsdata;
+  /* The callback sees the result in tinfo->tsdata (NULL if rejected) */
+  if (tinfo->emethods->execution_callback!=NULL) (*tinfo->emethods->execution_callback)(tinfo, E_CALLBACK_AFTER_EXEC);
   if (newtsdata==NULL) {
    if (tinfo->methods->method_type==GET_EPOCH_METHOD || tinfo->methods->get_epoch_override) {
     /* A GET_EPOCH_METHOD was tried but didn't yield an epoch: Try the next */
@@ -957,6 +987,13 @@ do_queue(transform_info_ptr tinfo, queue_desc *queue, int *last_method_nrp) {
    }
   }
  }
+ return newtsdata;
+}
+GLOBAL DATATYPE *
+do_queue(transform_info_ptr tinfo, queue_desc *queue, int *last_method_nrp) {
+ const transform_methods_ptr storemethods=tinfo->methods;
+ const DATATYPE *storetsdata=tinfo->tsdata;
+ DATATYPE *const newtsdata=do_queue_range(tinfo, queue, queue->current_get_epoch_method, queue->nr_of_methods, last_method_nrp);
 
  tinfo->tsdata=(DATATYPE *)storetsdata;
  tinfo->methods=storemethods;
@@ -1010,41 +1047,219 @@ free_queue_storage(queue_desc *queue) {
 }
 /*}}}  */
 
+/*{{{  Serial and parallel execution of the iterated queue*/
+/* Moves the epoch in from_tinfo to to_tinfo, keeping a possible linked list
+ * of data sets consistent */
+LOCAL void
+move_tinfo(transform_info_ptr to_tinfo, transform_info_ptr from_tinfo) {
+ *to_tinfo= *from_tinfo;
+ if (to_tinfo->next!=NULL) to_tinfo->next->previous=to_tinfo;
+}
+
+/* Book-keeping for a result of the iterated queue, common to the serial and
+ * parallel paths. Returns FALSE if the iterated queue is to be terminated. */
+LOCAL Bool
+account_iter_result(transform_info_ptr tinfo, queue_desc *iter_queue, DATATYPE *newtsdata, int last_method_nr, int *accepted_epochsp, int *rejected_epochsp, struct transform_info_struct *last_successfulp) {
+ if (newtsdata==NULL) {
+  /* Terminate the iter_queue if a GET_EPOCH_METHOD returned NULL: */
+  if (iter_queue->start[last_method_nr].method_type==GET_EPOCH_METHOD || iter_queue->start[last_method_nr].get_epoch_override) return FALSE;
+  /* Terminate the iter_queue if stopsignal was set: */
+  if (tinfo->stopsignal) return FALSE;
+  /* It is not clear what a `rejection' by a collect method should mean.
+   * We decide not to count NULL returned by a collect method (just like
+   * always done by null_sink) as rejection: */
+  if (iter_queue->start[last_method_nr].method_type==COLLECT_METHOD) {
+   (*accepted_epochsp)++;
+  } else {
+   (*rejected_epochsp)++;
+  }
+ } else {
+  *last_successfulp= *tinfo;
+  last_successfulp->tsdata=newtsdata;
+  tinfo->tsdata=NULL;	/* Prevent do_queue from freeing the last data */
+  (*accepted_epochsp)++;
+ }
+ return TRUE;
+}
+
+LOCAL void
+do_iter_queue_serial(transform_info_ptr tinfo, queue_desc *iter_queue, int *accepted_epochsp, int *rejected_epochsp, struct transform_info_struct *last_successfulp) {
+ int last_method_nr;
+ DATATYPE *newtsdata;
+ /* Execute iter_queue until the first (get_epoch) method returns an error */
+ do {
+  tinfo->accepted_epochs= *accepted_epochsp;
+  tinfo->rejected_epochs= *rejected_epochsp;
+  newtsdata=do_queue(tinfo, iter_queue, &last_method_nr);
+ } while (account_iter_result(tinfo, iter_queue, newtsdata, last_method_nr, accepted_epochsp, rejected_epochsp, last_successfulp));
+}
+
+/* Each thread of the team works on its own copy of the parallel section of
+ * iter_queue; emethod is copied as well since message_parm is scratch space */
+struct queue_worker {
+ struct external_methods_struct emethod;
+ queue_desc queue;
+};
+/* This many epochs per thread are fetched into a batch */
+#define PARALLEL_BATCH_FACTOR 4
+
+/* Returns the number of the first method after the parallel section of
+ * iter_queue, which starts right after the get_epoch methods and branches */
+LOCAL int
+parallel_section_end(queue_desc *iter_queue) {
+ int method_nr=iter_queue->nr_of_get_epoch_methods;
+ while (method_nr<iter_queue->nr_of_methods) {
+  transform_methods_ptr const methodp=iter_queue->start+method_nr;
+  if (!methodp->parallel_safe || (methodp->method_type!=TRANSFORM_METHOD && methodp->method_type!=REJECT_METHOD)) break;
+  method_nr++;
+ }
+ return method_nr;
+}
+
+LOCAL void
+do_iter_queue_parallel(transform_info_ptr tinfo, queue_desc *iter_queue, int const end_parallel, int *accepted_epochsp, int *rejected_epochsp, struct transform_info_struct *last_successfulp) {
+ int const nr_of_threads=tinfo->emethods->nr_of_threads;
+ int const batch_size=nr_of_threads*PARALLEL_BATCH_FACTOR;
+ int const start_parallel=iter_queue->nr_of_get_epoch_methods;
+ int const nr_of_parallel_methods=end_parallel-start_parallel;
+ struct queue_worker *workers;
+ struct transform_info_struct *batch;
+ Bool more_epochs=TRUE, stopped=FALSE;
+ int thread, i;
+
+ TRACEMS3(tinfo->emethods, 1, "do_queues: Executing methods %d-%d of the iterated queue in %d threads\n", MSGPARM(start_parallel+1), MSGPARM(end_parallel), MSGPARM(nr_of_threads));
+ if ((workers=(struct queue_worker *)malloc(nr_of_threads*sizeof(struct queue_worker)))==NULL ||
+     (batch=(struct transform_info_struct *)malloc(batch_size*sizeof(struct transform_info_struct)))==NULL) {
+  ERREXIT(tinfo->emethods, "do_queues: Error allocating parallel execution memory\n");
+ }
+ /*{{{  Set up the method copies for each thread*/
+ for (thread=0; thread<nr_of_threads; thread++) {
+  struct queue_worker *const worker=workers+thread;
+  worker->emethod= *tinfo->emethods;
+  worker->queue=*iter_queue;
+  worker->queue.nr_of_methods=worker->queue.allocated_methods=nr_of_parallel_methods;
+  worker->queue.nr_of_get_epoch_methods=worker->queue.current_get_epoch_method=0;
+  if ((worker->queue.start=(transform_methods_ptr)malloc(nr_of_parallel_methods*sizeof(struct transform_methods_struct)))==NULL) {
+   ERREXIT(tinfo->emethods, "do_queues: Error allocating parallel execution memory\n");
+  }
+  memcpy(worker->queue.start, iter_queue->start+start_parallel, nr_of_parallel_methods*sizeof(struct transform_methods_struct));
+  for (i=0; i<nr_of_parallel_methods; i++) {
+   transform_methods_ptr const methodp=worker->queue.start+i;
+   /* The arguments are shared read-only, local storage is private */
+   methodp->init_done=FALSE;
+   methodp->local_storage=NULL;
+   if (methodp->local_storage_size>0 && (methodp->local_storage=calloc(methodp->local_storage_size,1))==NULL) {
+    ERREXIT(tinfo->emethods, "do_queues: Error allocating parallel execution memory\n");
+   }
+  }
+ }
+ /*}}}  */
+
+ while (more_epochs && !stopped) {
+  int nr_in_batch, epoch, last_method_nr;
+
+  /*{{{  Fetch the next batch of epochs in order*/
+  for (nr_in_batch=0; nr_in_batch<batch_size; nr_in_batch++) {
+   DATATYPE *newtsdata;
+   /* accepted_epochs+rejected_epochs+1 is the number of the current epoch */
+   tinfo->accepted_epochs= *accepted_epochsp+nr_in_batch;
+   tinfo->rejected_epochs= *rejected_epochsp;
+   newtsdata=do_queue_range(tinfo, iter_queue, iter_queue->current_get_epoch_method, start_parallel, &last_method_nr);
+   if (newtsdata==NULL && (iter_queue->start[last_method_nr].method_type==GET_EPOCH_METHOD || iter_queue->start[last_method_nr].get_epoch_override)) {
+    more_epochs=FALSE;
+    break;
+   }
+   /* Epochs rejected within a get_epoch branch are passed on with tsdata==NULL */
+   move_tinfo(batch+nr_in_batch, tinfo);
+   tinfo->tsdata=NULL;
+  }
+  /*}}}  */
+
+  /*{{{  Execute the parallel section on the batch*/
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nr_of_threads)
+#endif
+  {
+#ifdef FP_EXCEPTION
+  fp_exception_init();
+#endif
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic,1)
+#endif
+  for (epoch=0; epoch<nr_in_batch; epoch++) {
+   transform_info_ptr const epoch_tinfo=batch+epoch;
+#ifdef _OPENMP
+   struct queue_worker *const worker=workers+omp_get_thread_num();
+#else
+   struct queue_worker *const worker=workers;
+#endif
+   int worker_last_method_nr;
+   if (epoch_tinfo->tsdata==NULL) continue;
+   epoch_tinfo->emethods= &worker->emethod;
+   do_queue_range(epoch_tinfo, &worker->queue, 0, nr_of_parallel_methods, &worker_last_method_nr);
+   epoch_tinfo->emethods=tinfo->emethods;
+  }
+  }
+  /*}}}  */
+
+  /*{{{  Execute the rest of the queue serially in epoch order*/
+  for (epoch=0; epoch<nr_in_batch; epoch++) {
+   transform_info_ptr const epoch_tinfo=batch+epoch;
+   DATATYPE *newtsdata=NULL;
+   if (stopped) {
+    /* The queue was stopped by an earlier epoch of this batch */
+    if (epoch_tinfo->tsdata!=NULL) free_tinfo(epoch_tinfo);
+    continue;
+   }
+   move_tinfo(tinfo, epoch_tinfo);
+   tinfo->accepted_epochs= *accepted_epochsp;
+   tinfo->rejected_epochs= *rejected_epochsp;
+   /* Methods before end_parallel rejected the epoch if tsdata==NULL */
+   last_method_nr=end_parallel-1;
+   if (tinfo->tsdata!=NULL) {
+    newtsdata=do_queue_range(tinfo, iter_queue, end_parallel, iter_queue->nr_of_methods, &last_method_nr);
+   }
+   stopped= !account_iter_result(tinfo, iter_queue, newtsdata, last_method_nr, accepted_epochsp, rejected_epochsp, last_successfulp);
+  }
+  /*}}}  */
+ }
+
+ /*{{{  Exit and free the method copies*/
+ for (thread=0; thread<nr_of_threads; thread++) {
+  struct queue_worker *const worker=workers+thread;
+  struct transform_info_struct exit_tinfo;
+  memset((void *)&exit_tinfo, 0, sizeof(struct transform_info_struct));
+  exit_tinfo.emethods= &worker->emethod;
+  exit_queue(&exit_tinfo, &worker->queue);
+  for (i=0; i<nr_of_parallel_methods; i++) {
+   free_pointer(&worker->queue.start[i].local_storage);
+  }
+  free_queue_storage(&worker->queue);
+ }
+ free(workers);
+ free(batch);
+ /*}}}  */
+}
+/*}}}  */
+
 /*{{{  do_queues(transform_info_ptr tinfo, queue_desc *iter_queue, queue_desc *post_queue) {*/
 /* This function executes a script when the queues are already set up.
  * Sets (and returns) tinfo->tsdata, which will be NULL if all data was rejected. */
 GLOBAL DATATYPE *
 do_queues(transform_info_ptr tinfo, queue_desc *iter_queue, queue_desc *post_queue) {
+ transform_methods_ptr const storemethods=tinfo->methods;
+ int const end_parallel=parallel_section_end(iter_queue);
  int last_method_nr, rejected_epochs=0, accepted_epochs=0;
  DATATYPE *newtsdata;
  struct transform_info_struct last_successful;
 
  iter_queue->current_get_epoch_method=post_queue->current_get_epoch_method=0;
  last_successful.tsdata=NULL;
- /* Execute iter_queue until the first (get_epoch) method returns an error */
- for (;;) {
-  tinfo->accepted_epochs=accepted_epochs;
-  tinfo->rejected_epochs=rejected_epochs;
-  newtsdata=do_queue(tinfo, iter_queue, &last_method_nr);
-  if (newtsdata==NULL) {
-   /* Terminate the iter_queue if a GET_EPOCH_METHOD returned NULL: */
-   if (iter_queue->start[last_method_nr].method_type==GET_EPOCH_METHOD || iter_queue->start[last_method_nr].get_epoch_override) break;
-   /* Terminate the iter_queue if stopsignal was set: */
-   if (tinfo->stopsignal) break;
-   /* It is not clear what a `rejection' by a collect method should mean.
-    * We decide not to count NULL returned by a collect method (just like
-    * always done by null_sink) as rejection: */
-   if (iter_queue->start[last_method_nr].method_type==COLLECT_METHOD) {
-    accepted_epochs++;
-   } else {
-    rejected_epochs++;
-   }
-  } else {
-   last_successful= *tinfo;
-   last_successful.tsdata=newtsdata;
-   tinfo->tsdata=NULL;	/* Prevent do_queue from freeing the last data */
-   accepted_epochs++;
-  }
+ if (tinfo->emethods->nr_of_threads>1 && end_parallel>iter_queue->nr_of_get_epoch_methods) {
+  do_iter_queue_parallel(tinfo, iter_queue, end_parallel, &accepted_epochs, &rejected_epochs, &last_successful);
+  tinfo->methods=last_successful.methods=storemethods;
+ } else {
+  do_iter_queue_serial(tinfo, iter_queue, &accepted_epochs, &rejected_epochs, &last_successful);
  }
 
  if (last_successful.tsdata!=NULL) {
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2026 Bernd Feige
+ * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+ */
+/*
+ * sidecar.c handles files that cache information derived from a data file
+ * next to it (<datafile><suffix>, eg the trigger cache and the asc epoch
+ * index). A sidecar starts with a header recording a magic string, the byte
+ * order, size and modification time of the data file and a key string
+ * describing everything else the contents depend on; it is only used while
+ * all of these match. sidecar_create() writes the header into a temporary
+ * file that sidecar_commit() renames to the final name, so that concurrent
+ * readers never see a partial sidecar. Data files modified very recently may
+ * still be growing within the resolution of st_mtime and get no sidecar.
+ * The payload following the header is up to the caller. Failure to read or
+ * write a sidecar is never an error; it is simply not used.
+ *	-- Bernd Feige 17.10.2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "transform.h"
+#include "bf.h"
+
+#define SIDECAR_MAGIC_LENGTH 32
+/* Minimum age in seconds of a data file to create a sidecar for */
+#define SIDECAR_MINAGE 2
+
+struct sidecar_header {
+ char magic[SIDECAR_MAGIC_LENGTH];	/* Zero-terminated and padded */
+ uint32_t byteorder;	/* 0x01020304 in the writer's byte order */
+ uint32_t keylength;	/* Including the terminating zero */
+ int64_t filesize;
+ int64_t mtime;
+};
+
+/*{{{  sidecar_fill_header(struct sidecar_header *header, char const *datafilename, char const *magic, char const *key, time_t *mtimep)*/
+LOCAL Bool
+sidecar_fill_header(struct sidecar_header *header, char const *datafilename, char const *magic, char const *key, time_t *mtimep) {
+ struct stat statbuff;
+ if (stat(datafilename, &statbuff)!=0) return FALSE;
+ memset(header, 0, sizeof(*header));
+ strncpy(header->magic, magic, SIDECAR_MAGIC_LENGTH-1);
+ header->byteorder=0x01020304;
+ header->keylength=strlen(key)+1;
+ header->filesize=statbuff.st_size;
+ header->mtime=statbuff.st_mtime;
+ if (mtimep!=NULL) *mtimep=statbuff.st_mtime;
+ return TRUE;
+}
+/*}}}  */
+
+/*{{{  sidecar_filename(char const *datafilename, char const *suffix)*/
+LOCAL char *
+sidecar_filename(char const *datafilename, char const *suffix) {
+ char * const filename=(char *)malloc(strlen(datafilename)+strlen(suffix)+1);
+ if (filename!=NULL) {
+  strcpy(filename, datafilename);
+  strcat(filename, suffix);
+ }
+ return filename;
+}
+/*}}}  */
+
+/*{{{  sidecar_open(struct sidecar_file *sidecarp, char const *datafilename, char const *suffix, char const *magic, char const *key)*/
+/* Opens the sidecar of datafilename for reading. Returns TRUE with
+ * sidecarp->file positioned at the payload if it exists and matches the
+ * current state of the data file and the key; sidecar_close() must then be
+ * called. */
+GLOBAL Bool
+sidecar_open(struct sidecar_file *sidecarp, char const *datafilename, char const *suffix, char const *magic, char const *key) {
+ struct sidecar_header expected, header;
+ Bool valid=FALSE;
+
+ sidecarp->file=NULL;
+ sidecarp->tempfilename=NULL;
+ if ((sidecarp->filename=sidecar_filename(datafilename, suffix))==NULL) return FALSE;
+ if (sidecar_fill_header(&expected, datafilename, magic, key, NULL)
+  && (sidecarp->file=fopen(sidecarp->filename, "rb"))!=NULL
+  && fread(&header, sizeof(header), 1, sidecarp->file)==1
+  && memcmp(&header, &expected, sizeof(header))==0) {
+  char * const storedkey=(char *)malloc(header.keylength);
+  valid=(storedkey!=NULL
+   && fread(storedkey, 1, header.keylength, sidecarp->file)==header.keylength
+   && memcmp(storedkey, key, header.keylength)==0);
+  free_pointer((void **)&storedkey);
+ }
+ if (!valid) sidecar_close(sidecarp);
+ return valid;
+}
+/*}}}  */
+
+/*{{{  sidecar_close(struct sidecar_file *sidecarp)*/
+GLOBAL void
+sidecar_close(struct sidecar_file *sidecarp) {
+ if (sidecarp->file!=NULL) {
+  fclose(sidecarp->file);
+  sidecarp->file=NULL;
+ }
+ free_pointer((void **)&sidecarp->filename);
+}
+/*}}}  */
+
+/*{{{  sidecar_create(struct sidecar_file *sidecarp, char const *datafilename, char const *suffix, char const *magic, char const *key)*/
+/* Starts a new sidecar for datafilename. Returns TRUE with the header
+ * written to sidecarp->file, after which the caller writes the payload and
+ * calls sidecar_commit(). */
+GLOBAL Bool
+sidecar_create(struct sidecar_file *sidecarp, char const *datafilename, char const *suffix, char const *magic, char const *key) {
+ struct sidecar_header header;
+ time_t mtime;
+
+ sidecarp->file=NULL;
+ sidecarp->tempfilename=NULL;
+ if ((sidecarp->filename=sidecar_filename(datafilename, suffix))==NULL) return FALSE;
+ if (!sidecar_fill_header(&header, datafilename, magic, key, &mtime)
+  || time(NULL)-mtime<SIDECAR_MINAGE
+  || (sidecarp->tempfilename=(char *)malloc(strlen(sidecarp->filename)+24))==NULL) {
+  free_pointer((void **)&sidecarp->filename);
+  return FALSE;
+ }
+ sprintf(sidecarp->tempfilename, "%s.%ld", sidecarp->filename, (long)getpid());
+ if ((sidecarp->file=fopen(sidecarp->tempfilename, "wb"))==NULL) {
+  free_pointer((void **)&sidecarp->tempfilename);
+  free_pointer((void **)&sidecarp->filename);
+  return FALSE;
+ }
+ if (fwrite(&header, sizeof(header), 1, sidecarp->file)!=1
+  || fwrite(key, 1, header.keylength, sidecarp->file)!=header.keylength) {
+  sidecar_commit(sidecarp, FALSE);
+  return FALSE;
+ }
+ return TRUE;
+}
+/*}}}  */
+
+/*{{{  sidecar_commit(struct sidecar_file *sidecarp, Bool ok)*/
+/* Finishes a sidecar started by sidecar_create(): If ok (the payload was
+ * written completely), it is moved to its final name, else discarded.
+ * Returns TRUE if the sidecar is in place. */
+GLOBAL Bool
+sidecar_commit(struct sidecar_file *sidecarp, Bool ok) {
+ if (fclose(sidecarp->file)!=0) ok=FALSE;
+ sidecarp->file=NULL;
+ if (ok && rename(sidecarp->tempfilename, sidecarp->filename)!=0) ok=FALSE;
+ if (!ok) remove(sidecarp->tempfilename);
+ free_pointer((void **)&sidecarp->tempfilename);
+ free_pointer((void **)&sidecarp->filename);
+ return ok;
+}
+/*}}}  */
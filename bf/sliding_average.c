@@ -21,6 +21,11 @@
  * resamples the original data at twice the rate.
  *
  * 						-- Bernd Feige 22.07.1993
+ *
+ * Sliding quantiles (-M, -q) are maintained in a pair of heaps holding the
+ * lower and upper part of the window, so that each step only inserts the
+ * entering and removes the leaving points.
+ * 						-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
@@ -46,6 +51,21 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_STRING_WORD, "sliding_step", "", ARGDESC_UNUSED, (const char *const *)"2.5ms"}
 };
 
+/*{{{  struct running_quantile*/
+/* Order statistic of a sliding window: Points are stored in slot
+ * point%ssize. lower is a max-heap of the smallest points of the window
+ * (as many as needed to have the requested one on top), upper a min-heap of
+ * the rest. heap_index locates each slot: >=0 in lower, <0 (-1-index) in upper. */
+struct running_quantile {
+ DATATYPE *value;
+ int *heap_index;
+ int *lower;
+ int *upper;
+ int nr_in_lower;
+ int nr_in_upper;
+};
+/*}}}  */
+
 typedef struct sliding_data_struct {
  void (*single_sliding_function)(struct sliding_data_struct *sdata);
 
@@ -62,6 +82,7 @@ typedef struct sliding_data_struct {
 
  int allocated_outpoints;
  DATATYPE quantile;
+ struct running_quantile rq;
  /*}}}  */
 
  DATATYPE sfreq; /* To see whether sfreq changed */
@@ -131,25 +152,147 @@ single_sliding_average(sliding_data *sdata) {
   }
  }
 }
+/*{{{  Running quantile*/
+/* Heap primitives. A heap entry is a slot; `sign' is 1 for the max-heap
+ * lower and -1 for the min-heap upper. */
+LOCAL void
+rq_place(struct running_quantile *rq, int *heap, int sign, int index, int slot) {
+ heap[index]=slot;
+ rq->heap_index[slot]=(sign>0 ? index : -1-index);
+}
+LOCAL void
+rq_siftup(struct running_quantile *rq, int *heap, int sign, int index) {
+ int const slot=heap[index];
+ DATATYPE const v=sign*rq->value[slot];
+ while (index>0) {
+  int const parent=(index-1)/2;
+  if (sign*rq->value[heap[parent]]>=v) break;
+  rq_place(rq, heap, sign, index, heap[parent]);
+  index=parent;
+ }
+ rq_place(rq, heap, sign, index, slot);
+}
+LOCAL void
+rq_siftdown(struct running_quantile *rq, int *heap, int sign, int n, int index) {
+ int const slot=heap[index];
+ DATATYPE const v=sign*rq->value[slot];
+ while (TRUE) {
+  int child=2*index+1;
+  if (child>=n) break;
+  if (child+1<n && sign*rq->value[heap[child+1]]>sign*rq->value[heap[child]]) child++;
+  if (v>=sign*rq->value[heap[child]]) break;
+  rq_place(rq, heap, sign, index, heap[child]);
+  index=child;
+ }
+ rq_place(rq, heap, sign, index, slot);
+}
+/* Remove the entry at index and return its slot */
+LOCAL int
+rq_remove(struct running_quantile *rq, int *heap, int sign, int *n, int index) {
+ int const slot=heap[index];
+ (*n)--;
+ if (index< *n) {
+  rq_place(rq, heap, sign, index, heap[*n]);
+  rq_siftdown(rq, heap, sign, *n, index);
+  rq_siftup(rq, heap, sign, index);
+ }
+ return slot;
+}
+
+LOCAL void
+rq_insert(struct running_quantile *rq, int slot, DATATYPE value) {
+ rq->value[slot]=value;
+ if (rq->nr_in_lower>0 && value<=rq->value[rq->lower[0]]) {
+  rq_place(rq, rq->lower, 1, rq->nr_in_lower, slot);
+  rq_siftup(rq, rq->lower, 1, rq->nr_in_lower++);
+ } else {
+  rq_place(rq, rq->upper, -1, rq->nr_in_upper, slot);
+  rq_siftup(rq, rq->upper, -1, rq->nr_in_upper++);
+ }
+}
+LOCAL void
+rq_delete(struct running_quantile *rq, int slot) {
+ int const index=rq->heap_index[slot];
+ if (index>=0) {
+  rq_remove(rq, rq->lower, 1, &rq->nr_in_lower, index);
+ } else {
+  rq_remove(rq, rq->upper, -1, &rq->nr_in_upper, -1-index);
+ }
+}
+/* Move entries between the heaps until lower holds nr_lower entries */
+LOCAL void
+rq_balance(struct running_quantile *rq, int nr_lower) {
+ while (rq->nr_in_lower>nr_lower) {
+  int const slot=rq_remove(rq, rq->lower, 1, &rq->nr_in_lower, 0);
+  rq_place(rq, rq->upper, -1, rq->nr_in_upper, slot);
+  rq_siftup(rq, rq->upper, -1, rq->nr_in_upper++);
+ }
+ while (rq->nr_in_lower<nr_lower) {
+  int const slot=rq_remove(rq, rq->upper, -1, &rq->nr_in_upper, 0);
+  rq_place(rq, rq->lower, 1, rq->nr_in_lower, slot);
+  rq_siftup(rq, rq->lower, 1, rq->nr_in_lower++);
+ }
+}
+/* The same as array_quantile() for the n points in the heaps */
+LOCAL DATATYPE
+rq_quantile(struct running_quantile *rq, DATATYPE q) {
+ int const n=rq->nr_in_lower+rq->nr_in_upper;
+ unsigned long i1=(n-1)*q, i2=n*q;
+ if (i2>=n) i2=i1;
+ rq_balance(rq, i1+1);
+ if (i2==i1) return rq->value[rq->lower[0]];
+ return (rq->value[rq->lower[0]]+rq->value[rq->upper[0]])/2;
+}
+/*}}}  */
+
 LOCAL void
 single_sliding_quantile(sliding_data *sdata) {
  int spoint;
- array a;
-
- a.current_vector=0;
- a.nr_of_vectors=a.element_skip=sdata->pointskip;
-
- for (spoint=0; spoint<sdata->allocated_outpoints; spoint++) { /* Loop across target points */
-  int const middle_point=(int)floorf(spoint*sdata->sstep);
-  int const new_left_point= (middle_point-sdata->leftover>0 ? middle_point-sdata->leftover : 0);
-  int const new_right_point=(middle_point+sdata->rightover<sdata->inpoints ? middle_point+sdata->rightover : sdata->inpoints)-1;
-  a.start=sdata->fromstart+new_left_point*sdata->pointskip;
-  a.nr_of_elements=new_right_point-new_left_point+1;
-  array_setreadwrite(&a);
-  sdata->tostart[spoint*sdata->pointskip]=array_quantile(&a,sdata->quantile);
+
+ if (sdata->sstep>sdata->ssize/2) {
+  /* Windows hardly overlap, select the quantile anew for each */
+  array a;
+  a.current_vector=0;
+  a.nr_of_vectors=a.element_skip=sdata->pointskip;
+  for (spoint=0; spoint<sdata->allocated_outpoints; spoint++) { /* Loop across target points */
+   int const middle_point=(int)floorf(spoint*sdata->sstep);
+   int const new_left_point= (middle_point-sdata->leftover>0 ? middle_point-sdata->leftover : 0);
+   int const new_right_point=(middle_point+sdata->rightover<sdata->inpoints ? middle_point+sdata->rightover : sdata->inpoints)-1;
+   a.start=sdata->fromstart+new_left_point*sdata->pointskip;
+   a.nr_of_elements=new_right_point-new_left_point+1;
+   array_setreadwrite(&a);
+   sdata->tostart[spoint*sdata->pointskip]=array_quantile(&a,sdata->quantile);
+  }
+ } else {
+  /* Remove points falling out on the left, insert incoming points to the right */
+  struct running_quantile * const rq= &sdata->rq;
+  int left_point=0, right_point= -1;
+  rq->nr_in_lower=rq->nr_in_upper=0;
+  for (spoint=0; spoint<sdata->allocated_outpoints; spoint++) { /* Loop across target points */
+   int const middle_point=(int)floorf(spoint*sdata->sstep);
+   int const new_left_point= (middle_point-sdata->leftover>0 ? middle_point-sdata->leftover : 0);
+   int const new_right_point=(middle_point+sdata->rightover<sdata->inpoints ? middle_point+sdata->rightover : sdata->inpoints)-1;
+   int point;
+
+   for (point=left_point; point<new_left_point && point<=right_point; point++) {
+    rq_delete(rq, point%sdata->ssize);
+   }
+   for (point=(right_point+1>new_left_point ? right_point+1 : new_left_point); point<=new_right_point; point++) {
+    rq_insert(rq, point%sdata->ssize, sdata->fromstart[point*sdata->pointskip]);
+   }
+   left_point=new_left_point;
+   right_point=new_right_point;
+   sdata->tostart[spoint*sdata->pointskip]=rq_quantile(rq, sdata->quantile);
+  }
  }
 }
 
+LOCAL void
+free_rq(sliding_data *sdata) {
+ free_pointer((void **)&sdata->rq.value);
+ free_pointer((void **)&sdata->rq.heap_index);
+}
+
 LOCAL void
 init_sdata(transform_info_ptr tinfo) {
  sliding_data *sdata=(sliding_data *)tinfo->methods->local_storage;
@@ -176,6 +319,13 @@ init_sdata(transform_info_ptr tinfo) {
    ERREXIT(tinfo->emethods, "sliding_average_init: -M and -q cannot be set at the same time.\n");
   } else if (args[ARGS_MEDIAN].is_set || args[ARGS_QUANTILE].is_set) {
    sdata->single_sliding_function=single_sliding_quantile;
+   free_rq(sdata);
+   if ((sdata->rq.value=(DATATYPE *)malloc(sdata->ssize*sizeof(DATATYPE)))==NULL ||
+       (sdata->rq.heap_index=(int *)malloc(3*sdata->ssize*sizeof(int)))==NULL) {
+    ERREXIT(tinfo->emethods, "sliding_average_init: Error allocating running quantile memory\n");
+   }
+   sdata->rq.lower=sdata->rq.heap_index+sdata->ssize;
+   sdata->rq.upper=sdata->rq.lower+sdata->ssize;
    if (args[ARGS_MEDIAN].is_set) {
     sdata->quantile=0.5;
    } else {
@@ -197,6 +347,10 @@ init_sdata(transform_info_ptr tinfo) {
 /*{{{  sliding_average_init(transform_info_ptr tinfo) {*/
 METHODDEF void
 sliding_average_init(transform_info_ptr tinfo) {
+ sliding_data *sdata=(sliding_data *)tinfo->methods->local_storage;
+
+ sdata->rq.value=NULL;
+ sdata->rq.heap_index=NULL;
  init_sdata(tinfo);
 
  tinfo->methods->init_done=TRUE;
@@ -292,6 +446,9 @@ sliding_average(transform_info_ptr tinfo) {
 /*{{{  sliding_average_exit(transform_info_ptr tinfo) {*/
 METHODDEF void
 sliding_average_exit(transform_info_ptr tinfo) {
+ sliding_data *sdata=(sliding_data *)tinfo->methods->local_storage;
+
+ free_rq(sdata);
  tinfo->methods->init_done=FALSE;
 }
 /*}}}  */
@@ -303,6 +460,7 @@ select_sliding_average(transform_info_ptr tinfo) {
  tinfo->methods->transform= &sliding_average;
  tinfo->methods->transform_exit= &sliding_average_exit;
  tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="sliding_average";
  tinfo->methods->method_description=
   "Sliding average method (block filter) for smoothing and resampling.\n"
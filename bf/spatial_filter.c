@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2026 Bernd Feige
+ * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+ */
+/*{{{}}}*/
+/*{{{  Description*/
+/*
+ * spatial_filter.c method to apply a linear spatial filter read from a file
+ * in the format written by laplacian -M: A line `Original channelnames:'
+ * followed by the line of input channel names, a line `Transformed
+ * channelnames:' followed by the output channel names and the matrix in
+ * MatLab format with one row per output and one column per input channel.
+ * Input channels are looked up by name; the non-zero matrix entries are
+ * compiled into a sparse channel operator for each epoch.
+ *	-- Bernd Feige 17.10.2026
+ */
+/*}}}  */
+
+/*{{{  #includes*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "transform.h"
+#include "bf.h"
+#include "growing_buf.h"
+/*}}}  */
+
+enum ARGS_ENUM {
+ ARGS_MATFILE=0,
+ NR_OF_ARGUMENTS
+};
+LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
+ {T_ARGS_TAKES_FILENAME, "matfile", "", ARGDESC_UNUSED, (const char *const *)"*.mat"},
+};
+
+/*{{{  Local definitions*/
+struct spatial_filter_storage {
+ int nr_of_inputs;
+ int nr_of_outputs;
+ growing_buf names;	/* All channel names, zero-terminated, inputs first */
+ char **input_names;
+ char **output_names;
+ array matrix;	/* nr_of_outputs vectors of nr_of_inputs elements */
+ struct channel_operator op;
+};
+/*}}}  */
+
+/*{{{  read_channelnames(transform_info_ptr tinfo, FILE *matfile, char const *header, growing_buf *linebuf)*/
+/* Reads the header line and the line of channel names following it, appending
+ * the names to local_arg->names. Returns the number of names read. */
+LOCAL int
+read_channelnames(transform_info_ptr tinfo, FILE *matfile, char const *header, growing_buf *linebuf) {
+ struct spatial_filter_storage *local_arg=(struct spatial_filter_storage *)tinfo->methods->local_storage;
+ growing_buf tokenbuf;
+ int nr_of_names=0;
+
+ growing_buf_read_line(matfile, linebuf);
+ if (strcmp(linebuf->buffer_start, header)!=0) {
+  ERREXIT1(tinfo->emethods, "spatial_filter_init: Expected `%s' in the matrix file\n", MSGPARM(header));
+ }
+ growing_buf_init(&tokenbuf);
+ growing_buf_allocate(&tokenbuf, 0);
+ growing_buf_read_line(matfile, linebuf);
+ if (growing_buf_get_firsttoken(linebuf, &tokenbuf)) {
+  do {
+   if (!growing_buf_append(&local_arg->names, tokenbuf.buffer_start, tokenbuf.current_length)) {
+    ERREXIT(tinfo->emethods, "spatial_filter_init: Error allocating channel names\n");
+   }
+   nr_of_names++;
+  } while (growing_buf_get_nexttoken(linebuf, &tokenbuf));
+ }
+ growing_buf_free(&tokenbuf);
+ return nr_of_names;
+}
+/*}}}  */
+
+/*{{{  spatial_filter_init(transform_info_ptr tinfo)*/
+METHODDEF void
+spatial_filter_init(transform_info_ptr tinfo) {
+ struct spatial_filter_storage *local_arg=(struct spatial_filter_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+ FILE *matfile;
+ growing_buf linebuf;
+ char *name;
+ int i;
+
+ if ((matfile=fopen(args[ARGS_MATFILE].arg.s, "r"))==NULL) {
+  ERREXIT1(tinfo->emethods, "spatial_filter_init: Can't open matrix file %s\n", MSGPARM(args[ARGS_MATFILE].arg.s));
+ }
+ growing_buf_init(&linebuf);
+ growing_buf_init(&local_arg->names);
+ if (!growing_buf_allocate(&linebuf, 0) || !growing_buf_allocate(&local_arg->names, 0)) {
+  ERREXIT(tinfo->emethods, "spatial_filter_init: Error allocating buffers\n");
+ }
+ local_arg->nr_of_inputs=read_channelnames(tinfo, matfile, "Original channelnames:", &linebuf);
+ local_arg->nr_of_outputs=read_channelnames(tinfo, matfile, "Transformed channelnames:", &linebuf);
+ growing_buf_free(&linebuf);
+ if (local_arg->nr_of_inputs==0 || local_arg->nr_of_outputs==0) {
+  ERREXIT(tinfo->emethods, "spatial_filter_init: No channel names in the matrix file\n");
+ }
+ array_undump(matfile, &local_arg->matrix);
+ fclose(matfile);
+ if (local_arg->matrix.message==ARRAY_ERROR) {
+  ERREXIT1(tinfo->emethods, "spatial_filter_init: Error reading the matrix from %s\n", MSGPARM(args[ARGS_MATFILE].arg.s));
+ }
+ if (local_arg->matrix.nr_of_vectors!=local_arg->nr_of_outputs || local_arg->matrix.nr_of_elements!=local_arg->nr_of_inputs) {
+  ERREXIT4(tinfo->emethods, "spatial_filter_init: The matrix is %dx%d, but there are %d output and %d input channel names\n", MSGPARM(local_arg->matrix.nr_of_vectors), MSGPARM(local_arg->matrix.nr_of_elements), MSGPARM(local_arg->nr_of_outputs), MSGPARM(local_arg->nr_of_inputs));
+ }
+
+ /* The name buffer is complete now and won't move any more */
+ if ((local_arg->input_names=(char **)malloc((local_arg->nr_of_inputs+local_arg->nr_of_outputs)*sizeof(char *)))==NULL) {
+  ERREXIT(tinfo->emethods, "spatial_filter_init: Error allocating channel names\n");
+ }
+ local_arg->output_names=local_arg->input_names+local_arg->nr_of_inputs;
+ name=local_arg->names.buffer_start;
+ for (i=0; i<local_arg->nr_of_inputs+local_arg->nr_of_outputs; i++) {
+  local_arg->input_names[i]=name;
+  name+=strlen(name)+1;
+ }
+ channel_operator_init(&local_arg->op);
+
+ tinfo->methods->init_done=TRUE;
+}
+/*}}}  */
+
+/*{{{  spatial_filter(transform_info_ptr tinfo)*/
+METHODDEF DATATYPE *
+spatial_filter(transform_info_ptr tinfo) {
+ struct spatial_filter_storage *local_arg=(struct spatial_filter_storage *)tinfo->methods->local_storage;
+ int const nr_of_outputs=local_arg->nr_of_outputs;
+ array outdata;
+ array_view inview;
+ char **new_channelnames=NULL, *in_buffer=NULL;
+ int stringlength=0;
+ double *new_probepos=NULL;
+ int input, output, itempart;
+ Bool ok;
+
+ /*{{{  Compile the operator: Channel names could change between epochs*/
+ channel_operator_reset(&local_arg->op, tinfo->nr_of_channels, 0);
+ array_reset(&local_arg->matrix);
+ ok=TRUE;
+ for (output=0; ok && output<nr_of_outputs; output++) {
+  ok=channel_operator_new_row(&local_arg->op);
+  for (input=0; ok && input<local_arg->nr_of_inputs; input++) {
+   DATATYPE const weight=array_scan(&local_arg->matrix);
+   if (weight!=0.0) {
+    int const channel=find_channel_number(tinfo, local_arg->input_names[input]);
+    if (channel<0) {
+     ERREXIT1(tinfo->emethods, "spatial_filter: Input channel %s is not in the data\n", MSGPARM(local_arg->input_names[input]));
+    }
+    ok=channel_operator_add(&local_arg->op, channel, weight);
+   }
+  }
+ }
+ if (!ok) {
+  ERREXIT(tinfo->emethods, "spatial_filter: Error allocating the channel operator\n");
+ }
+ /*}}}  */
+
+ /*{{{  Initialize output data*/
+ for (output=0; output<nr_of_outputs; output++) {
+  stringlength+=strlen(local_arg->output_names[output])+1;
+ }
+ outdata.nr_of_elements=nr_of_outputs;
+ outdata.nr_of_vectors=tinfo->nr_of_points;
+ outdata.element_skip=tinfo->itemsize;
+ if (array_allocate(&outdata)==NULL ||
+     (new_channelnames=(char **)malloc(nr_of_outputs*sizeof(char *)))==NULL ||
+     (in_buffer=(char *)malloc(stringlength))==NULL ||
+     (new_probepos=(double *)malloc(3*nr_of_outputs*sizeof(double)))==NULL) {
+  ERREXIT(tinfo->emethods, "spatial_filter: Error allocating output memory\n");
+ }
+ for (output=0; output<nr_of_outputs; output++) {
+  /* Output channels keep the position of the input channel of the same name */
+  int const channel=find_channel_number(tinfo, local_arg->output_names[output]);
+  new_channelnames[output]=in_buffer;
+  strcpy(in_buffer, local_arg->output_names[output]);
+  in_buffer=in_buffer+strlen(in_buffer)+1;
+  if (channel>=0) {
+   new_probepos[3*output  ]=tinfo->probepos[3*channel  ];
+   new_probepos[3*output+1]=tinfo->probepos[3*channel+1];
+   new_probepos[3*output+2]=tinfo->probepos[3*channel+2];
+  } else {
+   new_probepos[3*output  ]=new_probepos[3*output+1]=new_probepos[3*output+2]=0.0;
+  }
+ }
+ /*}}}  */
+
+ tinfo_array_view(tinfo, &inview);
+ for (itempart=0; itempart<tinfo->itemsize; itempart++) {
+  array_view initemview=inview, outitemview;
+  initemview.start+=itempart;
+  outitemview.start=outdata.start+itempart;
+  outitemview.nr_of_vectors=nr_of_outputs;
+  outitemview.vector_skip=tinfo->itemsize;
+  outitemview.nr_of_elements=inview.nr_of_elements;
+  outitemview.element_skip=nr_of_outputs*tinfo->itemsize;
+  if (!channel_operator_apply(&local_arg->op, &initemview, &outitemview)) {
+   ERREXIT(tinfo->emethods, "spatial_filter: Error allocating memory\n");
+  }
+ }
+
+ free_pointer((void **)&tinfo->channelnames[0]);
+ free_pointer((void **)&tinfo->channelnames);
+ free_pointer((void **)&tinfo->probepos);
+ tinfo->nr_of_channels=nr_of_outputs;
+ tinfo->multiplexed=TRUE;
+ tinfo->channelnames=new_channelnames;
+ tinfo->probepos=new_probepos;
+ tinfo->length_of_output_region=tinfo->nr_of_channels*tinfo->nr_of_points*tinfo->itemsize;
+ return outdata.start;
+}
+/*}}}  */
+
+/*{{{  spatial_filter_exit(transform_info_ptr tinfo)*/
+METHODDEF void
+spatial_filter_exit(transform_info_ptr tinfo) {
+ struct spatial_filter_storage *local_arg=(struct spatial_filter_storage *)tinfo->methods->local_storage;
+
+ free_pointer((void **)&local_arg->input_names);
+ local_arg->output_names=NULL;
+ growing_buf_free(&local_arg->names);
+ array_free(&local_arg->matrix);
+ channel_operator_free(&local_arg->op);
+
+ tinfo->methods->init_done=FALSE;
+}
+/*}}}  */
+
+/*{{{  select_spatial_filter(transform_info_ptr tinfo)*/
+GLOBAL void
+select_spatial_filter(transform_info_ptr tinfo) {
+ tinfo->methods->transform_init= &spatial_filter_init;
+ tinfo->methods->transform= &spatial_filter;
+ tinfo->methods->transform_exit= &spatial_filter_exit;
+ tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->method_name="spatial_filter";
+ tinfo->methods->method_description=
+  "Transform method to apply a linear spatial filter (a matrix mapping input\n"
+  " to output channels) read from a file in the format written by laplacian -M\n";
+ tinfo->methods->local_storage_size=sizeof(struct spatial_filter_storage);
+ tinfo->methods->nr_of_arguments=NR_OF_ARGUMENTS;
+ tinfo->methods->argument_descriptors=argument_descriptors;
+}
+/*}}}  */
@@ -0,0 +1,427 @@
+/*
+ * Copyright (C) 2026 Bernd Feige
+ * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+ */
+/*{{{}}}*/
+/*{{{  Description*/
+/*
+ * stream_filter is a FIR filter method for continuous data read in chunks.
+ * The filter kernel is designed from a transfer function given in the
+ * `blocks' syntax of fftfilter by the window method. Each epoch is filtered
+ * by overlap-save: The last taps-1 input points of each channel are kept
+ * from the previous epoch and prepended, so that consecutive epochs are
+ * filtered as if they were one long trace, without edge artefacts at the
+ * epoch boundaries.
+ * The filter output lags its input by (taps-1)/2 points. Triggers and the
+ * x axis are delayed along with it, so that they stay aligned with the
+ * filtered signal; triggers moved beyond the end of an epoch are carried
+ * over into the next one. Channels and items not selected with -n or -i
+ * are delayed by the same amount without filtering.
+ * 						-- Bernd Feige 17.10.2026
+ */
+/*}}}  */
+
+/*{{{  #includes*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "transform.h"
+#include "bf.h"
+#include "growing_buf.h"
+/*}}}  */
+
+enum ARGS_ENUM {
+ ARGS_VERBOSE=0,
+ ARGS_EPOCHMODE,
+ ARGS_BYNAME,
+ ARGS_ITEMPART,
+ ARGS_TAPS,
+ ARGS_BLOCKS,
+ NR_OF_ARGUMENTS
+};
+LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
+ {T_ARGS_TAKES_NOTHING, "Verbose output of filter parameters", "V", FALSE, NULL},
+ {T_ARGS_TAKES_NOTHING, "Epoch mode - Restart for each epoch", "e", FALSE, NULL},
+ {T_ARGS_TAKES_STRING_WORD, "channelnames: Restrict to these channel names", "n", ARGDESC_UNUSED, NULL},
+ {T_ARGS_TAKES_LONG, "nr_of_item: work only on this item # (>=0)", "i", 0, NULL},
+ {T_ARGS_TAKES_STRING_WORD, "taps: Length of the FIR kernel (default: 1s)", "t", ARGDESC_UNUSED, (const char *const *)"1s"},
+ {T_ARGS_TAKES_SENTENCE, "blocks", "", ARGDESC_UNUSED, (const char *const *)"0.6 0.7 1 1"}
+};
+
+struct stream_filter_storage {
+ struct fftfilter_block *blockdefs;
+ int *channel_list;
+ Bool have_channel_list;
+ int fromitem;
+ int toitem;
+ DATATYPE sfreq; /* To see whether sfreq changed */
+
+ long taps;
+ DATATYPE *kernel;	/* taps points, delay (taps-1)/2 */
+
+ /* Kernel spectrum for an FFT of transfer_fftsize points, see build_transfer() */
+ long transfer_fftsize;
+ DATATYPE *transfer;
+ DATATYPE *workbuf;
+
+ /* The last taps-1 input points of each channel and item, filtered or not */
+ DATATYPE *history;
+ int history_channels;
+ int history_items;
+
+ /* Triggers delayed beyond the current epoch, positions relative to the
+  * next one, and the last (taps-1)/2 x axis values if there is xdata */
+ growing_buf pending_triggers;
+ DATATYPE *xhistory;
+};
+
+/*{{{  Kernel design*/
+/* The kernel is obtained by sampling the transfer function on a grid much
+ * finer than the kernel length, transforming back and applying a Hamming
+ * window to taps points centered on the zero-phase impulse response. */
+LOCAL void
+design_kernel(transform_info_ptr tinfo) {
+ struct stream_filter_storage *local_arg=(struct stream_filter_storage *)tinfo->methods->local_storage;
+ long const taps=local_arg->taps, delay=(taps-1)/2;
+ long const designsize=2*fft_good_size(2*taps, TRUE);
+ DATATYPE const norm=(DATATYPE)(designsize>>1);
+ DATATYPE *designbuf;
+ long i;
+
+ free_pointer((void **)&local_arg->kernel);
+ if ((local_arg->kernel=(DATATYPE *)malloc(taps*sizeof(DATATYPE)))==NULL ||
+     (designbuf=(DATATYPE *)malloc((designsize+2)*sizeof(DATATYPE)))==NULL) {
+  ERREXIT(tinfo->emethods, "stream_filter: Error allocating kernel memory\n");
+ }
+ for (i=0; i<=designsize; i+=2) {
+  designbuf[i]=fftfilter_transfer_factor(local_arg->blockdefs, ((float)i)/designsize);
+  designbuf[i+1]=0.0;
+ }
+ if (!realfft(designbuf, designsize, -1)) {
+  ERREXIT(tinfo->emethods, "stream_filter: Error allocating FFT memory\n");
+ }
+ for (i=0; i<taps; i++) {
+  DATATYPE const window=(taps==1 ? 1.0 : 0.54-0.46*cos(2*M_PI*i/(taps-1)));
+  local_arg->kernel[i]=designbuf[(i-delay+designsize)%designsize]/norm*window;
+ }
+ free((void *)designbuf);
+ local_arg->transfer_fftsize=0;
+}
+
+/* Transform the kernel zero-padded to fftsize points, in the realfft()
+ * layout. The normalization of the forward/backward realfft() pair is
+ * included. */
+LOCAL void
+build_transfer(transform_info_ptr tinfo, long const fftsize) {
+ struct stream_filter_storage *local_arg=(struct stream_filter_storage *)tinfo->methods->local_storage;
+ DATATYPE const norm=(DATATYPE)(fftsize>>1);
+ long i;
+
+ free_pointer((void **)&local_arg->transfer);
+ free_pointer((void **)&local_arg->workbuf);
+ if ((local_arg->transfer=(DATATYPE *)calloc(fftsize+2,sizeof(DATATYPE)))==NULL ||
+     (local_arg->workbuf=(DATATYPE *)malloc((fftsize+2)*sizeof(DATATYPE)))==NULL) {
+  ERREXIT(tinfo->emethods, "stream_filter: Error allocating transfer function\n");
+ }
+ memcpy(local_arg->transfer, local_arg->kernel, local_arg->taps*sizeof(DATATYPE));
+ if (!realfft(local_arg->transfer, fftsize, 1)) {
+  ERREXIT(tinfo->emethods, "stream_filter: Error allocating FFT memory\n");
+ }
+ for (i=0; i<fftsize+2; i++) {
+  local_arg->transfer[i]/=norm;
+ }
+ local_arg->transfer_fftsize=fftsize;
+}
+/*}}}  */
+
+/*{{{  Delaying triggers and x axis*/
+LOCAL void
+clear_delayed_annotations(transform_info_ptr tinfo) {
+ struct stream_filter_storage *local_arg=(struct stream_filter_storage *)tinfo->methods->local_storage;
+ if (local_arg->pending_triggers.buffer_start!=NULL) {
+  struct trigger *intrig=(struct trigger *)local_arg->pending_triggers.buffer_start;
+  struct trigger *const afterlast=(struct trigger *)(local_arg->pending_triggers.buffer_start+local_arg->pending_triggers.current_length);
+  for (; intrig<afterlast; intrig++) {
+   free_pointer((void **)&intrig->description);
+  }
+  growing_buf_free(&local_arg->pending_triggers);
+ }
+ free_pointer((void **)&local_arg->xhistory);
+}
+
+LOCAL void
+delay_trigger(transform_info_ptr tinfo, growing_buf *triggersp, growing_buf *pendingp, struct trigger trig) {
+ if (trig.position<tinfo->nr_of_points) {
+  growing_buf_append(triggersp, (char *)&trig, sizeof(struct trigger));
+ } else {
+  trig.position-=tinfo->nr_of_points;
+  growing_buf_append(pendingp, (char *)&trig, sizeof(struct trigger));
+ }
+}
+
+/* Delay the triggers, beforetrig and xdata of the current epoch by the
+ * filter delay */
+LOCAL void
+delay_annotations(transform_info_ptr tinfo) {
+ struct stream_filter_storage *local_arg=(struct stream_filter_storage *)tinfo->methods->local_storage;
+ long const delay=(local_arg->taps-1)/2, nr_of_points=tinfo->nr_of_points;
+ long point;
+
+ if (delay==0) return;
+ tinfo->beforetrig+=delay;
+ tinfo->aftertrig-=delay;
+
+ if (tinfo->xdata!=NULL) {
+  DATATYPE *xbuf=(DATATYPE *)malloc((delay+nr_of_points)*sizeof(DATATYPE));
+  if (xbuf==NULL) {
+   ERREXIT(tinfo->emethods, "stream_filter: Error allocating x axis memory\n");
+  }
+  if (local_arg->xhistory==NULL) {
+   /* Extrapolate the x axis into the past */
+   DATATYPE const step=(nr_of_points>1 ? tinfo->xdata[1]-tinfo->xdata[0] : 1.0/tinfo->sfreq);
+   if ((local_arg->xhistory=(DATATYPE *)malloc(delay*sizeof(DATATYPE)))==NULL) {
+    ERREXIT(tinfo->emethods, "stream_filter: Error allocating x axis memory\n");
+   }
+   for (point=0; point<delay; point++) {
+    local_arg->xhistory[point]=tinfo->xdata[0]-(delay-point)*step;
+   }
+  }
+  memcpy(xbuf, local_arg->xhistory, delay*sizeof(DATATYPE));
+  memcpy(xbuf+delay, tinfo->xdata, nr_of_points*sizeof(DATATYPE));
+  memcpy(tinfo->xdata, xbuf, nr_of_points*sizeof(DATATYPE));
+  memcpy(local_arg->xhistory, xbuf+nr_of_points, delay*sizeof(DATATYPE));
+  free((void *)xbuf);
+ }
+
+ if (tinfo->triggers.buffer_start!=NULL) {
+  struct trigger *intrig=(struct trigger *)tinfo->triggers.buffer_start;
+  growing_buf triggers, pending;
+  growing_buf_init(&triggers);
+  growing_buf_allocate(&triggers, 0);
+  growing_buf_init(&pending);
+  growing_buf_allocate(&pending, 0);
+  /* The file position entry */
+  growing_buf_append(&triggers, (char *)intrig, sizeof(struct trigger));
+  if (local_arg->pending_triggers.buffer_start!=NULL) {
+   struct trigger *pendtrig=(struct trigger *)local_arg->pending_triggers.buffer_start;
+   struct trigger *const afterlast=(struct trigger *)(local_arg->pending_triggers.buffer_start+local_arg->pending_triggers.current_length);
+   for (; pendtrig<afterlast; pendtrig++) {
+    delay_trigger(tinfo, &triggers, &pending, *pendtrig);
+   }
+   growing_buf_free(&local_arg->pending_triggers);
+  }
+  for (intrig++; intrig->code!=0; intrig++) {
+   struct trigger trig= *intrig;
+   trig.position+=delay;
+   delay_trigger(tinfo, &triggers, &pending, trig);
+  }
+  /* End marker */
+  growing_buf_append(&triggers, (char *)intrig, sizeof(struct trigger));
+  growing_buf_free(&tinfo->triggers);
+  tinfo->triggers=triggers;
+  local_arg->pending_triggers=pending;
+ }
+}
+/*}}}  */
+
+LOCAL void
+init_stream_filter_storage(transform_info_ptr tinfo) {
+ struct stream_filter_storage *local_arg=(struct stream_filter_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+
+ local_arg->sfreq=tinfo->sfreq;
+ free_pointer((void **)&local_arg->blockdefs);
+ local_arg->blockdefs=fftfilter_parse_blocks(tinfo, args[ARGS_BLOCKS].arg.s);
+ local_arg->taps=gettimeslice(tinfo, args[ARGS_TAPS].is_set ? args[ARGS_TAPS].arg.s : "1s");
+ if (local_arg->taps<1) {
+  ERREXIT1(tinfo->emethods, "stream_filter_init: Invalid number of taps %ld\n", MSGPARM(local_arg->taps));
+ }
+ /* An odd length gives a delay of an integer number of points */
+ local_arg->taps|=1;
+ design_kernel(tinfo);
+ /* Filtering starts afresh */
+ free_pointer((void **)&local_arg->history);
+ clear_delayed_annotations(tinfo);
+}
+
+/*{{{  stream_filter_init(transform_info_ptr tinfo) {*/
+METHODDEF void
+stream_filter_init(transform_info_ptr tinfo) {
+ struct stream_filter_storage *local_arg=(struct stream_filter_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+
+ local_arg->blockdefs=NULL;
+ local_arg->kernel=local_arg->transfer=local_arg->workbuf=local_arg->history=NULL;
+ growing_buf_init(&local_arg->pending_triggers);
+ local_arg->xhistory=NULL;
+ init_stream_filter_storage(tinfo);
+
+ if (args[ARGS_BYNAME].is_set) {
+  /* Note that this is NULL if no channel matched, which is why we need have_channel_list as well... */
+  local_arg->channel_list=expand_channel_list(tinfo, args[ARGS_BYNAME].arg.s);
+  local_arg->have_channel_list=TRUE;
+ } else {
+  local_arg->channel_list=NULL;
+  local_arg->have_channel_list=FALSE;
+ }
+
+ local_arg->fromitem=0;
+ local_arg->toitem=tinfo->itemsize-tinfo->leaveright-1;
+ if (args[ARGS_ITEMPART].is_set) {
+  local_arg->fromitem=local_arg->toitem=args[ARGS_ITEMPART].arg.i;
+  if (local_arg->fromitem<0 || local_arg->fromitem>=tinfo->itemsize) {
+   ERREXIT1(tinfo->emethods, "stream_filter_init: No item number %d in file\n", MSGPARM(local_arg->fromitem));
+  }
+ }
+
+ tinfo->methods->init_done=TRUE;
+}
+/*}}}  */
+
+/*{{{  stream_filter(transform_info_ptr tinfo) {*/
+METHODDEF DATATYPE *
+stream_filter(transform_info_ptr tinfo) {
+ struct stream_filter_storage *local_arg=(struct stream_filter_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+ long const datasize=tinfo->nr_of_points, overlap=local_arg->taps-1;
+ long fftsize, point, i;
+ int itempart, channel;
+ array_view view;
+
+ if (tinfo->sfreq!=local_arg->sfreq) init_stream_filter_storage(tinfo);
+ if (args[ARGS_EPOCHMODE].is_set) {
+  /* Triggers delayed beyond the end of the last epoch are dropped */
+  clear_delayed_annotations(tinfo);
+ }
+
+ if (local_arg->history!=NULL && (args[ARGS_EPOCHMODE].is_set || local_arg->history_channels!=tinfo->nr_of_channels || local_arg->history_items!=tinfo->itemsize)) {
+  if (!args[ARGS_EPOCHMODE].is_set) {
+   TRACEMS(tinfo->emethods, 1, "stream_filter: Channels or items changed, restarting the filter\n");
+  }
+  free_pointer((void **)&local_arg->history);
+ }
+
+ /* The buffer holds overlap points of history followed by the data */
+ fftsize=2*fft_good_size((overlap+datasize+1)/2, TRUE);
+ if (fftsize!=local_arg->transfer_fftsize) build_transfer(tinfo, fftsize);
+
+ if (args[ARGS_VERBOSE].is_set) {
+  growing_buf tracebuf;
+  growing_buf_init(&tracebuf);
+  growing_buf_allocate(&tracebuf,0);
+  growing_buf_appendf(&tracebuf, "stream_filter: %ld taps, delay %ld points, FFT size %ld points\n", local_arg->taps, overlap/2, fftsize);
+  TRACEMS(tinfo->emethods, -1, tracebuf.buffer_start);
+  growing_buf_free(&tracebuf);
+ }
+
+ tinfo_array_view(tinfo, &view);
+ if (local_arg->history==NULL) {
+  /* Start with the first value of each trace extended into the past */
+  if (overlap>0 && (local_arg->history=(DATATYPE *)malloc(tinfo->itemsize*view.nr_of_vectors*overlap*sizeof(DATATYPE)))==NULL) {
+   ERREXIT(tinfo->emethods, "stream_filter: Error allocating history memory\n");
+  }
+  for (itempart=0; itempart<tinfo->itemsize; itempart++) {
+   for (channel=0; channel<view.nr_of_vectors; channel++) {
+    DATATYPE * const history=local_arg->history+(itempart*view.nr_of_vectors+channel)*overlap;
+    DATATYPE const firstval=view.start[itempart+channel*view.vector_skip];
+    for (i=0; i<overlap; i++) history[i]=firstval;
+   }
+  }
+  local_arg->history_channels=view.nr_of_vectors;
+  local_arg->history_items=tinfo->itemsize;
+ }
+
+ /* Traces not selected by -n or -i are only delayed, so that they stay
+  * aligned with the filtered ones and with the delayed annotations */
+ for (itempart=0; itempart<tinfo->itemsize; itempart++) {
+  for (channel=0; channel<view.nr_of_vectors; channel++) {
+   DATATYPE * const history=local_arg->history+(itempart*view.nr_of_vectors+channel)*overlap;
+   DATATYPE * const fftdata=local_arg->workbuf;
+   DATATYPE const * const transfer=local_arg->transfer;
+   DATATYPE * const trace=view.start+itempart+channel*view.vector_skip;
+   Bool const selected=(itempart>=local_arg->fromitem && itempart<=local_arg->toitem &&
+    (!local_arg->have_channel_list || is_in_channellist(channel+1, local_arg->channel_list)));
+
+   memcpy(fftdata, history, overlap*sizeof(DATATYPE));
+   for (point=0; point<datasize; point++) {
+    fftdata[overlap+point]=trace[point*view.element_skip];
+   }
+   /* Keep the input tail for the next epoch before it is overwritten */
+   memcpy(history, fftdata+datasize, overlap*sizeof(DATATYPE));
+   if (!selected) {
+    for (point=0; point<datasize; point++) {
+     trace[point*view.element_skip]=fftdata[overlap-overlap/2+point];
+    }
+    continue;
+   }
+   for (point=overlap+datasize; point<fftsize; point++) {
+    fftdata[point]=0.0;
+   }
+   if (!realfft(fftdata, fftsize, 1)) {
+    ERREXIT(tinfo->emethods, "stream_filter: Error allocating FFT memory\n");
+   }
+   for (i=0; i<fftsize+2; i+=2) {
+    DATATYPE const re=fftdata[i]*transfer[i]-fftdata[i+1]*transfer[i+1];
+    fftdata[i+1]=fftdata[i]*transfer[i+1]+fftdata[i+1]*transfer[i];
+    fftdata[i]=re;
+   }
+   if (!realfft(fftdata, fftsize, -1)) {
+    ERREXIT(tinfo->emethods, "stream_filter: Error allocating FFT memory\n");
+   }
+   /* The first overlap points are wrapped around and discarded */
+   for (point=0; point<datasize; point++) {
+    trace[point*view.element_skip]=fftdata[overlap+point];
+   }
+  }
+ }
+ delay_annotations(tinfo);
+
+ return tinfo->tsdata;
+}
+/*}}}  */
+
+/*{{{  stream_filter_exit(transform_info_ptr tinfo) {*/
+METHODDEF void
+stream_filter_exit(transform_info_ptr tinfo) {
+ struct stream_filter_storage *local_arg=(struct stream_filter_storage *)tinfo->methods->local_storage;
+
+ free_pointer((void **)&local_arg->blockdefs);
+ free_pointer((void **)&local_arg->channel_list);
+ free_pointer((void **)&local_arg->kernel);
+ free_pointer((void **)&local_arg->transfer);
+ free_pointer((void **)&local_arg->workbuf);
+ free_pointer((void **)&local_arg->history);
+ clear_delayed_annotations(tinfo);
+
+ tinfo->methods->init_done=FALSE;
+}
+/*}}}  */
+
+/*{{{  select_stream_filter(transform_info_ptr tinfo) {*/
+GLOBAL void
+select_stream_filter(transform_info_ptr tinfo) {
+ tinfo->methods->transform_init= &stream_filter_init;
+ tinfo->methods->transform= &stream_filter;
+ tinfo->methods->transform_exit= &stream_filter_exit;
+ tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->method_name="stream_filter";
+ tinfo->methods->method_description=
+  "Transform method applying a FIR filter to continuous data read in chunks\n"
+  "(eg read_generic -c). The last taps-1 input points of each trace are kept,\n"
+  "so that consecutive epochs are filtered seamlessly as one long trace\n"
+  "(overlap-save). The first epoch is preceded by its first value.\n"
+  "The transfer function is given by `blocks' as for fftfilter:\n"
+  "start1 zerostart1 zeroend1 end1  [block2...], with an optional -x factor\n"
+  "at the start of any block. The kernel of `taps' points (rounded up to an odd\n"
+  "number) is designed from it with a Hamming window; longer kernels give\n"
+  "steeper transitions. The output is delayed by (taps-1)/2 points; triggers,\n"
+  "beforetrig and the x axis are delayed with it so that they stay aligned\n"
+  "with the filtered signal. Triggers delayed beyond the end of an epoch move\n"
+  "to the next one, or are dropped with -e or at the end of the data.\n"
+  "Channels and items not selected by -n or -i are delayed without filtering.\n";
+ tinfo->methods->local_storage_size=sizeof(struct stream_filter_storage);
+ tinfo->methods->nr_of_arguments=NR_OF_ARGUMENTS;
+ tinfo->methods->argument_descriptors=argument_descriptors;
+}
+/*}}}  */
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-2001,2004 Bernd Feige
+ * Copyright (C) 1996-2001,2004,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -10,6 +10,10 @@
  * each item, the waveforms of all channels are equal, only the amplitude is
  * different. This is a somewhat `exploded' but useful view on the SVD result.
  * 						-- Bernd Feige 08.09.1996
+ * The components are those with the largest singular values, in decreasing
+ * order; array_svd_leading uses LAPACK if available and computes only the
+ * leading components with option -t.
+ * 						-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
@@ -24,6 +28,7 @@ enum ARGS_ENUM {
  ARGS_MAPS=0, 
  ARGS_ONLYMAPS, 
  ARGS_COMPLEX, 
+ ARGS_TRUNCATED, 
  ARGS_NCOMPONENTS, 
  NR_OF_ARGUMENTS
 };
@@ -31,6 +36,7 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_NOTHING, "The components are the maps rather than the waveforms", "m", FALSE, NULL},
  {T_ARGS_TAKES_NOTHING, "Output only the maps for later projection", "M", FALSE, NULL},
  {T_ARGS_TAKES_NOTHING, "Treat item pairs as complex entities", "c", FALSE, NULL},
+ {T_ARGS_TAKES_NOTHING, "Truncated SVD: Approximate only the leading components by randomized subspace iteration", "t", FALSE, NULL},
  {T_ARGS_TAKES_LONG, "n_components", "", 3, NULL}
 };
 
@@ -112,7 +118,10 @@ svdecomp(transform_info_ptr tinfo) {
    /* For the decomposition, we have only tinfo->itemsize/subitemsize items */
    array_use_item(&myarray_decompversion, itempart/subitemsize);
    array_reset(&myarray_decompversion); array_reset(&w); array_reset(&v);
-   array_svdcmp(&myarray_decompversion, &w, &v);
+   array_svd_leading(&myarray_decompversion, &w, &v, ncomps, args[ARGS_TRUNCATED].is_set);
+   if (myarray_decompversion.message==ARRAY_ERROR) {
+    ERREXIT(tinfo->emethods, "svdecomp: Singular value decomposition failed\n");
+   }
   }
   if (args[ARGS_ONLYMAPS].is_set) {
    array_reset(&v);
@@ -179,7 +188,8 @@ select_svdecomp(transform_info_ptr tinfo) {
   " it returns a number of items corresponding to different component waveforms;\n"
   " within each item, the waveforms of all channels are equal, only the amplitude\n"
   " is different. This is a somewhat `exploded' but useful view on the SVD result.\n"
-  " The argument n_components is the number of SVD components to output.\n";
+  " The argument n_components is the number of SVD components to output,\n"
+  " those with the largest singular values.\n";
  tinfo->methods->local_storage_size=0;
  tinfo->methods->nr_of_arguments=NR_OF_ARGUMENTS;
  tinfo->methods->argument_descriptors=argument_descriptors;
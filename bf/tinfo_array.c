@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1993,1994,1997,1998,2001 Bernd Feige
+ * Copyright (C) 1993,1994,1997,1998,2001,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*
@@ -70,3 +70,14 @@ tinfo_array_setfreq(transform_info_ptr tinfo, array *thisarray, int freq) {
  array_setreadwrite(thisarray);
  array_reset(thisarray);
 }
+
+GLOBAL void
+tinfo_array_view(transform_info_ptr tinfo, array_view *view) {
+ /* Same layout as tinfo_array(., .), but handed out as a plain strided view
+  * for loops that access the memory directly. Item 0 is at view->start. */
+ array myarray;
+ tinfo_array(tinfo, &myarray);
+ if (!array_get_view(&myarray, view)) {
+  ERREXIT(tinfo->emethods, "tinfo_array_view: Can't describe the data as a view\n");
+ }
+}
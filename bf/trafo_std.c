@@ -375,6 +375,42 @@ copy_channelinfo(transform_info_ptr tinfo, char **channelnames, double *probepos
 }
 /*}}}  */
 
+/*{{{  select_channelinfo(transform_info_ptr tinfo, Bool const *selected)*/
+/* select_channelinfo reduces the channel names and probe positions of the
+ * tinfo->nr_of_channels channels in tinfo to those marked in selected[]
+ * (see expand_channel_selection) and sets nr_of_channels accordingly. */
+GLOBAL void
+select_channelinfo(transform_info_ptr tinfo, Bool const *selected) {
+ int channel, nr_selected=0, stringlength=0;
+
+ for (channel=0; channel<tinfo->nr_of_channels; channel++) {
+  if (!selected[channel]) continue;
+  if (tinfo->channelnames!=NULL) stringlength+=strlen(tinfo->channelnames[channel])+1;
+  if (tinfo->probepos!=NULL && nr_selected<channel) {
+   memcpy(tinfo->probepos+3*nr_selected, tinfo->probepos+3*channel, 3*sizeof(double));
+  }
+  nr_selected++;
+ }
+ if (tinfo->channelnames!=NULL) {
+  char * const old_buffer=tinfo->channelnames[0];
+  char *in_buffer=(char *)malloc(stringlength);
+  if (in_buffer==NULL) {
+   ERREXIT(tinfo->emethods, "select_channelinfo: Error allocating channelnames\n");
+  }
+  /* The names are moved down in the array, never overwriting one still to be copied */
+  nr_selected=0;
+  for (channel=0; channel<tinfo->nr_of_channels; channel++) {
+   if (!selected[channel]) continue;
+   strcpy(in_buffer, tinfo->channelnames[channel]);
+   tinfo->channelnames[nr_selected++]=in_buffer;
+   in_buffer+=strlen(in_buffer)+1;
+  }
+  free(old_buffer);
+ }
+ tinfo->nr_of_channels=nr_selected;
+}
+/*}}}  */
+
 /*{{{  deepcopy_tinfo(transform_info_ptr to_tinfo, transform_info_ptr from_tinfo) {*/
 /* deepcopy_tinfo copies the whole tinfo structure including all strings and
  * arrays, EXCEPT tsdata. This makes sense if the target number of channels AND 
@@ -691,6 +727,31 @@ push_trigger(growing_buf *triggersp, long position, int code, char *description)
 }
 /*}}}  */
 
+/*{{{  join_triggers(growing_buf *triggersp, growing_buf *fromtriggersp, long offset)*/
+/* Append the triggers of the epoch list fromtriggersp to triggersp, shifting
+ * their positions by offset. Both lists follow the epoch convention (file
+ * position entry first, code==0 end marker); if triggersp is empty, it
+ * takes over the file position entry of fromtriggersp. */
+GLOBAL void
+join_triggers(growing_buf *triggersp, growing_buf *fromtriggersp, long offset) {
+ struct trigger *intrig;
+ if (fromtriggersp->buffer_start==NULL) return;
+ if (triggersp->buffer_start==NULL) {
+  growing_buf_allocate(triggersp, 0);
+  /* Record the file position... */
+  growing_buf_append(triggersp, fromtriggersp->buffer_start, sizeof(struct trigger));
+ } else {
+  /* Delete the end marker */
+  triggersp->current_length-=sizeof(struct trigger);
+ }
+ for (intrig=(struct trigger *)fromtriggersp->buffer_start+1; intrig->code!=0; intrig++) {
+  push_trigger(triggersp, intrig->position+offset, intrig->code, intrig->description);
+ }
+ /* Write end marker */
+ push_trigger(triggersp, 0, 0, NULL);
+}
+/*}}}  */
+
 /*{{{  clear_triggers(growing_buf *triggersp)*/
 GLOBAL void
 clear_triggers(growing_buf *triggersp) {
@@ -105,6 +105,10 @@ struct external_methods_struct {
 msgparm_t message_parm[8];	/* store numeric parms for messages here */
 
  METHOD(void, execution_callback, (const transform_info_ptr tinfo, const execution_callback_place where));
+
+ /* Number of threads to use for the iterated queue; <=1 means serial execution.
+  * See do_queues() in setup_queue.c */
+ int nr_of_threads;
 };
 /*}}}  */
 
@@ -115,6 +119,13 @@ enum method_types {
  NR_OF_METHOD_TYPES
 };
 
+/* Destination layouts for the block interface: Multiplexed means
+ * dest[point*nr_of_channels+channel], nonmultiplexed
+ * dest[channel*nr_of_points+point] */
+enum get_block_layouts {
+ GET_BLOCK_MULTIPLEXED, GET_BLOCK_NONMULTIPLEXED
+};
+
 struct transform_methods_struct {
  METHOD(void, transform_init, (transform_info_ptr tinfo));
  METHOD(DATATYPE *, transform, (transform_info_ptr tinfo));
@@ -123,6 +134,12 @@ struct transform_methods_struct {
  /* The single point interface */
  METHOD(int,  get_singlepoint, (transform_info_ptr tinfo, array *toarray));
  METHOD(void, seek_point, (transform_info_ptr tinfo, long to_point));
+ /* The block interface: Read nr_of_points points from start_point on for the
+  * channels in channel_list (channel_index+1 values terminated by 0 as from
+  * expand_channel_list; NULL means all) into dest. Returns the number of
+  * points read. Use get_block() in get_block.c, which falls back to the
+  * single point interface for methods not setting this. */
+ METHOD(long, get_block, (transform_info_ptr tinfo, long start_point, long nr_of_points, int const *channel_list, DATATYPE *dest, enum get_block_layouts layout));
  METHOD(int, seek_trigger, (transform_info_ptr tinfo, int trigcode));
  METHOD(void, get_filestrings, (transform_info_ptr tinfo));
 
@@ -144,6 +161,12 @@ struct transform_methods_struct {
  int line_of_script;
  /* Tells which of a sequence of scripts this was: */
  int script_number;
+
+ /* Set by the select function if transform() keeps no state between epochs
+  * and uses no global state, so that copies of the method (with their own
+  * local_storage) may process different epochs concurrently. FALSE (the
+  * default, set by setup_queue) declares the method serial-only. */
+ Bool parallel_safe;
 };
 /*}}}  */
 
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2026 Bernd Feige
+ * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+ */
+/*
+ * trigger_cache.c keeps the trigger list that a reader extracted by scanning
+ * a data file in a sidecar file next to it (<datafile>.trgcache), so that
+ * the scan is only done once per file. The cache is keyed on the size and
+ * modification time of the data file, on the sampling frequency and on a
+ * reader-supplied key string describing everything else the list depends on
+ * (reader name, relevant options); see sidecar.c. Failure to read or write
+ * the cache is never an error; the reader simply scans the file as before.
+ *	-- Bernd Feige 17.10.2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "transform.h"
+#include "bf.h"
+
+#define TRIGGER_CACHE_SUFFIX ".trgcache"
+#define TRIGGER_CACHE_MAGIC "avg_q trigger cache 2\n"
+
+/*{{{  trigger_cache_key(transform_info_ptr tinfo, char const *key)*/
+/* The sidecar key: The reader's key and the sampling frequency the trigger
+ * positions were computed with */
+LOCAL char *
+trigger_cache_key(transform_info_ptr tinfo, char const *key) {
+ char * const fullkey=(char *)malloc(strlen(key)+40);
+ if (fullkey!=NULL) sprintf(fullkey, "%s sfreq=%.17g", key, (double)tinfo->sfreq);
+ return fullkey;
+}
+/*}}}  */
+
+/*{{{  trigger_cache_load(transform_info_ptr tinfo, char const *datafilename, char const *key, growing_buf *triggersp)*/
+/* Returns TRUE and replaces the contents of *triggersp by the cached list
+ * if a cache matching the current state of datafilename exists. */
+GLOBAL Bool
+trigger_cache_load(transform_info_ptr tinfo, char const *datafilename, char const *key, growing_buf *triggersp) {
+ char * const fullkey=trigger_cache_key(tinfo, key);
+ struct sidecar_file cache;
+ char *description=NULL;
+ uint32_t allocated_description=0;
+ uint32_t ntriggers, trigno;
+ Bool valid;
+
+ if (fullkey==NULL) return FALSE;
+ valid=sidecar_open(&cache, datafilename, TRIGGER_CACHE_SUFFIX, TRIGGER_CACHE_MAGIC, fullkey);
+ free(fullkey);
+ if (!valid) return FALSE;
+ if (triggersp->buffer_start==NULL) {
+  growing_buf_allocate(triggersp, 0);
+ } else {
+  growing_buf_clear(triggersp);
+ }
+ valid=(fread(&ntriggers, sizeof(ntriggers), 1, cache.file)==1);
+ for (trigno=0; valid && trigno<ntriggers; trigno++) {
+  int64_t position;
+  int32_t code;
+  uint32_t descriptionlength;
+  if (fread(&position, sizeof(position), 1, cache.file)!=1
+   || fread(&code, sizeof(code), 1, cache.file)!=1
+   || fread(&descriptionlength, sizeof(descriptionlength), 1, cache.file)!=1) {
+   valid=FALSE;
+   break;
+  }
+  if (descriptionlength>0) {
+   if (descriptionlength>allocated_description) {
+    free_pointer((void **)&description);
+    if ((description=(char *)malloc(descriptionlength))==NULL) {
+     valid=FALSE;
+     break;
+    }
+    allocated_description=descriptionlength;
+   }
+   if (fread(description, 1, descriptionlength, cache.file)!=descriptionlength) {
+    valid=FALSE;
+    break;
+   }
+   description[descriptionlength-1]='\0';
+  }
+  push_trigger(triggersp, (long)position, (int)code, descriptionlength>0 ? description : NULL);
+ }
+ free_pointer((void **)&description);
+ if (!valid) {
+  /* Truncated cache: Forget the partial list, caller will rebuild it */
+  clear_triggers(triggersp);
+  growing_buf_clear(triggersp);
+  TRACEMS1(tinfo->emethods, 0, "trigger_cache_load: Ignoring damaged cache file %s\n", MSGPARM(cache.filename));
+ } else {
+  TRACEMS2(tinfo->emethods, 1, "trigger_cache_load: Read %d triggers from %s\n", MSGPARM(ntriggers), MSGPARM(cache.filename));
+ }
+ sidecar_close(&cache);
+ return valid;
+}
+/*}}}  */
+
+/*{{{  trigger_cache_save(transform_info_ptr tinfo, char const *datafilename, char const *key, growing_buf *triggersp)*/
+/* Store the first current_length/sizeof(struct trigger) entries of
+ * *triggersp. */
+GLOBAL void
+trigger_cache_save(transform_info_ptr tinfo, char const *datafilename, char const *key, growing_buf *triggersp) {
+ char * const fullkey=trigger_cache_key(tinfo, key);
+ struct sidecar_file cache;
+ uint32_t const ntriggers=(triggersp->buffer_start==NULL ? 0 : triggersp->current_length/sizeof(struct trigger));
+ struct trigger const * const triggers=(struct trigger const *)triggersp->buffer_start;
+ uint32_t trigno;
+ Bool ok;
+
+ if (fullkey==NULL) return;
+ ok=sidecar_create(&cache, datafilename, TRIGGER_CACHE_SUFFIX, TRIGGER_CACHE_MAGIC, fullkey);
+ free(fullkey);
+ if (!ok) {
+  TRACEMS1(tinfo->emethods, 1, "trigger_cache_save: Not creating a trigger cache for %s\n", MSGPARM(datafilename));
+  return;
+ }
+ ok=(fwrite(&ntriggers, sizeof(ntriggers), 1, cache.file)==1);
+ for (trigno=0; ok && trigno<ntriggers; trigno++) {
+  int64_t const position=triggers[trigno].position;
+  int32_t const code=triggers[trigno].code;
+  char const * const description=triggers[trigno].description;
+  uint32_t const descriptionlength=(description==NULL ? 0 : strlen(description)+1);
+  ok=(fwrite(&position, sizeof(position), 1, cache.file)==1
+   && fwrite(&code, sizeof(code), 1, cache.file)==1
+   && fwrite(&descriptionlength, sizeof(descriptionlength), 1, cache.file)==1
+   && (descriptionlength==0 || fwrite(description, 1, descriptionlength, cache.file)==descriptionlength));
+ }
+ if (sidecar_commit(&cache, ok)) {
+  TRACEMS2(tinfo->emethods, 1, "trigger_cache_save: Wrote %d triggers for %s\n", MSGPARM(ntriggers), MSGPARM(datafilename));
+ } else {
+  TRACEMS1(tinfo->emethods, 1, "trigger_cache_save: Can't write the trigger cache for %s\n", MSGPARM(datafilename));
+ }
+}
+/*}}}  */
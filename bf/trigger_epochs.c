@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2026 Bernd Feige
+ * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+ */
+/*
+ * trigger_epochs.c implements the trigger-driven epoch selection common to
+ * the get_epoch methods: Walking the file trigger list in file order, only
+ * accepting codes from the -t list, shrinking the window by the -o offset
+ * and skipping windows that would extend beyond the data, as well as
+ * collecting the triggers within an epoch for option -T.
+ * The latter used to be a scan of the whole list for each epoch; it is now
+ * answered from an index of the list sorted by position, which is built on
+ * first use, by a binary search for the window start.
+ *	-- Bernd Feige 17.10.2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "transform.h"
+#include "bf.h"
+
+struct trigger_epochs_entry {
+ long position;
+ int entry;	/* Index into the file trigger list */
+};
+
+/*{{{  Comparison functions for qsort*/
+LOCAL int
+trigger_epochs_compare_entries(const void *a, const void *b) {
+ struct trigger_epochs_entry const * const ea=(struct trigger_epochs_entry const *)a;
+ struct trigger_epochs_entry const * const eb=(struct trigger_epochs_entry const *)b;
+ if (ea->position!=eb->position) return (ea->position<eb->position ? -1 : 1);
+ /* Keep triggers at the same position in file order */
+ return ea->entry-eb->entry;
+}
+LOCAL int
+trigger_epochs_compare_ints(const void *a, const void *b) {
+ return *(int const *)a-*(int const *)b;
+}
+/*}}}  */
+
+/*{{{  trigger_epochs_load(transform_info_ptr tinfo, struct trigger_epochs *epochs)*/
+/* Build the file trigger list if that didn't happen yet and return the
+ * number of its entries */
+LOCAL int
+trigger_epochs_load(transform_info_ptr tinfo, struct trigger_epochs *epochs) {
+ if (epochs->triggersp->buffer_start==NULL) {
+  /* Load the event information */
+  if (epochs->build_trigbuffer!=NULL) (*epochs->build_trigbuffer)(tinfo);
+  if (epochs->triggersp->buffer_start==NULL) growing_buf_allocate(epochs->triggersp, 0);
+ }
+ return epochs->triggersp->current_length/sizeof(struct trigger);
+}
+/*}}}  */
+
+/*{{{  trigger_epochs_index(transform_info_ptr tinfo, struct trigger_epochs *epochs)*/
+/* (Re)build the position index if the list changed since it was built.
+ * As for the sequential access, a code of 0 ends the list. */
+LOCAL void
+trigger_epochs_index(transform_info_ptr tinfo, struct trigger_epochs *epochs) {
+ int const nevents=trigger_epochs_load(tinfo, epochs);
+ struct trigger const * const triggers=(struct trigger const *)epochs->triggersp->buffer_start;
+ Bool in_order=TRUE;
+ int trigno;
+
+ if (epochs->by_position!=NULL && epochs->nr_listed==nevents) return;
+ free_pointer((void **)&epochs->by_position);
+ free_pointer((void **)&epochs->hits);
+ if ((epochs->by_position=(struct trigger_epochs_entry *)malloc((nevents>0 ? nevents : 1)*sizeof(struct trigger_epochs_entry)))==NULL
+  || (epochs->hits=(int *)malloc((nevents>0 ? nevents : 1)*sizeof(int)))==NULL) {
+  ERREXIT(tinfo->emethods, "trigger_epochs_index: Error allocating memory\n");
+ }
+ for (trigno=0; trigno<nevents && triggers[trigno].code!=0; trigno++) {
+  epochs->by_position[trigno].position=triggers[trigno].position;
+  epochs->by_position[trigno].entry=trigno;
+  if (trigno>0 && triggers[trigno].position<triggers[trigno-1].position) in_order=FALSE;
+ }
+ epochs->nr_listed=nevents;
+ epochs->nr_indexed=trigno;
+ if (!in_order) {
+  qsort(epochs->by_position, epochs->nr_indexed, sizeof(struct trigger_epochs_entry), trigger_epochs_compare_entries);
+ }
+ TRACEMS1(tinfo->emethods, 1, "trigger_epochs_index: Indexed %d triggers\n", MSGPARM(epochs->nr_indexed));
+}
+/*}}}  */
+
+/*{{{  trigger_epochs_init(struct trigger_epochs *epochs, growing_buf *triggersp, void (*build_trigbuffer)(transform_info_ptr tinfo))*/
+/* Start the selection at the beginning of the list with all triggers
+ * accepted; The caller sets trigcodes, remap_codes, offset and
+ * points_in_file afterwards as needed. build_trigbuffer may be NULL if the
+ * list is filled by other means. */
+GLOBAL void
+trigger_epochs_init(struct trigger_epochs *epochs, growing_buf *triggersp, void (*build_trigbuffer)(transform_info_ptr tinfo)) {
+ memset(epochs, 0, sizeof(struct trigger_epochs));
+ epochs->triggersp=triggersp;
+ epochs->build_trigbuffer=build_trigbuffer;
+}
+/*}}}  */
+
+/*{{{  trigger_epochs_next(transform_info_ptr tinfo, struct trigger_epochs *epochs, long beforetrig, long aftertrig)*/
+/* Advance to the next trigger defining a valid epoch window and return its
+ * (possibly remapped) code, or 0 if the list is exhausted. The window is
+ * stored in trigger_point, start_point and end_point (inclusive). */
+GLOBAL int
+trigger_epochs_next(transform_info_ptr tinfo, struct trigger_epochs *epochs, long beforetrig, long aftertrig) {
+ int const nevents=trigger_epochs_load(tinfo, epochs);
+ struct trigger const * const triggers=(struct trigger const *)epochs->triggersp->buffer_start;
+
+ while (epochs->current_trigger<nevents) {
+  struct trigger const * const intrig=triggers+epochs->current_trigger++;
+  int code=intrig->code;
+  long const start_point=intrig->position-beforetrig+epochs->offset;
+  long const end_point=intrig->position+aftertrig-1-epochs->offset;
+
+  if (code==0) break;	/* End marker */
+  if (epochs->trigcodes!=NULL) {
+   int trigno=0;
+   while (epochs->trigcodes[trigno]!=0 && epochs->trigcodes[trigno]!=code) trigno++;
+   if (epochs->trigcodes[trigno]==0) continue;
+   if (epochs->remap_codes) code=trigno+1;
+  }
+  if (start_point<0 || (epochs->points_in_file>0 && end_point>=epochs->points_in_file)) continue;
+  epochs->trigger_point=intrig->position;
+  epochs->start_point=start_point;
+  epochs->end_point=end_point;
+  epochs->description=intrig->description;
+  return code;
+ }
+ return 0;
+}
+/*}}}  */
+
+/*{{{  trigger_epochs_transfer(transform_info_ptr tinfo, struct trigger_epochs *epochs, growing_buf *epochtriggersp, long file_start_point, long file_end_point)*/
+/* Append the epoch trigger list for the window file_start_point..file_end_point
+ * (inclusive) to epochtriggersp: The file position entry, all file triggers
+ * within the window in file order with positions relative to its start,
+ * and the end marker. Neither -t nor the current position apply here. */
+GLOBAL void
+trigger_epochs_transfer(transform_info_ptr tinfo, struct trigger_epochs *epochs, growing_buf *epochtriggersp, long file_start_point, long file_end_point) {
+ struct trigger const *triggers;
+ int low=0, high, nhits=0, hit;
+
+ trigger_epochs_index(tinfo, epochs);
+ triggers=(struct trigger const *)epochs->triggersp->buffer_start;
+ /* First trigger entry holds file_start_point */
+ push_trigger(epochtriggersp, file_start_point, -1, NULL);
+ /* Find the first indexed trigger at or after file_start_point */
+ high=epochs->nr_indexed;
+ while (low<high) {
+  int const mid=low+(high-low)/2;
+  if (epochs->by_position[mid].position<file_start_point) low=mid+1;
+  else high=mid;
+ }
+ for (; low<epochs->nr_indexed && epochs->by_position[low].position<=file_end_point; low++) {
+  epochs->hits[nhits++]=epochs->by_position[low].entry;
+ }
+ /* Restore file order if the list is not sorted by position */
+ if (nhits>1) qsort(epochs->hits, nhits, sizeof(int), trigger_epochs_compare_ints);
+ for (hit=0; hit<nhits; hit++) {
+  struct trigger const * const intrig=triggers+epochs->hits[hit];
+  push_trigger(epochtriggersp, intrig->position-file_start_point, intrig->code, intrig->description);
+ }
+ push_trigger(epochtriggersp, 0, 0, NULL); /* End of list */
+}
+/*}}}  */
+
+/*{{{  trigger_epochs_free(struct trigger_epochs *epochs)*/
+/* Free the index; The trigger list itself belongs to the caller */
+GLOBAL void
+trigger_epochs_free(struct trigger_epochs *epochs) {
+ free_pointer((void **)&epochs->by_position);
+ free_pointer((void **)&epochs->hits);
+ epochs->nr_listed=epochs->nr_indexed=0;
+}
+/*}}}  */
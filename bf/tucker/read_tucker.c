@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-1999,2001-2004,2006-2008,2010-2014,2024 Bernd Feige
+ * Copyright (C) 1996-1999,2001-2004,2006-2008,2010-2014,2024,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -8,6 +8,9 @@
  * read_tucker.c module to read data from the Tucker format that is
  * used with the `Geodesic Net' 128-electrode system.
  *	-- Bernd Feige 16.12.1996
+ * Epochs are read through the block interface, converting up to a megabyte
+ * of points per fread.
+ *	-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
@@ -32,6 +35,7 @@
 enum ARGS_ENUM {
  ARGS_CONTINUOUS=0,
  ARGS_TRIGTRANSFER, 
+ ARGS_SINGLEPOINT, 
  ARGS_TRIGLIST, 
  ARGS_FROMEPOCH,
  ARGS_EPOCHS,
@@ -45,6 +49,7 @@ enum ARGS_ENUM {
 LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_NOTHING, "Continuous mode. Read the file in chunks of the given size without triggers", "c", FALSE, NULL},
  {T_ARGS_TAKES_NOTHING, "Transfer a list of triggers within the read epoch", "T", FALSE, NULL},
+ {T_ARGS_TAKES_NOTHING, "Read the data point by point rather than in blocks (slow)", "p", FALSE, NULL},
  {T_ARGS_TAKES_STRING_WORD, "trigger_list: Restrict epochs to these condition codes. Eg: 1,2", "t", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_LONG, "fromepoch: Specify start epoch beginning with 1", "f", 1, NULL},
  {T_ARGS_TAKES_LONG, "epochs: Specify maximum number of epochs to get", "e", 1, NULL},
@@ -60,8 +65,8 @@ struct read_tucker_storage {
  struct tucker_header header;
  FILE *infile;
  int *trigcodes;
- int current_trigger;
  growing_buf triggers;
+ struct trigger_epochs trigger_epochs;
  long current_point;
  char (*EventCodes)[5]; /* Pointer to fixed-length strings */
  long SizeofHeader;
@@ -79,7 +84,7 @@ struct read_tucker_storage {
 };
 /*}}}  */
 
-/*{{{  Single point interface*/
+/*{{{  Single point and block interface*/
 
 /*{{{  read_tucker_get_filestrings: Allocate and set strings and probepos array*/
 LOCAL void
@@ -175,11 +180,76 @@ read_tucker_get_singlepoint(transform_info_ptr tinfo, array *toarray) {
 }
 /*}}}  */
 
-/*{{{  Maintaining the buffered triggers list*/
-LOCAL void 
-read_tucker_reset_triggerbuffer(transform_info_ptr tinfo) {
+/*{{{  read_tucker_get_block(transform_info_ptr tinfo, long start_point, long nr_of_points, int const *channel_list, DATATYPE *dest, enum get_block_layouts layout) {*/
+/* The native block interface: Reads as many points as fit into
+ * BLOCK_READ_BYTES with a single fread and converts them to dest in one pass */
+#define BLOCK_READ_BYTES (1<<20)
+LOCAL long
+read_tucker_get_block(transform_info_ptr tinfo, long start_point, long nr_of_points, int const *channel_list, DATATYPE *dest, enum get_block_layouts layout) {
  struct read_tucker_storage *local_arg=(struct read_tucker_storage *)tinfo->methods->local_storage;
- local_arg->current_trigger=0;
+ int const nr_of_outchannels=get_block_nr_of_channels(tinfo, channel_list);
+ long const points_per_read=(local_arg->bytes_per_point>=BLOCK_READ_BYTES ? 1 : BLOCK_READ_BYTES/local_arg->bytes_per_point);
+ long const end_point=(start_point+nr_of_points<local_arg->points_in_file ? start_point+nr_of_points : local_arg->points_in_file);
+ void *readbuf;
+ long point=start_point;
+
+ if (end_point<=start_point) return 0;
+ if ((readbuf=malloc(points_per_read*local_arg->bytes_per_point))==NULL) {
+  ERREXIT(tinfo->emethods, "read_tucker_get_block: Error allocating read buffer\n");
+ }
+ fseek(local_arg->infile,start_point*local_arg->bytes_per_point+local_arg->SizeofHeader,SEEK_SET);
+ while (point<end_point) {
+  long const chunk_points=(end_point-point<points_per_read ? end_point-point : points_per_read);
+  long inpoint;
+  if ((long)fread(readbuf,local_arg->bytes_per_point,chunk_points,local_arg->infile)!=chunk_points) {
+   free(readbuf);
+   ERREXIT(tinfo->emethods, "read_tucker_get_block: Error reading data\n");
+  }
+  for (inpoint=0; inpoint<chunk_points; inpoint++, point++) {
+   long const sample0=inpoint*(local_arg->header.NChan+local_arg->header.NEvents);
+   long const outpoint=point-start_point;
+   int channel;
+   for (channel=0; channel<nr_of_outchannels; channel++) {
+    long const sample=sample0+(channel_list==NULL ? channel : channel_list[channel]-1);
+    DATATYPE val;
+    /* The data are big-endian */
+    switch (local_arg->header.Version) {
+     case 2: {
+      uint16_t word=((uint16_t *)readbuf)[sample];
+#     ifdef LITTLE_ENDIAN
+      Intel_int16(&word);
+#     endif
+      val=local_arg->Factor*word;
+      }
+      break;
+     case 4: {
+      float f=((float *)readbuf)[sample];
+#     ifdef LITTLE_ENDIAN
+      Intel_float(&f);
+#     endif
+      val=f;
+      }
+      break;
+     default: {
+      double d=((double *)readbuf)[sample];
+#     ifdef LITTLE_ENDIAN
+      Intel_double(&d);
+#     endif
+      val=d;
+      }
+      break;
+    }
+    if (layout==GET_BLOCK_MULTIPLEXED) {
+     dest[outpoint*nr_of_outchannels+channel]=val;
+    } else {
+     dest[channel*nr_of_points+outpoint]=val;
+    }
+   }
+  }
+ }
+ free(readbuf);
+ local_arg->current_point=end_point;
+ return end_point-start_point;
 }
 /*}}}  */
 
@@ -264,33 +334,6 @@ read_tucker_build_trigbuffer(transform_info_ptr tinfo) {
 }
 /*}}}  */
 
-/* This is the highest-level access function: Read the next trigger and
- * advance the trigger counter. If this function is not called at least
- * once, event information is not even touched. */
-LOCAL int
-read_tucker_read_trigger(transform_info_ptr tinfo, long *position, char **descriptionp) {
- struct read_tucker_storage *local_arg=(struct read_tucker_storage *)tinfo->methods->local_storage;
- int code=0;
- if (local_arg->triggers.buffer_start==NULL) {
-  /* Load the event information */
-  read_tucker_build_trigbuffer(tinfo);
- }
- {
- int const nevents=local_arg->triggers.current_length/sizeof(struct trigger);
-
- if (local_arg->current_trigger<nevents) {
-  struct trigger * const intrig=((struct trigger *)local_arg->triggers.buffer_start)+local_arg->current_trigger;
-  *position=intrig->position;
-   code    =intrig->code;
-  if (descriptionp!=NULL) *descriptionp=intrig->description;
- }
- }
- local_arg->current_trigger++;
- return code;
-}
-/*}}}  */
-/*}}}  */
-
 /*{{{  read_tucker_init(transform_info_ptr tinfo) {*/
 METHODDEF void
 read_tucker_init(transform_info_ptr tinfo) {
@@ -384,8 +427,12 @@ read_tucker_init(transform_info_ptr tinfo) {
   local_arg->trigcodes=NULL;
  }
 
- read_tucker_reset_triggerbuffer(tinfo);
- local_arg->current_trigger=0;
+ trigger_epochs_init(&local_arg->trigger_epochs, &local_arg->triggers, &read_tucker_build_trigbuffer);
+ local_arg->trigger_epochs.trigcodes=local_arg->trigcodes;
+ local_arg->trigger_epochs.offset=local_arg->offset;
+ local_arg->trigger_epochs.points_in_file=local_arg->points_in_file;
+ /* get_block() then falls back to the single point interface */
+ if (args[ARGS_SINGLEPOINT].is_set) tinfo->methods->get_block=NULL;
  local_arg->current_point=0;
 
  tinfo->methods->init_done=TRUE;
@@ -398,7 +445,6 @@ read_tucker(transform_info_ptr tinfo) {
  struct read_tucker_storage *local_arg=(struct read_tucker_storage *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
  array myarray;
- Bool not_correct_trigger=FALSE;
  long trigger_point, file_start_point, file_end_point;
  char *description=NULL;
 
@@ -422,50 +468,23 @@ read_tucker(transform_info_ptr tinfo) {
    trigger_point=file_start_point+tinfo->beforetrig;
    file_end_point=trigger_point+tinfo->aftertrig-1;
    if (file_end_point>=local_arg->points_in_file) return NULL;
-   local_arg->current_trigger++;
+   local_arg->trigger_epochs.current_trigger++;
    local_arg->current_point+=tinfo->nr_of_points;
    tinfo->condition=0;
-  } else 
-  do {
-   tinfo->condition=read_tucker_read_trigger(tinfo, &trigger_point, &description);
+  } else {
+   tinfo->condition=trigger_epochs_next(tinfo, &local_arg->trigger_epochs, tinfo->beforetrig, tinfo->aftertrig);
    if (tinfo->condition==0) return NULL;	/* No more triggers in file */
-   file_start_point=trigger_point-tinfo->beforetrig+local_arg->offset;
-   file_end_point=trigger_point+tinfo->aftertrig-1-local_arg->offset;
-   
-   if (local_arg->trigcodes==NULL) {
-    not_correct_trigger=FALSE;
-   } else {
-    int trigno=0;
-    not_correct_trigger=TRUE;
-    while (local_arg->trigcodes[trigno]!=0) {
-     if (local_arg->trigcodes[trigno]==tinfo->condition) {
-      not_correct_trigger=FALSE;
-      break;
-     }
-     trigno++;
-    }
-   }
-  } while (not_correct_trigger || file_start_point<0 || file_end_point>=local_arg->points_in_file);
+   trigger_point=local_arg->trigger_epochs.trigger_point;
+   file_start_point=local_arg->trigger_epochs.start_point;
+   file_end_point=local_arg->trigger_epochs.end_point;
+   description=local_arg->trigger_epochs.description;
+  }
  } while (--local_arg->fromepoch>0);
- TRACEMS3(tinfo->emethods, 1, "read_tucker: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
+ TRACEMS3(tinfo->emethods, 1, "read_tucker: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
 
  /*{{{  Handle triggers within the epoch (option -T)*/
  if (args[ARGS_TRIGTRANSFER].is_set) {
-  int code;
-  long trigpoint;
-  long const old_current_trigger=local_arg->current_trigger;
-  char *thisdescription;
-
-  /* First trigger entry holds file_start_point */
-  push_trigger(&tinfo->triggers, file_start_point, -1, NULL);
-  read_tucker_reset_triggerbuffer(tinfo);
-  for (; (code=read_tucker_read_trigger(tinfo, &trigpoint, &thisdescription))!=0;) {
-   if (trigpoint>=file_start_point && trigpoint<=file_end_point) {
-    push_trigger(&tinfo->triggers, trigpoint-file_start_point, code, thisdescription);
-   }
-  }
-  push_trigger(&tinfo->triggers, 0, 0, NULL); /* End of list */
-  local_arg->current_trigger=old_current_trigger;
+  trigger_epochs_transfer(tinfo, &local_arg->trigger_epochs, &tinfo->triggers, file_start_point, file_end_point);
  }
  /*}}}  */
 
@@ -496,10 +515,9 @@ read_tucker(transform_info_ptr tinfo) {
    strcat(tinfo->comment, description);
   }
  }
- local_arg->current_point=file_start_point;
- do {
-  read_tucker_get_singlepoint(tinfo, &myarray);
- } while (myarray.message!=ARRAY_ENDOFSCAN);
+ if (get_block(tinfo, file_start_point, tinfo->nr_of_points, NULL, myarray.start, GET_BLOCK_MULTIPLEXED)!=tinfo->nr_of_points) {
+  ERREXIT(tinfo->emethods, "read_tucker: Epoch extends beyond the end of the file\n");
+ }
 
  tinfo->file_start_point=file_start_point;
  tinfo->z_label=NULL;
@@ -523,6 +541,7 @@ read_tucker_exit(transform_info_ptr tinfo) {
  free_pointer((void **)&local_arg->trigcodes);
  free_pointer((void **)&local_arg->EventCodes);
 
+ trigger_epochs_free(&local_arg->trigger_epochs);
  if (local_arg->triggers.buffer_start!=NULL) {
   clear_triggers(&local_arg->triggers);
   growing_buf_free(&local_arg->triggers);
@@ -541,6 +560,7 @@ select_read_tucker(transform_info_ptr tinfo) {
  tinfo->methods->transform_exit= &read_tucker_exit;
  tinfo->methods->get_singlepoint= &read_tucker_get_singlepoint;
  tinfo->methods->seek_point= &read_tucker_seek_point;
+ tinfo->methods->get_block= &read_tucker_get_block;
  tinfo->methods->get_filestrings= &read_tucker_get_filestrings;
  tinfo->methods->method_type=GET_EPOCH_METHOD;
  tinfo->methods->method_name="read_tucker";
@@ -72,7 +72,7 @@ struct read_vitaport_storage {
  FILE *infile;
  FILE *triggerfile;
  int *trigcodes;
- int current_trigger;
+ struct trigger_epochs trigger_epochs;
  growing_buf triggers;
  long sum_dlen;
  long current_point;
@@ -130,19 +130,14 @@ read_vitaport_get_filestrings(transform_info_ptr tinfo) {
 /*}}}  */
 
 /*{{{  read_vitaport_nexttrigger(transform_info_ptr tinfo, long *trigpoint) {*/
-/*{{{  Maintaining the triggers list*/
-LOCAL void 
-read_vitaport_reset_triggerbuffer(transform_info_ptr tinfo) {
- struct read_vitaport_storage *local_arg=(struct read_vitaport_storage *)tinfo->methods->local_storage;
- local_arg->current_trigger=0;
-}
-
 /*{{{  read_vitaport_build_trigbuffer(transform_info_ptr tinfo) {*/
 /* This function has all the knowledge about events in the various file types */
 LOCAL void 
 read_vitaport_build_trigbuffer(transform_info_ptr tinfo) {
  struct read_vitaport_storage *local_arg=(struct read_vitaport_storage *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
+ /* Identifies the trigger list in the cache: options that change it go here */
+ char const * const cachekey=(args[ARGS_MARKER].is_set ? "read_vitaport -M" : "read_vitaport");
 
  if (local_arg->triggers.buffer_start==NULL) {
   growing_buf_allocate(&local_arg->triggers, 0);
@@ -164,7 +159,7 @@ read_vitaport_build_trigbuffer(transform_info_ptr tinfo) {
    free_pointer((void **)&description);
   }
   if (triggerfile!=stdin) fclose(triggerfile);
- } else {
+ } else if (!trigger_cache_load(tinfo, args[ARGS_IFILE].arg.s, cachekey, &local_arg->triggers)) {
   int channel, marker_channel= -1;
   int const NoOfChannels=local_arg->fileheader.knum;
   /* Hmmm, first we saw only the 'MARKER' variant but then also 'Marker' was
@@ -289,35 +284,11 @@ read_vitaport_build_trigbuffer(transform_info_ptr tinfo) {
     }
    }
   }
+  trigger_cache_save(tinfo, args[ARGS_IFILE].arg.s, cachekey, &local_arg->triggers);
  }
 }
 /*}}}  */
 
-/* This is the highest-level access function: Read the next trigger and
- * advance the trigger counter. If this function is not called at least
- * once, event information is not even touched. */
-LOCAL int
-read_vitaport_read_trigger(transform_info_ptr tinfo, long *position, char **descriptionp) {
- struct read_vitaport_storage *local_arg=(struct read_vitaport_storage *)tinfo->methods->local_storage;
- int code=0;
- if (local_arg->triggers.buffer_start==NULL) {
-  /* Load the event information */
-  read_vitaport_build_trigbuffer(tinfo);
- }
- {
- int const nevents=local_arg->triggers.current_length/sizeof(struct trigger);
-
- if (local_arg->current_trigger<nevents) {
-  struct trigger * const intrig=((struct trigger *)local_arg->triggers.buffer_start)+local_arg->current_trigger;
-  *position=intrig->position;
-   code    =intrig->code;
-  if (descriptionp!=NULL) *descriptionp=intrig->description;
- }
- }
- local_arg->current_trigger++;
- return code;
-}
-/*}}}  */
 /*}}}  */
 
 /*{{{  read_vitaport_init(transform_info_ptr tinfo) {*/
@@ -574,8 +545,10 @@ read_vitaport_init(transform_info_ptr tinfo) {
   local_arg->trigcodes=NULL;
  }
 
- read_vitaport_reset_triggerbuffer(tinfo);
- local_arg->current_trigger=0;
+ trigger_epochs_init(&local_arg->trigger_epochs, &local_arg->triggers, &read_vitaport_build_trigbuffer);
+ local_arg->trigger_epochs.trigcodes=local_arg->trigcodes;
+ local_arg->trigger_epochs.offset=local_arg->offset;
+ local_arg->trigger_epochs.points_in_file=local_arg->points_in_file;
  local_arg->current_point=0;
  local_arg->current_triggerpoint=0;
 
@@ -590,7 +563,6 @@ read_vitaport(transform_info_ptr tinfo) {
  transform_argument *args=tinfo->methods->arguments;
  array myarray;
  FILE *infile=local_arg->infile;
- Bool not_correct_trigger=FALSE;
  long trigger_point, file_start_point, file_end_point;
  char *description=NULL;
 
@@ -614,50 +586,23 @@ read_vitaport(transform_info_ptr tinfo) {
    trigger_point=file_start_point+tinfo->beforetrig;
    file_end_point=trigger_point+tinfo->aftertrig-1;
    if (file_end_point>=local_arg->points_in_file) return NULL;
-   local_arg->current_trigger++;
+   local_arg->trigger_epochs.current_trigger++;
    local_arg->current_point+=tinfo->nr_of_points;
    tinfo->condition=0;
-  } else 
-  do {
-   tinfo->condition=read_vitaport_read_trigger(tinfo, &trigger_point, &description);
+  } else {
+   tinfo->condition=trigger_epochs_next(tinfo, &local_arg->trigger_epochs, tinfo->beforetrig, tinfo->aftertrig);
    if (tinfo->condition==0) return NULL;	/* No more triggers in file */
-   file_start_point=trigger_point-tinfo->beforetrig+local_arg->offset;
-   file_end_point=trigger_point+tinfo->aftertrig-1-local_arg->offset;
-   
-   if (local_arg->trigcodes==NULL) {
-    not_correct_trigger=FALSE;
-   } else {
-    int trigno=0;
-    not_correct_trigger=TRUE;
-    while (local_arg->trigcodes[trigno]!=0) {
-     if (local_arg->trigcodes[trigno]==tinfo->condition) {
-      not_correct_trigger=FALSE;
-      break;
-     }
-     trigno++;
-    }
-   }
-  } while (not_correct_trigger || file_start_point<0 || file_end_point>=local_arg->points_in_file);
+   trigger_point=local_arg->trigger_epochs.trigger_point;
+   file_start_point=local_arg->trigger_epochs.start_point;
+   file_end_point=local_arg->trigger_epochs.end_point;
+   description=local_arg->trigger_epochs.description;
+  }
  } while (--local_arg->fromepoch>0);
- TRACEMS3(tinfo->emethods, 1, "read_vitaport: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
+ TRACEMS3(tinfo->emethods, 1, "read_vitaport: Reading around tag %d at %d, condition=%d\n", MSGPARM(local_arg->trigger_epochs.current_trigger), MSGPARM(trigger_point), MSGPARM(tinfo->condition));
 
  /*{{{  Handle triggers within the epoch (option -T)*/
  if (args[ARGS_TRIGTRANSFER].is_set) {
-  int code;
-  long trigpoint;
-  long const old_current_trigger=local_arg->current_trigger;
-  char *thisdescription;
-
-  /* First trigger entry holds file_start_point */
-  push_trigger(&tinfo->triggers, file_start_point, -1, NULL);
-  read_vitaport_reset_triggerbuffer(tinfo);
-  for (; (code=read_vitaport_read_trigger(tinfo, &trigpoint, &thisdescription))!=0;) {
-   if (trigpoint>=file_start_point && trigpoint<=file_end_point) {
-    push_trigger(&tinfo->triggers, trigpoint-file_start_point, code, thisdescription);
-   }
-  }
-  push_trigger(&tinfo->triggers, 0, 0, NULL); /* End of list */
-  local_arg->current_trigger=old_current_trigger;
+  trigger_epochs_transfer(tinfo, &local_arg->trigger_epochs, &tinfo->triggers, file_start_point, file_end_point);
  }
  /*}}}  */
 
@@ -850,6 +795,7 @@ read_vitaport_exit(transform_info_ptr tinfo) {
  }
  fclose(local_arg->infile);
  free_pointer((void **)&local_arg->trigcodes);
+ trigger_epochs_free(&local_arg->trigger_epochs);
  free_pointer((void **)&local_arg->sampling_step);
  if (local_arg->channelnames!=NULL) {
   free_pointer((void **)&local_arg->channelnames[0]);
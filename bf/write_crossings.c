@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 1996-1999,2001-2007,2010,2012-2014,2020 Bernd Feige
+ * Copyright (C) 1996-1999,2001-2007,2010,2012-2014,2020,2026 Bernd Feige
  * This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
  */
 /*{{{}}}*/
@@ -18,6 +18,18 @@
  *  by this method (most useful, of course, if a continuous file is read
  *  with the -c option).
  * 						-- Bernd Feige 2.02.1996
+ *
+ * In ranges mode (-r), the sections above threshold are reported as pairs
+ *  of onset (1) and offset (-1) events carrying the peak value of the
+ *  section. Sections separated by at most the debounce gap (-d) are joined
+ *  and sections shorter than the minimum duration (-m) are dropped, so that
+ *  detectors don't have to pair and filter the crossings afterwards.
+ * With -b, events are written as fixed-size binary records (see
+ *  write_binary_event) instead of text lines.
+ * In epoch mode, sections are clipped to the epoch: A section already above
+ *  threshold at the first point of an epoch starts there, and one still
+ *  above threshold at the end ends one point past the last.
+ * 						-- Bernd Feige 17.10.2026
  */
 /*}}}  */
 
@@ -26,6 +38,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
+#ifdef __MINGW32__
+#include <fcntl.h>
+#include <io.h>
+#endif
+#include <Intel_compat.h>
 #include "transform.h"
 #include "bf.h"
 /*}}}  */
@@ -35,8 +53,12 @@ enum ARGS_ENUM {
  ARGS_CLOSE,
  ARGS_EPOCHMODE, 
  ARGS_REPORT_XVALUE, 
+ ARGS_BINARY, 
  ARGS_ITEMPART, 
  ARGS_REFRACTORY_PERIOD, 
+ ARGS_RANGES, 
+ ARGS_MIN_DURATION, 
+ ARGS_DEBOUNCE, 
  ARGS_POINTOFFSET, 
  ARGS_CHANNELNAMES, 
  ARGS_THRESHOLD, 
@@ -48,14 +70,48 @@ LOCAL transform_argument_descriptor argument_descriptors[NR_OF_ARGUMENTS]={
  {T_ARGS_TAKES_NOTHING, "Close the output file after each epoch (and open it again next time)", "c", FALSE, NULL},
  {T_ARGS_TAKES_NOTHING, "Epoch mode - Restart detector for each new epoch", "e", FALSE, NULL},
  {T_ARGS_TAKES_NOTHING, "Report x axis values rather than point numbers", "x", FALSE, NULL},
+ {T_ARGS_TAKES_NOTHING, "Write binary event records rather than text", "b", FALSE, NULL},
  {T_ARGS_TAKES_LONG, "nr_of_item: work only on this item # (>=0)", "i", 0, NULL},
  {T_ARGS_TAKES_STRING_WORD, "Refractory period", "R", ARGDESC_UNUSED, NULL},
+ {T_ARGS_TAKES_NOTHING, "Ranges mode: Report onset and offset of the sections above threshold", "r", FALSE, NULL},
+ {T_ARGS_TAKES_STRING_WORD, "Ranges mode: Minimum duration of a section", "m", ARGDESC_UNUSED, NULL},
+ {T_ARGS_TAKES_STRING_WORD, "Ranges mode: Join sections separated by at most this gap", "d", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_STRING_WORD, "Offset to add to each point number", "o", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_STRING_WORD, "channelnames", "", ARGDESC_UNUSED, NULL},
  {T_ARGS_TAKES_DOUBLE, "threshold", "", 0, NULL},
  {T_ARGS_TAKES_FILENAME, "Output file", "", ARGDESC_UNUSED, (const char *const *)"*.crs"}
 };
 
+/* The binary output starts with CROSSINGS_MAGIC, the header length as
+ * little-endian uint64 and a key=value text header padded with zeros to a
+ * multiple of 8 bytes; then follows one crossings_record per event, all
+ * numbers little-endian. */
+#define CROSSINGS_MAGIC "AVGQCRS1"
+struct crossings_record {
+ int64_t position;	/* Point number as in the text output */
+ int32_t code;	/* 1/-1 for positive/negative crossing, maximum/minimum, onset/offset */
+ int32_t channel;	/* Index into the channel list, starting with 1 */
+ double value;	/* Value at the crossing, extremum, or peak value of the section */
+};
+
+/*{{{  Definition of crossing_range*/
+/* Ranges mode state of one channel. A finished section is kept pending
+ * until it is clear that no following section is close enough to be
+ * joined with it. */
+struct crossing_range {
+ Bool in_range;
+ long onset;
+ double onset_x;	/* x values are only set with -x */
+ DATATYPE peak;
+ Bool have_pending;
+ long pending_onset;
+ long pending_offset;
+ double pending_onset_x;
+ double pending_offset_x;
+ DATATYPE pending_peak;
+};
+/*}}}  */
+
 /*{{{  Definition of write_crossings_storage*/
 struct write_crossings_storage {
  FILE *outfile;
@@ -66,20 +122,161 @@ struct write_crossings_storage {
  long refractory_period;
  long remaining_refractory_points;
  long pointoffset;
+ /* Ranges mode is also implied by -m and -d: */
+ Bool ranges_mode;
+ long min_duration;
+ long debounce;
  /* Note how many points have already been seen: */
  long past_points;
+ /* past_points at the start of the current epoch: */
+ long epoch_start;
  long epochs_seen;
+ /* Channel for which a `# Channel=' line was last written, -1 if none */
+ int reported_channel;
  /* sign(val-threshold). This can be -1, +1 or 0 if undetermined: */
  int *signs_of_last_diff;
+ struct crossing_range *ranges;
  growing_buf triggers;
 };
 /*}}}  */
 
+/*{{{  Event output*/
+LOCAL void
+write_binary_header(transform_info_ptr tinfo) {
+ struct write_crossings_storage *local_arg=(struct write_crossings_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+ growing_buf header;
+ uint64_t header_length;
+ int channel_list_index;
+
+ growing_buf_init(&header);
+ growing_buf_allocate(&header, 0);
+ growing_buf_appendf(&header, "mode=%s\nsfreq=%.17g\nthreshold=%.17g\n", (local_arg->ranges_mode ? "Ranges" : args[ARGS_EXTREMA].is_set ? "Extrema" : "Crossings"), tinfo->sfreq, args[ARGS_THRESHOLD].arg.d);
+ if (local_arg->ranges_mode) {
+  growing_buf_appendf(&header, "min_duration=%ld\ndebounce=%ld\n", local_arg->min_duration, local_arg->debounce);
+ }
+ growing_buf_appendf(&header, "channelnames=");
+ for (channel_list_index=0; channel_list_index<local_arg->channels_in_list; channel_list_index++) {
+  growing_buf_appendf(&header, "%s%s", (channel_list_index>0 ? "\t" : ""), tinfo->channelnames[local_arg->channel_list[channel_list_index]-1]);
+ }
+ growing_buf_appendf(&header, "\n");
+ /* Drop the terminating zero and pad to 8 bytes so that the records are aligned */
+ header.current_length--;
+ while (header.current_length%8!=0) growing_buf_appendchar(&header, '\0');
+ header_length=header.current_length;
+#ifndef LITTLE_ENDIAN
+ Intel_int64(&header_length);
+#endif
+ if (fwrite(CROSSINGS_MAGIC, 1, 8, local_arg->outfile)!=8
+  || fwrite(&header_length, sizeof(header_length), 1, local_arg->outfile)!=1
+  || fwrite(header.buffer_start, 1, header.current_length, local_arg->outfile)!=(size_t)header.current_length) {
+  ERREXIT(tinfo->emethods, "write_crossings: Error writing binary header\n");
+ }
+ growing_buf_free(&header);
+}
+
+LOCAL void
+write_binary_event(transform_info_ptr tinfo, long position, int code, int channel_list_index, DATATYPE value) {
+ struct write_crossings_storage *local_arg=(struct write_crossings_storage *)tinfo->methods->local_storage;
+ struct crossings_record record;
+ record.position=position;
+ record.code=code;
+ record.channel=channel_list_index+1;
+ record.value=value;
+#ifndef LITTLE_ENDIAN
+ Intel_int64((uint64_t *)&record.position);
+ Intel_int32((uint32_t *)&record.code);
+ Intel_int32((uint32_t *)&record.channel);
+ Intel_double(&record.value);
+#endif
+ if (fwrite(&record, sizeof(record), 1, local_arg->outfile)!=1) {
+  ERREXIT(tinfo->emethods, "write_crossings: Error writing event record\n");
+ }
+}
+
+/* Write the `# Channel=' line before the first text event of a channel */
+LOCAL void
+report_channel(transform_info_ptr tinfo, int channel) {
+ struct write_crossings_storage *local_arg=(struct write_crossings_storage *)tinfo->methods->local_storage;
+ if (channel!=local_arg->reported_channel) {
+  fprintf(local_arg->outfile, "# Channel=%s\n", tinfo->channelnames[channel]);
+  local_arg->reported_channel=channel;
+ }
+}
+
+/* The x value of local_point in ranges mode, which may be the end of the epoch */
+LOCAL double
+range_xvalue(transform_info_ptr tinfo, long local_point) {
+ if (tinfo->xdata==NULL) {
+  create_xaxis(tinfo, NULL);
+ }
+ if (local_point<tinfo->nr_of_points) return tinfo->xdata[local_point];
+ if (tinfo->nr_of_points<2) return tinfo->xdata[tinfo->nr_of_points-1];
+ return 2*tinfo->xdata[tinfo->nr_of_points-1]-tinfo->xdata[tinfo->nr_of_points-2];
+}
+
+/* Output one onset or offset event of ranges mode; position counts like point,
+ * x is the corresponding x value reported with -x */
+LOCAL void
+write_range_event(transform_info_ptr tinfo, long position, double x, int code, int channel_list_index, DATATYPE peak) {
+ struct write_crossings_storage *local_arg=(struct write_crossings_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+ if (local_arg->outfile==NULL) {
+  /* Relative to the current epoch; Negative for onsets in earlier epochs */
+  char description[32];
+  snprintf(description, sizeof(description), "%g", peak);
+  push_trigger(&local_arg->triggers, position-local_arg->epoch_start, code*(channel_list_index+1), description);
+ } else if (args[ARGS_BINARY].is_set) {
+  write_binary_event(tinfo, position, code, channel_list_index, peak);
+ } else {
+  report_channel(tinfo, local_arg->channel_list[channel_list_index]-1);
+  if (args[ARGS_REPORT_XVALUE].is_set) {
+   fprintf(local_arg->outfile, "%s=%g\t%d\t%g\n", tinfo->xchannelname, x, code, peak);
+  } else {
+   fprintf(local_arg->outfile, "%ld\t%d\t%g\n", position, code, peak);
+  }
+ }
+}
+
+/* End the section of a channel at point, keeping it pending */
+LOCAL void
+end_range(transform_info_ptr tinfo, int channel_list_index, long point, long local_point) {
+ struct write_crossings_storage *local_arg=(struct write_crossings_storage *)tinfo->methods->local_storage;
+ transform_argument *args=tinfo->methods->arguments;
+ struct crossing_range * const range=local_arg->ranges+channel_list_index;
+ range->in_range=FALSE;
+ range->have_pending=TRUE;
+ range->pending_onset=range->onset;
+ range->pending_offset=point;
+ range->pending_onset_x=range->onset_x;
+ range->pending_offset_x=(args[ARGS_REPORT_XVALUE].is_set ? range_xvalue(tinfo, local_point) : 0.0);
+ range->pending_peak=range->peak;
+}
+
+/* Output the pending section of a channel if it is long enough */
+LOCAL void
+flush_pending_range(transform_info_ptr tinfo, int channel_list_index) {
+ struct write_crossings_storage *local_arg=(struct write_crossings_storage *)tinfo->methods->local_storage;
+ struct crossing_range * const range=local_arg->ranges+channel_list_index;
+ if (!range->have_pending) return;
+ if (range->pending_offset-range->pending_onset>=local_arg->min_duration) {
+  write_range_event(tinfo, range->pending_onset, range->pending_onset_x, 1, channel_list_index, range->pending_peak);
+  write_range_event(tinfo, range->pending_offset, range->pending_offset_x, -1, channel_list_index, range->pending_peak);
+ }
+ range->have_pending=FALSE;
+}
+/*}}}  */
+
 LOCAL void open_file(transform_info_ptr tinfo) {
  struct write_crossings_storage *local_arg=(struct write_crossings_storage *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
  if (strcmp(args[ARGS_OFILE].arg.s, "stdout")==0) {
   local_arg->outfile=stdout;
+#ifdef __MINGW32__
+  if (args[ARGS_BINARY].is_set && _setmode( _fileno( stdout ), _O_BINARY ) == -1) {
+   ERREXIT(tinfo->emethods, "write_crossings_init: Can't set binary mode for stdout\n");
+  }
+#endif
  } else if (strcmp(args[ARGS_OFILE].arg.s, "stderr")==0) {
   local_arg->outfile=stderr;
  } else if (strcmp(args[ARGS_OFILE].arg.s, "triggers")==0) {
@@ -87,10 +284,12 @@ LOCAL void open_file(transform_info_ptr tinfo) {
    * memory. outfile==NULL is taken as indication for this condition. */
   local_arg->outfile=NULL;
  } else
- if ((local_arg->outfile=fopen(args[ARGS_OFILE].arg.s, "w"))==NULL) {
+ if ((local_arg->outfile=fopen(args[ARGS_OFILE].arg.s, args[ARGS_BINARY].is_set ? "wb" : "w"))==NULL) {
   ERREXIT1(tinfo->emethods, "write_crossings_init: Can't open file >%s<\n", MSGPARM(args[ARGS_OFILE].arg.s));
  }
- if (local_arg->outfile!=NULL) {
+ if (local_arg->outfile!=NULL && args[ARGS_BINARY].is_set) {
+  write_binary_header(tinfo);
+ } else if (local_arg->outfile!=NULL) {
   /* For info, output the sampling frequency as comment */
   fprintf(local_arg->outfile, "# %s\n# Sfreq=%f\n# Epochlength=%d\n# Threshold=%g\n", (args[ARGS_EXTREMA].is_set ? "Extrema" : "Crossings"), (float)tinfo->sfreq, tinfo->nr_of_points, args[ARGS_THRESHOLD].arg.d);
   if (args[ARGS_ITEMPART].is_set) {
@@ -102,7 +301,21 @@ LOCAL void open_file(transform_info_ptr tinfo) {
   if (args[ARGS_POINTOFFSET].is_set) {
    fprintf(local_arg->outfile, "# Point offset=%ld\n", local_arg->pointoffset);
   }
+  if (local_arg->ranges_mode) {
+   fprintf(local_arg->outfile, "# Min duration=%ld\n# Debounce=%ld\n", local_arg->min_duration, local_arg->debounce);
+  }
+ }
+}
+
+/* Range events carry descriptions which were copied to tinfo->triggers */
+LOCAL void
+clear_range_events(transform_info_ptr tinfo) {
+ struct write_crossings_storage *local_arg=(struct write_crossings_storage *)tinfo->methods->local_storage;
+ struct trigger *intrig;
+ for (intrig=(struct trigger *)local_arg->triggers.buffer_start; intrig!=NULL && (char *)intrig<local_arg->triggers.buffer_start+local_arg->triggers.current_length; intrig++) {
+  free_pointer((void **)&intrig->description);
  }
+ growing_buf_clear(&local_arg->triggers);
 }
 
 LOCAL void close_file(transform_info_ptr tinfo) {
@@ -154,6 +367,33 @@ write_crossings_init(transform_info_ptr tinfo) {
  } else {
   local_arg->pointoffset=0;
  }
+ local_arg->ranges_mode=(args[ARGS_RANGES].is_set || args[ARGS_MIN_DURATION].is_set || args[ARGS_DEBOUNCE].is_set);
+ local_arg->min_duration=local_arg->debounce=0;
+ if (local_arg->ranges_mode) {
+  if (args[ARGS_EXTREMA].is_set) {
+   ERREXIT(tinfo->emethods, "write_crossings_init: Ranges mode cannot be combined with -E.\n");
+  }
+  if (args[ARGS_REFRACTORY_PERIOD].is_set) {
+   ERREXIT(tinfo->emethods, "write_crossings_init: Ranges mode cannot be combined with -R; use -d.\n");
+  }
+  if (args[ARGS_MIN_DURATION].is_set) {
+   local_arg->min_duration=gettimeslice(tinfo, args[ARGS_MIN_DURATION].arg.s);
+  }
+  if (args[ARGS_DEBOUNCE].is_set) {
+   local_arg->debounce=gettimeslice(tinfo, args[ARGS_DEBOUNCE].arg.s);
+  }
+  if (local_arg->min_duration<0 || local_arg->debounce<0) {
+   ERREXIT(tinfo->emethods, "write_crossings_init: Minimum duration and debounce gap must not be negative.\n");
+  }
+ }
+ if (args[ARGS_BINARY].is_set) {
+  if (args[ARGS_REPORT_XVALUE].is_set || args[ARGS_EPOCHMODE].is_set) {
+   ERREXIT(tinfo->emethods, "write_crossings_init: Binary records contain point numbers and cannot be combined with -x or -e.\n");
+  }
+  if (strcmp(args[ARGS_OFILE].arg.s, "triggers")==0) {
+   ERREXIT(tinfo->emethods, "write_crossings_init: Option -b needs an output file.\n");
+  }
+ }
 
  local_arg->channel_list=expand_channel_list(tinfo, args[ARGS_CHANNELNAMES].arg.s);
  if (local_arg->channel_list==NULL) {
@@ -161,6 +401,7 @@ write_crossings_init(transform_info_ptr tinfo) {
  }
  local_arg->channels_in_list=0;
  while (local_arg->channel_list[local_arg->channels_in_list]!=0) local_arg->channels_in_list++;
+ local_arg->reported_channel= -1;
 
  if (!args[ARGS_CLOSE].is_set) open_file(tinfo);
 
@@ -179,6 +420,12 @@ write_crossings_init(transform_info_ptr tinfo) {
    ERREXIT(tinfo->emethods, "write_crossings_init: Error allocating signs_of_last_diff array\n");
   }
  }
+ local_arg->ranges=NULL;
+ if (local_arg->ranges_mode) {
+  if ((local_arg->ranges=(struct crossing_range *)calloc(local_arg->channels_in_list, sizeof(struct crossing_range)))==NULL) {
+   ERREXIT(tinfo->emethods, "write_crossings_init: Error allocating ranges array\n");
+  }
+ }
 
  tinfo->methods->init_done=TRUE;
 }
@@ -201,11 +448,16 @@ write_crossings(transform_info_ptr tinfo) {
   if (!args[ARGS_EXTREMA].is_set) {
    memset(local_arg->signs_of_last_diff, 0, local_arg->channels_in_list*sizeof(int));
   }
+  if (local_arg->ranges_mode) {
+   memset(local_arg->ranges, 0, local_arg->channels_in_list*sizeof(struct crossing_range));
+  }
  }
+ local_arg->epoch_start=local_arg->past_points;
+ if (local_arg->channels_in_list>1) local_arg->reported_channel= -1;
 
  if (local_arg->outfile==NULL) {
-  growing_buf_clear(&local_arg->triggers);
- } else {
+  clear_range_events(tinfo);
+ } else if (!args[ARGS_BINARY].is_set) {
  if (args[ARGS_EPOCHMODE].is_set || args[ARGS_REPORT_XVALUE].is_set) {
   /* In epoch mode or if we report x values, the epoch number cannot be
    * calculated because point numbers and x values repeat across epochs. Thus,
@@ -219,7 +471,7 @@ write_crossings(transform_info_ptr tinfo) {
  }
  /* Report the channel name only once if only one channel is selected: */
  if (local_arg->channels_in_list==1 && local_arg->epochs_seen==0) {
-  fprintf(local_arg->outfile, "# Channel=%s\n", tinfo->channelnames[local_arg->channel_list[0] - 1]);
+  report_channel(tinfo, local_arg->channel_list[0] - 1);
  }
  }
 
@@ -229,7 +481,7 @@ write_crossings(transform_info_ptr tinfo) {
  while ((channel= local_arg->channel_list[channel_list_index] - 1)>=0) {
   long local_point=0;
   int sign_of_last_diff=0;
-  Bool channelname_reported=(local_arg->channels_in_list==1);
+  struct crossing_range * const range=(local_arg->ranges_mode ? local_arg->ranges+channel_list_index : NULL);
 
   if (!args[ARGS_EXTREMA].is_set) {
    sign_of_last_diff=local_arg->signs_of_last_diff[channel_list_index];
@@ -271,14 +523,13 @@ write_crossings(transform_info_ptr tinfo) {
      if (local_arg->outfile==NULL) {
       int const code=condition*(channel_list_index+1);
       push_trigger(&local_arg->triggers, (local_point>0 ? local_point-1 : 0L), code, NULL);
+     } else if (args[ARGS_BINARY].is_set) {
+      write_binary_event(tinfo, point-1, condition, channel_list_index, p2);
      } else {
 #define WHERE_SIZE 1024
      char where[WHERE_SIZE];
 
-     if (!channelname_reported) {
-      fprintf(local_arg->outfile, "# Channel=%s\n", tinfo->channelnames[channel]);
-      channelname_reported=TRUE;
-     }
+     report_channel(tinfo, channel);
 
      if (args[ARGS_REPORT_XVALUE].is_set) {
       if (tinfo->xdata==NULL) {
@@ -300,8 +551,36 @@ write_crossings(transform_info_ptr tinfo) {
    }
    }
   } else {
-  DATATYPE const diff=array_scan(&tsdata)-args[ARGS_THRESHOLD].arg.d;
+  DATATYPE const value=array_scan(&tsdata);
+  DATATYPE const diff=value-args[ARGS_THRESHOLD].arg.d;
   int const sign_of_this_diff=(diff>=0 ? 1 : -1);
+   if (range!=NULL) {
+    /*{{{ Ranges mode*/
+    if (range->in_range) {
+     if (sign_of_this_diff<0) {
+      /* Offset: Keep the section pending, it might be joined with the next */
+      end_range(tinfo, channel_list_index, point, local_point);
+      if (local_arg->debounce==0) flush_pending_range(tinfo, channel_list_index);
+     } else if (value>range->peak) {
+      range->peak=value;
+     }
+    } else if (sign_of_this_diff>0 && (sign_of_last_diff<0 || (sign_of_last_diff==0 && args[ARGS_EPOCHMODE].is_set))) {
+     /* Onset, or the start of the epoch in epoch mode */
+     range->in_range=TRUE;
+     if (range->have_pending && point-range->pending_offset<=local_arg->debounce) {
+      range->onset=range->pending_onset;
+      range->onset_x=range->pending_onset_x;
+      range->peak=(value>range->pending_peak ? value : range->pending_peak);
+      range->have_pending=FALSE;
+     } else {
+      flush_pending_range(tinfo, channel_list_index);
+      range->onset=point;
+      range->onset_x=(args[ARGS_REPORT_XVALUE].is_set ? range_xvalue(tinfo, local_point) : 0.0);
+      range->peak=value;
+     }
+    }
+    /*}}}  */
+   } else
    if (sign_of_last_diff==0 || local_arg->remaining_refractory_points>0) {
     if (local_arg->remaining_refractory_points>0) local_arg->remaining_refractory_points--;
    } else {
@@ -309,13 +588,12 @@ write_crossings(transform_info_ptr tinfo) {
    /*{{{ Output a trigger */
    if (local_arg->outfile==NULL) {
     push_trigger(&local_arg->triggers, local_point, sign_of_this_diff*(channel_list_index+1), NULL);
+   } else if (args[ARGS_BINARY].is_set) {
+    write_binary_event(tinfo, point, sign_of_this_diff, channel_list_index, value);
    } else {
    char where[WHERE_SIZE];
 
-   if (!channelname_reported) {
-    fprintf(local_arg->outfile, "# Channel=%s\n", tinfo->channelnames[channel]);
-    channelname_reported=TRUE;
-   }
+   report_channel(tinfo, channel);
 
    if (args[ARGS_REPORT_XVALUE].is_set) {
     if (tinfo->xdata==NULL) {
@@ -340,6 +618,19 @@ write_crossings(transform_info_ptr tinfo) {
   if (!args[ARGS_EXTREMA].is_set) {
    local_arg->signs_of_last_diff[channel_list_index]=sign_of_last_diff;
   }
+  if (range!=NULL && range->in_range && args[ARGS_EPOCHMODE].is_set) {
+   /* Epoch mode restarts the detector, so end the section with the epoch */
+   end_range(tinfo, channel_list_index, point, local_point);
+  }
+  if (range!=NULL && range->have_pending) {
+   /* The pending section is final if no section starting with the next
+    * epoch can be joined with it; Epoch mode and a file rewritten for each
+    * epoch cannot carry it over. Neither can trigger lists since there may
+    * be no next epoch to deliver it with. */
+   if (point-range->pending_offset>local_arg->debounce || args[ARGS_EPOCHMODE].is_set || args[ARGS_CLOSE].is_set || local_arg->outfile==NULL) {
+    flush_pending_range(tinfo, channel_list_index);
+   }
+  }
   channel_list_index++;
  }
 
@@ -404,14 +695,26 @@ write_crossings_exit(transform_info_ptr tinfo) {
  struct write_crossings_storage *local_arg=(struct write_crossings_storage *)tinfo->methods->local_storage;
  transform_argument *args=tinfo->methods->arguments;
 
- if (!args[ARGS_CLOSE].is_set) close_file(tinfo);
+ if (!args[ARGS_CLOSE].is_set) {
+  if (local_arg->ranges_mode) {
+   int channel_list_index;
+   for (channel_list_index=0; channel_list_index<local_arg->channels_in_list; channel_list_index++) {
+    flush_pending_range(tinfo, channel_list_index);
+   }
+  }
+  close_file(tinfo);
+ }
 
  if (args[ARGS_EXTREMA].is_set) {
   array_free(&local_arg->last_three_points);
  } else {
   free_pointer((void **)&local_arg->signs_of_last_diff);
  }
+ free_pointer((void **)&local_arg->ranges);
  free_pointer((void **)&local_arg->channel_list);
+ /* The events of the last epoch, and those flushed above */
+ clear_range_events(tinfo);
+ growing_buf_free(&local_arg->triggers);
 
  tinfo->methods->init_done=FALSE;
 }
@@ -431,7 +734,9 @@ select_write_crossings(transform_info_ptr tinfo) {
   " or a local minimum<=(-threshold) (option -E)\n"
   " If `Output file' is `triggers', the positions are written to the epoch\n"
   " trigger list with code (+-)markerchannelnumber; In 1-channel Extrema\n"
-  " mode, code is set to the (rounded integer) extremal value.\n";
+  " mode, code is set to the (rounded integer) extremal value.\n"
+  " Ranges mode (-r, -m, -d) reports onset and offset of the sections above\n"
+  " threshold with their peak value, -b writes binary records.\n";
  tinfo->methods->local_storage_size=sizeof(struct write_crossings_storage);
  tinfo->methods->nr_of_arguments=NR_OF_ARGUMENTS;
  tinfo->methods->argument_descriptors=argument_descriptors;
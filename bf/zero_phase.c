@@ -121,6 +121,7 @@ select_zero_phase(transform_info_ptr tinfo) {
  tinfo->methods->transform= &zero_phase;
  tinfo->methods->transform_exit= &zero_phase_exit;
  tinfo->methods->method_type=TRANSFORM_METHOD;
+ tinfo->methods->parallel_safe=TRUE;
  tinfo->methods->method_name="zero_phase";
  tinfo->methods->method_description=
   "Method to set, for each incoming complex map, the phase of one channel to\n"
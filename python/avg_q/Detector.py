@@ -1,4 +1,4 @@
-# Copyright (C) 2008-2011,2014,2016 Bernd Feige
+# Copyright (C) 2008-2011,2014,2016,2026 Bernd Feige
 # This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
 """
 Detector base class.
@@ -7,6 +7,7 @@ Detector base class.
 __author__ = "Dr. Bernd Feige <Bernd.Feige@gmx.net>, Tanja Schmitt <schmitt.tanja@web.de>"
 
 import avg_q
+import bisect
 from . import trgfile
 
 def get_trigger_dict(tuples):
@@ -21,6 +22,26 @@ def get_trigger_dict(tuples):
   trigger_dict.setdefault(channel,[]).append((lat,code))
  return trigger_dict
 
+def read_binary_crossings(filename):
+ '''Read the output of "write_crossings -b".
+ Returns the header as dict and the events as numpy record array with the
+ fields position, code, channel (index into header['channelnames'], starting with 1) and value.
+ '''
+ import numpy
+ import struct
+ with open(filename,'rb') as f:
+  magic,header_length=struct.unpack('<8sQ',f.read(16))
+  if magic!=b'AVGQCRS1':
+   raise Exception('read_binary_crossings: %s was not written by write_crossings -b' % filename)
+  header={}
+  for line in f.read(header_length).rstrip(b'\0').decode('utf8').split('\n'):
+   if '=' in line:
+    name,value=line.split('=',maxsplit=1)
+    header[name]=value
+  header['channelnames']=header.get('channelnames','').split('\t')
+  events=numpy.fromfile(f,dtype=[('position','<i8'),('code','<i4'),('channel','<i4'),('value','<f8')])
+ return header,events
+
 class Detector(avg_q.Script):
  distance_from_breakpoint_s=0.5 # Events within that distance are discarded
  def __init__(self,avg_q_instance):
@@ -44,7 +65,7 @@ class Detector(avg_q.Script):
   # Note that we convert into time units because we may have resampling going on before detection
   if self.distance_from_breakpoint_s is not None:
    sfreq=self.avg_q_instance.get_description(self.Epochsource_list[0].infile,'sfreq')
-   self.breakpoints_in_s=[point/sfreq for point in self.avg_q_instance.get_breakpoints(self.Epochsource_list[0].infile)]
+   self.breakpoints_in_s=sorted([point/sfreq for point in self.avg_q_instance.get_breakpoints(self.Epochsource_list[0].infile)])
 
   crossings=trgfile.trgfile(self.runrdr())
   outtuples=[]
@@ -55,7 +76,7 @@ class Detector(avg_q.Script):
     self.sfreq=float(crossings.preamble['Sfreq'])
    if self.detection_start is not None and (point<self.detection_start or point>=self.detection_start+self.detection_length) \
     or maxvalue is not None and float(description)>maxvalue \
-    or self.distance_from_breakpoint_s is not None and any([abs(point/self.sfreq-breakpoint_in_s)<self.distance_from_breakpoint_s for breakpoint_in_s in self.breakpoints_in_s]):
+    or self.distance_from_breakpoint_s is not None and self.near_breakpoint(point/self.sfreq):
     continue
    descriptionitems=[] if description is None else [description]
    if 'Epoch' in crossings.preamble:
@@ -77,6 +98,13 @@ class Detector(avg_q.Script):
    trgout.close()
   return outtuples
 
+ def near_breakpoint(self,point_s):
+  '''Tell whether point_s is closer than distance_from_breakpoint_s to a breakpoint.
+  Only the two breakpoints enclosing point_s need to be checked in the sorted list.
+  '''
+  index=bisect.bisect_left(self.breakpoints_in_s,point_s)
+  return any(abs(point_s-self.breakpoints_in_s[i])<self.distance_from_breakpoint_s for i in (index-1,index) if 0<=i<len(self.breakpoints_in_s))
+
  def get_ranges(self,outtuples,direction=1,min_length=None,debounce_dist=None):
   '''
   takes the trigger tuples and returns a list of channel names and latency ranges in which
@@ -86,6 +114,8 @@ class Detector(avg_q.Script):
   If min_length is defined, ranges shorter than this are discarded.
   If debounce_dist is defined, adjacent accepted ranges separated by less than this distance
   are joined.
+  Note that "write_crossings -m min_duration -d debounce" can do this within avg_q, outputting
+  onset/offset pairs that this function merely collects.
   '''
   expected_code=1 if direction>0 else -1
 
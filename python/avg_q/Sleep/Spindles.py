@@ -1,4 +1,4 @@
-# Copyright (C) 2018 Bernd Feige
+# Copyright (C) 2018,2026 Bernd Feige
 # This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
 
 import avg_q
@@ -52,15 +52,17 @@ collapse_channels
   })
   if self.fixed_threshold:
    self.add_transform('''
-write_crossings collapsed %(threshold)g stdout
+write_crossings -m %(min_duration_ms)gms collapsed %(threshold)g stdout
 ''' % {
+   'min_duration_ms': self.min_duration_ms,
    'threshold': self.threshold_µV,
    })
   else:
    self.add_transform('''
 scale_by invpointquantile %(threshold_quantile)g
-write_crossings collapsed 1 stdout
+write_crossings -m %(min_duration_ms)gms collapsed 1 stdout
 ''' % {
+   'min_duration_ms': self.min_duration_ms,
    'threshold_quantile': self.threshold_quantile,
    })
   self.Spindletriggers=self.detect(outtrigfile, maxvalue)
@@ -0,0 +1,109 @@
+# Copyright (C) 2026 Bernd Feige
+# This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
+"""
+Reader for the binary frames written by the avg_q method write_frame.
+
+Each frame is the 8-byte magic 'AVGQFRM1', the lengths of header and data
+as little-endian uint64, a key=value text header padded to a multiple of 8
+bytes, and the x axis and multiplexed data as little-endian doubles.
+The arrays of the returned epochs are numpy views on the buffer the frame
+was read into (a bytearray for pipes, a memory map for files), so no data
+is copied or parsed; they are read-only for memory-mapped files.
+Trigger positions in epoch.trigpoints are relative to the start of the epoch.
+"""
+
+import mmap
+import struct
+import numpy
+
+from .numpy_Script import numpy_epoch
+
+MAGIC=b'AVGQFRM1'
+prefix=struct.Struct('<8sQQ')
+
+def _epoch_from_header(header):
+ '''Create a numpy_epoch with the fields given in the frame header.'''
+ epoch=numpy_epoch()
+ epoch.sfreq=1.0
+ trigpoints=[]
+ for line in header.rstrip(b'\0').decode('utf8',errors='replace').split('\n'):
+  if '=' not in line: continue
+  name,value=line.split('=',maxsplit=1)
+  if name in ('nr_of_points','nr_of_channels','itemsize','beforetrig'):
+   setattr(epoch,name,int(value))
+  elif name=='nrofaverages':
+   epoch.nrofaverages=int(value)
+  elif name=='sfreq':
+   epoch.sfreq=float(value)
+  elif name=='comment':
+   epoch.comment=value
+  elif name=='xchannelname':
+   epoch.xchannelname=value
+  elif name=='channelnames':
+   epoch.channelnames=value.split('\t') if value else []
+  elif name=='channelpositions':
+   epoch.channelpos=[tuple(float(x) for x in pos.split(' ')) for pos in value.split('\t')] if value else []
+  elif name=='trigger':
+   tup=value.split('\t',maxsplit=2)
+   trigpoints.append((int(tup[0]),int(tup[1]),tup[2] if len(tup)>2 else None))
+ if trigpoints:
+  epoch.trigpoints=trigpoints
+ return epoch
+
+def _set_arrays(epoch,buf,offset):
+ '''Set xdata and data as views on buf, starting at offset.'''
+ epoch.xdata=numpy.frombuffer(buf,dtype='<f8',count=epoch.nr_of_points,offset=offset)
+ offset+=8*epoch.nr_of_points
+ nr_of_values=epoch.nr_of_channels*epoch.itemsize
+ data=numpy.frombuffer(buf,dtype='<f8',count=epoch.nr_of_points*nr_of_values,offset=offset)
+ if epoch.itemsize>1:
+  epoch.data=data.reshape((epoch.nr_of_points,epoch.nr_of_channels,epoch.itemsize))
+ else:
+  epoch.data=data.reshape((epoch.nr_of_points,epoch.nr_of_channels))
+
+def frames(buf):
+ '''Yield the epochs of all frames in buf (bytes, bytearray or mmap).'''
+ offset=0
+ while offset+prefix.size<=len(buf):
+  magic,header_length,data_length=prefix.unpack_from(buf,offset)
+  if magic!=MAGIC:
+   raise Exception('avg_q.frame: No frame at offset %d' % offset)
+  offset+=prefix.size
+  epoch=_epoch_from_header(bytes(buf[offset:offset+header_length]))
+  offset+=header_length
+  _set_arrays(epoch,buf,offset)
+  offset+=data_length
+  yield epoch
+
+def read_file(filename):
+ '''Memory-map a file written by write_frame and return its epochs.
+    The file may be removed after this call, the mapping stays valid.'''
+ with open(filename,'rb') as f:
+  # mmap refuses to map empty files
+  f.seek(0,2)
+  if f.tell()==0: return []
+  buf=mmap.mmap(f.fileno(),0,access=mmap.ACCESS_READ)
+ return list(frames(buf))
+
+def _readinto(stream,buf):
+ view=memoryview(buf)
+ pos=0
+ while pos<len(buf):
+  n=stream.readinto(view[pos:])
+  if not n:
+   raise EOFError('avg_q.frame: Stream ended within a frame')
+  pos+=n
+
+def read_stream(stream):
+ '''Read the next frame from a binary stream, eg the stdout pipe of avg_q.
+    The data is read once into a buffer owned by the returned epoch.'''
+ head=bytearray(prefix.size)
+ _readinto(stream,head)
+ magic,header_length,data_length=prefix.unpack(head)
+ if magic!=MAGIC:
+  raise Exception('avg_q.frame: Stream is not at a frame')
+ buf=bytearray(header_length+data_length)
+ _readinto(stream,buf)
+ epoch=_epoch_from_header(bytes(buf[:header_length]))
+ _set_arrays(epoch,buf,header_length)
+ return epoch
@@ -1,4 +1,4 @@
-# Copyright (C) 2013-2021 Bernd Feige
+# Copyright (C) 2013-2021,2026 Bernd Feige
 # This file is part of avg_q and released under the GPL v3 (see avg_q/COPYING).
 import avg_q
 import numpy
@@ -105,26 +105,36 @@ read_generic -c %(readx)s -s %(sfreq)g -C %(nr_of_channels)d -I %(itemsize)d -e
 
 class numpy_Script(avg_q.Script):
  epochs=[] # List of numpy_epoch objects
- def read(self):
+ def read(self,mapfile=None):
   '''Read the current epoch into numpy array self.data, channels=columns
      We support both reading all epochs from the iterated queue (if no collect
      method is set) and reading the single result of the post-processing queue.
+     The data is transferred as binary frames written by write_frame (see frame.py).
+     By default, they are sent through the stdout pipe; if mapfile is set,
+     they are written to this file, which is then memory-mapped so that the
+     arrays are used in place. mapfile=True selects a temporary file, in
+     /dev/shm if available, which is removed after mapping.
+     As before, epoch.trigpoints holds (point, code, description) tuples
+     with the points counted from the start of the first epoch read, as
+     output by 'query triggers_for_trigfile'; point and code are ints.
   '''
+  from . import frame
+  import os
+  remove_mapfile=False
+  if mapfile is True:
+   import tempfile
+   fd,mapfile=tempfile.mkstemp(suffix='.frames',dir='/dev/shm' if os.path.isdir('/dev/shm') else None)
+   os.close(fd)
+   remove_mapfile=True
   # Save and restore the current state, since we work by (temporally)
   # adding our own transforms
   self.save_state()
-  transform="""
-echo -F stdout Epoch Dataset\\n
-query channelpositions stdout
-query -N comment stdout
-query -N sfreq stdout
-query -N nr_of_points stdout
-query -N beforetrig stdout
-query -N itemsize stdout
-query -N nrofaverages stdout
-query -N triggers_for_trigfile stdout
-echo -F stdout Data:\\n
-write_generic -x stdout float64
+  if mapfile:
+   transform='write_frame %s' % avg_q.escape_filename(mapfile)
+  else:
+   transform="""
+echo -F stdout Frame\\n
+write_frame stdout
 """
   if self.collect=='null_sink':
    self.add_transform(transform)
@@ -132,75 +142,23 @@ write_generic -x stdout float64
    self.add_postprocess(transform)
   rdr=self.runrdr()
   self.epochs=[]
-  while True:
-   try:
-    n=next(rdr)
-   except StopIteration:
-    break
-   if n!='Epoch Dataset': break
-   epoch=numpy_epoch()
-   for r in rdr:
-    if '=' in r: break
-    channelname,x,y,z=r.split('\t')
-    epoch.channelnames.append(channelname)
-    epoch.channelpos.append((float(x),float(y),float(z)))
-   while r:
-    if r=='Data:': break
-    name,value=r.split('=',maxsplit=1)
-    if name=='comment':
-     epoch.comment=value
-    elif name=='sfreq':
-     epoch.sfreq=float(value)
-    elif name=='nr_of_points':
-     epoch.nr_of_points=int(value)
-    elif name=='beforetrig':
-     epoch.beforetrig=int(value)
-    elif name=='itemsize':
-     epoch.itemsize=int(value)
-    elif name=='nrofaverages':
-     epoch.nrofaverages=int(value)
-    elif name=='triggers_for_trigfile':
-     r=value
-     trigpoints=[]
-     while r!='Data:':
-      if not r.startswith('#'):
-       tup=r.split('\t')
-       point=None
-       if len(tup)<2:
-        pass
-       elif len(tup)==2:
-        (point, code)=tup
-        description=None
-       else:
-        (point, code)=tup[0:2]
-        description='\t'.join(tup[2:])
-       if point is not None:
-        trigpoints.append((point, code, description))
-      r=next(rdr)
-     if trigpoints:
-      epoch.trigpoints=trigpoints
-     break
-    r=next(rdr)
-   epoch.nr_of_channels=len(epoch.channelnames)
-   #print(epoch)
-
-   # Problem: If executed too quickly, the read() below will return only partial data...
-   datapoints=epoch.nr_of_points*(1+epoch.nr_of_channels*epoch.itemsize)
-   datalength=8*datapoints
-   buf=self.avg_q_instance.avg_q.stdout.read(datalength)
-   while len(buf)!=datalength:
-    buf2=self.avg_q_instance.avg_q.stdout.read(datalength-len(buf))
-    buf+=buf2
-
-   #print(len(buf))
-   # http://docs.scipy.org/doc/numpy-1.7.0/reference/generated/numpy.frombuffer.html
-   data=numpy.frombuffer(buf,dtype=numpy.float64,count=datapoints)
-   data.shape=(epoch.nr_of_points,1+epoch.nr_of_channels*epoch.itemsize)
-   epoch.xdata=data[:,0]
-   epoch.data=data[:,1:]
-   if epoch.itemsize>1:
-    epoch.data=epoch.data.reshape((epoch.nr_of_points,epoch.nr_of_channels,epoch.itemsize))
-   self.epochs.append(epoch)
+  for r in rdr:
+   if r=='Frame':
+    self.epochs.append(frame.read_stream(self.avg_q_instance.avg_q.stdout))
+  if mapfile:
+   self.epochs=frame.read_file(mapfile)
+   if remove_mapfile:
+    try:
+     os.remove(mapfile)
+    except OSError:
+     # Windows does not allow removing mapped files
+     pass
+  # write_frame stores epoch-relative trigger positions
+  total_points=0
+  for epoch in self.epochs:
+   if epoch.trigpoints:
+    epoch.trigpoints=[(total_points+point,code,description) for point,code,description in epoch.trigpoints]
+   total_points+=epoch.nr_of_points
   self.restore_state()
  def plot_maps(self, ncols=None, vmin=None, vmax=None, globalscale=False, isolines=[0]):
   '''globalscale arranges for vmin,vmax to actually be -1,+1 after global max(abs) scaling.'''